@@ -42,6 +42,15 @@
 #  define CURVE_UNLIKELY(expr) (expr)
 #endif  // INCLUDE_CURVE_COMPILER_SPECIFIC_H_
 
+// 自旋等待时提示cpu降低功耗、让出流水线
+#if defined(__x86_64__) || defined(__i386__)
+#  define CURVE_CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#  define CURVE_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+#  define CURVE_CPU_RELAX() do {} while (0)
+#endif
+
 #ifdef UNIT_TEST
 #define CURVE_MOCK virtual
 #else
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include "src/chunkserver/applied_index_file.h"
+
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include "src/common/crc32.h"
+
+namespace curve {
+namespace chunkserver {
+
+const uint64_t kAppliedIndexFileMagic = 0x4150504c49454458;
+const size_t kAppliedIndexFileSize = 20;
+
+int AppliedIndexFile::Load(const std::string &path, uint64_t *index) {
+    int fd = fs_->Open(path.c_str(), O_RDONLY);
+    if (0 > fd) {
+        LOG(WARNING) << "Failed to open applied index file " << path
+                     << ", ret: " << fd;
+        return -1;
+    }
+
+    char buf[kAppliedIndexFileSize] = {0};
+    int size = fs_->Read(fd, buf, 0, kAppliedIndexFileSize);
+    fs_->Close(fd);
+    if (size != static_cast<int>(kAppliedIndexFileSize)) {
+        LOG(WARNING) << "Failed to read applied index file " << path
+                     << ", ret: " << size;
+        return -1;
+    }
+
+    uint64_t magic;
+    uint32_t crc;
+    memcpy(&magic, buf, sizeof(magic));
+    memcpy(index, buf + 8, sizeof(*index));
+    memcpy(&crc, buf + 16, sizeof(crc));
+    if (magic != kAppliedIndexFileMagic
+        || crc != curve::common::CRC32(buf, 16)) {
+        LOG(WARNING) << "Applied index file " << path << " is corrupted";
+        return -1;
+    }
+    return 0;
+}
+
+int AppliedIndexFile::Save(const std::string &path, uint64_t index) {
+    char buf[kAppliedIndexFileSize];
+    uint64_t magic = kAppliedIndexFileMagic;
+    memcpy(buf, &magic, sizeof(magic));
+    memcpy(buf + 8, &index, sizeof(index));
+    uint32_t crc = curve::common::CRC32(buf, 16);
+    memcpy(buf + 16, &crc, sizeof(crc));
+
+    int fd = fs_->Open(path.c_str(), O_RDWR | O_CREAT);
+    if (0 > fd) {
+        LOG(ERROR) << "Failed to open applied index file " << path
+                   << ", ret: " << fd;
+        return -1;
+    }
+    int ret = fs_->Write(fd, buf, 0, kAppliedIndexFileSize);
+    if (ret != static_cast<int>(kAppliedIndexFileSize)) {
+        LOG(ERROR) << "Failed to write applied index file " << path
+                   << ", ret: " << ret;
+        fs_->Close(fd);
+        return -1;
+    }
+    ret = fs_->Fdatasync(fd);
+    fs_->Close(fd);
+    if (0 != ret) {
+        LOG(ERROR) << "Failed to sync applied index file " << path
+                   << ", ret: " << ret;
+        return -1;
+    }
+    return 0;
+}
+
+}  // namespace chunkserver
+}  // namespace curve
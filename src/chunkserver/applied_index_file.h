@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_APPLIED_INDEX_FILE_H_
+#define SRC_CHUNKSERVER_APPLIED_INDEX_FILE_H_
+
+#include <string>
+#include <memory>
+
+#include "src/fs/local_filesystem.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::fs::LocalFileSystem;
+
+/**
+ * 持久化copyset已经落盘的applied index，重启时跳过回放不大于它的日志
+ * 文件格式为固定长度的二进制记录，每次原地覆盖写并落盘，
+ * 写入不完整时crc校验失败，此时回放所有日志
+ * |  magic  |  index  |  crc32  |
+ * | 8 bytes | 8 bytes | 4 bytes |
+ */
+class AppliedIndexFile {
+ public:
+    explicit AppliedIndexFile(std::shared_ptr<LocalFileSystem> fs)
+        : fs_(fs) {}
+
+    /**
+     * 加载applied index
+     * @param path: 文件路径
+     * @param index: 出参，返回持久化的applied index
+     * @return 0成功；-1失败，包括文件不存在和校验失败
+     */
+    int Load(const std::string &path, uint64_t *index);
+
+    /**
+     * 保存applied index，返回时已经落盘
+     * 调用前index之前的日志对应的数据必须已经落盘
+     * @param path: 文件路径
+     * @param index: applied index
+     * @return 0成功；-1失败
+     */
+    int Save(const std::string &path, uint64_t index);
+
+ private:
+    std::shared_ptr<LocalFileSystem> fs_;
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_APPLIED_INDEX_FILE_H_
@@ -0,0 +1,119 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-30
+ * Author: curve
+ */
+
+#include "src/chunkserver/batch_request.h"
+
+#include <glog/logging.h>
+#include <brpc/closure_guard.h>
+
+#include <utility>
+
+namespace curve {
+namespace chunkserver {
+
+namespace {
+
+// 子请求的closure，析构时释放对上下文的引用
+class BatchSubClosure : public google::protobuf::Closure {
+ public:
+    explicit BatchSubClosure(std::shared_ptr<BatchRequestContext> context)
+        : context_(std::move(context)) {}
+
+    void Run() override {
+        delete this;
+    }
+
+ private:
+    std::shared_ptr<BatchRequestContext> context_;
+};
+
+}  // namespace
+
+BatchRequestContext::BatchRequestContext(brpc::Controller *cntl,
+                                         const BatchChunkRequest *request,
+                                         BatchChunkResponse *response,
+                                         google::protobuf::Closure *done)
+    : cntl_(cntl),
+      request_(request),
+      response_(response),
+      done_(done) {}
+
+BatchRequestContext::~BatchRequestContext() {
+    brpc::ClosureGuard doneGuard(done_);
+    // 读成功的数据按照请求的顺序返回，client根据请求的大小拆分
+    for (int i = 0; i < response_->responses_size(); ++i) {
+        const ChunkRequest &subRequest = request_->requests(i);
+        ChunkResponse *subResponse = response_->mutable_responses(i);
+        if (subRequest.optype() != CHUNK_OP_TYPE::CHUNK_OP_READ
+            || subResponse->status()
+               != CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS) {
+            continue;
+        }
+        butil::IOBuf &data = subCntls_[i]->response_attachment();
+        if (data.size() != subRequest.size()) {
+            LOG(ERROR) << "Batch read data size mismatch, chunk id: "
+                       << subRequest.chunkid()
+                       << ", request size: " << subRequest.size()
+                       << ", data size: " << data.size();
+            subResponse->set_status(
+                CHUNK_OP_STATUS::CHUNK_OP_STATUS_FAILURE_UNKNOWN);
+            continue;
+        }
+        cntl_->response_attachment().append(data);
+    }
+}
+
+int BatchRequestContext::Init() {
+    subCntls_.reserve(request_->requests_size());
+    for (int i = 0; i < request_->requests_size(); ++i) {
+        response_->add_responses()->set_status(
+            CHUNK_OP_STATUS::CHUNK_OP_STATUS_FAILURE_UNKNOWN);
+        subCntls_.emplace_back(new brpc::Controller());
+    }
+
+    butil::IOBuf &data = cntl_->request_attachment();
+    for (int i = 0; i < request_->requests_size(); ++i) {
+        const ChunkRequest &subRequest = request_->requests(i);
+        if (subRequest.optype() != CHUNK_OP_TYPE::CHUNK_OP_WRITE) {
+            continue;
+        }
+        if (data.size() < subRequest.size()) {
+            return -1;
+        }
+        data.cutn(&subCntls_[i]->request_attachment(), subRequest.size());
+    }
+    return data.empty() ? 0 : -1;
+}
+
+void BatchRequestContext::SetStatus(CHUNK_OP_STATUS status) {
+    for (int i = 0; i < response_->responses_size(); ++i) {
+        response_->mutable_responses(i)->set_status(status);
+    }
+}
+
+google::protobuf::Closure *BatchRequestContext::NewSubClosure(
+    std::shared_ptr<BatchRequestContext> context) {
+    return new BatchSubClosure(std::move(context));
+}
+
+}  // namespace chunkserver
+}  // namespace curve
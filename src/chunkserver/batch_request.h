@@ -0,0 +1,89 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-30
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_BATCH_REQUEST_H_
+#define SRC_CHUNKSERVER_BATCH_REQUEST_H_
+
+#include <brpc/controller.h>
+#include <google/protobuf/stubs/callback.h>
+
+#include <memory>
+#include <vector>
+
+#include "proto/chunk.pb.h"
+
+namespace curve {
+namespace chunkserver {
+
+/**
+ * BatchChunk rpc的上下文
+ * 每个子请求使用独立的controller存放写入和读出的数据，子请求按照
+ * 单个请求的流程处理。子请求的closure持有上下文的引用，所有子请求
+ * 返回后上下文析构，按顺序拼接读出的数据并返回rpc
+ */
+class BatchRequestContext {
+ public:
+    BatchRequestContext(brpc::Controller *cntl,
+                        const BatchChunkRequest *request,
+                        BatchChunkResponse *response,
+                        google::protobuf::Closure *done);
+
+    ~BatchRequestContext();
+
+    /**
+     * 为每个子请求创建response和controller，并按照写请求的大小拆分attachment
+     * @return 0成功，-1 attachment的大小与写请求不一致
+     */
+    int Init();
+
+    /**
+     * 设置所有子请求的返回状态，用于在处理子请求之前出错的情况
+     */
+    void SetStatus(CHUNK_OP_STATUS status);
+
+    brpc::Controller *SubController(int index) {
+        return subCntls_[index].get();
+    }
+
+    ChunkResponse *SubResponse(int index) {
+        return response_->mutable_responses(index);
+    }
+
+    /**
+     * 生成子请求的closure，closure执行时释放对上下文的引用
+     */
+    static google::protobuf::Closure *NewSubClosure(
+        std::shared_ptr<BatchRequestContext> context);
+
+ private:
+    brpc::Controller *cntl_;
+    const BatchChunkRequest *request_;
+    BatchChunkResponse *response_;
+    google::protobuf::Closure *done_;
+    // 子请求的controller
+    std::vector<std::unique_ptr<brpc::Controller>> subCntls_;
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_BATCH_REQUEST_H_
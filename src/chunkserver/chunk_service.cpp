@@ -26,6 +26,7 @@
 #include <brpc/closure_guard.h>
 #include <brpc/controller.h>
 
+#include <map>
 #include <memory>
 #include <cerrno>
 #include <vector>
@@ -35,6 +36,7 @@
 #include "src/chunkserver/chunkserver_metrics.h"
 #include "src/chunkserver/op_request.h"
 #include "src/chunkserver/chunk_service_closure.h"
+#include "src/chunkserver/batch_request.h"
 
 namespace curve {
 namespace chunkserver {
@@ -42,7 +44,8 @@ namespace chunkserver {
 ChunkServiceImpl::ChunkServiceImpl(ChunkServiceOptions chunkServiceOptions) :
     chunkServiceOptions_(chunkServiceOptions),
     copysetNodeManager_(chunkServiceOptions.copysetNodeManager),
-    inflightThrottle_(chunkServiceOptions.inflightThrottle) {
+    inflightThrottle_(chunkServiceOptions.inflightThrottle),
+    qosScheduler_(chunkServiceOptions.qosScheduler) {
     maxChunkSize_ = copysetNodeManager_->GetCopysetNodeOptions().maxChunkSize;
 }
 
@@ -94,7 +97,8 @@ void ChunkServiceImpl::WriteChunk(RpcController *controller,
         new (std::nothrow) ChunkServiceClosure(inflightThrottle_,
                                                request,
                                                response,
-                                               done);
+                                               done,
+                                               qosScheduler_);
     CHECK(nullptr != closure) << "new chunk service closure failed";
 
     brpc::ClosureGuard doneGuard(closure);
@@ -134,13 +138,159 @@ void ChunkServiceImpl::WriteChunk(RpcController *controller,
         return;
     }
 
+    if (nullptr != qosScheduler_
+        && qosScheduler_->IsOverLoad(request->volumeid())) {
+        response->set_status(CHUNK_OP_STATUS::CHUNK_OP_STATUS_OVERLOAD);
+        LOG_EVERY_N(WARNING, 100)
+            << "WriteChunk: too many requests queued on volume "
+            << request->volumeid();
+        return;
+    }
+
     std::shared_ptr<WriteChunkRequest>
         req = std::make_shared<WriteChunkRequest>(nodePtr,
                                                   controller,
                                                   request,
                                                   response,
                                                   doneGuard.release());
-    req->Process();
+    ProcessWithQos(controller, request, req);
+}
+
+void ChunkServiceImpl::BatchChunk(RpcController *controller,
+                                  const BatchChunkRequest *request,
+                                  BatchChunkResponse *response,
+                                  Closure *done) {
+    brpc::Controller *cntl = dynamic_cast<brpc::Controller *>(controller);
+    // 上下文接管done，所有子请求返回后才会返回rpc
+    std::shared_ptr<BatchRequestContext> context =
+        std::make_shared<BatchRequestContext>(cntl, request, response, done);
+    if (0 != context->Init()) {
+        context->SetStatus(CHUNK_OP_STATUS::CHUNK_OP_STATUS_INVALID_REQUEST);
+        LOG(ERROR) << "batch chunk request attachment size mismatch: "
+                   << request->logicpoolid() << "," << request->copysetid()
+                   << ", request count: " << request->requests_size()
+                   << ", attachment size: "
+                   << cntl->request_attachment().size();
+        return;
+    }
+
+    bool overLoad = inflightThrottle_->IsOverLoad();
+    auto nodePtr = copysetNodeManager_->GetCopysetNode(request->logicpoolid(),
+                                                       request->copysetid());
+    // 子请求可能属于不同的卷，按卷分组分别调度和计费
+    struct VolumeBatch {
+        std::vector<std::shared_ptr<ChunkOpRequest>> writes;
+        std::vector<std::shared_ptr<ChunkOpRequest>> reads;
+        uint64_t bytes = 0;
+    };
+    std::map<uint64_t, VolumeBatch> batches;
+    for (int i = 0; i < request->requests_size(); ++i) {
+        const ChunkRequest *subRequest = &request->requests(i);
+        ChunkResponse *subResponse = context->SubResponse(i);
+        ChunkServiceClosure* closure =
+            new (std::nothrow) ChunkServiceClosure(
+                inflightThrottle_,
+                subRequest,
+                subResponse,
+                BatchRequestContext::NewSubClosure(context),
+                qosScheduler_);
+        CHECK(nullptr != closure) << "new chunk service closure failed";
+
+        brpc::ClosureGuard doneGuard(closure);
+
+        if (overLoad) {
+            subResponse->set_status(CHUNK_OP_STATUS::CHUNK_OP_STATUS_OVERLOAD);
+            LOG_EVERY_N(WARNING, 100)
+                << "BatchChunk: "
+                << "too many inflight requests to process in chunkserver";
+            continue;
+        }
+
+        // 子请求只能是同一个copyset上的读写请求
+        bool isRead = subRequest->optype() == CHUNK_OP_TYPE::CHUNK_OP_READ;
+        bool isWrite = subRequest->optype() == CHUNK_OP_TYPE::CHUNK_OP_WRITE;
+        if ((!isRead && !isWrite)
+            || subRequest->logicpoolid() != request->logicpoolid()
+            || subRequest->copysetid() != request->copysetid()
+            || !CheckRequestOffsetAndLength(subRequest->offset(),
+                                            subRequest->size())) {
+            subResponse->set_status(
+                CHUNK_OP_STATUS::CHUNK_OP_STATUS_INVALID_REQUEST);
+            LOG(ERROR) << "Invalid batch I/O request, op: "
+                       << subRequest->optype()
+                       << " copyset: " << subRequest->logicpoolid()
+                       << "," << subRequest->copysetid()
+                       << " offset: " << subRequest->offset()
+                       << " size: " << subRequest->size()
+                       << " max size: " << maxChunkSize_;
+            continue;
+        }
+
+        if (nullptr == nodePtr) {
+            subResponse->set_status(
+                CHUNK_OP_STATUS::CHUNK_OP_STATUS_COPYSET_NOTEXIST);
+            LOG(WARNING) << "batch chunk failed, copyset node is not found:"
+                         << request->logicpoolid() << ","
+                         << request->copysetid();
+            continue;
+        }
+
+        if (nullptr != qosScheduler_
+            && qosScheduler_->IsOverLoad(subRequest->volumeid())) {
+            subResponse->set_status(CHUNK_OP_STATUS::CHUNK_OP_STATUS_OVERLOAD);
+            LOG_EVERY_N(WARNING, 100)
+                << "BatchChunk: too many requests queued on volume "
+                << subRequest->volumeid();
+            continue;
+        }
+
+        VolumeBatch& batch = batches[subRequest->volumeid()];
+        batch.bytes += subRequest->size();
+        if (isRead) {
+            batch.reads.push_back(std::make_shared<ReadChunkRequest>(
+                nodePtr,
+                chunkServiceOptions_.cloneManager,
+                context->SubController(i),
+                subRequest,
+                subResponse,
+                doneGuard.release()));
+        } else {
+            batch.writes.push_back(std::make_shared<WriteChunkRequest>(
+                nodePtr,
+                context->SubController(i),
+                subRequest,
+                subResponse,
+                doneGuard.release()));
+        }
+    }
+
+    for (const auto &item : batches) {
+        const VolumeBatch& batch = item.second;
+        auto writes = batch.writes;
+        auto reads = batch.reads;
+        auto process = [writes, reads]() {
+            ChunkOpRequest::ProposeBatch(writes);
+            for (const auto &read : reads) {
+                read->Process();
+            }
+        };
+        if (nullptr == qosScheduler_) {
+            process();
+            continue;
+        }
+
+        // 每个卷的子请求作为一次IO调度，其余的IO次数补扣到该卷
+        uint64_t volumeId = item.first;
+        QosRequest qosRequest;
+        qosRequest.volumeId = volumeId;
+        qosRequest.client = butil::ip2str(cntl->remote_side().ip).c_str();
+        qosRequest.bytes = batch.bytes;
+        uint32_t count = writes.size() + reads.size();
+        qosScheduler_->Submit(qosRequest, process);
+        if (count > 1) {
+            qosScheduler_->Charge(volumeId, count - 1);
+        }
+    }
 }
 
 void ChunkServiceImpl::CreateCloneChunk(RpcController *controller,
@@ -209,7 +359,8 @@ void ChunkServiceImpl::ReadChunk(RpcController *controller,
         new (std::nothrow) ChunkServiceClosure(inflightThrottle_,
                                                request,
                                                response,
-                                               done);
+                                               done,
+                                               qosScheduler_);
     CHECK(nullptr != closure) << "new chunk service closure failed";
 
     brpc::ClosureGuard doneGuard(closure);
@@ -243,6 +394,15 @@ void ChunkServiceImpl::ReadChunk(RpcController *controller,
         return;
     }
 
+    if (nullptr != qosScheduler_
+        && qosScheduler_->IsOverLoad(request->volumeid())) {
+        response->set_status(CHUNK_OP_STATUS::CHUNK_OP_STATUS_OVERLOAD);
+        LOG_EVERY_N(WARNING, 100)
+            << "ReadChunk: too many requests queued on volume "
+            << request->volumeid();
+        return;
+    }
+
     std::shared_ptr<ReadChunkRequest> req =
         std::make_shared<ReadChunkRequest>(nodePtr,
                                            chunkServiceOptions_.cloneManager,
@@ -250,7 +410,7 @@ void ChunkServiceImpl::ReadChunk(RpcController *controller,
                                            request,
                                            response,
                                            doneGuard.release());
-    req->Process();
+    ProcessWithQos(controller, request, req);
 }
 
 void ChunkServiceImpl::RecoverChunk(RpcController *controller,
@@ -534,6 +694,26 @@ void ChunkServiceImpl::GetChunkHash(RpcController *controller,
     }
 }
 
+void ChunkServiceImpl::ProcessWithQos(
+    RpcController *controller,
+    const ChunkRequest *request,
+    std::shared_ptr<ChunkOpRequest> opRequest) {
+    if (nullptr == qosScheduler_) {
+        opRequest->Process();
+        return;
+    }
+    brpc::Controller *cntl = dynamic_cast<brpc::Controller *>(controller);
+    QosRequest qosRequest;
+    qosRequest.volumeId = request->volumeid();
+    if (nullptr != cntl) {
+        qosRequest.client = butil::ip2str(cntl->remote_side().ip).c_str();
+    }
+    qosRequest.bytes = request->size();
+    qosScheduler_->Submit(qosRequest, [opRequest]() {
+        opRequest->Process();
+    });
+}
+
 bool ChunkServiceImpl::CheckRequestOffsetAndLength(uint32_t offset,
                                                    uint32_t len) {
     // 检查offset+len是否越界
@@ -37,6 +37,7 @@ using ::google::protobuf::RpcController;
 using ::google::protobuf::Closure;
 
 class CopysetNodeManager;
+class ChunkOpRequest;
 
 class ChunkServiceImpl : public ChunkService {
  public:
@@ -58,6 +59,15 @@ class ChunkServiceImpl : public ChunkService {
                     ChunkResponse *response,
                     Closure *done);
 
+    /**
+     * 同一个copyset上的多个读写请求，每个子请求单独返回结果，
+     * 其中的写请求合并成一条raft日志propose
+     */
+    void BatchChunk(RpcController *controller,
+                    const BatchChunkRequest *request,
+                    BatchChunkResponse *response,
+                    Closure *done);
+
     void ReadChunkSnapshot(RpcController *controller,
                            const ChunkRequest *request,
                            ChunkResponse *response,
@@ -100,10 +110,21 @@ class ChunkServiceImpl : public ChunkService {
      */
     bool CheckRequestOffsetAndLength(uint32_t offset, uint32_t len);
 
+    /**
+     * 读写请求经过QoS调度之后再处理，没有开启QoS时直接处理
+     * @param controller[in]: rpc controller，用于获取请求来源
+     * @param request[in]: rpc请求
+     * @param opRequest[in]: 待处理的op request
+     */
+    void ProcessWithQos(RpcController *controller,
+                        const ChunkRequest *request,
+                        std::shared_ptr<ChunkOpRequest> opRequest);
+
  private:
     ChunkServiceOptions chunkServiceOptions_;
     CopysetNodeManager  *copysetNodeManager_;
     std::shared_ptr<InflightThrottle> inflightThrottle_;
+    std::shared_ptr<QosScheduler> qosScheduler_;
     uint32_t            maxChunkSize_;
 };
 
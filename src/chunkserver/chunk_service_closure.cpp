@@ -40,6 +40,7 @@ void ChunkServiceClosure::Run() {
         brpc::ClosureGuard doneGuard(brpcDone_);
         // 记录请求处理结果，收集到metric中
         OnResonse();
+        OnQosCost();
     }
 
     // closure调用的时候减1，closure创建的什么加1
@@ -87,6 +88,18 @@ void ChunkServiceClosure::OnRequest() {
     }
 }
 
+void ChunkServiceClosure::OnQosCost() {
+    if (qosScheduler_ == nullptr || request_ == nullptr
+        || response_ == nullptr || !response_->has_phasecost()) {
+        return;
+    }
+    // 下发时已经按一次IO扣除了令牌
+    int32_t cost = response_->phasecost().cost();
+    if (cost > 1) {
+        qosScheduler_->Charge(request_->volumeid(), cost - 1);
+    }
+}
+
 void ChunkServiceClosure::OnResonse() {
     // 如果request或者response为空就不统计metric
     if (request_ == nullptr || response_ == nullptr)
@@ -29,6 +29,7 @@
 #include "proto/chunk.pb.h"
 #include "src/chunkserver/op_request.h"
 #include "src/chunkserver/inflight_throttle.h"
+#include "src/chunkserver/qos_scheduler.h"
 #include "src/common/timeutility.h"
 
 namespace curve {
@@ -41,8 +42,10 @@ class ChunkServiceClosure : public braft::Closure {
             std::shared_ptr<InflightThrottle> inflightThrottle,
             const ChunkRequest *request,
             ChunkResponse *response,
-            google::protobuf::Closure *done)
+            google::protobuf::Closure *done,
+            std::shared_ptr<QosScheduler> qosScheduler = nullptr)
         : inflightThrottle_(inflightThrottle)
+        , qosScheduler_(qosScheduler)
         , request_(request)
         , response_(response)
         , brpcDone_(done)
@@ -73,10 +76,16 @@ class ChunkServiceClosure : public braft::Closure {
      * 记录请求处理的结果，例如请求是否出错、请求的延时等
      */
     void OnResonse();
+    /**
+     * 将写请求实际产生的额外IO补扣到QoS中
+     */
+    void OnQosCost();
 
  private:
     // inflight流控
     std::shared_ptr<InflightThrottle> inflightThrottle_;
+    // 卷级别的QoS
+    std::shared_ptr<QosScheduler> qosScheduler_;
     // rpc请求的request
     const ChunkRequest *request_;
     // rpc请求的response
@@ -41,6 +41,7 @@
 #include "src/chunkserver/raftsnapshot/curve_snapshot_attachment.h"
 #include "src/chunkserver/raftsnapshot/curve_file_service.h"
 #include "src/chunkserver/raftsnapshot/curve_snapshot_storage.h"
+#include "src/chunkserver/raftlog/curve_shared_log_storage.h"
 #include "src/common/curve_version.h"
 
 using ::curve::fs::LocalFileSystem;
@@ -74,6 +75,12 @@ void RegisterCurveSnapshotStorageOrDie() {
                                     "curve", &snapshotStorage);
 }
 
+void RegisterCurveSharedLogStorageOrDie() {
+    static CurveSharedLogStorage logStorage;
+    braft::log_storage_extension()->RegisterOrDie(
+                                    kSharedLogProtocol, &logStorage);
+}
+
 int ChunkServer::Run(int argc, char** argv) {
     gflags::ParseCommandLineFlags(&argc, &argv, true);
 
@@ -108,11 +115,18 @@ int ChunkServer::Run(int argc, char** argv) {
 
     // 初始化并发持久模块
     ConcurrentApplyModule concurrentapply;
-    int size;
-    LOG_IF(FATAL, !conf.GetIntValue("concurrentapply.size", &size));
-    int qdepth;
-    LOG_IF(FATAL, !conf.GetIntValue("concurrentapply.queuedepth", &qdepth));
-    LOG_IF(FATAL, false == concurrentapply.Init(size, qdepth))
+    ConcurrentApplyOption concurrentApplyOptions;
+    LOG_IF(FATAL, !conf.GetIntValue("concurrentapply.size",
+                                    &concurrentApplyOptions.wconcurrentsize));
+    LOG_IF(FATAL, !conf.GetIntValue("concurrentapply.queuedepth",
+                                    &concurrentApplyOptions.wqueuedepth));
+    LOG_IF(FATAL, !conf.GetIntValue("concurrentapply.max_merge_count",
+                                    &concurrentApplyOptions.maxmerge));
+    LOG_IF(FATAL, !conf.GetIntValue("concurrentapply.read_size",
+                                    &concurrentApplyOptions.rconcurrentsize));
+    LOG_IF(FATAL, !conf.GetIntValue("concurrentapply.read_queuedepth",
+                                    &concurrentApplyOptions.rqueuedepth));
+    LOG_IF(FATAL, false == concurrentapply.Init(concurrentApplyOptions))
         << "Failed to initialize concurrentapply module!";
 
     // 初始化本地文件系统
@@ -121,6 +135,10 @@ int ChunkServer::Run(int argc, char** argv) {
     LocalFileSystemOption lfsOption;
     LOG_IF(FATAL, !conf.GetBoolValue(
         "fs.enable_renameat2", &lfsOption.enableRenameat2));
+    LOG_IF(FATAL, !conf.GetBoolValue(
+        "fs.enable_io_uring", &lfsOption.enableIOUring));
+    LOG_IF(FATAL, !conf.GetUInt32Value(
+        "fs.io_uring_depth", &lfsOption.ioUringDepth));
     LOG_IF(FATAL, 0 != fs->Init(lfsOption))
         << "Failed to initialize local filesystem module!";
 
@@ -182,6 +200,14 @@ int ChunkServer::Run(int argc, char** argv) {
     trash_ = std::make_shared<Trash>();
     LOG_IF(FATAL, trash_->Init(trashOptions) != 0)
         << "Failed to init Trash";
+    // 后台补充chunkfilepool时优先复用trash中已过期的chunk
+    std::weak_ptr<Trash> weakTrash = trash_;
+    chunkfilePool->SetTrashReclaimer([weakTrash]() {
+        std::shared_ptr<Trash> trash = weakTrash.lock();
+        if (trash != nullptr) {
+            trash->DeleteEligibleFileInTrash();
+        }
+    });
 
     // 初始化复制组管理模块
     CopysetNodeOptions copysetNodeOptions;
@@ -190,6 +216,21 @@ int ChunkServer::Run(int argc, char** argv) {
     copysetNodeOptions.chunkfilePool = chunkfilePool;
     copysetNodeOptions.localFileSystem = fs;
     copysetNodeOptions.trash = trash_;
+    // chunk文件未写零时，必须记录page的写入状态，否则会读到其他chunk的旧数据
+    LOG_IF(FATAL, !chunkFilePoolOptions.needWriteZero
+                  && !copysetNodeOptions.trackWrittenPages)
+        << "chunkfilepool.need_write_zero=false requires "
+        << "storeng.track_written_pages=true";
+    if (copysetNodeOptions.maxOpenChunkFiles > 0) {
+        copysetNodeOptions.fdCache = std::make_shared<ChunkFdCache>(
+            copysetNodeOptions.maxOpenChunkFiles);
+    }
+    if (copysetNodeOptions.readCacheCapacityMB > 0) {
+        copysetNodeOptions.readCache = std::make_shared<ChunkReadCache>(
+            static_cast<uint64_t>(copysetNodeOptions.readCacheCapacityMB)
+                * 1024 * 1024,
+            copysetNodeOptions.pageSize);
+    }
 
     // install snapshot的带宽限制
     int snapshotThroughputBytes;
@@ -223,6 +264,9 @@ int ChunkServer::Run(int argc, char** argv) {
     // 注册curve snapshot storage
     RegisterCurveSnapshotStorageOrDie();
     CurveSnapshotStorage::set_server_addr(endPoint);
+    // 注册共享日志storage，copyset.raft_log_uri为curve_shared://时使用
+    RegisterCurveSharedLogStorageOrDie();
+    CurveSharedLogStorage::set_file_system(fs);
     copysetNodeManager_ = &CopysetNodeManager::GetInstance();
     LOG_IF(FATAL, copysetNodeManager_->Init(copysetNodeOptions) != 0)
         << "Failed to initialize CopysetNodeManager.";
@@ -240,6 +284,7 @@ int ChunkServer::Run(int argc, char** argv) {
     // 监控部分模块的metric指标
     metric->MonitorTrash(trash_.get());
     metric->MonitorChunkFilePool(chunkfilePool.get());
+    metric->MonitorConcurrentApply(&concurrentapply);
     metric->ExposeConfigMetric(&conf);
 
     // ========================添加rpc服务===============================//
@@ -261,11 +306,24 @@ int ChunkServer::Run(int argc, char** argv) {
         = std::make_shared<InflightThrottle>(maxInflight);
     CHECK(nullptr != inflightThrottle) << "new inflight throttle failed";
 
+    // qos scheduler
+    bool enableQos = false;
+    LOG_IF(FATAL, !conf.GetBoolValue("qos.enable", &enableQos));
+    std::shared_ptr<QosScheduler> qosScheduler;
+    if (enableQos) {
+        QosSchedulerOptions qosSchedulerOptions;
+        InitQosSchedulerOptions(&conf, &qosSchedulerOptions);
+        qosScheduler = std::make_shared<QosScheduler>(qosSchedulerOptions);
+        LOG_IF(FATAL, qosScheduler->Init() != 0)
+            << "Failed to init qos scheduler.";
+    }
+
     // chunk service
     ChunkServiceOptions chunkServiceOptions;
     chunkServiceOptions.copysetNodeManager = copysetNodeManager_;
     chunkServiceOptions.cloneManager = &cloneManager_;
     chunkServiceOptions.inflightThrottle = inflightThrottle;
+    chunkServiceOptions.qosScheduler = qosScheduler;
     ChunkServiceImpl chunkService(chunkServiceOptions);
     ret = server.AddService(&chunkService,
                         brpc::SERVER_DOESNT_OWN_SERVICE);
@@ -302,7 +360,8 @@ int ChunkServer::Run(int argc, char** argv) {
     CHECK(0 == ret) << "Fail to add FileService";
 
     // chunkserver service
-    ChunkServerServiceImpl chunkserverService(copysetNodeManager_);
+    ChunkServerServiceImpl chunkserverService(copysetNodeManager_,
+                                              qosScheduler.get());
     ret = server.AddService(&chunkserverService,
         brpc::SERVER_DOESNT_OWN_SERVICE);
     CHECK(0 == ret) << "Fail to add ChunkServerService";
@@ -334,6 +393,9 @@ int ChunkServer::Run(int argc, char** argv) {
     server.RunUntilAskedToQuit();
 
     LOG(INFO) << "ChunkServer is going to quit.";
+    if (nullptr != qosScheduler) {
+        qosScheduler->Fini();
+    }
     LOG_IF(ERROR, heartbeat_.Fini() != 0)
         << "Failed to shutdown heartbeat manager.";
     LOG_IF(ERROR, copysetNodeManager_->Fini() != 0)
@@ -344,6 +406,7 @@ int ChunkServer::Run(int argc, char** argv) {
         << "Failed to shutdown clone copyer.";
     LOG_IF(ERROR, trash_->Fini() != 0)
         << "Failed to shutdown trash.";
+    chunkfilePool->UnInitialize();
     concurrentapply.Stop();
 
     google::ShutdownGoogleLogging();
@@ -365,6 +428,19 @@ void ChunkServer::InitChunkFilePoolOptions(
     LOG_IF(FATAL, !conf->GetBoolValue(
         "chunkfilepool.enable_get_chunk_from_pool",
         &chunkFilePoolOptions->getChunkFromPool));
+    LOG_IF(FATAL, !conf->GetBoolValue("storeng.direct_io",
+        &chunkFilePoolOptions->directIO));
+    LOG_IF(FATAL, !conf->GetBoolValue("chunkfilepool.need_write_zero",
+        &chunkFilePoolOptions->needWriteZero));
+    LOG_IF(FATAL, !conf->GetBoolValue("chunkfilepool.enable_refill",
+        &chunkFilePoolOptions->enableRefill));
+    LOG_IF(FATAL, !conf->GetUInt32Value("chunkfilepool.refill_low_watermark",
+        &chunkFilePoolOptions->refillLowWatermark));
+    LOG_IF(FATAL, !conf->GetUInt32Value("chunkfilepool.refill_high_watermark",
+        &chunkFilePoolOptions->refillHighWatermark));
+    LOG_IF(FATAL, !conf->GetUInt64Value(
+        "chunkfilepool.refill_throughput_bytes",
+        &chunkFilePoolOptions->refillThroughputBytes));
 
     if (chunkFilePoolOptions->getChunkFromPool == false) {
         std::string chunkFilePoolUri;
@@ -420,6 +496,55 @@ void ChunkServer::InitCopysetNodeOptions(
         &copysetNodeOptions->finishLoadMargin));
     LOG_IF(FATAL, !conf->GetUInt32Value("copyset.check_loadmargin_interval_ms",
         &copysetNodeOptions->checkLoadMarginIntervalMs));
+    LOG_IF(FATAL, !conf->GetBoolValue("copyset.enable_propose_batch",
+        &copysetNodeOptions->enableProposeBatch));
+    LOG_IF(FATAL, !conf->GetUInt32Value("copyset.propose_batch_window_us",
+        &copysetNodeOptions->proposeBatchWindowUs));
+    LOG_IF(FATAL, !conf->GetUInt32Value("copyset.propose_batch_max_count",
+        &copysetNodeOptions->proposeBatchMaxCount));
+    LOG_IF(FATAL, !conf->GetUInt32Value("copyset.propose_batch_max_bytes",
+        &copysetNodeOptions->proposeBatchMaxBytes));
+    LOG_IF(FATAL, !conf->GetBoolValue("storeng.sync_write",
+        &copysetNodeOptions->syncWrite));
+    LOG_IF(FATAL, !conf->GetUInt64Value("storeng.sync_index_margin",
+        &copysetNodeOptions->syncIndexMargin));
+    LOG_IF(FATAL, !conf->GetUInt32Value("storeng.sync_interval_ms",
+        &copysetNodeOptions->syncIntervalMs));
+    LOG_IF(FATAL, !conf->GetBoolValue("storeng.direct_io",
+        &copysetNodeOptions->directIO));
+    LOG_IF(FATAL, !conf->GetUInt32Value("storeng.max_open_chunk_files",
+        &copysetNodeOptions->maxOpenChunkFiles));
+    LOG_IF(FATAL, !conf->GetUInt32Value("storeng.read_cache_capacity_mb",
+        &copysetNodeOptions->readCacheCapacityMB));
+    LOG_IF(FATAL, !conf->GetBoolValue("storeng.enable_chunk_manifest",
+        &copysetNodeOptions->enableChunkManifest));
+    LOG_IF(FATAL, !conf->GetBoolValue("storeng.batch_clone_bitmap",
+        &copysetNodeOptions->batchCloneBitmap));
+    LOG_IF(FATAL, !conf->GetBoolValue("storeng.track_written_pages",
+        &copysetNodeOptions->trackWrittenPages));
+    LOG_IF(FATAL, !conf->GetBoolValue(
+        "storeng.enable_applied_index_checkpoint",
+        &copysetNodeOptions->enableAppliedIndexCheckpoint));
+}
+
+void ChunkServer::InitQosSchedulerOptions(
+    common::Configuration *conf, QosSchedulerOptions *qosSchedulerOptions) {
+    LOG_IF(FATAL, !conf->GetUInt64Value("qos.disk_iops",
+        &qosSchedulerOptions->diskLimit.iops));
+    LOG_IF(FATAL, !conf->GetUInt64Value("qos.disk_bps",
+        &qosSchedulerOptions->diskLimit.bps));
+    LOG_IF(FATAL, !conf->GetUInt64Value("qos.volume_iops",
+        &qosSchedulerOptions->volumeLimit.iops));
+    LOG_IF(FATAL, !conf->GetUInt64Value("qos.volume_bps",
+        &qosSchedulerOptions->volumeLimit.bps));
+    LOG_IF(FATAL, !conf->GetUInt64Value("qos.client_iops",
+        &qosSchedulerOptions->clientLimit.iops));
+    LOG_IF(FATAL, !conf->GetUInt64Value("qos.client_bps",
+        &qosSchedulerOptions->clientLimit.bps));
+    LOG_IF(FATAL, !conf->GetUInt32Value("qos.volume_max_queue_depth",
+        &qosSchedulerOptions->maxVolumeQueueDepth));
+    LOG_IF(FATAL, !conf->GetUInt32Value("qos.idle_timeout_s",
+        &qosSchedulerOptions->idleTimeoutS));
 }
 
 void ChunkServer::InitCopyerOptions(
@@ -77,6 +77,9 @@ class ChunkServer {
     void InitMetricOptions(common::Configuration *conf,
         ChunkServerMetricOptions *metricOptions);
 
+    void InitQosSchedulerOptions(common::Configuration *conf,
+        QosSchedulerOptions *qosSchedulerOptions);
+
     void LoadConfigFromCmdline(common::Configuration *conf);
 
     int GetChunkServerMetaFromLocal(const std::string &storeUri,
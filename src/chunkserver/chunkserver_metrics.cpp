@@ -24,6 +24,7 @@
 #include <vector>
 #include <map>
 
+#include "src/chunkserver/concurrent_apply.h"
 #include "src/chunkserver/copyset_node_manager.h"
 #include "src/chunkserver/passive_getfn.h"
 
@@ -200,6 +201,28 @@ int CSCopysetMetric::Init(const LogicPoolID& logicPoolId,
                    << " metric failed.";
         return -1;
     }
+    ret = snapshotFlushLatency_.expose(Prefix(), "snapshot_flush_stall");
+    if (ret != 0) {
+        LOG(ERROR) << "Init Copyset ("
+                   << logicPoolId << "," << copysetId << ")"
+                   << " snapshot flush metric failed.";
+        return -1;
+    }
+    ret = followerReadCount_.expose_as(Prefix(), "follower_read");
+    if (ret != 0) {
+        LOG(ERROR) << "Init Copyset ("
+                   << logicPoolId << "," << copysetId << ")"
+                   << " follower read metric failed.";
+        return -1;
+    }
+    ret = followerReadRedirectCount_.expose_as(Prefix(),
+                                               "follower_read_redirect");
+    if (ret != 0) {
+        LOG(ERROR) << "Init Copyset ("
+                   << logicPoolId << "," << copysetId << ")"
+                   << " follower read redirect metric failed.";
+        return -1;
+    }
     return 0;
 }
 
@@ -213,6 +236,14 @@ void CSCopysetMetric::MonitorDataStore(CSDataStore* datastore) {
         snapshotCountPrefix, GetDatastoreSnapshotCountFunc, datastore);
     cloneChunkCount_ = std::make_shared<bvar::PassiveStatus<uint32_t>>(
         cloneChunkCountPrefix, GetDatastoreCloneChunkCountFunc, datastore);
+    readCacheHit_ = std::make_shared<bvar::PassiveStatus<uint64_t>>(
+        Prefix() + "_read_cache_hit", GetDatastoreReadCacheHitFunc, datastore);
+    readCacheMiss_ = std::make_shared<bvar::PassiveStatus<uint64_t>>(
+        Prefix() + "_read_cache_miss", GetDatastoreReadCacheMissFunc,
+        datastore);
+    readCacheHitRatio_ = std::make_shared<bvar::PassiveStatus<double>>(
+        Prefix() + "_read_cache_hit_ratio", GetDatastoreReadCacheHitRatioFunc,
+        datastore);
 }
 
 ChunkServerMetric::ChunkServerMetric()
@@ -377,6 +408,16 @@ void ChunkServerMetric::MonitorChunkFilePool(ChunkfilePool* chunkfilePool) {
     std::string chunkLeftPrefix = Prefix() + "_chunkfilepool_left";
     chunkLeft_ = std::make_shared<bvar::PassiveStatus<uint32_t>>(
         chunkLeftPrefix, GetChunkLeftFunc, chunkfilePool);
+
+    ChunkfilePoolMetric* poolMetric = chunkfilePool->GetMetric();
+    poolMetric->refillChunkCount.expose_as(
+        Prefix(), "chunkfilepool_refill_count");
+    poolMetric->recycleChunkCount.expose_as(
+        Prefix(), "chunkfilepool_recycle_count");
+    poolMetric->syncAllocChunkCount.expose_as(
+        Prefix(), "chunkfilepool_sync_alloc_count");
+    poolMetric->getChunkFailCount.expose_as(
+        Prefix(), "chunkfilepool_get_fail_count");
 }
 
 void ChunkServerMetric::MonitorTrash(Trash* trash) {
@@ -389,6 +430,23 @@ void ChunkServerMetric::MonitorTrash(Trash* trash) {
         chunkTrashedPrefix, GetChunkTrashedFunc, trash);
 }
 
+void ChunkServerMetric::MonitorConcurrentApply(
+    ConcurrentApplyModule* concurrentApply) {
+    if (!option_.collectMetric) {
+        return;
+    }
+
+    for (int i = 0; i < concurrentApply->WorkerCount(); ++i) {
+        ApplyWorkerMetric* workerMetric = concurrentApply->GetWorkerMetric(i);
+        std::string worker = "concurrentapply_worker_" + std::to_string(i);
+        workerMetric->busyUs.expose_as(Prefix(), worker + "_busy_us");
+        workerMetric->busyUsPerSecond.expose_as(
+            Prefix(), worker + "_busy_us_per_second");
+        workerMetric->taskCount.expose_as(Prefix(), worker + "_task_count");
+        workerMetric->stealCount.expose_as(Prefix(), worker + "_steal_count");
+    }
+}
+
 void ChunkServerMetric::IncreaseLeaderCount() {
     if (!option_.collectMetric) {
         return;
@@ -48,6 +48,7 @@ class CopysetNodeManager;
 class ChunkfilePool;
 class CSDataStore;
 class Trash;
+class ConcurrentApplyModule;
 
 template <typename Tp>
 using PassiveStatusPtr = std::shared_ptr<bvar::PassiveStatus<Tp>>;
@@ -183,7 +184,10 @@ class CSCopysetMetric {
         , copysetId_(0)
         , chunkCount_(nullptr)
         , snapshotCount_(nullptr)
-        , cloneChunkCount_(nullptr) {}
+        , cloneChunkCount_(nullptr)
+        , readCacheHit_(nullptr)
+        , readCacheMiss_(nullptr)
+        , readCacheHitRatio_(nullptr) {}
 
     ~CSCopysetMetric() {}
 
@@ -196,7 +200,7 @@ class CSCopysetMetric {
     int Init(const LogicPoolID& logicPoolId, const CopysetID& copysetId);
 
     /**
-     * 监控DataStore指标，主要包括chunk的数量、快照的数量等
+     * 监控DataStore指标，主要包括chunk的数量、快照的数量、读缓存命中率等
      * @param datastore: 该copyset下的datastore指针
      */
     void MonitorDataStore(CSDataStore* datastore);
@@ -233,6 +237,38 @@ class CSCopysetMetric {
         return ioMetrics_.GetIOMetric(type);
     }
 
+    /**
+     * 记录打快照时等待本copyset的IO落盘的时间，这段时间内copyset的apply被阻塞
+     * @param latUs: 等待的时间
+     */
+    void OnSnapshotFlush(int64_t latUs) {
+        snapshotFlushLatency_ << latUs;
+    }
+
+    const bvar::LatencyRecorder& GetSnapshotFlushLatency() const {
+        return snapshotFlushLatency_;
+    }
+
+    /**
+     * 记录follower上携带applied index的读请求
+     * @param served: 为true表示在follower上直接读，false表示重定向到leader
+     */
+    void OnFollowerRead(bool served) {
+        if (served) {
+            followerReadCount_ << 1;
+        } else {
+            followerReadRedirectCount_ << 1;
+        }
+    }
+
+    uint64_t GetFollowerReadCount() const {
+        return followerReadCount_.get_value();
+    }
+
+    uint64_t GetFollowerReadRedirectCount() const {
+        return followerReadRedirectCount_.get_value();
+    }
+
     const uint32_t GetChunkCount() const {
         if (chunkCount_ == nullptr) {
             return 0;
@@ -254,6 +290,27 @@ class CSCopysetMetric {
         return cloneChunkCount_->get_value();
     }
 
+    const uint64_t GetReadCacheHitCount() const {
+        if (readCacheHit_ == nullptr) {
+            return 0;
+        }
+        return readCacheHit_->get_value();
+    }
+
+    const uint64_t GetReadCacheMissCount() const {
+        if (readCacheMiss_ == nullptr) {
+            return 0;
+        }
+        return readCacheMiss_->get_value();
+    }
+
+    const double GetReadCacheHitRatio() const {
+        if (readCacheHitRatio_ == nullptr) {
+            return 0;
+        }
+        return readCacheHitRatio_->get_value();
+    }
+
  private:
     inline std::string Prefix() {
         return "copyset_"
@@ -273,8 +330,18 @@ class CSCopysetMetric {
     PassiveStatusPtr<uint32_t> snapshotCount_;
     // copyset上的 clone chunk 的数量
     PassiveStatusPtr<uint32_t> cloneChunkCount_;
+    // copyset上读缓存命中和未命中的page数，以及命中率
+    PassiveStatusPtr<uint64_t> readCacheHit_;
+    PassiveStatusPtr<uint64_t> readCacheMiss_;
+    PassiveStatusPtr<double> readCacheHitRatio_;
     // copyset上的IO类型的metric统计
     CSIOMetric ioMetrics_;
+    // 打快照时等待IO落盘导致apply阻塞的时间
+    bvar::LatencyRecorder snapshotFlushLatency_;
+    // 在follower上直接读的请求数
+    bvar::Adder<uint64_t> followerReadCount_;
+    // follower还没有apply到请求的applied index，重定向到leader的读请求数
+    bvar::Adder<uint64_t> followerReadRedirectCount_;
 };
 
 struct ChunkServerMetricOptions {
@@ -421,7 +488,7 @@ class ChunkServerMetric : public Uncopyable {
                             const CopysetID& copysetId);
 
     /**
-     * 监视chunk分配池，主要监视池中chunk的数量
+     * 监视chunk分配池，主要监视池中chunk的数量以及补充、回收chunk的统计
      * @param chunkfilePool: ChunkfilePool的对象指针
      */
     void MonitorChunkFilePool(ChunkfilePool* chunkfilePool);
@@ -432,6 +499,12 @@ class ChunkServerMetric : public Uncopyable {
      */
     void MonitorTrash(Trash* trash);
 
+    /**
+     * 监视并发apply模块，主要监视各个写线程的负载
+     * @param concurrentApply: ConcurrentApplyModule的对象指针
+     */
+    void MonitorConcurrentApply(ConcurrentApplyModule* concurrentApply);
+
     /**
      * 增加 leader count 计数
      */
@@ -46,6 +46,53 @@ void ChunkServerServiceImpl::ChunkServerStatus(
         << ". [ChunkServerStatusResponse] " << response->DebugString();
 }
 
+static QosLimit ToQosLimit(const QosLimitParas& paras) {
+    QosLimit limit;
+    limit.iops = paras.iops();
+    limit.bps = paras.bps();
+    return limit;
+}
+
+void ChunkServerServiceImpl::SetQosLimit(
+    RpcController *controller,
+    const SetQosLimitRequest *request,
+    SetQosLimitResponse *response,
+    Closure *done) {
+    brpc::ClosureGuard done_guard(done);
+
+    brpc::Controller* cntl =
+        static_cast<brpc::Controller*>(controller);
+    LOG(INFO) << "Received request[log_id=" << cntl->log_id()
+        << "] from " << cntl->remote_side() << " to " << cntl->local_side()
+        << ". [SetQosLimitRequest] " << request->DebugString();
+
+    if (nullptr == qosScheduler_) {
+        LOG(WARNING) << "Set qos limit failed, qos is not enabled";
+        response->set_success(false);
+        return;
+    }
+    if (request->has_disklimit()) {
+        qosScheduler_->SetDiskLimit(ToQosLimit(request->disklimit()));
+    }
+    if (request->has_defaultvolumelimit()) {
+        qosScheduler_->SetDefaultVolumeLimit(
+            ToQosLimit(request->defaultvolumelimit()));
+    }
+    if (request->has_clientlimit()) {
+        qosScheduler_->SetClientLimit(ToQosLimit(request->clientlimit()));
+    }
+    for (const auto& volumeLimit : request->volumelimits()) {
+        if (volumeLimit.has_limit()) {
+            qosScheduler_->SetVolumeLimit(volumeLimit.volumeid(),
+                                          ToQosLimit(volumeLimit.limit()),
+                                          volumeLimit.weight());
+        } else {
+            qosScheduler_->ResetVolumeLimit(volumeLimit.volumeid());
+        }
+    }
+    response->set_success(true);
+}
+
 }  // namespace chunkserver
 }  // namespace curve
 
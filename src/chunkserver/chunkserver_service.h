@@ -26,14 +26,17 @@
 #include <memory>
 #include "proto/chunkserver.pb.h"
 #include "src/chunkserver/copyset_node_manager.h"
+#include "src/chunkserver/qos_scheduler.h"
 
 namespace curve {
 namespace chunkserver {
 
 class ChunkServerServiceImpl : public ChunkServerService {
  public:
-    explicit ChunkServerServiceImpl(CopysetNodeManager* copysetNodeManager)
-        : copysetNodeManager_(copysetNodeManager) {}
+    explicit ChunkServerServiceImpl(CopysetNodeManager* copysetNodeManager,
+                                    QosScheduler* qosScheduler = nullptr)
+        : copysetNodeManager_(copysetNodeManager),
+          qosScheduler_(qosScheduler) {}
 
     virtual void ChunkServerStatus(
         RpcController *controller,
@@ -41,8 +44,18 @@ class ChunkServerServiceImpl : public ChunkServerService {
         ChunkServerStatusResponse *response,
         Closure *done);
 
+    /**
+     * 运行时修改QoS的上限，没有开启QoS时返回失败
+     */
+    virtual void SetQosLimit(
+        RpcController *controller,
+        const SetQosLimitRequest *request,
+        SetQosLimitResponse *response,
+        Closure *done);
+
  private:
     CopysetNodeManager *copysetNodeManager_;
+    QosScheduler *qosScheduler_;
 };
 
 }  // namespace chunkserver
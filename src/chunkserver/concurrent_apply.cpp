@@ -23,60 +23,270 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <memory>
 #include "src/chunkserver/concurrent_apply.h"
+#include "src/common/timeutility.h"
 
 namespace curve {
 namespace chunkserver {
 
+using curve::common::TimeUtility;
+
 #define DEFAULT_CONCURRENT_SIZE 10
 #define DEFAULT_QUEUEDEPTH 1
 
+// 消费者自旋次数的上下限，自旋等到任务时增加上限，睡眠后减小上限
+const int kMinSpinLimit = 16;
+const int kMaxSpinLimit = 4096;
+// 队列满时生产者睡眠前的自旋次数
+const int kProducerSpinLimit = 256;
+// 写线程每次连续执行同一个槽位上的任务数，之后让出给其他槽位
+const int kChunkBatchSize = 16;
+
+ApplyTaskQueue::ApplyTaskQueue(size_t capacity)
+    : ring_(capacity),
+      ready_(nullptr),
+      readyHead_(nullptr),
+      held_(nullptr),
+      consumerWaiting_(false),
+      producerWaiting_(0) {
+    // 只有一个cpu时自旋只会占用对方需要的时间片，直接睡眠
+    bool canSpin = std::thread::hardware_concurrency() > 1;
+    minSpinLimit_ = canSpin ? kMinSpinLimit : 0;
+    maxSpinLimit_ = canSpin ? kMaxSpinLimit : 0;
+    producerSpinLimit_ = canSpin ? kProducerSpinLimit : 0;
+    spinLimit_ = minSpinLimit_;
+}
+
+void ApplyTaskQueue::Push(ApplyTask* task) {
+    int spin = 0;
+    while (!ring_.TryPush(task)) {
+        if (spin < producerSpinLimit_) {
+            ++spin;
+            CURVE_CPU_RELAX();
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(mtx_);
+        producerWaiting_.fetch_add(1, std::memory_order_relaxed);
+        // 与消费者出队后检查producerWaiting_配对，避免错过唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ring_.Full()) {
+            notfullcv_.wait(lk);
+        }
+        producerWaiting_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    WakeupConsumer();
+}
+
+void ApplyTaskQueue::PushReady(ApplyTask* task) {
+    ApplyTask* head = ready_.load(std::memory_order_relaxed);
+    do {
+        task->applyNext_.store(head, std::memory_order_relaxed);
+    } while (!ready_.compare_exchange_weak(head, task,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+    WakeupConsumer();
+}
+
+void ApplyTaskQueue::WakeupConsumer() {
+    // 与消费者睡眠前设置consumerWaiting_配对，消费者要么能看到新的任务，
+    // 要么这里能看到消费者在睡眠
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumerWaiting_.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        notemptycv_.notify_one();
+    }
+}
+
+bool ApplyTaskQueue::TryPop(ApplyTask** task) {
+    // 先从环形队列取再取就绪链表，环形队列中任务入队之前放入就绪链表的任务
+    // 在这里一定能看到，保证Flush的任务在之前释放的读任务之后执行
+    if (held_ == nullptr && ring_.TryPop(&held_)) {
+        WakeupProducers();
+    }
+    if (readyHead_ == nullptr) {
+        ApplyTask* list = ready_.exchange(nullptr, std::memory_order_acquire);
+        // 链表是后进先出的，反转成入队顺序
+        while (list != nullptr) {
+            ApplyTask* next = list->applyNext_.load(std::memory_order_relaxed);
+            list->applyNext_.store(readyHead_, std::memory_order_relaxed);
+            readyHead_ = list;
+            list = next;
+        }
+    }
+    if (readyHead_ != nullptr) {
+        *task = readyHead_;
+        readyHead_ = readyHead_->applyNext_.load(std::memory_order_relaxed);
+        return true;
+    }
+    if (held_ != nullptr) {
+        *task = held_;
+        held_ = nullptr;
+        return true;
+    }
+    return false;
+}
+
+ApplyTask* ApplyTaskQueue::Pop() {
+    ApplyTask* task = nullptr;
+    int spin = 0;
+    while (!TryPop(&task)) {
+        if (spin < spinLimit_) {
+            ++spin;
+            CURVE_CPU_RELAX();
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(mtx_);
+        consumerWaiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (ring_.Empty()
+            && ready_.load(std::memory_order_relaxed) == nullptr) {
+            notemptycv_.wait(lk);
+        }
+        consumerWaiting_.store(false, std::memory_order_relaxed);
+        // 自旋没有等到任务，减少下次的自旋次数
+        spinLimit_ = std::max(minSpinLimit_, spinLimit_ / 2);
+        spin = 0;
+    }
+    if (spin > 0 && spin < spinLimit_) {
+        // 自旋等到了任务，增加下次的自旋次数
+        spinLimit_ = std::min(maxSpinLimit_, spinLimit_ * 2);
+    }
+    return task;
+}
+
+void ApplyTaskQueue::WakeupProducers() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // 队列消耗到一半以下才唤醒生产者，避免每出队一个任务都加锁唤醒
+    if (producerWaiting_.load(std::memory_order_relaxed) > 0
+        && ring_.Size() <= ring_.Capacity() / 2) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        notfullcv_.notify_all();
+    }
+}
+
+void ChunkWriteTracker::OnPush(uint64_t key) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    ++shard.chunks[key].pushed;
+}
+
+void ChunkWriteTracker::OnDone(uint64_t key, uint64_t count,
+                               std::vector<ApplyTask*>* ready) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    auto iter = shard.chunks.find(key);
+    CHECK(iter != shard.chunks.end()) << "chunk " << key << " not tracked";
+    ChunkState& state = iter->second;
+    state.done += count;
+    while (!state.waiters.empty()
+           && state.waiters.front().first <= state.done) {
+        ready->push_back(state.waiters.front().second);
+        state.waiters.pop_front();
+    }
+    if (state.pushed == state.done && state.waiters.empty()) {
+        shard.chunks.erase(iter);
+    }
+}
+
+bool ChunkWriteTracker::TryRead(uint64_t key, ApplyTask* task) {
+    Shard& shard = GetShard(key);
+    std::lock_guard<std::mutex> lk(shard.mtx);
+    auto iter = shard.chunks.find(key);
+    if (iter == shard.chunks.end()) {
+        return true;
+    }
+    // 记录在的chunk一定有未完成的写任务
+    iter->second.waiters.emplace_back(iter->second.pushed, task);
+    return false;
+}
+
 ConcurrentApplyModule::ConcurrentApplyModule():
-                                    stop_(0),
+                                    stop_(false),
                                     isStarted_(false),
-                                    concurrentsize_(0),
                                     queuedepth_(0),
-                                    cond_(0) {
-    applypoolMap_.clear();
+                                    concurrentsize_(0),
+                                    maxmerge_(0),
+                                    rconcurrentsize_(0),
+                                    rqueuedepth_(0),
+                                    readIndex_(0),
+                                    mergedCount_(0),
+                                    inplaceReadCount_(0),
+                                    cond_(0),
+                                    slots_(new ChunkApplySlot[kSlotNum]),
+                                    readyChunks_(0),
+                                    idleWorkers_(0),
+                                    pendingTasks_(0),
+                                    maxPendingTasks_(0),
+                                    producerWaiting_(0) {
 }
 
 ConcurrentApplyModule::~ConcurrentApplyModule() {
 }
 
-bool ConcurrentApplyModule::Init(int concurrentsize, int queuedepth) {
+bool ConcurrentApplyModule::Init(int concurrentsize, int queuedepth,
+                                 int maxmerge) {
+    ConcurrentApplyOption option;
+    option.wconcurrentsize = concurrentsize;
+    option.wqueuedepth = queuedepth;
+    option.maxmerge = maxmerge;
+    return Init(option);
+}
+
+bool ConcurrentApplyModule::Init(const ConcurrentApplyOption& option) {
     if (isStarted_) {
         LOG(WARNING) << "concurrent module already start!";
         return true;
     }
 
-    if (concurrentsize <= 0) {
+    if (option.wconcurrentsize <= 0) {
         concurrentsize_ = DEFAULT_CONCURRENT_SIZE;
     } else {
-        concurrentsize_ = concurrentsize;
+        concurrentsize_ = option.wconcurrentsize;
     }
 
-    if (queuedepth <= 0) {
+    if (option.wqueuedepth <= 0) {
         queuedepth_ = DEFAULT_QUEUEDEPTH;
     } else {
-        queuedepth_ = queuedepth;
+        queuedepth_ = option.wqueuedepth;
+    }
+    maxPendingTasks_ = static_cast<int64_t>(concurrentsize_) * queuedepth_;
+
+    maxmerge_ = option.maxmerge > 0 ? option.maxmerge : 0;
+
+    // 读队列的并发度为0时不单独创建读队列
+    rconcurrentsize_ = std::max(option.rconcurrentsize, 0);
+    if (option.rqueuedepth <= 0) {
+        rqueuedepth_ = DEFAULT_QUEUEDEPTH;
+    } else {
+        rqueuedepth_ = option.rqueuedepth;
     }
 
-    // 等待event事件数，等于线程数
-    cond_.Reset(concurrentsize);
+    stop_.store(false, std::memory_order_release);
+    // 等待event事件数，等于读写线程数
+    cond_.Reset(concurrentsize_ + rconcurrentsize_);
 
     /**
-     * 因为hash map并不是线程安全的，所以必须先将applyPoolMap_创建好
-     * 然后插入所有元素之后，之后才能创建线程，这样对applypoolMap_的
-     * read/write就不可能出现并发
+     * 先创建好所有线程的数据结构，之后才能创建线程，
+     * 这样线程之间偷取任务时对workers_的访问就不可能出现并发修改
      */
     for (int i = 0; i < concurrentsize_; i++) {
-        auto asyncth = new (std::nothrow) taskthread(queuedepth_);
+        // 每个槽位最多在一个就绪队列中，多留一个给屏障槽位
+        auto worker = new (std::nothrow) ApplyWorker(kSlotNum + 1);
+        CHECK(worker != nullptr) << "allocate failed!";
+        workers_.push_back(worker);
+    }
+    for (int i = 0; i < rconcurrentsize_; i++) {
+        auto asyncth = new (std::nothrow) taskthread(rqueuedepth_);
         CHECK(asyncth != nullptr) << "allocate failed!";
-        applypoolMap_.insert(std::make_pair(i, asyncth));
+        readpool_.push_back(asyncth);
     }
 
     for (int i = 0; i < concurrentsize_; i++) {
-        applypoolMap_[i]->th = std::move(std::thread(&ConcurrentApplyModule::Run, this, i));     // NOLINT
+        workers_[i]->th = std::thread(&ConcurrentApplyModule::Run, this, i);
+    }
+    for (int i = 0; i < rconcurrentsize_; i++) {
+        readpool_[i]->th = std::thread(&ConcurrentApplyModule::RunRead, this, i);
     }
 
     /**
@@ -95,22 +305,171 @@ bool ConcurrentApplyModule::Init(int concurrentsize, int queuedepth) {
 
 void ConcurrentApplyModule::Run(int index) {
     cond_.Signal();
-    while (!stop_) {
-        auto t = applypoolMap_[index]->tq.Pop();
-        t();
+    while (!stop_.load(std::memory_order_acquire)) {
+        ChunkApplySlot* slot = PopReady(index);
+        if (slot == nullptr) {
+            WaitForWork();
+            continue;
+        }
+        RunSlot(index, slot);
+    }
+}
+
+ChunkApplySlot* ConcurrentApplyModule::PopReady(int index) {
+    ChunkApplySlot* slot = nullptr;
+    if (workers_[index]->readyq.TryPop(&slot)) {
+        readyChunks_.fetch_sub(1);
+        return slot;
+    }
+
+    if (readyChunks_.load(std::memory_order_relaxed) <= 0) {
+        return nullptr;
+    }
+    // 从其他线程的就绪队列偷取整个槽位，槽位的所有权随之转移
+    for (int i = 1; i < concurrentsize_; i++) {
+        ApplyWorker* victim = workers_[(index + i) % concurrentsize_];
+        if (victim->readyq.TryPop(&slot)) {
+            readyChunks_.fetch_sub(1);
+            workers_[index]->metric.stealCount << 1;
+            return slot;
+        }
+    }
+    return nullptr;
+}
+
+void ConcurrentApplyModule::WaitForWork() {
+    std::unique_lock<std::mutex> lk(idleMtx_);
+    // 与Schedule中先增加readyChunks_再检查idleWorkers_配对，避免错过唤醒
+    idleWorkers_.fetch_add(1);
+    if (readyChunks_.load() <= 0 && !stop_.load(std::memory_order_acquire)) {
+        idleCv_.wait(lk);
+    }
+    idleWorkers_.fetch_sub(1);
+}
+
+void ConcurrentApplyModule::Schedule(ChunkApplySlot* slot, int index) {
+    // 槽位同一时刻最多在一个就绪队列中，队列容量大于槽位数，不会失败
+    CHECK(workers_[index]->readyq.TryPush(slot)) << "ready queue full";
+    readyChunks_.fetch_add(1);
+    if (idleWorkers_.load() > 0) {
+        std::lock_guard<std::mutex> lk(idleMtx_);
+        idleCv_.notify_one();
+    }
+}
+
+void ConcurrentApplyModule::RunSlot(int index, ChunkApplySlot* slot) {
+    ApplyWorker* worker = workers_[index];
+    uint64_t startUs = TimeUtility::GetTimeofDayUs();
+    int count = 0;
+    while (count < kChunkBatchSize) {
+        // 生产者还没有链入任务时返回nullptr，由ReleaseSlot重新调度
+        ApplyTask* task = slot->Pop();
+        if (task == nullptr) {
+            break;
+        }
+        // 只合并同一个chunk上紧邻的任务，合并失败（例如遇到屏障）就放回，
+        // 不改变执行顺序
+        int merged = 0;
+        while (merged < maxmerge_) {
+            ApplyTask* next = slot->Pop();
+            if (next == nullptr) {
+                break;
+            }
+            if (next->applyKey_ != task->applyKey_
+                || next->tracked_ != task->tracked_
+                || !task->Merge(next)) {
+                slot->Unpop(next);
+                break;
+            }
+            ++merged;
+        }
+        if (merged > 0) {
+            mergedCount_.fetch_add(merged, std::memory_order_relaxed);
+        }
+
+        // task执行完以后会释放自己，需要提前取出key
+        uint64_t key = task->applyKey_;
+        bool tracked = task->tracked_;
+        task->Run();
+        if (tracked) {
+            std::vector<ApplyTask*> ready;
+            writeTracker_.OnDone(key, 1 + merged, &ready);
+            for (auto read : ready) {
+                DispatchRead(read, true);
+            }
+        }
+        ReleasePending(1 + merged);
+        count += 1 + merged;
+    }
+    worker->metric.busyUs << TimeUtility::GetTimeofDayUs() - startUs;
+    worker->metric.taskCount << count;
+
+    ReleaseSlot(index, slot, count);
+}
+
+void ConcurrentApplyModule::ReleaseSlot(int index, ChunkApplySlot* slot,
+                                        int count) {
+    // 先清除组再减少pending，释放以后新的生产者会重新设置组。
+    // 清除到恢复之间组可能被其他组的生产者覆盖，resetSeq为奇数期间
+    // 屏障把槽位当作匹配，避免跳过还有本组任务的槽位
+    slot->resetSeq.fetch_add(1);
+    uint64_t group = slot->group.exchange(kNoApplyGroup);
+    int64_t remain = slot->pending.fetch_sub(count) - count;
+    if (remain > 0) {
+        MarkGroup(slot, group);
+    }
+    slot->resetSeq.fetch_add(1);
+    if (remain <= 0) {
+        return;
+    }
+    // 槽位上还有任务，放回自己的就绪队列末尾，
+    // 让其他槽位也能得到执行，空闲的线程也可以偷取
+    Schedule(slot, index);
+}
+
+void ConcurrentApplyModule::ReleasePending(int count) {
+    int64_t pending = pendingTasks_.fetch_sub(count) - count;
+    // 排队的任务消耗到上限的一半以下才唤醒生产者，避免每个任务都加锁唤醒
+    if (producerWaiting_.load() > 0 && pending <= maxPendingTasks_ / 2) {
+        std::lock_guard<std::mutex> lk(fullMtx_);
+        notFullCv_.notify_all();
+    }
+}
+
+void ConcurrentApplyModule::RunRead(int index) {
+    cond_.Signal();
+    while (!stop_.load(std::memory_order_acquire)) {
+        ApplyTask* t = readpool_[index]->tq.Pop();
+        t->Run();
     }
 }
 
 void ConcurrentApplyModule::Stop() {
     LOG(INFO) << "stop ConcurrentApplyModule...";
-    stop_ = true;
-    auto wakeup = []() {};
-    for (auto iter : applypoolMap_) {
-        iter.second->tq.Push(wakeup);
-        iter.second->th.join();
-        delete iter.second;
+    stop_.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lk(idleMtx_);
+        idleCv_.notify_all();
+    }
+    for (auto worker : workers_) {
+        worker->th.join();
+        delete worker;
     }
-    applypoolMap_.clear();
+    workers_.clear();
+    for (auto th : readpool_) {
+        th->tq.Push(new FunctionApplyTask([]() {}));
+        th->th.join();
+        delete th;
+    }
+    readpool_.clear();
+
+    // 线程退出后未执行的任务不再执行
+    for (int i = 0; i < kSlotNum; i++) {
+        slots_[i].Reset();
+    }
+    barrierSlot_.Reset();
+    readyChunks_.store(0);
+    pendingTasks_.store(0);
 
     isStarted_ = false;
     LOG(INFO) << "stop ConcurrentApplyModule ok.";
@@ -122,13 +481,52 @@ void ConcurrentApplyModule::Flush() {
         return;
     }
 
-    std::atomic<bool>* signal = new (std::nothrow) std::atomic<bool>[concurrentsize_];          //NOLINT
-    std::mutex* mtx = new (std::nothrow) std::mutex[concurrentsize_];
-    std::condition_variable* cv= new (std::nothrow) std::condition_variable[concurrentsize_];   //NOLINT
+    // 写任务执行完时会把等待的读任务放入读队列，所以要先等写任务
+    WaitBarrier(true, 0);
+
+    std::vector<ApplyTaskQueue*> queues;
+    for (auto th : readpool_) {
+        queues.push_back(&th->tq);
+    }
+    FlushQueues(queues);
+}
+
+void ConcurrentApplyModule::Flush(uint64_t group) {
+    if (!isStarted_) {
+        LOG(WARNING) << "concurrent module not start!";
+        return;
+    }
+
+    WaitBarrier(false, group);
+}
+
+void ConcurrentApplyModule::WaitBarrier(bool allGroups, uint64_t group) {
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool flushed = false;
+    PushBarrierImpl(allGroups, group, [&mtx, &cv, &flushed]() {
+        std::unique_lock<std::mutex> lk(mtx);
+        flushed = true;
+        cv.notify_one();
+    });
+    std::unique_lock<std::mutex> lk(mtx);
+    cv.wait(lk, [&flushed]()->bool{return flushed;});
+}
+
+void ConcurrentApplyModule::FlushQueues(
+    const std::vector<ApplyTaskQueue*>& queues) {
+    int size = queues.size();
+    if (size == 0) {
+        return;
+    }
+
+    std::atomic<bool>* signal = new (std::nothrow) std::atomic<bool>[size];
+    std::mutex* mtx = new (std::nothrow) std::mutex[size];
+    std::condition_variable* cv= new (std::nothrow) std::condition_variable[size];   //NOLINT
     CHECK(signal != nullptr && mtx != nullptr && cv != nullptr)
     << "allocate buffer failed!";
 
-    for (int i = 0; i < concurrentsize_; i++) {
+    for (int i = 0; i < size; i++) {
         signal[i].store(false);
     }
 
@@ -143,11 +541,11 @@ void ConcurrentApplyModule::Flush() {
         cv[i].wait(lk, [&]()->bool{return signal[i].load();});
     };
 
-    for (int i = 0; i < concurrentsize_; i++) {
-        applypoolMap_[i]->tq.Push(flushtask, i);
+    for (int i = 0; i < size; i++) {
+        queues[i]->Push(new FunctionApplyTask(std::bind(flushtask, i)));
     }
 
-    for (int i = 0; i < concurrentsize_; i++) {
+    for (int i = 0; i < size; i++) {
         flushwait(i);
     }
 
@@ -156,5 +554,162 @@ void ConcurrentApplyModule::Flush() {
     delete[] cv;
 }
 
+void ConcurrentApplyModule::PushBarrier(std::function<void()> done) {
+    if (!isStarted_) {
+        LOG(WARNING) << "concurrent module not start!";
+        done();
+        return;
+    }
+
+    PushBarrierImpl(true, 0, done);
+}
+
+void ConcurrentApplyModule::PushBarrier(uint64_t group,
+                                        std::function<void()> done) {
+    if (!isStarted_) {
+        LOG(WARNING) << "concurrent module not start!";
+        done();
+        return;
+    }
+
+    PushBarrierImpl(false, group, done);
+}
+
+void ConcurrentApplyModule::PushBarrierImpl(bool allGroups, uint64_t group,
+                                            std::function<void()> done) {
+    // 屏障队列中的屏障task与chunk中的屏障task一起，保证后一个屏障的done
+    // 不会先于同一个组或者全局的前一个屏障的done执行
+    auto remain = std::make_shared<std::atomic<int>>(1);
+    auto barriertask = [remain, done]() {
+        if (remain->fetch_sub(1) == 1) {
+            done();
+        }
+    };
+
+    // 有未完成任务的槽位都已经被调度，只需要追加屏障task，
+    // 全局屏障的task属于所有组
+    uint64_t barrierGroup = allGroups ? kMixedApplyGroup : group;
+    for (int i = 0; i < kSlotNum; i++) {
+        ChunkApplySlot* slot = &slots_[i];
+        if (allGroups ? slot->pending.load() <= 0
+                      : !slot->MayContain(group)) {
+            continue;
+        }
+        remain->fetch_add(1);
+        pendingTasks_.fetch_add(1);
+        PushSlot(slot, new FunctionApplyTask(barriertask), barrierGroup,
+                 Hash(i));
+    }
+
+    pendingTasks_.fetch_add(1);
+    PushSlot(&barrierSlot_, new FunctionApplyTask(barriertask), barrierGroup,
+             0);
+}
+
+bool ConcurrentApplyModule::PushTask(uint64_t key, ApplyTask* task,
+                                     uint64_t group) {
+    if (!isStarted_) {
+        LOG(WARNING) << "concurrent module not start!";
+        return false;
+    }
+
+    PushWrite(key, task, group);
+    return true;
+}
+
+bool ConcurrentApplyModule::PushRead(uint64_t key, ApplyTask* task,
+                                     bool inplace) {
+    if (!isStarted_) {
+        LOG(WARNING) << "concurrent module not start!";
+        return false;
+    }
+
+    // 没有读队列时与写任务在同一个chunk上排队
+    if (rconcurrentsize_ == 0) {
+        PushWrite(key, task, 0);
+        return true;
+    }
+
+    task->applyKey_ = key;
+    task->tracked_ = false;
+    if (writeTracker_.TryRead(key, task)) {
+        if (inplace) {
+            inplaceReadCount_.fetch_add(1, std::memory_order_relaxed);
+            task->Run();
+        } else {
+            DispatchRead(task);
+        }
+    }
+    return true;
+}
+
+void ConcurrentApplyModule::PushWrite(uint64_t key, ApplyTask* task,
+                                      uint64_t group) {
+    task->applyKey_ = key;
+    // 没有读队列时不需要记录chunk上未完成的写任务
+    task->tracked_ = rconcurrentsize_ > 0;
+
+    // 排队的任务数达到上限时等待
+    while (true) {
+        int64_t pending = pendingTasks_.load(std::memory_order_relaxed);
+        if (pending < maxPendingTasks_) {
+            if (pendingTasks_.compare_exchange_weak(pending, pending + 1)) {
+                break;
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lk(fullMtx_);
+        // 与ReleasePending中先减少pendingTasks_再检查producerWaiting_配对
+        producerWaiting_.fetch_add(1);
+        if (pendingTasks_.load() >= maxPendingTasks_) {
+            notFullCv_.wait(lk);
+        }
+        producerWaiting_.fetch_sub(1);
+    }
+
+    if (task->tracked_) {
+        writeTracker_.OnPush(key);
+    }
+
+    PushSlot(GetSlot(key), task, group, Hash(key));
+}
+
+void ConcurrentApplyModule::PushSlot(ChunkApplySlot* slot, ApplyTask* task,
+                                     uint64_t group, int home) {
+    // 先增加pending再链入任务，屏障看到pending为0时槽位上一定没有未完成的任务，
+    // 写线程取不到任务时pending仍大于0，会重新调度槽位
+    int64_t prev = slot->pending.fetch_add(1);
+    slot->Push(task);
+    MarkGroup(slot, group);
+    // 槽位被调度之前只有当前线程负责，调度之后由写线程在任务执行完时释放
+    if (prev == 0) {
+        Schedule(slot, home);
+    }
+}
+
+void ConcurrentApplyModule::MarkGroup(ChunkApplySlot* slot, uint64_t group) {
+    if (group == kNoApplyGroup) {
+        return;
+    }
+    uint64_t cur = slot->group.load();
+    while (cur != group && cur != kMixedApplyGroup) {
+        uint64_t target = cur == kNoApplyGroup ? group : kMixedApplyGroup;
+        if (slot->group.compare_exchange_weak(cur, target)) {
+            break;
+        }
+    }
+}
+
+void ConcurrentApplyModule::DispatchRead(ApplyTask* task, bool released) {
+    uint64_t index = readIndex_.fetch_add(1, std::memory_order_relaxed);
+    ApplyTaskQueue& queue = readpool_[index % rconcurrentsize_]->tq;
+    // 写线程释放的读任务不能等待读队列非满，否则读慢时会阻塞写线程
+    if (released) {
+        queue.PushReady(task);
+    } else {
+        queue.Push(task);
+    }
+}
+
 }   // namespace chunkserver
 }   // namespace curve
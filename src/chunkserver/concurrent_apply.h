@@ -26,30 +26,367 @@
 #include <glog/logging.h>
 #include <unistd.h>
 #include <atomic>
+#include <functional>
+#include <memory>
 #include <mutex>    // NOLINT
 #include <thread>    // NOLINT
 #include <unordered_map>
 #include <utility>
+#include <vector>
+#include <deque>
 #include <condition_variable>    // NOLINT
 
-#include "src/common/concurrent/task_queue.h"
+#include <bvar/bvar.h>
+
 #include "include/curve_compiler_specific.h"
 #include "src/common/concurrent/count_down_event.h"
+#include "src/common/concurrent/mpmc_ring_queue.h"
+#include "src/common/concurrent/mpsc_ring_queue.h"
 
-using curve::common::TaskQueue;
 using curve::common::CountDownEvent;
+using curve::common::MPMCRingQueue;
+using curve::common::MPSCRingQueue;
 namespace curve {
 namespace chunkserver {
 
+/**
+ * 后台队列中的任务，以侵入式的方式嵌入在请求等对象中，入队时不需要额外分配内存
+ * 任务的生命周期由任务自己负责，Run执行完以后模块不会再访问该任务
+ */
+class ApplyTask {
+ public:
+    ApplyTask() : applyKey_(0), tracked_(false), applyNext_(nullptr) {}
+    virtual ~ApplyTask() = default;
+
+    /**
+     * 尝试将next合并到当前任务中，合并成功后next不会再单独执行，
+     * 由当前任务的Run负责完成next，默认不合并
+     * 由后台线程调用，next此时仍在队列中，实现中不能阻塞
+     * @param: next为队列中紧随当前任务的任务
+     * @return: 合并成功返回true，否则返回false
+     */
+    virtual bool Merge(ApplyTask* next) {
+        return false;
+    }
+
+    /**
+     * 执行当前任务以及所有合并进来的任务
+     */
+    virtual void Run() = 0;
+
+ private:
+    friend class ConcurrentApplyModule;
+    friend class ApplyTaskQueue;
+    friend struct ChunkApplySlot;
+    // 以下成员由并发模块在任务入队时设置
+    // 任务入队时的key，即chunk id
+    uint64_t applyKey_;
+    // 是否计入key上未完成的写任务，读任务需要在这些任务之后执行
+    bool tracked_;
+    // 写任务在槽位链表中的下一个任务
+    std::atomic<ApplyTask*> applyNext_;
+};
+
+/**
+ * 由std::function包装的普通任务，用于屏障等不在IO路径上的任务，执行完以后释放自身
+ */
+class FunctionApplyTask : public ApplyTask {
+ public:
+    explicit FunctionApplyTask(std::function<void()> func)
+        : func_(std::move(func)) {}
+
+    void Run() override {
+        func_();
+        delete this;
+    }
+
+ private:
+    std::function<void()> func_;
+};
+
+/**
+ * 后台线程的任务队列，基于有界的无锁MPSC环形队列
+ * 1.队列空时消费者先自旋，自旋次数根据最近自旋能否等到任务自适应调整，
+ *   仍然等不到任务时才睡眠，生产者只在消费者睡眠时才加锁唤醒
+ * 2.队列满时生产者先自旋，之后睡眠等待消费者唤醒
+ * 3.写任务完成后释放的读任务放入无界的就绪链表，写线程不会被读线程阻塞，
+ *   就绪链表中的任务先于之后放入环形队列的任务执行
+ * 4.只用于读线程，读任务之间不需要合并
+ */
+class ApplyTaskQueue {
+ public:
+    explicit ApplyTaskQueue(size_t capacity);
+
+    void Push(ApplyTask* task);
+
+    /**
+     * 放入就绪链表，不会阻塞
+     */
+    void PushReady(ApplyTask* task);
+
+    /**
+     * 取出队首任务，队列为空时等待，只能由唯一的后台线程调用
+     */
+    ApplyTask* Pop();
+
+ private:
+    // 唤醒正在等待队列非满的生产者
+    void WakeupProducers();
+    // 消费者在睡眠时唤醒消费者
+    void WakeupConsumer();
+    // 不等待地取出一个任务，只能由消费者调用
+    bool TryPop(ApplyTask** task);
+
+ private:
+    MPSCRingQueue<ApplyTask*> ring_;
+    // 就绪链表，生产者以栈的方式链入，消费者一次全部取走
+    CURVE_CACHELINE_ALIGNMENT std::atomic<ApplyTask*> ready_;
+    // 以下只由消费者访问
+    // 从就绪链表取走、按入队顺序排列的任务
+    ApplyTask* readyHead_;
+    // 已经从环形队列取出，等待就绪链表中更早的任务执行完的任务
+    ApplyTask* held_;
+    // 消费者自旋次数上限的调整范围，以及当前的自旋次数上限
+    int minSpinLimit_;
+    int maxSpinLimit_;
+    int spinLimit_;
+    // 队列满时生产者睡眠前的自旋次数
+    int producerSpinLimit_;
+    std::mutex mtx_;
+    std::condition_variable notemptycv_;
+    std::condition_variable notfullcv_;
+    // 消费者是否在睡眠
+    CURVE_CACHELINE_ALIGNMENT std::atomic<bool> consumerWaiting_;
+    // 在睡眠的生产者数
+    std::atomic<int> producerWaiting_;
+};
+
+/**
+ * 记录每个chunk上已入队和已完成的写任务数，读任务只需要与同一个chunk上的写任务保序
+ * 1.写任务入队时入队数加一，执行完以后完成数加一，两者相等时删除chunk的记录
+ * 2.读任务入队时如果chunk上没有未完成的写任务，可以立刻执行，
+ *   否则以当前的入队数作为版本号挂在chunk上，完成数达到版本号时再执行
+ */
+class ChunkWriteTracker {
+ public:
+    /**
+     * 写任务入队
+     */
+    void OnPush(uint64_t key);
+
+    /**
+     * 写任务执行完成
+     * @param: count为完成的写任务数
+     * @param: ready为出参，返回可以执行的读任务
+     */
+    void OnDone(uint64_t key, uint64_t count, std::vector<ApplyTask*>* ready);
+
+    /**
+     * 读任务入队
+     * @return: chunk上没有未完成的写任务时返回true，可以立刻执行，
+     *          否则任务挂在chunk上等待写任务完成，返回false
+     */
+    bool TryRead(uint64_t key, ApplyTask* task);
+
+ private:
+    struct ChunkState {
+        uint64_t pushed = 0;
+        uint64_t done = 0;
+        // 等待的读任务及其需要等待的写任务版本，版本号递增
+        std::deque<std::pair<uint64_t, ApplyTask*>> waiters;
+    };
+
+    struct CURVE_CACHELINE_ALIGNMENT Shard {
+        std::mutex mtx;
+        std::unordered_map<uint64_t, ChunkState> chunks;
+    };
+
+    Shard& GetShard(uint64_t key) {
+        return shards_[key % kShardNum];
+    }
+
+ private:
+    static const int kShardNum = 64;
+    Shard shards_[kShardNum];
+};
+
+// 槽位中有多个组的任务，所有组的屏障都需要等待该槽位
+const uint64_t kMixedApplyGroup = UINT64_MAX;
+// 槽位空闲或者组还没有确定，所有组的屏障都需要等待有任务的该槽位
+const uint64_t kNoApplyGroup = UINT64_MAX - 1;
+
+/**
+ * 槽位链表的哨兵节点
+ */
+class StubApplyTask : public ApplyTask {
+ public:
+    void Run() override {}
+};
+
+/**
+ * 写任务的槽位，chunk按id哈希到固定的槽位上，同一个槽位上的任务按入队顺序执行
+ * 1.任务通过applyNext_串成侵入式的无锁MPSC链表，入队时不加锁也不分配内存
+ * 2.pending为已入队还没有执行完的任务数，从0变为1的生产者负责调度槽位，
+ *   槽位同一时刻只属于一个写线程，执行完一批任务后pending减为0时释放
+ * 3.group为槽位中任务所属的组，用于按组的屏障跳过其他组的槽位，
+ *   生产者只会把组合并得更宽，只有写线程释放一批任务时会重置组，
+ *   重置期间resetSeq为奇数，屏障读到重置中或者重置过的组时按匹配处理
+ */
+struct ChunkApplySlot {
+    ChunkApplySlot() {
+        Reset();
+    }
+
+    /**
+     * 任务入链表，可以被多个生产者并发调用
+     */
+    void Push(ApplyTask* task) {
+        task->applyNext_.store(nullptr, std::memory_order_relaxed);
+        ApplyTask* prev = head.exchange(task, std::memory_order_acq_rel);
+        prev->applyNext_.store(task, std::memory_order_release);
+    }
+
+    /**
+     * 取出链表头部的任务，只能由持有槽位的写线程调用，
+     * 生产者入队到一半时也可能返回nullptr，此时pending仍然大于0
+     */
+    ApplyTask* Pop() {
+        if (carry != nullptr) {
+            ApplyTask* task = carry;
+            carry = nullptr;
+            return task;
+        }
+        ApplyTask* task = tail;
+        ApplyTask* next = task->applyNext_.load(std::memory_order_acquire);
+        if (task == &stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail = next;
+            task = next;
+            next = next->applyNext_.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail = next;
+            return task;
+        }
+        if (task != head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        // 链表中只剩一个任务，放入哨兵节点之后才能取出
+        Push(&stub);
+        next = task->applyNext_.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail = next;
+            return task;
+        }
+        return nullptr;
+    }
+
+    /**
+     * 放回Pop取出但没有执行的任务，下次Pop时最先取出
+     */
+    void Unpop(ApplyTask* task) {
+        carry = task;
+    }
+
+    /**
+     * 屏障判断槽位中是否可能有group的未完成任务，无法确定时返回true
+     */
+    bool MayContain(uint64_t g) {
+        uint64_t seq = resetSeq.load();
+        if (pending.load() <= 0) {
+            return false;
+        }
+        uint64_t cur = group.load();
+        if (seq % 2 != 0 || seq != resetSeq.load()) {
+            return true;
+        }
+        return cur == g || cur == kMixedApplyGroup || cur == kNoApplyGroup;
+    }
+
+    /**
+     * 清空槽位，只能在没有生产者和写线程时调用
+     */
+    void Reset() {
+        stub.applyNext_.store(nullptr, std::memory_order_relaxed);
+        head.store(&stub, std::memory_order_relaxed);
+        pending.store(0, std::memory_order_relaxed);
+        group.store(kNoApplyGroup, std::memory_order_relaxed);
+        resetSeq.store(0, std::memory_order_relaxed);
+        tail = &stub;
+        carry = nullptr;
+    }
+
+    // 以下成员由生产者修改
+    CURVE_CACHELINE_ALIGNMENT std::atomic<ApplyTask*> head;
+    std::atomic<int64_t> pending;
+    // 槽位中任务所属的组，有多个组的任务时为kMixedApplyGroup
+    std::atomic<uint64_t> group;
+    // 以下成员只由持有槽位的写线程修改
+    CURVE_CACHELINE_ALIGNMENT std::atomic<uint64_t> resetSeq;
+    ApplyTask* tail;
+    ApplyTask* carry;
+    StubApplyTask stub;
+};
+
+/**
+ * 写线程的统计，用于观察各个线程的负载是否均衡
+ */
+struct ApplyWorkerMetric {
+    ApplyWorkerMetric() : busyUsPerSecond(&busyUs, 1) {}
+
+    // 线程执行任务的累计时间
+    bvar::Adder<uint64_t> busyUs;
+    // 每秒执行任务的时间，1000000表示线程满负荷
+    bvar::PerSecond<bvar::Adder<uint64_t>> busyUsPerSecond;
+    // 执行的任务数，包括被合并的任务
+    bvar::Adder<uint64_t> taskCount;
+    // 从其他线程偷取的chunk数
+    bvar::Adder<uint64_t> stealCount;
+};
+
+/**
+ * 并发模块的配置，写任务和经过raft的任务进入写队列，
+ * 不经过raft的读任务进入独立的读队列
+ */
+struct ConcurrentApplyOption {
+    // 写线程数和每个线程平均可以排队的任务数
+    int wconcurrentsize = 0;
+    int wqueuedepth = 0;
+    // 一个写任务最多合并的后续任务数，为0时不合并
+    int maxmerge = 0;
+    // 读队列的并发度和每个队列的深度，并发度为0时读任务也进入写队列
+    int rconcurrentsize = 0;
+    int rqueuedepth = 0;
+};
+
+/**
+ * 并发apply模块
+ * 1.写任务按照chunk哈希到的槽位排队，同一个槽位同一时刻只属于一个写线程，
+ *   保证chunk上的执行顺序
+ * 2.槽位有任务时放入key哈希到的线程的无锁就绪队列，线程每次执行一批任务后
+ *   将仍有任务的槽位重新放回自己的就绪队列末尾
+ * 3.空闲的线程从其他线程的就绪队列队首偷取整个槽位，即等待最久的槽位，
+ *   避免热点chunk和哈希不均导致部分线程繁忙而其他线程空闲
+ */
 class CURVE_CACHELINE_ALIGNMENT ConcurrentApplyModule {
  public:
     ConcurrentApplyModule();
     ~ConcurrentApplyModule();
     /**
      * @param: concurrentsize是当前并发模块的并发大小
-     * @param: queuedepth是当前并发模块每个队列的深度控制
+     * @param: queuedepth是每个线程平均可以排队的任务数，
+     *         排队的写任务总数超过concurrentsize*queuedepth时push会阻塞
+     * @param: maxmerge是同一个chunk上一个可合并任务最多合并的后续任务数，
+     *         为0时不合并，队列深度越小，可以合并的任务越少
      */
-    bool Init(int concurrentsize, int queuedepth);
+    bool Init(int concurrentsize, int queuedepth, int maxmerge = 0);
+
+    /**
+     * @param: option为读写队列的配置，参见ConcurrentApplyOption
+     */
+    bool Init(const ConcurrentApplyOption& option);
 
     /**
      * raft apply线程会将task push到后台队列
@@ -64,41 +401,189 @@ class CURVE_CACHELINE_ALIGNMENT ConcurrentApplyModule {
             return false;
         }
 
-        auto task = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-        applypoolMap_[Hash(key)]->tq.Push(task);
+        auto task = new FunctionApplyTask(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        PushWrite(key, task, 0);
         return true;
     };                                                                                  // NOLINT
 
-    // raft snapshot之前需要将队列中的IO全部落盘。
+    /**
+     * 将侵入式的task push到后台队列，IO路径上的请求使用该接口，避免分配内存
+     * 后台线程执行时会尝试与同一个chunk上紧随其后的task合并
+     * @param: key用于将task哈希到指定队列
+     * @param: task为要执行的task，执行完以后由task自己负责释放
+     * @param: group为task所属的组，Flush(group)和PushBarrier(group, done)
+     *         只等待同一个组的task
+     */
+    bool PushTask(uint64_t key, ApplyTask* task, uint64_t group = 0);
+
+    /**
+     * 将不经过raft的读task push到读队列，读task只在同一个chunk上
+     * 此前入队的写task都执行完以后才执行，不受其他chunk上写task的影响
+     * @param: key为读的chunk id
+     * @param: task为要执行的读task，执行完以后由task自己负责释放
+     * @param: inplace为true时，如果chunk上没有未完成的写task，
+     *         直接在调用线程中执行task，省去一次线程切换和排队；
+     *         没有读队列时不记录chunk上的写task，inplace不生效
+     */
+    bool PushRead(uint64_t key, ApplyTask* task, bool inplace = false);
+
+    /**
+     * 累计被合并执行的task数
+     */
+    uint64_t MergedTaskCount() const {
+        return mergedCount_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * 累计在调用线程中直接执行的读task数
+     */
+    uint64_t InplaceReadCount() const {
+        return inplaceReadCount_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * 写线程数
+     */
+    int WorkerCount() const {
+        return workers_.size();
+    }
+
+    /**
+     * 获取写线程的统计
+     * @param: index为写线程的下标，取值范围[0, WorkerCount())
+     */
+    ApplyWorkerMetric* GetWorkerMetric(int index) {
+        return &workers_[index]->metric;
+    }
+
+    // raft snapshot之前需要将队列中的IO全部落盘，也会等待读队列中的task执行完
     void Flush();
+
+    /**
+     * 只等待group中此前push的写task执行完，不等待其他组的task和读队列，
+     * 用于copyset打快照或者退出，避免等待其他copyset的IO
+     * @param: group为task所属的组
+     */
+    void Flush(uint64_t group);
+
+    /**
+     * 非阻塞的屏障，向每个有未完成任务的chunk以及屏障队列push一个屏障task，
+     * 此前push的写task都执行完以后，在最后一个执行屏障task的
+     * 后台线程中调用done，模块未启动时直接在调用线程中调用done
+     * @param: done为屏障完成时的回调
+     */
+    void PushBarrier(std::function<void()> done);
+
+    /**
+     * 与PushBarrier相同，但只等待group中此前push的写task
+     * @param: group为task所属的组
+     * @param: done为屏障完成时的回调
+     */
+    void PushBarrier(uint64_t group, std::function<void()> done);
     void Stop();
 
  private:
+    struct CURVE_CACHELINE_ALIGNMENT ApplyWorker {
+        explicit ApplyWorker(size_t capacity) : readyq(capacity) {}
+
+        std::thread th;
+        // 就绪的槽位，本线程和偷取的线程都从队首取，
+        // 每个槽位同一时刻最多在一个就绪队列中，容量不小于槽位数时不会满
+        MPMCRingQueue<ChunkApplySlot*> readyq;
+        ApplyWorkerMetric metric;
+    };
+
     void Run(int index);
+    void RunRead(int index);
+    // 将写task push到写队列，并记录chunk上未完成的写task
+    void PushWrite(uint64_t key, ApplyTask* task, uint64_t group);
+    // 向所有组或者指定组有未完成task的chunk push屏障task
+    void PushBarrierImpl(bool allGroups, uint64_t group,
+                         std::function<void()> done);
+    // 阻塞等待屏障完成
+    void WaitBarrier(bool allGroups, uint64_t group);
+    // 将task放入槽位，槽位空闲时调度到home线程
+    void PushSlot(ChunkApplySlot* slot, ApplyTask* task, uint64_t group,
+                  int home);
+    // 将group合并到槽位的组中
+    void MarkGroup(ChunkApplySlot* slot, uint64_t group);
+    // 将槽位放入index线程的就绪队列，并唤醒空闲线程
+    void Schedule(ChunkApplySlot* slot, int index);
+    // 依次从自己和其他线程的就绪队列中取出槽位，没有时返回nullptr
+    ChunkApplySlot* PopReady(int index);
+    // 执行槽位上的一批task
+    void RunSlot(int index, ChunkApplySlot* slot);
+    // 一批task执行完以后，槽位上没有task时释放，否则放回index线程的就绪队列
+    void ReleaseSlot(int index, ChunkApplySlot* slot, int count);
+    // 没有就绪的chunk时睡眠，直到有chunk就绪或者模块停止
+    void WaitForWork();
+    // 写task执行完以后释放排队的名额
+    void ReleasePending(int count);
+    // 将可以执行的读task push到读队列，released表示由写线程释放，不能阻塞
+    void DispatchRead(ApplyTask* task, bool released = false);
+    // 等待指定队列中已有的task执行完
+    void FlushQueues(const std::vector<ApplyTaskQueue*>& queues);
     inline int Hash(uint64_t key) {
         return key % concurrentsize_;
     }
+    inline ChunkApplySlot* GetSlot(uint64_t key) {
+        return &slots_[key % kSlotNum];
+    }
 
  private:
-    typedef uint8_t threadIndex;
     typedef struct taskthread {
         std::thread th;
-        TaskQueue tq;
+        ApplyTaskQueue tq;
         taskthread(size_t capacity):tq(capacity) {}
         ~taskthread() = default;
     } taskthread_t;
 
-    // 常规的stop和start控制变量
-    bool stop_;
+    // 常规的stop和start控制变量，stop_会被后台线程在无锁的情况下读取
+    std::atomic<bool> stop_;
     bool isStarted_;
-    // 每个队列的深度
+    // 每个线程平均可以排队的任务数
     int queuedepth_;
     // 并发度
     int concurrentsize_;
+    // 一个可合并任务最多合并的后续任务数
+    int maxmerge_;
+    // 读队列的并发度和每个队列的深度
+    int rconcurrentsize_;
+    int rqueuedepth_;
+    // 读队列的轮转下标
+    std::atomic<uint64_t> readIndex_;
+    // 每个chunk上未完成的写任务
+    ChunkWriteTracker writeTracker_;
+    // 累计被合并执行的任务数
+    std::atomic<uint64_t> mergedCount_;
+    // 累计在调用线程中直接执行的读任务数
+    std::atomic<uint64_t> inplaceReadCount_;
     // 用于统一启动后台线程完全创建完成的条件变量
     CountDownEvent cond_;
-    // 存储threadindex与taskthread的映射关系
-    CURVE_CACHELINE_ALIGNMENT std::unordered_map<threadIndex, taskthread_t*> applypoolMap_;     // NOLINT
+
+    // 写线程
+    std::vector<ApplyWorker*> workers_;
+    // 按chunk哈希排队的写任务槽位
+    static const int kSlotNum = 4096;
+    std::unique_ptr<ChunkApplySlot[]> slots_;
+    // 屏障槽位，每个屏障都会在这里push一个屏障task，
+    // 没有需要等待的task时屏障也能在后台线程中完成
+    ChunkApplySlot barrierSlot_;
+    // 所有线程就绪队列中的槽位数
+    std::atomic<int64_t> readyChunks_;
+    // 空闲的写线程在idleCv_上等待就绪的槽位
+    std::atomic<int> idleWorkers_;
+    std::mutex idleMtx_;
+    std::condition_variable idleCv_;
+    // 排队的写任务数及其上限，超过上限时push阻塞在notFullCv_上
+    std::atomic<int64_t> pendingTasks_;
+    int64_t maxPendingTasks_;
+    std::atomic<int> producerWaiting_;
+    std::mutex fullMtx_;
+    std::condition_variable notFullCv_;
+    // 读队列
+    std::vector<taskthread_t*> readpool_;
 };
 }   // namespace chunkserver
 }   // namespace curve
@@ -29,6 +29,9 @@
 #include "src/fs/local_filesystem.h"
 #include "src/chunkserver/trash.h"
 #include "src/chunkserver/inflight_throttle.h"
+#include "src/chunkserver/qos_scheduler.h"
+#include "src/chunkserver/datastore/chunkfile_fd_cache.h"
+#include "src/chunkserver/datastore/chunk_read_cache.h"
 #include "include/chunkserver/chunkserver_common.h"
 
 namespace curve {
@@ -116,6 +119,40 @@ struct CopysetNodeOptions {
     // 循环判定copyset是否加载完成的内部睡眠时间
     uint32_t checkLoadMarginIntervalMs = 1000;
 
+    // 是否以O_DSYNC方式写chunk文件，为false时批量调用fdatasync刷盘
+    bool syncWrite = true;
+    // 非同步写模式下，距上次刷盘apply的日志条数达到该值时触发刷盘，为0表示不触发
+    uint64_t syncIndexMargin = 10000;
+    // 非同步写模式下，距上次刷盘的时间达到该值时触发刷盘，为0表示不触发
+    uint32_t syncIntervalMs = 1000;
+    // 是否以O_DIRECT方式读写chunk文件和快照文件
+    bool directIO = false;
+    // 同时打开的chunk文件数上限，为0表示不限制，启动时打开所有chunk文件
+    uint32_t maxOpenChunkFiles = 0;
+    // 所有copyset共享的chunk文件fd缓存，maxOpenChunkFiles为0时为空
+    std::shared_ptr<ChunkFdCache> fdCache;
+    // 所有copyset共享的chunk数据读缓存的容量，单位MB，为0表示不开启
+    uint32_t readCacheCapacityMB = 0;
+    // 所有copyset共享的chunk数据读缓存，readCacheCapacityMB为0时为空
+    std::shared_ptr<ChunkReadCache> readCache;
+    // 是否使用chunk元数据清单，正常退出后再次启动时不需要扫描数据目录
+    bool enableChunkManifest = false;
+    // 是否批量持久化clone chunk的bitmap，丢失的更新由回放raft日志重建
+    bool batchCloneBitmap = false;
+    // 是否记录新chunk中page的写入状态，读未写过的page时不需要读盘
+    bool trackWrittenPages = false;
+    // 是否持久化已经落盘的applied index，重启时跳过回放不大于它的日志
+    bool enableAppliedIndexCheckpoint = false;
+
+    // 是否将短时间内到达的小写请求合并成一条raft日志propose
+    bool enableProposeBatch = false;
+    // 批次中第一个请求等待后续请求的时间，单位us
+    uint32_t proposeBatchWindowUs = 200;
+    // 一个批次的最大请求数
+    uint32_t proposeBatchMaxCount = 32;
+    // 一个批次的最大字节数，编码后不小于该值的请求单独propose
+    uint32_t proposeBatchMaxBytes = 256 * 1024;
+
     CopysetNodeOptions();
 };
 
@@ -126,6 +163,8 @@ struct ChunkServiceOptions {
     CopysetNodeManager *copysetNodeManager;
     CloneManager *cloneManager;
     std::shared_ptr<InflightThrottle> inflightThrottle;
+    // 卷级别的QoS调度，为空时不做限制
+    std::shared_ptr<QosScheduler> qosScheduler;
 };
 
 }  // namespace chunkserver
@@ -24,6 +24,7 @@
 
 #include <glog/logging.h>
 #include <brpc/controller.h>
+#include <bthread/bthread.h>
 #include <butil/sys_byteorder.h>
 #include <braft/closure_helper.h>
 #include <braft/snapshot.h>
@@ -43,13 +44,17 @@
 #include "src/chunkserver/uri_paser.h"
 #include "src/common/crc32.h"
 #include "src/common/fs_util.h"
+#include "src/common/timeutility.h"
 
 namespace curve {
 namespace chunkserver {
 
 using curve::fs::FileSystemInfo;
+using curve::common::TimeUtility;
 
 const char *kCurveConfEpochFilename = "conf.epoch";
+const char *kChunkManifestFilename = "chunk_manifest";
+const char *kAppliedIndexFilename = "applied_index";
 
 CopysetNode::CopysetNode(const LogicPoolID &logicPoolId,
                          const CopysetID &copysetId,
@@ -65,7 +70,19 @@ CopysetNode::CopysetNode(const LogicPoolID &logicPoolId,
     chunkDataRpath_(),
     appliedIndex_(0),
     leaderTerm_(-1),
-    configChange_(std::make_shared<ConfigurationChange>()) {
+    snapshotLoading_(false),
+    followerReads_(0),
+    configChange_(std::make_shared<ConfigurationChange>()),
+    syncWrite_(true),
+    syncIndexMargin_(0),
+    syncIntervalMs_(0),
+    lastApplyIndex_(0),
+    lastSyncTriggerIndex_(0),
+    lastSyncTimeMs_(0),
+    syncedIndex_(0),
+    dataSyncing_(false),
+    savedAppliedIndex_(0),
+    skipApplyIndex_(0) {
 }
 
 CopysetNode::~CopysetNode() {
@@ -112,6 +129,16 @@ int CopysetNode::Init(const CopysetNodeOptions &options) {
     dsOptions.chunkSize = options.maxChunkSize;
     dsOptions.pageSize = options.pageSize;
     dsOptions.locationLimit = options.locationLimit;
+    dsOptions.syncWrite = options.syncWrite;
+    dsOptions.directIO = options.directIO;
+    dsOptions.fdCache = options.fdCache;
+    dsOptions.readCache = options.readCache;
+    dsOptions.batchBitmapFlush = options.batchCloneBitmap;
+    dsOptions.trackWrittenPages = options.trackWrittenPages;
+    if (options.enableChunkManifest) {
+        // manifest不能放在数据目录下，否则会被raft快照当作chunk文件
+        dsOptions.manifestPath = copysetDirPath_ + "/" + kChunkManifestFilename;
+    }
     dataStore_ = std::make_shared<CSDataStore>(options.localFileSystem,
                                                options.chunkfilePool,
                                                dsOptions);
@@ -124,6 +151,34 @@ int CopysetNode::Init(const CopysetNodeOptions &options) {
     }
 
     recyclerUri_ = options.recyclerUri;
+    syncWrite_ = options.syncWrite;
+    syncIndexMargin_ = options.syncIndexMargin;
+    syncIntervalMs_ = options.syncIntervalMs;
+    lastSyncTimeMs_ = TimeUtility::GetTimeofDayMs();
+
+    if (options.enableAppliedIndexCheckpoint) {
+        // 文件不在数据目录下，不会被raft快照当作chunk文件
+        appliedIndexFile_.reset(new AppliedIndexFile(fs_));
+        std::string path = copysetDirPath_ + "/" + kAppliedIndexFilename;
+        uint64_t index = 0;
+        if (fs_->FileExists(path)
+            && 0 == appliedIndexFile_->Load(path, &index)) {
+            skipApplyIndex_ = index;
+            savedAppliedIndex_ = index;
+            LOG(INFO) << "Load applied index " << index
+                      << ", log entries not greater than it will be skipped. "
+                      << "Copyset: " << GroupIdString();
+        }
+    }
+
+    if (options.enableProposeBatch) {
+        ProposeBatcherOptions batchOptions;
+        batchOptions.windowUs = options.proposeBatchWindowUs;
+        batchOptions.maxCount = options.proposeBatchMaxCount;
+        batchOptions.maxBytes = options.proposeBatchMaxBytes;
+        proposeBatcher_.reset(new ProposeBatcher(batchOptions,
+            [this](const braft::Task &task) { Propose(task); }));
+    }
 
     // TODO(wudemiao): 放到nodeOptions的init中
     /**
@@ -213,7 +268,17 @@ void CopysetNode::Fini() {
     if (nullptr != concurrentapply_) {
         // 将未刷盘的数据落盘，如果不刷盘
         // 迁移copyset时，copyset移除后再去执行WriteChunk操作可能出错
-        concurrentapply_->Flush();
+        // 只需要等待本copyset的IO，也会等待本copyset的屏障执行结束
+        concurrentapply_->Flush(GroupNidValue());
+    }
+    if (nullptr != dataStore_) {
+        if (0 != SyncData(lastApplyIndex_)) {
+            LOG(ERROR) << "Sync data failed when fini copyset. "
+                       << "Copyset: " << GroupIdString();
+        } else {
+            // 数据已经落盘，封存manifest以便下次启动时跳过目录扫描
+            dataStore_->SealManifest();
+        }
     }
 }
 
@@ -233,16 +298,35 @@ void CopysetNode::on_apply(::braft::Iterator &iter) {
              * 1.closure不是null，那么说明当前节点正常，直接从内存中拿到Op
              * context进行apply
              */
-            ChunkClosure
-                *chunkClosure = dynamic_cast<ChunkClosure *>(iter.done());
-            CHECK(nullptr != chunkClosure)
-                << "ChunkClosure dynamic cast failed";
-            std::shared_ptr<ChunkOpRequest> opRequest = chunkClosure->request_;
-            auto task = std::bind(&ChunkOpRequest::OnApply,
-                                  opRequest,
-                                  iter.index(),
-                                  doneGuard.release());
-            concurrentapply_->Push(opRequest->ChunkId(), task);
+            BatchChunkClosure
+                *batchClosure = dynamic_cast<BatchChunkClosure *>(closure);
+            if (nullptr != batchClosure) {
+                // 合并propose的日志，每个请求使用自己的closure返回，
+                // 合并的closure在doneGuard析构时释放
+                for (ChunkClosure *chunkClosure :
+                     batchClosure->ReleaseClosures()) {
+                    std::shared_ptr<ChunkOpRequest> opRequest =
+                        chunkClosure->request_;
+                    concurrentapply_->PushTask(
+                        opRequest->ChunkId(),
+                        opRequest->PrepareApply(iter.index(), chunkClosure),
+                        GroupNidValue());
+                }
+            } else {
+                ChunkClosure
+                    *chunkClosure = dynamic_cast<ChunkClosure *>(closure);
+                CHECK(nullptr != chunkClosure)
+                    << "ChunkClosure dynamic cast failed";
+                std::shared_ptr<ChunkOpRequest> opRequest =
+                    chunkClosure->request_;
+                // request自身作为任务入队，写请求在后台线程中可以与
+                // 同一个chunk上相邻的写请求合并写入
+                concurrentapply_->PushTask(
+                    opRequest->ChunkId(),
+                    opRequest->PrepareApply(iter.index(),
+                                            doneGuard.release()),
+                    GroupNidValue());
+            }
         } else {
             // 获取log entry
             butil::IOBuf log = iter.data();
@@ -252,18 +336,101 @@ void CopysetNode::on_apply(::braft::Iterator &iter) {
              * 然后获取Op信息进行apply
              * 2.2. follower apply
              */
-            ChunkRequest request;
-            butil::IOBuf data;
-            auto opReq = ChunkOpRequest::Decode(log, &request, &data);
-            auto chunkId = request.chunkid();
-            auto task = std::bind(&ChunkOpRequest::OnApplyFromLog,
-                                  opReq,
-                                  dataStore_,
-                                  std::move(request),
-                                  data);
-            concurrentapply_->Push(chunkId, task);
+            if (static_cast<uint64_t>(iter.index()) <= skipApplyIndex_) {
+                // 重启前已经apply并落盘的日志，不需要再写一遍数据
+                UpdateAppliedIndex(iter.index());
+                lastApplyIndex_ = iter.index();
+                continue;
+            }
+            if (ProposeBatcher::IsBatchLog(log)) {
+                std::vector<butil::IOBuf> entries;
+                CHECK(0 == ProposeBatcher::DecodeBatchLog(log, &entries))
+                    << "Decode batch log failed, index: " << iter.index()
+                    << ", Copyset: " << GroupIdString();
+                for (const auto &entry : entries) {
+                    ApplyFromLog(entry, iter.index());
+                }
+            } else {
+                ApplyFromLog(log, iter.index());
+            }
         }
+        lastApplyIndex_ = iter.index();
+    }
+    MaybeSyncData(lastApplyIndex_);
+}
+
+void CopysetNode::ApplyFromLog(const butil::IOBuf &log, uint64_t index) {
+    ChunkRequest request;
+    butil::IOBuf data;
+    auto opReq = ChunkOpRequest::Decode(log, &request, &data);
+    auto chunkId = request.chunkid();
+    concurrentapply_->PushTask(
+        chunkId,
+        opReq->PrepareApplyFromLog(this, index, dataStore_, &request, &data),
+        GroupNidValue());
+}
+
+void CopysetNode::MaybeSyncData(uint64_t index) {
+    // 同步写模式下数据不需要刷盘，但仍然通过屏障推进持久化的applied index
+    if (syncWrite_ && nullptr == appliedIndexFile_) {
+        return;
+    }
+    if (dataSyncing_.load(std::memory_order_acquire)) {
+        return;
+    }
+    uint64_t nowMs = TimeUtility::GetTimeofDayMs();
+    bool reachIndex = syncIndexMargin_ > 0
+                   && index >= lastSyncTriggerIndex_ + syncIndexMargin_;
+    bool reachTime = syncIntervalMs_ > 0
+                  && index > lastSyncTriggerIndex_
+                  && nowMs >= lastSyncTimeMs_ + syncIntervalMs_;
+    if (!reachIndex && !reachTime) {
+        return;
+    }
+    lastSyncTriggerIndex_ = index;
+    lastSyncTimeMs_ = nowMs;
+    dataSyncing_.store(true, std::memory_order_release);
+    // 屏障完成时index之前的IO都已完成，Fini中的Flush会等待屏障执行结束
+    concurrentapply_->PushBarrier(GroupNidValue(), [this, index]() {
+        SyncData(index);
+        dataSyncing_.store(false, std::memory_order_release);
+    });
+}
+
+int CopysetNode::SyncData(uint64_t index) {
+    CSErrorCode errorCode = dataStore_->SyncChunkFiles();
+    if (errorCode != CSErrorCode::Success) {
+        LOG(ERROR) << "Sync chunk files failed. "
+                   << "Copyset: " << GroupIdString()
+                   << ", index: " << index
+                   << ", error: " << errorCode;
+        return -1;
+    }
+    uint64_t curIndex = syncedIndex_.load(std::memory_order_acquire);
+    while (index > curIndex
+           && !syncedIndex_.compare_exchange_weak(curIndex, index,
+                                                  std::memory_order_acq_rel)) {
+    }
+    SaveAppliedIndex(GetSyncedIndex());
+    return 0;
+}
+
+void CopysetNode::SaveAppliedIndex(uint64_t index, bool reset) {
+    if (nullptr == appliedIndexFile_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lockGuard(appliedIndexLock_);
+    if (reset ? index >= savedAppliedIndex_ : index <= savedAppliedIndex_) {
+        return;
+    }
+    std::string path = copysetDirPath_ + "/" + kAppliedIndexFilename;
+    if (0 != appliedIndexFile_->Save(path, index)) {
+        // 写入失败不影响正确性，重启时回放更多的日志
+        LOG(WARNING) << "Save applied index " << index << " failed. "
+                     << "Copyset: " << GroupIdString();
+        return;
     }
+    savedAppliedIndex_ = index;
 }
 
 void CopysetNode::on_shutdown() {
@@ -276,8 +443,22 @@ void CopysetNode::on_snapshot_save(::braft::SnapshotWriter *writer,
 
     /**
      * 1.flush I/O to disk，确保数据都落盘
+     * 非同步写模式下还需要fdatasync，否则braft截断日志后，
+     * 尚在pagecache中的数据掉电丢失后将无法通过回放日志恢复
+     * 只等待本copyset的IO，不影响其他copyset的apply
      */
-    concurrentapply_->Flush();
+    uint64_t flushStartUs = TimeUtility::GetTimeofDayUs();
+    concurrentapply_->Flush(GroupNidValue());
+    if (metric_ != nullptr) {
+        metric_->OnSnapshotFlush(
+            TimeUtility::GetTimeofDayUs() - flushStartUs);
+    }
+    if (0 != SyncData(lastApplyIndex_)) {
+        done->status().set_error(EIO, "sync chunk files failed");
+        LOG(ERROR) << "Sync data failed when save snapshot. "
+                   << "Copyset: " << GroupIdString();
+        return;
+    }
 
     /**
      * 2.保存配置版本: conf.epoch，注意conf.epoch是存放在data目录下
@@ -328,6 +509,18 @@ void CopysetNode::on_snapshot_save(::braft::SnapshotWriter *writer,
 }
 
 int CopysetNode::on_snapshot_load(::braft::SnapshotReader *reader) {
+    // 加载快照会替换数据目录并重新初始化datastore，
+    // 先禁止follower read，并等待进行中的follower read结束
+    snapshotLoading_.store(true);
+    while (followerReads_.load() > 0) {
+        bthread_usleep(1000);
+    }
+    int ret = LoadSnapshot(reader);
+    snapshotLoading_.store(false);
+    return ret;
+}
+
+int CopysetNode::LoadSnapshot(::braft::SnapshotReader *reader) {
     /**
      * 1. 加载快照数据
      */
@@ -341,7 +534,8 @@ int CopysetNode::on_snapshot_load(::braft::SnapshotReader *reader) {
     LOG(INFO) << "load snapshot data path: " << snapshotChunkDataDir
               << ", Copyset: " << GroupIdString();
     // 如果数据目录不存在，那么说明 load snapshot 数据部分就不需要处理
-    if (fs_->DirExists(snapshotChunkDataDir)) {
+    bool dataReplaced = fs_->DirExists(snapshotChunkDataDir);
+    if (dataReplaced) {
         // 加载快照数据前，要先清理copyset data目录下的文件
         // 否则可能导致快照加载以后存在一些残留的数据
         // 如果delete_file失败或者rename失败，当前node状态会置为ERROR
@@ -423,6 +617,16 @@ int CopysetNode::on_snapshot_load(::braft::SnapshotReader *reader) {
         }
     }
 
+    /**
+     * 5.数据被替换为快照中的数据后，之前持久化的applied index不再有效，
+     * 之后回放的日志都需要apply，持久化的index不能超过快照的index
+     */
+    if (dataReplaced) {
+        uint64_t snapshotIndex = meta.last_included_index();
+        skipApplyIndex_ = 0;
+        SaveAppliedIndex(snapshotIndex, true);
+    }
+
     return 0;
 }
 
@@ -716,6 +920,30 @@ uint64_t CopysetNode::GetAppliedIndex() const {
     return appliedIndex_.load(std::memory_order_acquire);
 }
 
+bool CopysetNode::BeginFollowerRead(uint64_t appliedIndex) {
+    // 先增加计数再检查加载快照的标记，与on_snapshot_load中的顺序相反，
+    // 保证加载快照时要么能看到计数，要么这里能看到标记
+    followerReads_.fetch_add(1);
+    bool readable = !snapshotLoading_.load()
+                    && appliedIndex > 0
+                    && GetAppliedIndex() >= appliedIndex;
+    if (!readable) {
+        followerReads_.fetch_sub(1);
+    }
+    if (metric_ != nullptr) {
+        metric_->OnFollowerRead(readable);
+    }
+    return readable;
+}
+
+void CopysetNode::EndFollowerRead() {
+    followerReads_.fetch_sub(1);
+}
+
+uint64_t CopysetNode::GetSyncedIndex() const {
+    return syncedIndex_.load(std::memory_order_acquire);
+}
+
 std::shared_ptr<CSDataStore> CopysetNode::GetDataStore() const {
     return dataStore_;
 }
@@ -33,12 +33,14 @@
 #include "src/chunkserver/concurrent_apply.h"
 #include "src/chunkserver/datastore/chunkserver_datastore.h"
 #include "src/chunkserver/conf_epoch_file.h"
+#include "src/chunkserver/applied_index_file.h"
 #include "src/chunkserver/config_info.h"
 #include "src/chunkserver/chunkserver_metrics.h"
 #include "src/chunkserver/raftsnapshot/define.h"
 #include "src/chunkserver/raftsnapshot/curve_snapshot_writer.h"
 #include "src/common/string_util.h"
 #include "src/chunkserver/raft_node.h"
+#include "src/chunkserver/propose_batcher.h"
 #include "proto/heartbeat.pb.h"
 #include "proto/chunk.pb.h"
 #include "proto/common.pb.h"
@@ -54,6 +56,7 @@ using ::curve::common::Peer;
 class CopysetNodeManager;
 
 extern const char *kCurveConfEpochFilename;
+extern const char *kAppliedIndexFilename;
 
 struct ConfigurationChange {
     ConfigChangeType type;
@@ -213,6 +216,27 @@ class CopysetNode : public braft::StateMachine,
      */
     virtual uint64_t GetAppliedIndex() const;
 
+    /**
+     * follower处理携带applied index的读请求前调用，follower已经apply到
+     * 请求的applied index，且没有在加载快照时可以直接读，成功时读完以后
+     * 需要调用EndFollowerRead
+     * @param appliedIndex: 请求携带的applied index
+     * @return 可以在follower上读返回true，否则返回false，需要重定向到leader
+     */
+    bool BeginFollowerRead(uint64_t appliedIndex);
+
+    /**
+     * follower上的读请求完成
+     */
+    void EndFollowerRead();
+
+    /**
+     * 返回已经持久化到磁盘的最大日志index，该index之前的IO都已经完成并刷盘，
+     * 由SyncData更新，持久化的applied index取该值
+     * @return
+     */
+    virtual uint64_t GetSyncedIndex() const;
+
     /**
      * @brief: 查询配置变更的状态
      * @param type[out]: 配置变更类型
@@ -261,6 +285,13 @@ class CopysetNode : public braft::StateMachine,
      */
     virtual void Propose(const braft::Task &task);
 
+    /**
+     * 返回propose合并工具，未开启合并时返回nullptr
+     */
+    ProposeBatcher* GetProposeBatcher() const {
+        return proposeBatcher_.get();
+    }
+
     /**
      * 获取复制组成员
      * @param peers:返回的成员列表(输出参数)
@@ -362,6 +393,14 @@ class CopysetNode : public braft::StateMachine,
      * better for test
      */
  public:
+    /**
+     * 从日志中反序列化出单个请求，放入并发模块apply，
+     * apply完成后更新applied index
+     * @param log: 单个请求的日志
+     * @param index: 日志的index，合并的日志中每个请求的index相同
+     */
+    void ApplyFromLog(const butil::IOBuf &log, uint64_t index);
+
     /**
      * 从文件中解析copyset配置版本信息
      * @param filePath:文件路径
@@ -385,6 +424,42 @@ class CopysetNode : public braft::StateMachine,
         return ToGroupIdString(logicPoolId_, copysetId_);
     }
 
+    inline GroupNid GroupNidValue() {
+        return ToGroupNid(logicPoolId_, copysetId_);
+    }
+
+    /**
+     * apply的日志条数或距上次刷盘的时间达到阈值时，
+     * 在并发模块中插入屏障，屏障之前的IO全部完成后异步刷盘，
+     * 并持久化applied index，
+     * 同步写模式下只在开启applied index持久化时插入屏障，
+     * 只在状态机线程中调用
+     * @param index: 当前apply到的日志index
+     */
+    void MaybeSyncData(uint64_t index);
+
+    /**
+     * 将datastore中未刷盘的数据刷盘，调用前index之前的IO必须已经全部完成
+     * @param index: 刷盘完成后持久化到的日志index
+     * @return 0 成功，-1 失败
+     */
+    int SyncData(uint64_t index);
+
+    /**
+     * 持久化已经落盘的applied index，只有比已经持久化的大时才写入
+     * @param index: 已经落盘的日志index
+     * @param reset: 为true时只有比已经持久化的小时才写入，用于安装快照后
+     *               保证持久化的index不超过快照的index
+     */
+    void SaveAppliedIndex(uint64_t index, bool reset = false);
+
+    /**
+     * 加载快照数据、配置以及重新初始化datastore
+     * @param reader: 快照的reader
+     * @return 0 成功，-1 失败
+     */
+    int LoadSnapshot(::braft::SnapshotReader *reader);
+
  private:
     // 逻辑池 id
     LogicPoolID logicPoolId_;
@@ -420,6 +495,10 @@ class CopysetNode : public braft::StateMachine,
     std::atomic<uint64_t> appliedIndex_;
     // 复制组当前任期，如果<=0表明不是leader
     std::atomic<int64_t> leaderTerm_;
+    // 是否在加载快照，加载期间数据目录会被替换，不允许follower read
+    std::atomic<bool> snapshotLoading_;
+    // 正在进行中的follower read数
+    std::atomic<int64_t> followerReads_;
     // 复制组数据回收站目录
     std::string recyclerUri_;
     // 复制组的metric信息
@@ -428,6 +507,32 @@ class CopysetNode : public braft::StateMachine,
     std::shared_ptr<ConfigurationChange> configChange_;
     // transfer leader的目标，状态为TRANSFERRING时有效
     Peer transferee_;
+    // 是否以O_DSYNC方式写chunk文件
+    bool syncWrite_;
+    // 触发批量刷盘的日志条数阈值
+    uint64_t syncIndexMargin_;
+    // 触发批量刷盘的时间阈值
+    uint32_t syncIntervalMs_;
+    // 状态机线程apply到的最新日志index
+    uint64_t lastApplyIndex_;
+    // 上次触发刷盘时的日志index和时间，只在状态机线程中访问
+    uint64_t lastSyncTriggerIndex_;
+    uint64_t lastSyncTimeMs_;
+    // 已经持久化到的日志index
+    std::atomic<uint64_t> syncedIndex_;
+    // 是否有正在进行的批量刷盘
+    std::atomic<bool> dataSyncing_;
+    // applied index持久化工具接口，未开启时为nullptr
+    std::unique_ptr<AppliedIndexFile> appliedIndexFile_;
+    // 保护applied index文件的写入
+    std::mutex appliedIndexLock_;
+    // 已经写入文件的applied index
+    uint64_t savedAppliedIndex_;
+    // 启动时加载的applied index，回放不大于它的日志时跳过apply，
+    // 只在状态机线程中访问
+    uint64_t skipApplyIndex_;
+    // 小写请求的propose合并，未开启时为nullptr
+    std::unique_ptr<ProposeBatcher> proposeBatcher_;
 };
 
 }  // namespace chunkserver
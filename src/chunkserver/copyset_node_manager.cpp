@@ -38,6 +38,7 @@
 #include "src/chunkserver/braft_cli_service.h"
 #include "src/chunkserver/braft_cli_service2.h"
 #include "src/chunkserver/uri_paser.h"
+#include "src/chunkserver/raftlog/curve_shared_log_storage.h"
 
 
 namespace curve {
@@ -463,6 +464,7 @@ bool CopysetNodeManager::PurgeCopysetNodeData(const LogicPoolID &logicPoolId,
         WriteLockGuard writeLockGuard(rwLock_);
         auto it = copysetNodeMap_.find(groupId);
         if (copysetNodeMap_.end() != it) {
+            ret = true;
             if (0 != copysetNodeOptions_.trash->RecycleCopySet(
                 it->second->GetCopysetDir())) {
                 LOG(ERROR) << "Failed to remove copyset "
@@ -473,8 +475,15 @@ bool CopysetNodeManager::PurgeCopysetNodeData(const LogicPoolID &logicPoolId,
             LOG(INFO) << "Move copyset"
                       << ToGroupIdString(logicPoolId, copysetId)
                       << "to trash success.";
+            // 使用共享日志时，复制组的日志不在copyset目录中，需要单独删除
+            if (0 != CurveSharedLogStorage::DropGroup(
+                copysetNodeOptions_.logUri,
+                ToGroupNid(logicPoolId, copysetId))) {
+                LOG(ERROR) << "Failed to drop shared log of copyset "
+                           << ToGroupIdString(logicPoolId, copysetId);
+                ret = false;
+            }
             copysetNodeMap_.erase(it);
-            ret = true;
         }
     }
 
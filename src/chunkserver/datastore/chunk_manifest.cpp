@@ -0,0 +1,487 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "src/chunkserver/datastore/chunk_manifest.h"
+#include "src/common/crc32.h"
+
+namespace curve {
+namespace chunkserver {
+
+const uint32_t kManifestMagic = 0x4d435343;
+const uint32_t kManifestVersion = 1;
+const uint32_t kManifestHeaderSize = 8;
+// type + length
+const uint32_t kRecordHeaderSize = 5;
+const uint32_t kRecordCrcSize = 4;
+// 缓冲的记录超过该大小时写入文件
+const uint32_t kManifestFlushThreshold = 64 * 1024;
+// 记录数少于该值时不重写文件
+const uint64_t kManifestMinCompactRecords = 1024;
+// id + sn + correctedSn + snapSn + flags + location length
+const uint32_t kEntryFixedSize = 8 * 4 + 1 + 4;
+const uint8_t kEntryFlagClone = 0x1;
+const uint8_t kEntryFlagMetaValid = 0x2;
+const uint8_t kEntryFlagHasBitmap = 0x4;
+// ino + mtimeSec + mtimeNsec + count
+const uint32_t kSealPayloadSize = 8 * 4;
+
+bool ChunkManifestEntry::operator==(const ChunkManifestEntry& other) const {
+    return id == other.id
+        && sn == other.sn
+        && correctedSn == other.correctedSn
+        && snapSn == other.snapSn
+        && isClone == other.isClone
+        && hasBitmap == other.hasBitmap
+        && metaValid == other.metaValid
+        && location == other.location;
+}
+
+ChunkManifest::ChunkManifest(std::shared_ptr<LocalFileSystem> lfs,
+                             const std::string& path)
+    : lfs_(lfs),
+      path_(path),
+      fd_(-1),
+      fileSize_(0),
+      recordCount_(0),
+      sealed_(false),
+      broken_(true) {
+    CHECK(lfs_ != nullptr) << "Create chunk manifest failed";
+}
+
+ChunkManifest::~ChunkManifest() {
+    LockGuard lock(mtx_);
+    closeLocked();
+}
+
+int ChunkManifest::Load(const DirStamp& stamp,
+                        std::vector<ChunkManifestEntry>* entries) {
+    LockGuard lock(mtx_);
+    closeLocked();
+    entries_.clear();
+    pending_.clear();
+    recordCount_ = 0;
+    sealed_ = false;
+    broken_ = true;
+
+    if (!lfs_->FileExists(path_)) {
+        LOG(INFO) << "Chunk manifest not exist: " << path_;
+        return -1;
+    }
+    int fd = lfs_->Open(path_, O_RDWR);
+    if (fd < 0) {
+        LOG(ERROR) << "Open chunk manifest failed: " << path_;
+        return -1;
+    }
+    struct stat fileInfo;
+    int rc = lfs_->Fstat(fd, &fileInfo);
+    if (rc < 0 || fileInfo.st_size < kManifestHeaderSize) {
+        LOG(ERROR) << "Invalid chunk manifest: " << path_;
+        lfs_->Close(fd);
+        return -1;
+    }
+
+    // 一次顺序读出整个文件
+    uint64_t size = fileInfo.st_size;
+    std::unique_ptr<char[]> buf(new char[size]);
+    rc = lfs_->Read(fd, buf.get(), 0, size);
+    if (rc < 0 || static_cast<uint64_t>(rc) != size) {
+        LOG(ERROR) << "Read chunk manifest failed: " << path_;
+        lfs_->Close(fd);
+        return -1;
+    }
+
+    bool valid = true;
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    memcpy(&magic, buf.get(), sizeof(magic));
+    memcpy(&version, buf.get() + sizeof(magic), sizeof(version));
+    if (magic != kManifestMagic || version != kManifestVersion) {
+        LOG(ERROR) << "Unknown chunk manifest format: " << path_;
+        valid = false;
+    }
+
+    RecordType lastType = RecordType::UNSEAL;
+    DirStamp sealStamp;
+    uint64_t sealCount = 0;
+    uint64_t off = kManifestHeaderSize;
+    while (valid && off < size) {
+        if (size - off < kRecordHeaderSize + kRecordCrcSize) {
+            LOG(ERROR) << "Truncated chunk manifest: " << path_;
+            valid = false;
+            break;
+        }
+        uint8_t type = buf[off];
+        uint32_t len = 0;
+        memcpy(&len, buf.get() + off + 1, sizeof(len));
+        if (size - off - kRecordHeaderSize - kRecordCrcSize < len) {
+            LOG(ERROR) << "Truncated chunk manifest: " << path_;
+            valid = false;
+            break;
+        }
+        const char* payload = buf.get() + off + kRecordHeaderSize;
+        uint32_t crc = 0;
+        memcpy(&crc, payload + len, sizeof(crc));
+        if (crc != curve::common::CRC32(buf.get() + off,
+                                        kRecordHeaderSize + len)) {
+            LOG(ERROR) << "Chunk manifest crc check failed: " << path_
+                       << ", offset: " << off;
+            valid = false;
+            break;
+        }
+
+        lastType = static_cast<RecordType>(type);
+        switch (lastType) {
+        case RecordType::PUT: {
+            ChunkManifestEntry entry;
+            valid = decodeEntry(payload, len, &entry);
+            if (valid) {
+                entries_[entry.id] = entry;
+            }
+            break;
+        }
+        case RecordType::DEL: {
+            ChunkID id = 0;
+            valid = (len == sizeof(id));
+            if (valid) {
+                memcpy(&id, payload, sizeof(id));
+                entries_.erase(id);
+            }
+            break;
+        }
+        case RecordType::SEAL:
+            valid = (len == kSealPayloadSize);
+            if (valid) {
+                memcpy(&sealStamp.ino, payload, 8);
+                memcpy(&sealStamp.mtimeSec, payload + 8, 8);
+                memcpy(&sealStamp.mtimeNsec, payload + 16, 8);
+                memcpy(&sealCount, payload + 24, 8);
+            }
+            break;
+        case RecordType::UNSEAL:
+            break;
+        default:
+            valid = false;
+            break;
+        }
+        if (!valid) {
+            LOG(ERROR) << "Invalid chunk manifest record: " << path_
+                       << ", offset: " << off
+                       << ", type: " << static_cast<int>(type);
+        }
+        off += kRecordHeaderSize + len + kRecordCrcSize;
+        ++recordCount_;
+    }
+
+    if (valid && lastType != RecordType::SEAL) {
+        LOG(WARNING) << "Chunk manifest is not sealed, "
+                     << "chunkserver may not exit normally: " << path_;
+        valid = false;
+    }
+    if (valid && (!(sealStamp == stamp) || sealCount != entries_.size())) {
+        LOG(WARNING) << "Chunk manifest is stale: " << path_;
+        valid = false;
+    }
+    if (!valid) {
+        lfs_->Close(fd);
+        entries_.clear();
+        recordCount_ = 0;
+        return -1;
+    }
+
+    fd_ = fd;
+    fileSize_ = size;
+    sealed_ = true;
+    broken_ = false;
+    // 加载后chunk元数据可能在数据目录不变的情况下发生变化，
+    // 先使manifest失效，保证异常退出后不会使用过期的manifest
+    if (unsealLocked() != 0) {
+        entries_.clear();
+        return -1;
+    }
+    entries->clear();
+    entries->reserve(entries_.size());
+    for (const auto& item : entries_) {
+        entries->push_back(item.second);
+    }
+    LOG(INFO) << "Load chunk manifest success: " << path_
+              << ", chunk count: " << entries->size();
+    return 0;
+}
+
+int ChunkManifest::Reset() {
+    LockGuard lock(mtx_);
+    closeLocked();
+    entries_.clear();
+    pending_.clear();
+    recordCount_ = 0;
+    sealed_ = false;
+    broken_ = true;
+
+    int fd = lfs_->Open(path_, O_RDWR|O_CREAT|O_TRUNC);
+    if (fd < 0) {
+        LOG(ERROR) << "Open chunk manifest failed: " << path_;
+        return -1;
+    }
+    char header[kManifestHeaderSize];
+    memcpy(header, &kManifestMagic, sizeof(kManifestMagic));
+    memcpy(header + sizeof(kManifestMagic),
+           &kManifestVersion, sizeof(kManifestVersion));
+    int rc = lfs_->Write(fd, header, 0, kManifestHeaderSize);
+    if (rc != kManifestHeaderSize || lfs_->Fdatasync(fd) != 0) {
+        LOG(ERROR) << "Write chunk manifest failed: " << path_;
+        lfs_->Close(fd);
+        return -1;
+    }
+    fd_ = fd;
+    fileSize_ = kManifestHeaderSize;
+    broken_ = false;
+    return 0;
+}
+
+void ChunkManifest::Put(const ChunkManifestEntry& entry) {
+    LockGuard lock(mtx_);
+    auto iter = entries_.find(entry.id);
+    if (iter != entries_.end() && iter->second == entry) {
+        return;
+    }
+    entries_[entry.id] = entry;
+    appendLocked(RecordType::PUT, encodeEntry(entry));
+}
+
+void ChunkManifest::Remove(ChunkID id) {
+    LockGuard lock(mtx_);
+    if (entries_.erase(id) == 0) {
+        return;
+    }
+    std::string payload(reinterpret_cast<const char*>(&id), sizeof(id));
+    appendLocked(RecordType::DEL, payload);
+}
+
+int ChunkManifest::Seal(const DirStamp& stamp) {
+    LockGuard lock(mtx_);
+    if (broken_ || fd_ < 0) {
+        LOG(WARNING) << "Chunk manifest is broken, skip seal: " << path_;
+        return -1;
+    }
+    if (recordCount_ > kManifestMinCompactRecords
+        && recordCount_ > 2 * entries_.size()) {
+        if (compactLocked() != 0) {
+            return -1;
+        }
+    }
+    appendRecord(RecordType::SEAL, encodeStamp(stamp, entries_.size()));
+    if (flushLocked(true) != 0) {
+        return -1;
+    }
+    sealed_ = true;
+    return 0;
+}
+
+uint32_t ChunkManifest::Size() {
+    LockGuard lock(mtx_);
+    return entries_.size();
+}
+
+int ChunkManifest::GetDirStamp(std::shared_ptr<LocalFileSystem> lfs,
+                               const std::string& dir,
+                               DirStamp* stamp) {
+    int fd = lfs->Open(dir, O_RDONLY|O_DIRECTORY);
+    if (fd < 0) {
+        LOG(ERROR) << "Open dir failed: " << dir;
+        return -1;
+    }
+    struct stat info;
+    int rc = lfs->Fstat(fd, &info);
+    lfs->Close(fd);
+    if (rc < 0) {
+        LOG(ERROR) << "Stat dir failed: " << dir;
+        return -1;
+    }
+    stamp->ino = info.st_ino;
+    stamp->mtimeSec = info.st_mtim.tv_sec;
+    stamp->mtimeNsec = info.st_mtim.tv_nsec;
+    return 0;
+}
+
+void ChunkManifest::appendRecord(RecordType type, const std::string& payload) {
+    size_t begin = pending_.size();
+    uint32_t len = payload.size();
+    pending_.push_back(static_cast<char>(type));
+    pending_.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    pending_.append(payload);
+    uint32_t crc = curve::common::CRC32(pending_.data() + begin,
+                                        kRecordHeaderSize + len);
+    pending_.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+    ++recordCount_;
+}
+
+void ChunkManifest::appendLocked(RecordType type, const std::string& payload) {
+    if (broken_) {
+        return;
+    }
+    if (sealed_ && unsealLocked() != 0) {
+        return;
+    }
+    appendRecord(type, payload);
+    if (pending_.size() >= kManifestFlushThreshold) {
+        flushLocked(false);
+    }
+}
+
+int ChunkManifest::flushLocked(bool sync) {
+    if (broken_ || fd_ < 0) {
+        return -1;
+    }
+    if (!pending_.empty()) {
+        int rc = lfs_->Write(fd_, pending_.data(), fileSize_, pending_.size());
+        if (rc < 0 || static_cast<size_t>(rc) != pending_.size()) {
+            LOG(ERROR) << "Write chunk manifest failed: " << path_
+                       << ", rc: " << rc;
+            broken_ = true;
+            return -1;
+        }
+        fileSize_ += pending_.size();
+        pending_.clear();
+    }
+    if (sync && lfs_->Fdatasync(fd_) != 0) {
+        LOG(ERROR) << "Sync chunk manifest failed: " << path_;
+        broken_ = true;
+        return -1;
+    }
+    return 0;
+}
+
+int ChunkManifest::compactLocked() {
+    std::string tmpPath = path_ + ".tmp";
+    int fd = lfs_->Open(tmpPath, O_RDWR|O_CREAT|O_TRUNC);
+    if (fd < 0) {
+        LOG(ERROR) << "Open chunk manifest failed: " << tmpPath;
+        broken_ = true;
+        return -1;
+    }
+    // 缓冲区中的记录已经反映在entries_中，可以直接丢弃
+    pending_.clear();
+    recordCount_ = 0;
+    pending_.append(reinterpret_cast<const char*>(&kManifestMagic),
+                    sizeof(kManifestMagic));
+    pending_.append(reinterpret_cast<const char*>(&kManifestVersion),
+                    sizeof(kManifestVersion));
+    for (const auto& item : entries_) {
+        appendRecord(RecordType::PUT, encodeEntry(item.second));
+    }
+    int rc = lfs_->Write(fd, pending_.data(), 0, pending_.size());
+    if (rc < 0 || static_cast<size_t>(rc) != pending_.size()
+        || lfs_->Fdatasync(fd) != 0
+        || lfs_->Rename(tmpPath, path_) != 0) {
+        LOG(ERROR) << "Compact chunk manifest failed: " << path_;
+        lfs_->Close(fd);
+        broken_ = true;
+        return -1;
+    }
+    closeLocked();
+    fd_ = fd;
+    fileSize_ = pending_.size();
+    pending_.clear();
+    LOG(INFO) << "Compact chunk manifest success: " << path_
+              << ", chunk count: " << entries_.size();
+    return 0;
+}
+
+int ChunkManifest::unsealLocked() {
+    appendRecord(RecordType::UNSEAL, "");
+    if (flushLocked(true) != 0) {
+        return -1;
+    }
+    sealed_ = false;
+    return 0;
+}
+
+void ChunkManifest::closeLocked() {
+    if (fd_ >= 0) {
+        lfs_->Close(fd_);
+        fd_ = -1;
+    }
+}
+
+std::string ChunkManifest::encodeEntry(const ChunkManifestEntry& entry) {
+    std::string buf;
+    buf.reserve(kEntryFixedSize + entry.location.size());
+    uint8_t flags = 0;
+    if (entry.isClone) {
+        flags |= kEntryFlagClone;
+    }
+    if (entry.metaValid) {
+        flags |= kEntryFlagMetaValid;
+    }
+    if (entry.hasBitmap) {
+        flags |= kEntryFlagHasBitmap;
+    }
+    uint32_t locationLen = entry.location.size();
+    buf.append(reinterpret_cast<const char*>(&entry.id), 8);
+    buf.append(reinterpret_cast<const char*>(&entry.sn), 8);
+    buf.append(reinterpret_cast<const char*>(&entry.correctedSn), 8);
+    buf.append(reinterpret_cast<const char*>(&entry.snapSn), 8);
+    buf.append(reinterpret_cast<const char*>(&flags), 1);
+    buf.append(reinterpret_cast<const char*>(&locationLen), 4);
+    buf.append(entry.location);
+    return buf;
+}
+
+bool ChunkManifest::decodeEntry(const char* buf, uint32_t len,
+                                ChunkManifestEntry* entry) {
+    if (len < kEntryFixedSize) {
+        return false;
+    }
+    uint8_t flags = 0;
+    uint32_t locationLen = 0;
+    memcpy(&entry->id, buf, 8);
+    memcpy(&entry->sn, buf + 8, 8);
+    memcpy(&entry->correctedSn, buf + 16, 8);
+    memcpy(&entry->snapSn, buf + 24, 8);
+    memcpy(&flags, buf + 32, 1);
+    memcpy(&locationLen, buf + 33, 4);
+    if (len != kEntryFixedSize + locationLen) {
+        return false;
+    }
+    entry->isClone = flags & kEntryFlagClone;
+    entry->metaValid = flags & kEntryFlagMetaValid;
+    entry->hasBitmap = flags & kEntryFlagHasBitmap;
+    entry->location.assign(buf + kEntryFixedSize, locationLen);
+    return true;
+}
+
+std::string ChunkManifest::encodeStamp(const DirStamp& stamp, uint64_t count) {
+    std::string buf;
+    buf.append(reinterpret_cast<const char*>(&stamp.ino), 8);
+    buf.append(reinterpret_cast<const char*>(&stamp.mtimeSec), 8);
+    buf.append(reinterpret_cast<const char*>(&stamp.mtimeNsec), 8);
+    buf.append(reinterpret_cast<const char*>(&count), 8);
+    return buf;
+}
+
+}  // namespace chunkserver
+}  // namespace curve
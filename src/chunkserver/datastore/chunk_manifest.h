@@ -0,0 +1,198 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_DATASTORE_CHUNK_MANIFEST_H_
+#define SRC_CHUNKSERVER_DATASTORE_CHUNK_MANIFEST_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "include/chunkserver/chunkserver_common.h"
+#include "src/common/concurrent/concurrent.h"
+#include "src/fs/local_filesystem.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::fs::LocalFileSystem;
+using curve::common::Mutex;
+using curve::common::LockGuard;
+
+/**
+ * manifest中记录的chunk元数据
+ * snapSn:chunk快照文件的版本号，0表示不存在快照
+ * hasBitmap:非clone chunk的metapage中记录了page的写入状态，首次访问时需要加载
+ * metaValid:为false时只记录了chunk文件的存在，
+ *           sn、correctedSn、location需要在首次访问时从metapage加载
+ */
+struct ChunkManifestEntry {
+    ChunkID     id;
+    SequenceNum sn;
+    SequenceNum correctedSn;
+    SequenceNum snapSn;
+    bool        isClone;
+    bool        hasBitmap;
+    bool        metaValid;
+    std::string location;
+
+    ChunkManifestEntry() : id(0)
+                         , sn(0)
+                         , correctedSn(0)
+                         , snapSn(0)
+                         , isClone(false)
+                         , hasBitmap(false)
+                         , metaValid(false)
+                         , location("") {}
+
+    bool operator==(const ChunkManifestEntry& other) const;
+    bool operator!=(const ChunkManifestEntry& other) const {
+        return !(*this == other);
+    }
+};
+
+/**
+ * 数据目录的状态，目录下创建、删除、rename文件都会改变mtime
+ */
+struct DirStamp {
+    uint64_t ino;
+    uint64_t mtimeSec;
+    uint64_t mtimeNsec;
+
+    DirStamp() : ino(0), mtimeSec(0), mtimeNsec(0) {}
+    bool operator==(const DirStamp& other) const {
+        return ino == other.ino
+            && mtimeSec == other.mtimeSec
+            && mtimeNsec == other.mtimeNsec;
+    }
+};
+
+/**
+ * copyset数据目录的chunk元数据清单，用于chunkserver启动时代替目录扫描
+ * 文件格式: magic(4 bytes) version(4 bytes) record...
+ * record格式: type(1 byte) length(4 bytes) payload(length bytes) crc(4 bytes)
+ * 1.运行过程中chunk元数据变化时追加记录，记录先缓存在内存中批量写入
+ * 2.正常退出时调用Seal，写入数据目录的状态并落盘
+ * 3.启动时只有manifest完整、已封存并且数据目录的状态与封存时一致才可以使用，
+ *   加载后立即追加解封记录并落盘，异常退出后的manifest都会被认为已过期
+ * 4.记录数超过有效chunk数的两倍时，在Seal时重写整个文件
+ */
+class ChunkManifest {
+ public:
+    ChunkManifest(std::shared_ptr<LocalFileSystem> lfs,
+                  const std::string& path);
+    virtual ~ChunkManifest();
+
+    /**
+     * 加载manifest
+     * @param stamp: 数据目录当前的状态
+     * @param[out] entries: manifest中记录的chunk
+     * @return: 成功返回0；文件不存在、损坏、未封存或者已过期返回-1
+     */
+    int Load(const DirStamp& stamp, std::vector<ChunkManifestEntry>* entries);
+
+    /**
+     * 清空manifest，全量扫描数据目录之前调用
+     * @return: 成功返回0，失败返回-1
+     */
+    int Reset();
+
+    /**
+     * 记录chunk的元数据，与已记录的相同时不追加记录
+     */
+    void Put(const ChunkManifestEntry& entry);
+
+    /**
+     * 删除chunk的记录
+     */
+    void Remove(ChunkID id);
+
+    /**
+     * 将缓存的记录写入文件并封存，调用后数据目录不能再有变化
+     * @param stamp: 数据目录当前的状态
+     * @return: 成功返回0，失败返回-1
+     */
+    int Seal(const DirStamp& stamp);
+
+    /**
+     * 当前记录的chunk数量
+     */
+    uint32_t Size();
+
+    /**
+     * 获取目录的状态
+     * @return: 成功返回0，失败返回-1
+     */
+    static int GetDirStamp(std::shared_ptr<LocalFileSystem> lfs,
+                           const std::string& dir,
+                           DirStamp* stamp);
+
+ private:
+    enum class RecordType : uint8_t {
+        PUT = 1,
+        DEL = 2,
+        SEAL = 3,
+        UNSEAL = 4,
+    };
+
+    // 将记录编码后追加到缓冲区
+    void appendRecord(RecordType type, const std::string& payload);
+    // 在持有mtx_的情况下追加记录，缓冲区超过阈值时写入文件
+    void appendLocked(RecordType type, const std::string& payload);
+    // 将缓冲区写入文件，sync为true时同时落盘
+    int flushLocked(bool sync);
+    // 重写整个文件，只保留有效的chunk记录
+    int compactLocked();
+    // 追加解封记录并落盘，保证在数据目录变化之前manifest已失效
+    int unsealLocked();
+    void closeLocked();
+
+    static std::string encodeEntry(const ChunkManifestEntry& entry);
+    static bool decodeEntry(const char* buf, uint32_t len,
+                            ChunkManifestEntry* entry);
+    static std::string encodeStamp(const DirStamp& stamp, uint64_t count);
+
+ private:
+    std::shared_ptr<LocalFileSystem> lfs_;
+    std::string path_;
+    Mutex mtx_;
+    int fd_;
+    // 文件当前的长度，新的记录写在这个位置
+    uint64_t fileSize_;
+    // 还未写入文件的记录
+    std::string pending_;
+    // 文件中的记录数，用于判断是否需要重写
+    uint64_t recordCount_;
+    // 文件最后一条记录是否为封存记录
+    bool sealed_;
+    // 写文件失败后manifest不再可信，不会被封存
+    bool broken_;
+    std::unordered_map<ChunkID, ChunkManifestEntry> entries_;
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_DATASTORE_CHUNK_MANIFEST_H_
@@ -0,0 +1,154 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-12-10
+ * Author: curve
+ */
+
+#include <glog/logging.h>
+#include <string.h>
+
+#include "src/chunkserver/datastore/chunk_read_cache.h"
+
+namespace curve {
+namespace chunkserver {
+
+ChunkReadCache::ChunkReadCache(uint64_t capacity, PageSizeType pageSize)
+    : capacity_(capacity),
+      pageSize_(pageSize) {
+    CHECK(pageSize_ > 0) << "Invalid read cache page size";
+    shardPages_ = capacity_ / pageSize_ / kShardNum;
+    CHECK(shardPages_ > 0) << "Invalid read cache capacity";
+}
+
+uint32_t ChunkReadCache::Get(ChunkID id,
+                             SequenceNum sn,
+                             uint32_t beginIndex,
+                             uint32_t count,
+                             char* buf,
+                             std::vector<bool>* hits) {
+    hits->assign(count, false);
+    uint32_t hitCount = 0;
+    Shard& shard = getShard(id);
+    LockGuard lock(shard.mtx);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto iter = shard.index.find(PageKey(id, sn, beginIndex + i));
+        if (iter == shard.index.end()) {
+            continue;
+        }
+        memcpy(buf + i * pageSize_, iter->second->data.get(), pageSize_);
+        shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+        (*hits)[i] = true;
+        ++hitCount;
+    }
+    return hitCount;
+}
+
+void ChunkReadCache::Put(ChunkID id,
+                         SequenceNum sn,
+                         uint32_t beginIndex,
+                         uint32_t count,
+                         const char* buf,
+                         const std::vector<bool>* hits) {
+    Shard& shard = getShard(id);
+    LockGuard lock(shard.mtx);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (hits != nullptr && (*hits)[i]) {
+            continue;
+        }
+        insertLocked(&shard,
+                     PageKey(id, sn, beginIndex + i),
+                     buf + i * pageSize_);
+    }
+}
+
+void ChunkReadCache::Update(ChunkID id,
+                            SequenceNum sn,
+                            uint32_t beginIndex,
+                            uint32_t count,
+                            const char* buf) {
+    Shard& shard = getShard(id);
+    LockGuard lock(shard.mtx);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto iter = shard.index.find(PageKey(id, sn, beginIndex + i));
+        if (iter != shard.index.end()) {
+            memcpy(iter->second->data.get(), buf + i * pageSize_, pageSize_);
+        }
+    }
+}
+
+void ChunkReadCache::Update(ChunkID id,
+                            SequenceNum sn,
+                            uint32_t beginIndex,
+                            uint32_t count,
+                            const butil::IOBuf& buf) {
+    Shard& shard = getShard(id);
+    LockGuard lock(shard.mtx);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto iter = shard.index.find(PageKey(id, sn, beginIndex + i));
+        if (iter != shard.index.end()) {
+            buf.copy_to(iter->second->data.get(), pageSize_, i * pageSize_);
+        }
+    }
+}
+
+void ChunkReadCache::Invalidate(ChunkID id) {
+    Shard& shard = getShard(id);
+    LockGuard lock(shard.mtx);
+    auto iter = shard.index.lower_bound(PageKey(id, 0, 0));
+    while (iter != shard.index.end() && std::get<0>(iter->first) == id) {
+        shard.lru.erase(iter->second);
+        iter = shard.index.erase(iter);
+    }
+}
+
+uint64_t ChunkReadCache::Size() {
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < kShardNum; ++i) {
+        LockGuard lock(shards_[i].mtx);
+        size += shards_[i].index.size();
+    }
+    return size;
+}
+
+void ChunkReadCache::insertLocked(Shard* shard,
+                                  const PageKey& key,
+                                  const char* data) {
+    auto iter = shard->index.find(key);
+    if (iter != shard->index.end()) {
+        memcpy(iter->second->data.get(), data, pageSize_);
+        shard->lru.splice(shard->lru.begin(), shard->lru, iter->second);
+        return;
+    }
+    // 分片已满时复用最久未访问的page的内存
+    std::unique_ptr<char[]> buf;
+    if (shard->index.size() >= shardPages_) {
+        CachedPage& victim = shard->lru.back();
+        shard->index.erase(victim.key);
+        buf = std::move(victim.data);
+        shard->lru.pop_back();
+    } else {
+        buf.reset(new char[pageSize_]);
+    }
+    memcpy(buf.get(), data, pageSize_);
+    shard->lru.push_front(CachedPage{key, std::move(buf)});
+    shard->index[key] = shard->lru.begin();
+}
+
+}  // namespace chunkserver
+}  // namespace curve
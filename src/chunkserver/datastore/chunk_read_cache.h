@@ -0,0 +1,144 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-12-10
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_DATASTORE_CHUNK_READ_CACHE_H_
+#define SRC_CHUNKSERVER_DATASTORE_CHUNK_READ_CACHE_H_
+
+#include <butil/iobuf.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "include/chunkserver/chunkserver_common.h"
+#include "src/common/concurrent/concurrent.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::common::Mutex;
+using curve::common::LockGuard;
+
+/**
+ * chunkserver上所有datastore共享的chunk数据读缓存，以page为单位缓存
+ * 1.缓存的key为(chunk id, chunk版本号, page索引)，chunk版本号变化后
+ *   旧版本的page不会再被命中
+ * 2.读盘后调用Put填充缓存，写入时调用Update更新已缓存的page，不会插入新的page
+ * 3.按chunk id分片，每个分片独立加锁并按LRU淘汰，一次请求只需要加一次锁
+ * 4.chunk删除或者析构时需要调用Invalidate清除其所有page
+ */
+class ChunkReadCache {
+ public:
+    // 分片数为2的kShardBits次幂
+    static const uint32_t kShardBits = 4;
+    static const uint32_t kShardNum = 1 << kShardBits;
+
+    /**
+     * @param capacity: 缓存的总字节数
+     * @param pageSize: 缓存的page大小，与chunk的page大小一致
+     */
+    ChunkReadCache(uint64_t capacity, PageSizeType pageSize);
+    virtual ~ChunkReadCache() {}
+
+    /**
+     * 查找连续的count个page，命中的page拷贝到buf中对应的位置
+     * @param hits[out]: 每个page是否命中
+     * @return 命中的page数
+     */
+    uint32_t Get(ChunkID id, SequenceNum sn, uint32_t beginIndex,
+                 uint32_t count, char* buf, std::vector<bool>* hits);
+
+    /**
+     * 将读盘得到的连续count个page放入缓存
+     * @param hits: 不为空时跳过其中已命中的page
+     */
+    void Put(ChunkID id, SequenceNum sn, uint32_t beginIndex,
+             uint32_t count, const char* buf,
+             const std::vector<bool>* hits = nullptr);
+
+    /**
+     * 写入数据后更新已缓存的page，未缓存的page不插入
+     */
+    void Update(ChunkID id, SequenceNum sn, uint32_t beginIndex,
+                uint32_t count, const char* buf);
+    void Update(ChunkID id, SequenceNum sn, uint32_t beginIndex,
+                uint32_t count, const butil::IOBuf& buf);
+
+    /**
+     * 清除chunk所有版本的page
+     */
+    void Invalidate(ChunkID id);
+
+    /**
+     * 当前缓存的page数
+     */
+    uint64_t Size();
+
+    uint64_t Capacity() const {
+        return capacity_;
+    }
+
+    PageSizeType PageSize() const {
+        return pageSize_;
+    }
+
+ private:
+    // (chunk id, chunk版本号, page索引)
+    using PageKey = std::tuple<ChunkID, SequenceNum, uint32_t>;
+
+    struct CachedPage {
+        PageKey key;
+        std::unique_ptr<char[]> data;
+    };
+    using PageList = std::list<CachedPage>;
+
+    struct Shard {
+        Mutex mtx;
+        // 链表头部为最近访问的page
+        PageList lru;
+        // 有序的索引，可以按chunk id范围删除
+        std::map<PageKey, PageList::iterator> index;
+    };
+
+    inline Shard& getShard(ChunkID id) {
+        return shards_[id & (kShardNum - 1)];
+    }
+
+    // 在持有分片锁的情况下插入page，超过分片容量时淘汰最久未访问的page
+    void insertLocked(Shard* shard, const PageKey& key, const char* data);
+
+ private:
+    const uint64_t capacity_;
+    const PageSizeType pageSize_;
+    // 每个分片最多缓存的page数
+    uint64_t shardPages_;
+    Shard shards_[kShardNum];
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_DATASTORE_CHUNK_READ_CACHE_H_
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <glog/logging.h>
+
+#include "src/chunkserver/datastore/chunkfile_fd_cache.h"
+
+namespace curve {
+namespace chunkserver {
+
+ChunkFdCache::ChunkFdCache(uint32_t capacity)
+    : capacity_(capacity),
+      evictCount_(0) {
+    CHECK(capacity_ > 0) << "Invalid fd cache capacity";
+    hand_ = entries_.end();
+}
+
+void ChunkFdCache::Insert(FdCacheEntry* entry) {
+    LockGuard lock(mtx_);
+    entry->referenced_.store(true, std::memory_order_relaxed);
+    if (entry->inCache_) {
+        return;
+    }
+    // 插入到时钟指针之前，即最后一个被检查
+    entry->iter_ = entries_.insert(hand_, entry);
+    entry->inCache_ = true;
+    if (entries_.size() > capacity_) {
+        evictLocked(entry);
+    }
+}
+
+void ChunkFdCache::Remove(FdCacheEntry* entry) {
+    LockGuard lock(mtx_);
+    if (entry->inCache_) {
+        eraseLocked(entry);
+    }
+}
+
+uint32_t ChunkFdCache::Size() {
+    LockGuard lock(mtx_);
+    return entries_.size();
+}
+
+void ChunkFdCache::eraseLocked(FdCacheEntry* entry) {
+    if (hand_ == entry->iter_) {
+        hand_ = entries_.erase(entry->iter_);
+    } else {
+        entries_.erase(entry->iter_);
+    }
+    entry->inCache_ = false;
+}
+
+void ChunkFdCache::evictLocked(FdCacheEntry* except) {
+    // 最多转两圈：第一圈清除访问标记，第二圈淘汰未被访问的文件
+    size_t steps = 2 * entries_.size();
+    while (entries_.size() > capacity_ && steps-- > 0) {
+        if (hand_ == entries_.end()) {
+            hand_ = entries_.begin();
+        }
+        FdCacheEntry* entry = *hand_;
+        if (entry == except) {
+            ++hand_;
+            continue;
+        }
+        if (entry->referenced_.exchange(false, std::memory_order_relaxed)) {
+            ++hand_;
+            continue;
+        }
+        if (!entry->TryCloseFd()) {
+            // 正在被使用，本轮跳过
+            ++hand_;
+            continue;
+        }
+        eraseLocked(entry);
+        evictCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace chunkserver
+}  // namespace curve
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_DATASTORE_CHUNKFILE_FD_CACHE_H_
+#define SRC_CHUNKSERVER_DATASTORE_CHUNKFILE_FD_CACHE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+
+#include "src/common/concurrent/concurrent.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::common::Mutex;
+using curve::common::LockGuard;
+
+class ChunkFdCache;
+
+/**
+ * 持有fd并可以被ChunkFdCache淘汰的文件
+ */
+class FdCacheEntry {
+ public:
+    FdCacheEntry() : inCache_(false), referenced_(false) {}
+    virtual ~FdCacheEntry() {}
+
+    /**
+     * 尝试关闭fd，文件正在被使用时不关闭
+     * 由ChunkFdCache在持有自身锁的情况下调用，实现中不能再调用ChunkFdCache的接口
+     * @return 成功关闭返回true，否则返回false
+     */
+    virtual bool TryCloseFd() = 0;
+
+    /**
+     * 标记文件最近被访问过，淘汰时会跳过一轮
+     */
+    void MarkReferenced() {
+        referenced_.store(true, std::memory_order_relaxed);
+    }
+
+ private:
+    friend class ChunkFdCache;
+    // 以下两个成员由ChunkFdCache在持有其锁的情况下访问
+    bool inCache_;
+    std::list<FdCacheEntry*>::iterator iter_;
+    std::atomic<bool> referenced_;
+};
+
+/**
+ * chunkserver上所有datastore共享的fd缓存，限制同时打开的chunk文件数
+ * 1.文件打开fd后调用Insert加入缓存，数量超过容量时淘汰最近未被访问的文件
+ * 2.淘汰采用CLOCK算法近似LRU，访问文件时只需要设置访问标记，不需要加锁
+ * 3.正在被使用的文件不会被淘汰，此时允许短暂超过容量
+ * 4.文件关闭fd或者析构前需要调用Remove
+ */
+class ChunkFdCache {
+ public:
+    explicit ChunkFdCache(uint32_t capacity);
+    virtual ~ChunkFdCache() {}
+
+    /**
+     * 将打开了fd的文件加入缓存，如果已在缓存中则只标记访问
+     * 超过容量时淘汰其他文件，不会淘汰entry本身
+     */
+    void Insert(FdCacheEntry* entry);
+
+    /**
+     * 将文件从缓存中移除，不会关闭fd
+     */
+    void Remove(FdCacheEntry* entry);
+
+    /**
+     * 当前缓存中的文件数
+     */
+    uint32_t Size();
+
+    uint32_t Capacity() const {
+        return capacity_;
+    }
+
+    /**
+     * 累计淘汰的文件数
+     */
+    uint64_t EvictCount() const {
+        return evictCount_.load(std::memory_order_relaxed);
+    }
+
+ private:
+    // 在持有mtx_的情况下淘汰文件，直到数量不超过容量或者没有可淘汰的文件
+    void evictLocked(FdCacheEntry* except);
+    // 从缓存中移除entry，并保证时钟指针有效
+    void eraseLocked(FdCacheEntry* entry);
+
+ private:
+    const uint32_t capacity_;
+    Mutex mtx_;
+    std::list<FdCacheEntry*> entries_;
+    // CLOCK算法的时钟指针，指向下一个待检查的文件
+    std::list<FdCacheEntry*>::iterator hand_;
+    std::atomic<uint64_t> evictCount_;
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_DATASTORE_CHUNKFILE_FD_CACHE_H_
@@ -36,8 +36,11 @@
 #include "src/common/configuration.h"
 #include "src/common/curve_define.h"
 #include "src/chunkserver/datastore/chunkfile_pool.h"
+#include "src/chunkserver/datastore/direct_io.h"
 
 using curve::common::kChunkFilePoolMaigic;
+using curve::common::AlignedBuffer;
+using curve::common::AlignedBufferPool;
 
 namespace curve {
 namespace chunkserver {
@@ -46,6 +49,19 @@ const char* ChunkfilePoolHelper::kMetaPageSize = "metaPageSize";
 const char* ChunkfilePoolHelper::kChunkFilePoolPath = "chunkfilepool_path";
 const char* ChunkfilePoolHelper::kCRC = "crc";
 const uint32_t ChunkfilePoolHelper::kPersistSize = 4096;
+// 后台补充线程检查池中chunk数以及出错后重试的时间间隔
+static const uint32_t kRefillCheckIntervalMs = 1000;
+// 不从池中取chunk时，后台补充的chunk放在池目录下的独立子目录中，
+// 池目录可能与copyset数据目录相同，不能直接清理池目录
+static const char* kRefillPoolDir = "refillpool";
+
+// 池中chunk文件名只由数字组成
+static bool IsPoolChunkName(const std::string& name) {
+    return !name.empty() &&
+        std::all_of(name.begin(), name.end(), [](unsigned char c) {
+        return std::isdigit(c);
+    });
+}
 
 int ChunkfilePoolHelper::PersistEnCodeMetaInfo(
                                     std::shared_ptr<LocalFileSystem> fsptr,
@@ -206,35 +222,173 @@ int ChunkfilePoolHelper::DecodeMetaInfoFromMetaFile(
 }
 
 ChunkfilePool::ChunkfilePool(std::shared_ptr<LocalFileSystem> fsptr):
-                             currentmaxfilenum_(0) {
+                             currentmaxfilenum_(0),
+                             refillStop_(true) {
     CHECK(fsptr != nullptr) << "fs ptr allocate failed!";
     fsptr_ = fsptr;
     tmpChunkvec_.clear();
 }
 
+ChunkfilePool::~ChunkfilePool() {
+    StopRefill();
+}
+
 bool ChunkfilePool::Initialize(const ChunkfilePoolOptions& cfopt) {
     chunkPoolOpt_ = cfopt;
+    if (chunkPoolOpt_.enableRefill &&
+        (chunkPoolOpt_.refillHighWatermark == 0 ||
+         chunkPoolOpt_.refillHighWatermark <
+         chunkPoolOpt_.refillLowWatermark)) {
+        LOG(ERROR) << "invalid refill watermark, low = "
+                   << chunkPoolOpt_.refillLowWatermark
+                   << ", high = " << chunkPoolOpt_.refillHighWatermark;
+        return false;
+    }
+
     if (chunkPoolOpt_.getChunkFromPool) {
         if (!CheckValid()) {
             LOG(ERROR) << "check valid failed!";
             return false;
         }
-        if (fsptr_->DirExists(currentdir_.c_str())) {
-            return ScanInternal();
-        } else {
+        if (!fsptr_->DirExists(currentdir_.c_str())) {
             LOG(ERROR) << "chunkfile pool not exists, inited failed!"
                        << " chunkfile pool path = " << currentdir_.c_str();
             return false;
         }
+        if (!ScanInternal()) {
+            return false;
+        }
     } else {
         currentdir_ = chunkPoolOpt_.chunkFilePoolDir;
+        if (chunkPoolOpt_.enableRefill) {
+            currentdir_ = currentdir_ + "/" + kRefillPoolDir;
+        }
         if (!fsptr_->DirExists(currentdir_.c_str())) {
-            return fsptr_->Mkdir(currentdir_.c_str()) == 0;
+            if (fsptr_->Mkdir(currentdir_.c_str()) != 0) {
+                return false;
+            }
+        } else if (chunkPoolOpt_.enableRefill && !CleanTmpChunks()) {
+            return false;
         }
     }
+
+    if (chunkPoolOpt_.enableRefill) {
+        std::unique_lock<std::mutex> lk(mtx_);
+        refillStop_ = false;
+        refillThread_ = curve::common::Thread(&ChunkfilePool::RefillWorker,
+                                              this);
+        LOG(INFO) << "chunkfile pool refill started, low watermark = "
+                  << chunkPoolOpt_.refillLowWatermark
+                  << ", high watermark = "
+                  << chunkPoolOpt_.refillHighWatermark
+                  << ", throughput = " << chunkPoolOpt_.refillThroughputBytes;
+    }
+    return true;
+}
+
+bool ChunkfilePool::CleanTmpChunks() {
+    std::vector<std::string> files;
+    if (fsptr_->List(currentdir_.c_str(), &files) < 0) {
+        LOG(ERROR) << "list chunkfile pool dir failed, " << currentdir_;
+        return false;
+    }
+    // 先检查目录中只有补充遗留的chunk文件，有其他文件说明目录配置错误，
+    // 拒绝启动而不是删除
+    for (auto& file : files) {
+        std::string path = currentdir_ + "/" + file;
+        if (!IsPoolChunkName(file) || !fsptr_->FileExists(path)) {
+            LOG(ERROR) << "refill pool dir contains unexpected entry, "
+                       << path;
+            return false;
+        }
+    }
+    for (auto& file : files) {
+        std::string path = currentdir_ + "/" + file;
+        if (fsptr_->Delete(path.c_str()) < 0) {
+            LOG(ERROR) << "delete tmp chunk failed, " << path;
+            return false;
+        }
+    }
+    return true;
+}
+
+void ChunkfilePool::RefillWorker() {
+    uint64_t chunklen = chunkPoolOpt_.chunkSize + chunkPoolOpt_.metaPageSize;
+    // 按照限速计算每补充一个chunk后需要等待的时间
+    std::chrono::microseconds throttle(0);
+    if (chunkPoolOpt_.refillThroughputBytes > 0) {
+        throttle = std::chrono::microseconds(
+            chunklen * 1000000 / chunkPoolOpt_.refillThroughputBytes);
+    }
+    auto interval = std::chrono::milliseconds(kRefillCheckIntervalMs);
+
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (!refillStop_) {
+        refillCond_.wait_for(lk, interval, [this] {
+            return refillStop_ ||
+                tmpChunkvec_.size() < chunkPoolOpt_.refillLowWatermark;
+        });
+        if (refillStop_) {
+            break;
+        }
+        if (tmpChunkvec_.size() >= chunkPoolOpt_.refillLowWatermark) {
+            continue;
+        }
+
+        // 优先回收trash中已过期的chunk，这部分chunk不需要重新格式化
+        std::function<void()> reclaimer = trashReclaimer_;
+        if (reclaimer) {
+            lk.unlock();
+            reclaimer();
+            lk.lock();
+        }
+
+        while (!refillStop_ &&
+               tmpChunkvec_.size() < chunkPoolOpt_.refillHighWatermark) {
+            lk.unlock();
+            bool success = RefillOneChunk();
+            lk.lock();
+            if (!success) {
+                // 格式化失败，等待一段时间后再重试，避免空转
+                refillCond_.wait_for(lk, interval,
+                                     [this] { return refillStop_; });
+                break;
+            }
+            if (throttle.count() > 0) {
+                refillCond_.wait_for(lk, throttle,
+                                     [this] { return refillStop_; });
+            }
+        }
+    }
+}
+
+bool ChunkfilePool::RefillOneChunk() {
+    uint64_t chunkID = currentmaxfilenum_.fetch_add(1) + 1;
+    std::string chunkpath = currentdir_ + "/" + std::to_string(chunkID);
+    if (AllocateChunk(chunkpath) < 0) {
+        LOG(ERROR) << "refill chunk failed, " << chunkpath;
+        fsptr_->Delete(chunkpath.c_str());
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lk(mtx_);
+    tmpChunkvec_.push_back(chunkID);
+    ++currentState_.preallocatedChunksLeft;
+    metric_.refillChunkCount << 1;
     return true;
 }
 
+void ChunkfilePool::StopRefill() {
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        refillStop_ = true;
+    }
+    refillCond_.notify_all();
+    if (refillThread_.joinable()) {
+        refillThread_.join();
+    }
+}
+
 bool ChunkfilePool::CheckValid() {
     uint32_t chunksize = 0;
     uint32_t metapagesize = 0;
@@ -264,25 +418,42 @@ int ChunkfilePool::GetChunk(const std::string& targetpath, char* metapage) {
     while (retry < chunkPoolOpt_.retryTimes) {
         uint64_t chunkID;
         std::string srcpath;
-        if (chunkPoolOpt_.getChunkFromPool) {
+        bool fromPool = false;
+        // 开启后台补充时，优先从池中取已经格式化好的chunk
+        if (chunkPoolOpt_.getChunkFromPool || chunkPoolOpt_.enableRefill) {
             std::unique_lock<std::mutex> lk(mtx_);
-            if (tmpChunkvec_.empty()) {
+            if (!tmpChunkvec_.empty()) {
+                chunkID = tmpChunkvec_.back();
+                srcpath = currentdir_ + "/" + std::to_string(chunkID);
+                tmpChunkvec_.pop_back();
+                --currentState_.preallocatedChunksLeft;
+                fromPool = true;
+            }
+            if (chunkPoolOpt_.enableRefill &&
+                tmpChunkvec_.size() < chunkPoolOpt_.refillLowWatermark) {
+                refillCond_.notify_one();
+            }
+        }
+
+        if (!fromPool) {
+            // 池中没有chunk且没有开启后台补充，直接失败
+            if (chunkPoolOpt_.getChunkFromPool &&
+                !chunkPoolOpt_.enableRefill) {
                 LOG(ERROR) << "no avaliable chunk!";
                 break;
             }
-            chunkID = tmpChunkvec_.back();
+            // 后台补充跟不上时在写路径上同步格式化
+            chunkID = currentmaxfilenum_.fetch_add(1) + 1;
             srcpath = currentdir_ + "/" + std::to_string(chunkID);
-            tmpChunkvec_.pop_back();
-            --currentState_.preallocatedChunksLeft;
-        } else {
-            currentmaxfilenum_.fetch_add(1);
-            srcpath = currentdir_ + "/" + std::to_string(currentmaxfilenum_);
             int r = AllocateChunk(srcpath);
             if (r < 0) {
                 LOG(ERROR) << "file allocate failed, " << srcpath.c_str();
                 retry++;
                 continue;
             }
+            if (chunkPoolOpt_.enableRefill) {
+                metric_.syncAllocChunkCount << 1;
+            }
         }
 
         bool rc = WriteMetaPage(srcpath, metapage);
@@ -305,6 +476,8 @@ int ChunkfilePool::GetChunk(const std::string& targetpath, char* metapage) {
             } else {
                 LOG(INFO) << "get chunk success! now pool size = "
                           << tmpChunkvec_.size();
+                markDirDirty(srcpath);
+                markDirDirty(targetpath);
                 break;
             }
         } else {
@@ -313,13 +486,20 @@ int ChunkfilePool::GetChunk(const std::string& targetpath, char* metapage) {
         }
         retry++;
     }
+    if (ret < 0) {
+        metric_.getChunkFailCount << 1;
+    }
     return ret;
 }
 
 int ChunkfilePool::AllocateChunk(const std::string& chunkpath) {
     uint64_t chunklen = chunkPoolOpt_.chunkSize + chunkPoolOpt_.metaPageSize;
 
-    int ret = fsptr_->Open(chunkpath.c_str(), O_RDWR | O_CREAT);
+    int flags = O_RDWR | O_CREAT;
+    if (chunkPoolOpt_.directIO) {
+        flags |= O_DIRECT;
+    }
+    int ret = fsptr_->Open(chunkpath.c_str(), flags);
     if (ret < 0) {
         LOG(ERROR) << "file open failed, " << chunkpath.c_str();
         return -1;
@@ -333,17 +513,22 @@ int ChunkfilePool::AllocateChunk(const std::string& chunkpath) {
         return -1;
     }
 
-    char* data = new (std::nothrow) char[chunklen];
-    memset(data, 0, chunklen);
-
-    ret = fsptr_->Write(fd, data, 0, chunklen);
+    if (!chunkPoolOpt_.needWriteZero) {
+        // 未写过的page由datastore记录，读时直接返回0，不需要写零
+        ret = 0;
+    } else if (chunkPoolOpt_.directIO) {
+        ret = WriteZeroDirect(fd, chunklen);
+    } else {
+        char* data = new (std::nothrow) char[chunklen];
+        memset(data, 0, chunklen);
+        ret = fsptr_->Write(fd, data, 0, chunklen);
+        delete[] data;
+    }
     if (ret < 0) {
         fsptr_->Close(fd);
-        delete[] data;
         LOG(ERROR) << "write failed, " << chunkpath.c_str();
         return -1;
     }
-    delete[] data;
 
     ret = fsptr_->Fsync(fd);
     if (ret < 0) {
@@ -359,11 +544,35 @@ int ChunkfilePool::AllocateChunk(const std::string& chunkpath) {
     return ret;
 }
 
+int ChunkfilePool::WriteZeroDirect(int fd, uint64_t length) {
+    // 以不超过缓存上限的对齐内存分段写入，避免申请整个chunk大小的内存
+    size_t bufSize = std::min<uint64_t>(length,
+                                        AlignedBufferPool::kMaxBufferSize);
+    AlignedBuffer zero = AlignedBufferPool::Get(bufSize);
+    if (zero.Data() == nullptr) {
+        return -ENOMEM;
+    }
+    memset(zero.Data(), 0, bufSize);
+    for (uint64_t offset = 0; offset < length; offset += bufSize) {
+        size_t writeLen = std::min<uint64_t>(bufSize, length - offset);
+        int ret = DirectIOHelper::Write(fsptr_.get(), fd, zero.Data(),
+                                        offset, writeLen);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
+
 bool ChunkfilePool::WriteMetaPage(const std::string& sourcepath, char* page) {
     int fd = -1;
     int ret = -1;
 
-    ret = fsptr_->Open(sourcepath.c_str(), O_RDWR);
+    int flags = O_RDWR;
+    if (chunkPoolOpt_.directIO) {
+        flags |= O_DIRECT;
+    }
+    ret = fsptr_->Open(sourcepath.c_str(), flags);
     if (ret < 0) {
         LOG(ERROR) << "file open failed, " << sourcepath.c_str();
         return false;
@@ -371,7 +580,12 @@ bool ChunkfilePool::WriteMetaPage(const std::string& sourcepath, char* page) {
 
     fd = ret;
 
-    ret = fsptr_->Write(fd, page, 0, chunkPoolOpt_.metaPageSize);
+    if (chunkPoolOpt_.directIO) {
+        ret = DirectIOHelper::Write(fsptr_.get(), fd, page, 0,
+                                    chunkPoolOpt_.metaPageSize);
+    } else {
+        ret = fsptr_->Write(fd, page, 0, chunkPoolOpt_.metaPageSize);
+    }
     if (ret != chunkPoolOpt_.metaPageSize) {
         fsptr_->Close(fd);
         LOG(ERROR) << "write metapage failed, " << sourcepath.c_str();
@@ -394,6 +608,8 @@ bool ChunkfilePool::WriteMetaPage(const std::string& sourcepath, char* page) {
 }
 
 int ChunkfilePool::RecycleChunk(const std::string& chunkpath) {
+    // 不管是直接删除还是rename回池中，chunk所在的目录都被修改
+    markDirDirty(chunkpath);
     if (!chunkPoolOpt_.getChunkFromPool) {
         int ret = fsptr_->Delete(chunkpath.c_str());
         if (ret < 0) {
@@ -449,14 +665,61 @@ int ChunkfilePool::RecycleChunk(const std::string& chunkpath) {
             LOG(INFO) << "Recycle " << chunkpath.c_str() << ", success!"
                       << ", now chunkpool size = " << tmpChunkvec_.size() + 1;
         }
+        markDirDirty(targetpath);
         std::unique_lock<std::mutex> lk(mtx_);
         tmpChunkvec_.push_back(newfilenum);
         ++currentState_.preallocatedChunksLeft;
+        metric_.recycleChunkCount << 1;
     }
     return 0;
 }
 
+void ChunkfilePool::markDirDirty(const std::string& path) {
+    size_t pos = path.find_last_of('/');
+    std::string dir = pos == std::string::npos ? "." : path.substr(0, pos);
+    std::unique_lock<std::mutex> lk(dirMtx_);
+    dirtyDirs_.insert(dir);
+}
+
+int ChunkfilePool::SyncDirs() {
+    std::unique_lock<std::mutex> syncLk(syncDirMtx_);
+    std::set<std::string> dirs;
+    {
+        std::unique_lock<std::mutex> lk(dirMtx_);
+        dirs.swap(dirtyDirs_);
+    }
+    int ret = 0;
+    for (auto it = dirs.begin(); it != dirs.end();) {
+        // copyset被删除后目录也不存在了，不需要再持久化
+        if (!fsptr_->DirExists(*it)) {
+            it = dirs.erase(it);
+            continue;
+        }
+        int fd = fsptr_->Open(*it, O_RDONLY | O_DIRECTORY);
+        if (fd < 0) {
+            LOG(ERROR) << "open dir failed, " << *it;
+            ret = -1;
+            break;
+        }
+        int rc = fsptr_->Fsync(fd);
+        fsptr_->Close(fd);
+        if (rc < 0) {
+            LOG(ERROR) << "fsync dir failed, " << *it;
+            ret = -1;
+            break;
+        }
+        it = dirs.erase(it);
+    }
+    // 未成功的目录留到下次再fsync
+    if (!dirs.empty()) {
+        std::unique_lock<std::mutex> lk(dirMtx_);
+        dirtyDirs_.insert(dirs.begin(), dirs.end());
+    }
+    return ret;
+}
+
 void ChunkfilePool::UnInitialize() {
+    StopRefill();
     currentdir_         = "";
 
     std::unique_lock<std::mutex> lk(mtx_);
@@ -477,11 +740,7 @@ bool ChunkfilePool::ScanInternal() {
 
     uint64_t chunklen = chunkPoolOpt_.chunkSize + chunkPoolOpt_.metaPageSize;
     for (auto& iter : tmpvec) {
-        auto it =
-            std::find_if(iter.begin(), iter.end(), [](unsigned char c) {
-            return !std::isdigit(c);
-        });
-        if (it != iter.end()) {
+        if (!IsPoolChunkName(iter)) {
             LOG(ERROR) << "file name illegal! [" << iter << "]";
             return false;
         }
@@ -24,16 +24,20 @@
 #define SRC_CHUNKSERVER_DATASTORE_CHUNKFILE_POOL_H_
 
 #include <glog/logging.h>
+#include <bvar/bvar.h>
 
 #include <set>
 #include <mutex>  // NOLINT
+#include <condition_variable>  // NOLINT
 #include <vector>
 #include <string>
 #include <memory>
 #include <deque>
 #include <atomic>
+#include <functional>
 
 #include "src/fs/local_filesystem.h"
+#include "src/common/concurrent/concurrent.h"
 #include "include/curve_compiler_specific.h"
 
 using curve::fs::LocalFileSystem;
@@ -45,7 +49,8 @@ struct ChunkfilePoolOptions {
     // 开关，是否从chunkfile pool取chunk
     bool        getChunkFromPool;
 
-    // chunkfilepool 文件夹路径,当getChunkFromPool为false的时候，需要设置该选项
+    // chunkfilepool 文件夹路径,当getChunkFromPool为false的时候，需要设置该选项，
+    // 同时开启后台补充时，补充的chunk放在该目录下的refillpool子目录中
     char        chunkFilePoolDir[256];
 
     // 配置文件的chunk大小
@@ -63,12 +68,37 @@ struct ChunkfilePoolOptions {
     // GetChunk重试次数
     uint16_t    retryTimes;
 
+    // 是否以O_DIRECT方式写chunk文件的metapage和数据
+    bool        directIO;
+
+    // 分配chunk时是否写零，为false时只fallocate，
+    // 要求datastore记录page的写入状态
+    bool        needWriteZero;
+
+    // 是否启动后台线程补充池中的chunk
+    bool        enableRefill;
+
+    // 池中chunk数低于该值时开始补充
+    uint32_t    refillLowWatermark;
+
+    // 补充到池中chunk数达到该值为止
+    uint32_t    refillHighWatermark;
+
+    // 后台补充时每秒写入的最大字节数，为0表示不限制
+    uint64_t    refillThroughputBytes;
+
     ChunkfilePoolOptions() {
         getChunkFromPool = true;
         cpMetaFileSize = 4096;
         chunkSize = 0;
         metaPageSize = 0;
         retryTimes = 5;
+        directIO = false;
+        needWriteZero = true;
+        enableRefill = false;
+        refillLowWatermark = 0;
+        refillHighWatermark = 0;
+        refillThroughputBytes = 0;
         ::memset(metaPath, 0, 256);
         ::memset(chunkFilePoolDir, 0, 256);
     }
@@ -79,6 +109,12 @@ struct ChunkfilePoolOptions {
         chunkSize    = other.chunkSize;
         retryTimes   = other.retryTimes;
         metaPageSize = other.metaPageSize;
+        directIO     = other.directIO;
+        needWriteZero = other.needWriteZero;
+        enableRefill = other.enableRefill;
+        refillLowWatermark    = other.refillLowWatermark;
+        refillHighWatermark   = other.refillHighWatermark;
+        refillThroughputBytes = other.refillThroughputBytes;
         ::memcpy(metaPath, other.metaPath, 256);
         ::memcpy(chunkFilePoolDir, other.chunkFilePoolDir, 256);
         return *this;
@@ -90,11 +126,31 @@ struct ChunkfilePoolOptions {
         chunkSize    = other.chunkSize;
         retryTimes   = other.retryTimes;
         metaPageSize = other.metaPageSize;
+        directIO     = other.directIO;
+        needWriteZero = other.needWriteZero;
+        enableRefill = other.enableRefill;
+        refillLowWatermark    = other.refillLowWatermark;
+        refillHighWatermark   = other.refillHighWatermark;
+        refillThroughputBytes = other.refillThroughputBytes;
         ::memcpy(metaPath, other.metaPath, 256);
         ::memcpy(chunkFilePoolDir, other.chunkFilePoolDir, 256);
     }
 };
 
+/**
+ * chunkfilepool的统计信息
+ * refillChunkCount:后台线程格式化补充的chunk数
+ * recycleChunkCount:回收到池中的chunk数，包括从trash回收的chunk
+ * syncAllocChunkCount:池中没有chunk时在写路径上同步分配的chunk数
+ * getChunkFailCount:获取chunk失败的次数
+ */
+struct ChunkfilePoolMetric {
+    bvar::Adder<uint64_t> refillChunkCount;
+    bvar::Adder<uint64_t> recycleChunkCount;
+    bvar::Adder<uint64_t> syncAllocChunkCount;
+    bvar::Adder<uint64_t> getChunkFailCount;
+};
+
 typedef struct ChunkFilePoolState {
     // 预分配的chunk还有多少没有被datastore使用
     uint64_t    preallocatedChunksLeft;
@@ -150,7 +206,7 @@ class CURVE_CACHELINE_ALIGNMENT ChunkfilePool {
  public:
     // fsptr 本地文件系统.
     explicit ChunkfilePool(std::shared_ptr<LocalFileSystem> fsptr);
-    virtual ~ChunkfilePool() = default;
+    virtual ~ChunkfilePool();
 
     /**
      * 初始化函数
@@ -168,6 +224,12 @@ class CURVE_CACHELINE_ALIGNMENT ChunkfilePool {
      * @param: chunkpath是需要回收的chunk路径
      */
     virtual int RecycleChunk(const std::string& chunkpath);
+    /**
+     * 对GetChunk和RecycleChunk修改过的目录做fsync，
+     * 保证chunk的创建和删除持久化，持久化applied index之前需要调用
+     * @return: 成功返回0，否则返回-1，未成功的目录留到下次调用
+     */
+    virtual int SyncDirs();
     /**
      * 获取当前chunkfile pool大小
      */
@@ -187,6 +249,22 @@ class CURVE_CACHELINE_ALIGNMENT ChunkfilePool {
      */
     virtual void UnInitialize();
 
+    /**
+     * 设置回收trash中chunk的回调，后台补充时先调用该回调回收已过期的chunk，
+     * 回收后仍低于高水位才格式化新的chunk
+     */
+    virtual void SetTrashReclaimer(std::function<void()> reclaimer) {
+        std::unique_lock<std::mutex> lk(mtx_);
+        trashReclaimer_ = reclaimer;
+    }
+
+    /**
+     * 获取chunkfilepool的统计信息
+     */
+    virtual ChunkfilePoolMetric* GetMetric() {
+        return &metric_;
+    }
+
     /**
      * 测试使用
      */
@@ -212,6 +290,32 @@ class CURVE_CACHELINE_ALIGNMENT ChunkfilePool {
      * @return: 成功返回0，否则返回小于0
      */
     int AllocateChunk(const std::string& chunkpath);
+    /**
+     * 以O_DIRECT方式向文件写入length长度的0
+     * @param: fd为以O_DIRECT方式打开的文件句柄
+     * @param: length为写入的长度
+     * @return: 成功返回0，否则返回小于0
+     */
+    int WriteZeroDirect(int fd, uint64_t length);
+    /**
+     * 后台补充线程，池中chunk数低于低水位时补充到高水位
+     */
+    void RefillWorker();
+    /**
+     * 格式化一个新的chunk并加入池中
+     * @return: 成功返回true，否则返回false
+     */
+    bool RefillOneChunk();
+    /**
+     * 不从池中取chunk的模式下，补充目录中的文件都是上次运行遗留的临时文件，
+     * 启用后台补充前全部删除；目录中有非chunk文件时返回false
+     */
+    bool CleanTmpChunks();
+    void StopRefill();
+    /**
+     * 记录path所在的目录有文件被创建或者删除，等待SyncDirs持久化
+     */
+    void markDirDirty(const std::string& path);
 
  private:
     // 保护tmpChunkvec_
@@ -234,6 +338,25 @@ class CURVE_CACHELINE_ALIGNMENT ChunkfilePool {
 
     // chunkfilepool分配状态
     ChunkFilePoolState_t currentState_;
+
+    // 后台补充线程
+    curve::common::Thread refillThread_;
+    // 池中chunk数低于低水位或者需要退出时唤醒补充线程，与mtx_配合使用
+    std::condition_variable refillCond_;
+    // 补充线程是否需要退出，由mtx_保护
+    bool refillStop_;
+    // 回收trash中过期chunk的回调，由mtx_保护
+    std::function<void()> trashReclaimer_;
+
+    // chunkfilepool的统计信息
+    ChunkfilePoolMetric metric_;
+
+    // 保护dirtyDirs_
+    std::mutex dirMtx_;
+    // 上次SyncDirs之后有文件被创建或者删除的目录
+    std::set<std::string> dirtyDirs_;
+    // 串行化SyncDirs，保证返回前其他调用取走的目录也已经fsync
+    std::mutex syncDirMtx_;
 };
 }   // namespace chunkserver
 }   // namespace curve
@@ -20,8 +20,10 @@
  * Author: yangyaokai
  */
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <algorithm>
 #include <memory>
+#include <vector>
 
 #include "src/chunkserver/datastore/chunkserver_datastore.h"
 #include "src/chunkserver/datastore/chunkserver_chunkfile.h"
@@ -60,8 +62,11 @@ ChunkFileMetaPage& ChunkFileMetaPage::operator =(
     return *this;
 }
 
-void ChunkFileMetaPage::encode(char* buf) {
+void ChunkFileMetaPage::encode(char* buf) const {
     size_t len = 0;
+    // 只有非clone chunk记录写入状态时才使用新的格式，其余情况保持兼容，
+    // version在创建bitmap或者去掉bitmap时由CSChunkFile持有写锁设置
+    bool trackWritten = version == FORMAT_VERSION_V2;
     memcpy(buf, &version, sizeof(version));
     len += sizeof(version);
     memcpy(buf + len, &sn, sizeof(sn));
@@ -71,8 +76,8 @@ void ChunkFileMetaPage::encode(char* buf) {
     size_t loc_size = location.size();
     memcpy(buf + len, &loc_size, sizeof(loc_size));
     len += sizeof(loc_size);
-    // CloneChunk需要序列化位置信息和bitmap信息
-    if (loc_size > 0) {
+    // CloneChunk需要序列化位置信息和bitmap信息，记录写入状态的chunk只有bitmap
+    if (loc_size > 0 || trackWritten) {
         memcpy(buf + len, location.c_str(), loc_size);
         len += loc_size;
         uint32_t bits = bitmap->Size();
@@ -97,7 +102,7 @@ CSErrorCode ChunkFileMetaPage::decode(const char* buf) {
     size_t loc_size;
     memcpy(&loc_size, buf + len, sizeof(loc_size));
     len += sizeof(loc_size);
-    if (loc_size > 0) {
+    if (loc_size > 0 || version == FORMAT_VERSION_V2) {
         location = string(buf + len, loc_size);
         len += loc_size;
         uint32_t bits = 0;
@@ -106,6 +111,9 @@ CSErrorCode ChunkFileMetaPage::decode(const char* buf) {
         bitmap = std::make_shared<Bitmap>(bits, buf + len);
         size_t bitmapBytes = (bitmap->Size() + 8 - 1) >> 3;
         len += bitmapBytes;
+    } else {
+        location = "";
+        bitmap = nullptr;
     }
     uint32_t crc =  ::curve::common::CRC32(buf, len);
     uint32_t recordCrc;
@@ -117,7 +125,7 @@ CSErrorCode ChunkFileMetaPage::decode(const char* buf) {
     }
 
     // TODO(yyk) 判断版本兼容性，当前简单处理，后续详细实现
-    if (version != FORMAT_VERSION) {
+    if (version != FORMAT_VERSION && version != FORMAT_VERSION_V2) {
         LOG(ERROR) << "File format version incompatible."
                     << "file version: "
                     << static_cast<uint32_t>(version)
@@ -137,12 +145,31 @@ CSChunkFile::CSChunkFile(std::shared_ptr<LocalFileSystem> lfs,
       chunkId_(options.id),
       baseDir_(options.baseDir),
       isCloneChunk_(false),
+      dirtyPages_(nullptr),
+      batchBitmapFlush_(options.batchBitmapFlush),
+      trackWrittenPages_(options.trackWrittenPages),
+      bitmapPending_(false),
+      unsynced_(false),
+      asyncIOCount_(0),
       snapshot_(nullptr),
       chunkfilePool_(chunkfilePool),
       lfs_(lfs),
-      metric_(options.metric) {
+      metric_(options.metric),
+      syncWrite_(options.syncWrite),
+      directIO_(options.directIO),
+      loaded_(false),
+      deleted_(false),
+      pendingSnapSn_(0),
+      fdCache_(options.fdCache),
+      metaListener_(options.metaListener),
+      readCache_(options.readCache),
+      cacheVersion_(0) {
     CHECK(!baseDir_.empty()) << "Create chunk file failed";
     CHECK(lfs_ != nullptr) << "Create chunk file failed";
+    // 缓存按固定大小的page组织，page大小不一致的chunk不使用缓存
+    if (readCache_ != nullptr && readCache_->PageSize() != pageSize_) {
+        readCache_ = nullptr;
+    }
     metaPage_.sn = options.sn;
     metaPage_.correctedSn = options.correctedSn;
     metaPage_.location = options.location;
@@ -151,12 +178,23 @@ CSChunkFile::CSChunkFile(std::shared_ptr<LocalFileSystem> lfs,
         uint32_t bits = size_ / pageSize_;
         metaPage_.bitmap = std::make_shared<Bitmap>(bits);
     }
+    // 元数据来自manifest时，非clone chunk打开时只需要打开文件，不需要读metapage
+    if (options.metaLoaded && metaPage_.location.empty()) {
+        loaded_ = true;
+    }
     if (metric_ != nullptr) {
         metric_->chunkFileCount << 1;
     }
 }
 
 CSChunkFile::~CSChunkFile() {
+    // 先从fd缓存中移除，避免析构过程中被淘汰
+    if (fdCache_ != nullptr) {
+        fdCache_->Remove(this);
+    }
+    waitAsyncIODone();
+    // 同一个chunk重新创建或加载后不能命中之前的缓存
+    invalidateReadCache();
     if (snapshot_ != nullptr) {
         delete snapshot_;
         snapshot_ = nullptr;
@@ -176,6 +214,25 @@ CSChunkFile::~CSChunkFile() {
 
 CSErrorCode CSChunkFile::Open(bool createFile) {
     WriteLockGuard writeGuard(rwLock_);
+    CSErrorCode errorCode = CSErrorCode::Success;
+    if (loaded_ && !createFile) {
+        // 未启用fd缓存时从manifest加载chunk，元数据已经在内存中
+        errorCode = openFd();
+    } else {
+        errorCode = open(createFile);
+    }
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
+    loaded_ = true;
+    if (fdCache_ != nullptr) {
+        fdCache_->Insert(this);
+    }
+    reportMeta();
+    return CSErrorCode::Success;
+}
+
+CSErrorCode CSChunkFile::open(bool createFile) {
     string chunkFilePath = path();
     // 创建新文件,如果chunk文件已经存在则不用再创建
     // chunk文件存在可能有两种情况引起:
@@ -184,6 +241,11 @@ CSErrorCode CSChunkFile::Open(bool createFile) {
     if (createFile
         && !lfs_->FileExists(chunkFilePath)
         && metaPage_.sn > 0) {
+        // 新chunk文件中的数据可能是未清零的旧数据，记录哪些page已经被写过
+        if (trackWrittenPages_ && metaPage_.bitmap == nullptr) {
+            metaPage_.bitmap = std::make_shared<Bitmap>(size_ / pageSize_);
+            metaPage_.version = FORMAT_VERSION_V2;
+        }
         char buf[pageSize_];  // NOLINT
         memset(buf, 0, sizeof(buf));
         metaPage_.encode(buf);
@@ -197,15 +259,12 @@ CSErrorCode CSChunkFile::Open(bool createFile) {
             return CSErrorCode::InternalError;
         }
     }
-    int rc = lfs_->Open(chunkFilePath, O_RDWR|O_NOATIME|O_DSYNC);
-    if (rc < 0) {
-        LOG(ERROR) << "Error occured when opening file."
-                   << " filepath = " << chunkFilePath;
-        return CSErrorCode::InternalError;
+    CSErrorCode errorCode = openFd();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
     }
-    fd_ = rc;
     struct stat fileInfo;
-    rc = lfs_->Fstat(fd_, &fileInfo);
+    int rc = lfs_->Fstat(fd_, &fileInfo);
     if (rc < 0) {
         LOG(ERROR) << "Error occured when stating file."
                    << " filepath = " << chunkFilePath;
@@ -233,6 +292,27 @@ CSErrorCode CSChunkFile::Open(bool createFile) {
 
 CSErrorCode CSChunkFile::LoadSnapshot(SequenceNum sn) {
     WriteLockGuard writeGuard(rwLock_);
+    // 延迟加载模式下chunk还未加载，记录下来等chunk加载时一起加载
+    if (!loaded_ && fdCache_ != nullptr) {
+        if (pendingSnapSn_ != 0) {
+            LOG(ERROR) << "Snapshot conflict."
+                       << " ChunkID: " << chunkId_
+                       << " Exist snapshot sn: " << pendingSnapSn_
+                       << " Request snapshot sn: " << sn;
+            return CSErrorCode::SnapshotConflictError;
+        }
+        pendingSnapSn_ = sn;
+        reportMeta();
+        return CSErrorCode::Success;
+    }
+    CSErrorCode errorCode = loadSnapshot(sn);
+    if (errorCode == CSErrorCode::Success) {
+        reportMeta();
+    }
+    return errorCode;
+}
+
+CSErrorCode CSChunkFile::loadSnapshot(SequenceNum sn) {
     if (snapshot_ != nullptr) {
         LOG(ERROR) << "Snapshot conflict."
                    << " ChunkID: " << chunkId_
@@ -247,6 +327,8 @@ CSErrorCode CSChunkFile::LoadSnapshot(SequenceNum sn) {
     options.chunkSize = size_;
     options.pageSize = pageSize_;
     options.metric = metric_;
+    options.syncWrite = syncWrite_;
+    options.directIO = directIO_;
     snapshot_ = new(std::nothrow) CSSnapshot(lfs_,
                                             chunkfilePool_,
                                             options);
@@ -269,7 +351,70 @@ CSErrorCode CSChunkFile::Write(SequenceNum sn,
                                off_t offset,
                                size_t length,
                                uint32_t* cost) {
+    return doWrite(sn, buf, offset, length, cost);
+}
+
+CSErrorCode CSChunkFile::Write(SequenceNum sn,
+                               const butil::IOBuf& buf,
+                               off_t offset,
+                               size_t length,
+                               uint32_t* cost) {
+    if (buf.size() < length) {
+        LOG(ERROR) << "Write chunk failed, data is shorter than length."
+                   << "ChunkID: " << chunkId_
+                   << ", data size: " << buf.size()
+                   << ", length: " << length;
+        return CSErrorCode::InvalidArgError;
+    }
+    return doWrite(sn, buf, offset, length, cost);
+}
+
+template <typename Buffer>
+CSErrorCode CSChunkFile::doWrite(SequenceNum sn,
+                                 const Buffer& buf,
+                                 off_t offset,
+                                 size_t length,
+                                 uint32_t* cost) {
     WriteLockGuard writeGuard(rwLock_);
+    CSErrorCode errorCode = ensureOpen();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
+    // 异步读提交后就释放了读锁，等在途的读完成后再写，避免读到写了一半的page
+    waitAsyncIODone();
+    // 数据本身的写入算一次IO，其余IO在prepareWrite和flush中累加
+    uint32_t ioCount = 1;
+    errorCode = prepareWrite(sn, offset, length, &ioCount);
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
+    int rc = writeData(buf, offset, length);
+    if (rc < 0) {
+        LOG(ERROR) << "Write data to chunk file failed."
+                   << "ChunkID: " << chunkId_
+                   << ",request sn: " << sn
+                   << ",chunk sn: " << metaPage_.sn;
+        return CSErrorCode::InternalError;
+    }
+    // 如果是clone chunk会更新bitmap
+    errorCode = flush(&ioCount);
+    if (errorCode != CSErrorCode::Success) {
+        LOG(ERROR) << "Write data to chunk file failed."
+                   << "ChunkID: " << chunkId_
+                   << ",request sn: " << sn
+                   << ",chunk sn: " << metaPage_.sn;
+        return errorCode;
+    }
+    if (cost != nullptr) {
+        *cost = ioCount;
+    }
+    return CSErrorCode::Success;
+}
+
+CSErrorCode CSChunkFile::prepareWrite(SequenceNum sn,
+                                      off_t offset,
+                                      size_t length,
+                                      uint32_t* ioCount) {
     if (!CheckOffsetAndLength(offset, length)) {
         LOG(ERROR) << "Write chunk failed, invalid offset or length."
                    << "ChunkID: " << chunkId_
@@ -319,6 +464,8 @@ CSErrorCode CSChunkFile::Write(SequenceNum sn,
         options.chunkSize = size_;
         options.pageSize = pageSize_;
         options.metric = metric_;
+        options.syncWrite = syncWrite_;
+        options.directIO = directIO_;
         snapshot_ = new(std::nothrow) CSSnapshot(lfs_,
                                                  chunkfilePool_,
                                                  options);
@@ -333,12 +480,18 @@ CSErrorCode CSChunkFile::Write(SequenceNum sn,
                        << ",chunk sn: " << metaPage_.sn;
             return errorCode;
         }
+        // 创建快照文件需要写入快照的metapage
+        ++*ioCount;
+        reportMeta();
     }
     // 如果请求版本号大于当前chunk版本号，需要更新metapage
     if (sn > metaPage_.sn) {
         ChunkFileMetaPage tempMeta = metaPage_;
         tempMeta.sn = sn;
         CSErrorCode errorCode = updateMetaPage(&tempMeta);
+        if (errorCode == CSErrorCode::Success) {
+            errorCode = syncBarrier();
+        }
         if (errorCode != CSErrorCode::Success) {
             LOG(ERROR) << "Update metapage failed."
                        << "ChunkID: " << chunkId_
@@ -347,10 +500,14 @@ CSErrorCode CSChunkFile::Write(SequenceNum sn,
             return errorCode;
         }
         metaPage_.sn = tempMeta.sn;
+        ++*ioCount;
+        reportMeta();
+        // 旧版本的page不会再被读到，提前释放缓存空间
+        invalidateReadCache();
     }
     // 判断是否要cow,若是先将数据拷贝到快照文件
     if (needCow(sn)) {
-        CSErrorCode errorCode = copy2Snapshot(offset, length);
+        CSErrorCode errorCode = copy2Snapshot(offset, length, ioCount);
         if (errorCode != CSErrorCode::Success) {
             LOG(ERROR) << "Copy data to snapshot failed."
                         << "ChunkID: " << chunkId_
@@ -359,28 +516,35 @@ CSErrorCode CSChunkFile::Write(SequenceNum sn,
             return errorCode;
         }
     }
-    int rc = writeData(buf, offset, length);
-    if (rc < 0) {
-        LOG(ERROR) << "Write data to chunk file failed."
-                   << "ChunkID: " << chunkId_
-                   << ",request sn: " << sn
-                   << ",chunk sn: " << metaPage_.sn;
-        return CSErrorCode::InternalError;
-    }
-    // 如果是clone chunk会更新bitmap
-    CSErrorCode errorCode = flush();
-    if (errorCode != CSErrorCode::Success) {
-        LOG(ERROR) << "Write data to chunk file failed."
-                   << "ChunkID: " << chunkId_
-                   << ",request sn: " << sn
-                   << ",chunk sn: " << metaPage_.sn;
-        return errorCode;
-    }
     return CSErrorCode::Success;
 }
 
 CSErrorCode CSChunkFile::Paste(const char * buf, off_t offset, size_t length) {
+    return doPaste(buf, offset, length);
+}
+
+CSErrorCode CSChunkFile::Paste(const butil::IOBuf& buf,
+                               off_t offset,
+                               size_t length) {
+    if (buf.size() < length) {
+        LOG(ERROR) << "Paste chunk failed, data is shorter than length."
+                   << "ChunkID: " << chunkId_
+                   << ", data size: " << buf.size()
+                   << ", length: " << length;
+        return CSErrorCode::InvalidArgError;
+    }
+    return doPaste(buf, offset, length);
+}
+
+template <typename Buffer>
+CSErrorCode CSChunkFile::doPaste(const Buffer& buf,
+                                 off_t offset,
+                                 size_t length) {
     WriteLockGuard writeGuard(rwLock_);
+    CSErrorCode errorCode = ensureOpen();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
     if (!CheckOffsetAndLength(offset, length)) {
         LOG(ERROR) << "Paste chunk failed, invalid offset or length."
                    << "ChunkID: " << chunkId_
@@ -394,6 +558,7 @@ CSErrorCode CSChunkFile::Paste(const char * buf, off_t offset, size_t length) {
     if (!isCloneChunk_) {
         return CSErrorCode::Success;
     }
+    waitAsyncIODone();
 
     // 上面下来的请求必须是pagesize对齐的
     // 请求paste区域的起始page索引号
@@ -413,7 +578,7 @@ CSErrorCode CSChunkFile::Paste(const char * buf, off_t offset, size_t length) {
     for (auto& range : uncopiedRange) {
         pasteOff = range.beginIndex * pageSize_;
         pasteSize = (range.endIndex - range.beginIndex + 1) * pageSize_;
-        int rc = writeData(buf + (pasteOff - offset), pasteOff, pasteSize);
+        int rc = writeDataFrom(buf, pasteOff - offset, pasteOff, pasteSize);
         if (rc < 0) {
             LOG(ERROR) << "Paste data to chunk failed."
                        << "ChunkID: " << chunkId_
@@ -424,7 +589,7 @@ CSErrorCode CSChunkFile::Paste(const char * buf, off_t offset, size_t length) {
     }
 
     // 更新bitmap
-    CSErrorCode errorCode = flush();
+    errorCode = flush();
     if (errorCode != CSErrorCode::Success) {
         LOG(ERROR) << "Paste data to chunk failed."
                     << "ChunkID: " << chunkId_
@@ -437,34 +602,16 @@ CSErrorCode CSChunkFile::Paste(const char * buf, off_t offset, size_t length) {
 
 CSErrorCode CSChunkFile::Read(char * buf, off_t offset, size_t length) {
     ReadLockGuard readGuard(rwLock_);
-    if (!CheckOffsetAndLength(offset, length)) {
-        LOG(ERROR) << "Read chunk failed, invalid offset or length."
-                   << "ChunkID: " << chunkId_
-                   << ", offset: " << offset
-                   << ", length: " << length
-                   << ", page size: " << pageSize_
-                   << ", chunk size: " << size_;
-        return CSErrorCode::InvalidArgError;
+    CSErrorCode errorCode = ensureOpen();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
     }
-
-    // 如果是 clonechunk ,要保证读取区域已经被写过，否则返回错误
-    if (isCloneChunk_) {
-        // 上面下来的请求必须是pagesize对齐的
-        // 请求paste区域的起始page索引号
-        uint32_t beginIndex = offset / pageSize_;
-        // 请求paste区域的最后一个page索引号
-        uint32_t endIndex = (offset + length - 1) / pageSize_;
-        if (metaPage_.bitmap->NextClearBit(beginIndex, endIndex)
-            != Bitmap::NO_POS) {
-            LOG(ERROR) << "Read chunk file failed, has page never written."
-                       << "ChunkID: " << chunkId_
-                       << ", offset: " << offset
-                       << ", length: " << length;
-            return CSErrorCode::PageNerverWrittenError;
-        }
+    errorCode = checkReadable(offset, length);
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
     }
 
-    int rc = readData(buf, offset, length);
+    int rc = readWrittenData(buf, offset, length);
     if (rc < 0) {
         LOG(ERROR) << "Read chunk file failed."
                    << "ChunkID: " << chunkId_
@@ -474,11 +621,85 @@ CSErrorCode CSChunkFile::Read(char * buf, off_t offset, size_t length) {
     return CSErrorCode::Success;
 }
 
+void CSChunkFile::ReadAsync(char * buf,
+                            off_t offset,
+                            size_t length,
+                            CSIOCallback done) {
+    ReadLockGuard readGuard(rwLock_);
+    CSErrorCode errorCode = ensureOpen();
+    if (errorCode == CSErrorCode::Success) {
+        errorCode = checkReadable(offset, length);
+    }
+    if (errorCode != CSErrorCode::Success) {
+        done(errorCode);
+        return;
+    }
+
+    // O_DIRECT方式下不对齐的请求需要借助对齐内存中转，改为同步读；
+    // 有未写过的page时只需要读已写过的部分，也改为同步读
+    if ((directIO_ && !DirectIOHelper::IsAligned(buf,
+                                                 offset + pageSize_,
+                                                 length))
+        || hasUnwrittenPages(offset, length)) {
+        int rc = readWrittenData(buf, offset, length);
+        if (rc < 0) {
+            LOG(ERROR) << "Read chunk file failed."
+                       << "ChunkID: " << chunkId_
+                       << ",chunk sn: " << metaPage_.sn;
+        }
+        done(rc < 0 ? CSErrorCode::InternalError : CSErrorCode::Success);
+        return;
+    }
+    // 全部命中读缓存时不需要读盘
+    if (readFromCache(buf, offset, length)) {
+        done(CSErrorCode::Success);
+        return;
+    }
+
+    // 读锁只保护提交过程，修改chunk数据的请求拿到写锁后
+    // 会等待asyncIOCount_归零，保证读完成前数据不会被改写
+    {
+        std::lock_guard<std::mutex> lock(asyncIOMtx_);
+        ++asyncIOCount_;
+    }
+    SequenceNum sn = metaPage_.sn;
+    uint64_t version = cacheVersion_;
+    auto callback = [this, sn, version, buf, offset, length, done](int rc) {
+        if (rc < 0) {
+            LOG(ERROR) << "Read chunk file failed."
+                       << "ChunkID: " << chunkId_
+                       << ",chunk sn: " << sn;
+        } else if (readCache_ != nullptr && rwLock_.TryRDLock() == 0) {
+            // 提交读请求以后chunk没有被写过，读到的数据才能放入缓存；
+            // 拿不到读锁说明有写请求或删除正在进行，不放入缓存
+            if (version == cacheVersion_ && !deleted_) {
+                readCache_->Put(chunkId_, sn, offset / pageSize_,
+                                length / pageSize_, buf);
+            }
+            rwLock_.Unlock();
+        }
+        done(rc < 0 ? CSErrorCode::InternalError : CSErrorCode::Success);
+        std::lock_guard<std::mutex> lock(asyncIOMtx_);
+        if (--asyncIOCount_ == 0) {
+            asyncIOCond_.notify_all();
+        }
+    };
+    int rc = lfs_->ReadAsync(fd_, buf, offset + pageSize_, length, callback);
+    if (rc < 0) {
+        // 提交失败时回调不会被调用
+        callback(rc);
+    }
+}
+
 CSErrorCode CSChunkFile::ReadSpecifiedChunk(SequenceNum sn,
                                             char * buf,
                                             off_t offset,
                                             size_t length)  {
     ReadLockGuard readGuard(rwLock_);
+    CSErrorCode errorCode = ensureOpen();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
     if (!CheckOffsetAndLength(offset, length)) {
         LOG(ERROR) << "Read specified chunk failed, invalid offset or length."
                    << "ChunkID: " << chunkId_
@@ -490,7 +711,7 @@ CSErrorCode CSChunkFile::ReadSpecifiedChunk(SequenceNum sn,
     }
     // 版本为当前chunk的版本，则读当前chunk文件
     if (sn == metaPage_.sn) {
-        int rc = readData(buf, offset, length);
+        int rc = readWrittenData(buf, offset, length);
         if (rc < 0) {
             LOG(ERROR) << "Read chunk file failed."
                        << "ChunkID: " << chunkId_
@@ -515,16 +736,16 @@ CSErrorCode CSChunkFile::ReadSpecifiedChunk(SequenceNum sn,
                        &uncopiedRange,
                        &copiedRange);
 
-    CSErrorCode errorCode = CSErrorCode::Success;
+    errorCode = CSErrorCode::Success;
     off_t readOff;
     size_t readSize;
     // 对于未拷贝的extent，读chunk的数据
     for (auto& range : uncopiedRange) {
         readOff = range.beginIndex * pageSize_;
         readSize = (range.endIndex - range.beginIndex + 1) * pageSize_;
-        int rc = readData(buf + (readOff - offset),
-                          readOff,
-                          readSize);
+        int rc = readWrittenData(buf + (readOff - offset),
+                                 readOff,
+                                 readSize);
         if (rc < 0) {
             LOG(ERROR) << "Read chunk file failed. "
                        << "ChunkID: " << chunkId_
@@ -532,7 +753,7 @@ CSErrorCode CSChunkFile::ReadSpecifiedChunk(SequenceNum sn,
             return CSErrorCode::InternalError;
         }
     }
-    // 对于已拷贝的range，读snapshot的数据
+    // 对于已拷贝的range，读snapshot的数据，快照的数据不放入读缓存
     for (auto& range : copiedRange) {
         readOff = range.beginIndex * pageSize_;
         readSize = (range.endIndex - range.beginIndex + 1) * pageSize_;
@@ -551,6 +772,11 @@ CSErrorCode CSChunkFile::ReadSpecifiedChunk(SequenceNum sn,
 
 CSErrorCode CSChunkFile::Delete(SequenceNum sn)  {
     WriteLockGuard writeGuard(rwLock_);
+    // 只需要元数据，不需要打开fd
+    CSErrorCode errorCode = ensureOpen(false);
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
     // 如果 sn 小于当前chunk的版本号，不允许删除
     if (sn < metaPage_.sn) {
         LOG(WARNING) << "Delete chunk failed, backward request."
@@ -563,7 +789,7 @@ CSErrorCode CSChunkFile::Delete(SequenceNum sn)  {
     // 如果存在快照，就先删除快照，正常是不会出现这种调用的
     // Delete语义就是将chunk删除，不管存不存在快照
     if (snapshot_ != nullptr) {
-        CSErrorCode errorCode = snapshot_->Delete();
+        errorCode = snapshot_->Delete();
         if (errorCode != CSErrorCode::Success) {
             LOG(ERROR) << "Delete snapshot failed."
                        << "ChunkID: " << chunkId_
@@ -578,13 +804,19 @@ CSErrorCode CSChunkFile::Delete(SequenceNum sn)  {
         snapshot_ = nullptr;
     }
 
+    if (fdCache_ != nullptr) {
+        fdCache_->Remove(this);
+    }
     if (fd_ >= 0) {
+        waitAsyncIODone();
         lfs_->Close(fd_);
         fd_ = -1;
     }
+    invalidateReadCache();
     int ret = chunkfilePool_->RecycleChunk(path());
     if (ret < 0)
         return CSErrorCode::InternalError;
+    deleted_ = true;
 
     LOG(INFO) << "Chunk deleted."
               << "ChunkID: " << chunkId_
@@ -595,6 +827,10 @@ CSErrorCode CSChunkFile::Delete(SequenceNum sn)  {
 
 CSErrorCode CSChunkFile::DeleteSnapshotOrCorrectSn(SequenceNum correctedSn)  {
     WriteLockGuard writeGuard(rwLock_);
+    CSErrorCode errorCode = ensureOpen();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
 
     // 如果是clone chunk， 理论上不应该会调这个接口，返回错误
     if (isCloneChunk_) {
@@ -623,7 +859,7 @@ CSErrorCode CSChunkFile::DeleteSnapshotOrCorrectSn(SequenceNum correctedSn)  {
      * 当前的删除操作时回放的历史日志，这种情况不允许删除
      */
     if (snapshot_ != nullptr && metaPage_.sn > snapshot_->GetSn()) {
-        CSErrorCode errorCode = snapshot_->Delete();
+        errorCode = snapshot_->Delete();
         if (errorCode != CSErrorCode::Success) {
             LOG(ERROR) << "Delete snapshot failed."
                        << "ChunkID: " << chunkId_
@@ -632,6 +868,7 @@ CSErrorCode CSChunkFile::DeleteSnapshotOrCorrectSn(SequenceNum correctedSn)  {
         }
         delete snapshot_;
         snapshot_ = nullptr;
+        reportMeta();
     }
 
     /*
@@ -648,7 +885,10 @@ CSErrorCode CSChunkFile::DeleteSnapshotOrCorrectSn(SequenceNum correctedSn)  {
     if (correctedSn > chunkSn) {
         ChunkFileMetaPage tempMeta = metaPage_;
         tempMeta.correctedSn = correctedSn;
-        CSErrorCode errorCode = updateMetaPage(&tempMeta);
+        errorCode = updateMetaPage(&tempMeta);
+        if (errorCode == CSErrorCode::Success) {
+            errorCode = syncBarrier();
+        }
         if (errorCode != CSErrorCode::Success) {
             LOG(ERROR) << "Update metapage failed."
                        << "ChunkID: " << chunkId_
@@ -656,13 +896,19 @@ CSErrorCode CSChunkFile::DeleteSnapshotOrCorrectSn(SequenceNum correctedSn)  {
             return errorCode;
         }
         metaPage_.correctedSn = tempMeta.correctedSn;
+        reportMeta();
     }
 
     return CSErrorCode::Success;
 }
 
-void CSChunkFile::GetInfo(CSChunkInfo* info)  {
+CSErrorCode CSChunkFile::GetInfo(CSChunkInfo* info)  {
     ReadLockGuard readGuard(rwLock_);
+    // 元数据已加载时不需要持有fd
+    CSErrorCode errorCode = ensureOpen(false);
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
     info->chunkId = chunkId_;
     info->pageSize = pageSize_;
     info->chunkSize = size_;
@@ -681,33 +927,84 @@ void CSChunkFile::GetInfo(CSChunkInfo* info)  {
                                                 metaPage_.bitmap->GetBitmap());
     else
         info->bitmap = nullptr;
+    return CSErrorCode::Success;
 }
 
 CSErrorCode CSChunkFile::GetHash(off_t offset,
                                  size_t length,
                                  std::string* hash)  {
     ReadLockGuard readGuard(rwLock_);
+    CSErrorCode errorCode = ensureOpen();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
     uint32_t crc32c = 0;
 
-    char *buf = new(std::nothrow) char[length];
-    if (nullptr == buf) {
+    AlignedBuffer buf = AlignedBufferPool::Get(length);
+    if (nullptr == buf.Data()) {
         return CSErrorCode::InternalError;
     }
 
-    int rc = lfs_->Read(fd_, buf, offset, length);
+    int rc = readFile(buf.Data(), offset, length);
     if (rc < 0) {
         LOG(ERROR) << "Read chunk file failed."
                    << "ChunkID: " << chunkId_
                    << ",chunk sn: " << metaPage_.sn;
-        delete[] buf;
         return CSErrorCode::InternalError;
     }
 
-    crc32c = curve::common::CRC32(crc32c, buf, length);
+    // 未写过的page中可能是未清零的旧数据，按0计算，保证各副本的hash一致
+    off_t dataBegin = std::max<off_t>(offset, pageSize_) - pageSize_;
+    off_t dataEnd = std::min<off_t>(
+        static_cast<off_t>(offset + length) - pageSize_, size_);
+    if (!isCloneChunk_ && metaPage_.bitmap != nullptr && dataBegin < dataEnd) {
+        std::vector<BitRange> unwrittenRanges;
+        metaPage_.bitmap->Divide(dataBegin / pageSize_,
+                                 (dataEnd - 1) / pageSize_,
+                                 &unwrittenRanges,
+                                 nullptr);
+        for (auto& range : unwrittenRanges) {
+            off_t begin = std::max<off_t>(range.beginIndex * pageSize_,
+                                          dataBegin);
+            off_t end = std::min<off_t>((range.endIndex + 1) * pageSize_,
+                                        dataEnd);
+            memset(buf.Data() + (begin + pageSize_ - offset), 0, end - begin);
+        }
+    }
+
+    crc32c = curve::common::CRC32(crc32c, buf.Data(), length);
     *hash = std::to_string(crc32c);
 
-    delete[] buf;
+    return CSErrorCode::Success;
+}
 
+CSErrorCode CSChunkFile::Sync() {
+    ReadLockGuard readGuard(rwLock_);
+    // chunk文件可能已经被删除
+    if (deleted_) {
+        return CSErrorCode::Success;
+    }
+    // fd被淘汰后可能还有批量延迟的bitmap需要写入，需要重新打开
+    CSErrorCode errorCode = ensureOpen();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
+    if (fd_ < 0) {
+        return CSErrorCode::Success;
+    }
+    // 先写入批量延迟的bitmap，再一起刷盘
+    errorCode = flushPendingBitmap();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
+    int rc = lfs_->Fdatasync(fd_);
+    if (rc < 0) {
+        LOG(ERROR) << "Sync chunk file failed."
+                   << "ChunkID: " << chunkId_
+                   << ",chunk sn: " << metaPage_.sn;
+        return CSErrorCode::InternalError;
+    }
+    unsynced_.store(false, std::memory_order_relaxed);
     return CSErrorCode::Success;
 }
 
@@ -764,10 +1061,19 @@ bool CSChunkFile::needCow(SequenceNum sn) {
 }
 
 CSErrorCode CSChunkFile::updateMetaPage(ChunkFileMetaPage* metaPage) {
-    char buf[pageSize_];  // NOLINT
-    memset(buf, 0, sizeof(buf));
-    metaPage->encode(buf);
-    int rc = writeMetaPage(buf);
+    // 此前写入的数据必须先于metapage落盘
+    CSErrorCode errorCode = syncBarrier();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
+    // metapage使用对齐的内存，O_DIRECT方式下可以直接写入
+    AlignedBuffer buf = AlignedBufferPool::Get(pageSize_);
+    if (nullptr == buf.Data()) {
+        return CSErrorCode::InternalError;
+    }
+    memset(buf.Data(), 0, pageSize_);
+    metaPage->encode(buf.Data());
+    int rc = writeMetaPage(buf.Data());
     if (rc < 0) {
         LOG(ERROR) << "Update metapage failed."
                    << "ChunkID: " << chunkId_
@@ -777,19 +1083,38 @@ CSErrorCode CSChunkFile::updateMetaPage(ChunkFileMetaPage* metaPage) {
     return CSErrorCode::Success;
 }
 
+CSErrorCode CSChunkFile::syncBarrier() {
+    if (syncWrite_) {
+        return CSErrorCode::Success;
+    }
+    int rc = lfs_->Fdatasync(fd_);
+    if (rc < 0) {
+        LOG(ERROR) << "Sync chunk file failed."
+                   << "ChunkID: " << chunkId_
+                   << ",chunk sn: " << metaPage_.sn;
+        return CSErrorCode::InternalError;
+    }
+    unsynced_.store(false, std::memory_order_relaxed);
+    return CSErrorCode::Success;
+}
+
 CSErrorCode CSChunkFile::loadMetaPage() {
-    char buf[pageSize_];  // NOLINT
-    memset(buf, 0, sizeof(buf));
-    int rc = readMetaPage(buf);
+    AlignedBuffer buf = AlignedBufferPool::Get(pageSize_);
+    if (nullptr == buf.Data()) {
+        return CSErrorCode::InternalError;
+    }
+    memset(buf.Data(), 0, pageSize_);
+    int rc = readMetaPage(buf.Data());
     if (rc < 0) {
         LOG(ERROR) << "Error occured when reading metaPage_."
                    << " filepath = " << path();
         return CSErrorCode::InternalError;
     }
-    return metaPage_.decode(buf);
+    return metaPage_.decode(buf.Data());
 }
 
-CSErrorCode CSChunkFile::copy2Snapshot(off_t offset, size_t length) {
+CSErrorCode CSChunkFile::copy2Snapshot(off_t offset, size_t length,
+                                       uint32_t* ioCount) {
     // 获取快照文件中未被拷贝过的区域
     uint32_t pageBeginIndex = offset / pageSize_;
     uint32_t pageEndIndex = (offset + length - 1) / pageSize_;
@@ -807,18 +1132,20 @@ CSErrorCode CSChunkFile::copy2Snapshot(off_t offset, size_t length) {
     for (auto& range : uncopiedRange) {
         copyOff = range.beginIndex * pageSize_;
         copySize = (range.endIndex - range.beginIndex + 1) * pageSize_;
-        std::shared_ptr<char> buf(new char[copySize],
-                                  std::default_delete<char[]>());
-        int rc = readData(buf.get(),
-                          copyOff,
-                          copySize);
+        AlignedBuffer buf = AlignedBufferPool::Get(copySize);
+        if (nullptr == buf.Data()) {
+            return CSErrorCode::InternalError;
+        }
+        int rc = readWrittenData(buf.Data(),
+                                 copyOff,
+                                 copySize);
         if (rc < 0) {
             LOG(ERROR) << "Read from chunk file failed."
                        << "ChunkID: " << chunkId_
                        << ",chunk sn: " << metaPage_.sn;
             return CSErrorCode::InternalError;
         }
-        errorCode = snapshot_->Write(buf.get(), copyOff, copySize);
+        errorCode = snapshot_->Write(buf.Data(), copyOff, copySize);
         if (errorCode != CSErrorCode::Success) {
             LOG(ERROR) << "Write to snapshot failed."
                        << "ChunkID: " << chunkId_
@@ -826,6 +1153,8 @@ CSErrorCode CSChunkFile::copy2Snapshot(off_t offset, size_t length) {
                        << ",snapshot sn: " << snapshot_->GetSn();
             return errorCode;
         }
+        // 从chunk文件读出再写入快照文件
+        *ioCount += 2;
     }
     // 如果快照文件被写过，需要调用Flush持久化metapage
     if (uncopiedRange.size() > 0) {
@@ -837,46 +1166,360 @@ CSErrorCode CSChunkFile::copy2Snapshot(off_t offset, size_t length) {
                         << ",snapshot sn: " << snapshot_->GetSn();
             return errorCode;
         }
+        ++*ioCount;
     }
     return CSErrorCode::Success;
 }
 
-CSErrorCode CSChunkFile::flush() {
-    ChunkFileMetaPage tempMeta = metaPage_;
-    bool needUpdateMeta = dirtyPages_.size() > 0;
-    bool clearClone = false;
-    for (auto pageIndex : dirtyPages_) {
-        tempMeta.bitmap->Set(pageIndex);
+CSErrorCode CSChunkFile::checkReadable(off_t offset, size_t length) {
+    if (!CheckOffsetAndLength(offset, length)) {
+        LOG(ERROR) << "Read chunk failed, invalid offset or length."
+                   << "ChunkID: " << chunkId_
+                   << ", offset: " << offset
+                   << ", length: " << length
+                   << ", page size: " << pageSize_
+                   << ", chunk size: " << size_;
+        return CSErrorCode::InvalidArgError;
     }
+
+    // 如果是 clonechunk ,要保证读取区域已经被写过，否则返回错误
     if (isCloneChunk_) {
-        // 如果所有的page都被写过,将Chunk标记为非clone chunk
-        if (tempMeta.bitmap->NextClearBit(0) == Bitmap::NO_POS) {
-            tempMeta.location = "";
-            tempMeta.bitmap = nullptr;
-            needUpdateMeta = true;
-            clearClone = true;
+        // 上面下来的请求必须是pagesize对齐的
+        // 请求paste区域的起始page索引号
+        uint32_t beginIndex = offset / pageSize_;
+        // 请求paste区域的最后一个page索引号
+        uint32_t endIndex = (offset + length - 1) / pageSize_;
+        if (metaPage_.bitmap->NextClearBit(beginIndex, endIndex)
+            != Bitmap::NO_POS) {
+            LOG(ERROR) << "Read chunk file failed, has page never written."
+                       << "ChunkID: " << chunkId_
+                       << ", offset: " << offset
+                       << ", length: " << length;
+            return CSErrorCode::PageNerverWrittenError;
         }
     }
-    if (needUpdateMeta) {
-        CSErrorCode errorCode = updateMetaPage(&tempMeta);
-        if (errorCode != CSErrorCode::Success) {
-            LOG(ERROR) << "Update metapage failed."
-                        << "ChunkID: " << chunkId_
-                        << ",chunk sn: " << metaPage_.sn;
-            return errorCode;
+    return CSErrorCode::Success;
+}
+
+CSErrorCode CSChunkFile::openFd() {
+    string chunkFilePath = path();
+    int flags = O_RDWR|O_NOATIME;
+    if (syncWrite_) {
+        flags |= O_DSYNC;
+    }
+    if (directIO_) {
+        flags |= O_DIRECT;
+    }
+    int rc = lfs_->Open(chunkFilePath, flags);
+    if (rc < 0) {
+        LOG(ERROR) << "Error occured when opening file."
+                   << " filepath = " << chunkFilePath;
+        return CSErrorCode::InternalError;
+    }
+    fd_ = rc;
+    return CSErrorCode::Success;
+}
+
+void CSChunkFile::closeFd() {
+    if (fd_ >= 0) {
+        lfs_->Close(fd_);
+        fd_ = -1;
+    }
+    if (snapshot_ != nullptr) {
+        snapshot_->CloseFd();
+    }
+}
+
+CSErrorCode CSChunkFile::ensureOpen(bool needFd) {
+    // 未启用fd缓存时，chunk在Open时加载并一直持有fd
+    if (fdCache_ == nullptr) {
+        return CSErrorCode::Success;
+    }
+    MarkReferenced();
+    std::lock_guard<std::mutex> lock(fdMtx_);
+    if (loaded_ && (fd_ >= 0 || !needFd)) {
+        return CSErrorCode::Success;
+    }
+
+    CSErrorCode errorCode = CSErrorCode::Success;
+    if (!loaded_) {
+        // 首次访问，加载metapage以及启动时发现的快照
+        errorCode = open(false);
+        if (errorCode == CSErrorCode::Success && pendingSnapSn_ != 0) {
+            errorCode = loadSnapshot(pendingSnapSn_);
+        }
+        if (errorCode == CSErrorCode::Success) {
+            pendingSnapSn_ = 0;
+            loaded_ = true;
+            reportMeta();
+        }
+    } else {
+        // fd被淘汰过，元数据仍在内存中，只需要重新打开文件
+        errorCode = openFd();
+        if (errorCode == CSErrorCode::Success
+            && snapshot_ != nullptr && !snapshot_->IsFdOpened()) {
+            errorCode = snapshot_->OpenFd();
         }
+    }
+    if (errorCode != CSErrorCode::Success) {
+        LOG(ERROR) << "Open chunk file failed."
+                   << "ChunkID: " << chunkId_;
+        closeFd();
+        return errorCode;
+    }
+    fdCache_->Insert(this);
+    return CSErrorCode::Success;
+}
+
+void CSChunkFile::reportMeta() {
+    if (!metaListener_) {
+        return;
+    }
+    ChunkManifestEntry entry;
+    entry.id = chunkId_;
+    entry.sn = metaPage_.sn;
+    entry.correctedSn = metaPage_.correctedSn;
+    entry.snapSn = snapshot_ != nullptr ? snapshot_->GetSn() : pendingSnapSn_;
+    entry.isClone = isCloneChunk_;
+    entry.hasBitmap = !isCloneChunk_ && metaPage_.bitmap != nullptr;
+    entry.metaValid = loaded_;
+    entry.location = metaPage_.location;
+    metaListener_(entry);
+}
+
+bool CSChunkFile::TryCloseFd() {
+    // 持有写锁才能保证没有请求正在使用fd
+    if (rwLock_.TryWRLock() != 0) {
+        return false;
+    }
+    bool idle = false;
+    {
+        std::lock_guard<std::mutex> lock(asyncIOMtx_);
+        idle = (asyncIOCount_ == 0);
+    }
+    // 有未刷盘的写入时不关闭fd，关闭后回写失败的错误无法通过重新打开的fd
+    // 发现，等SyncChunkFiles刷盘后再淘汰
+    if (unsynced_.load(std::memory_order_relaxed)) {
+        idle = false;
+    }
+    if (idle) {
+        closeFd();
+    }
+    rwLock_.Unlock();
+    return idle;
+}
+
+void CSChunkFile::waitAsyncIODone() {
+    std::unique_lock<std::mutex> lock(asyncIOMtx_);
+    asyncIOCond_.wait(lock, [this] { return asyncIOCount_ == 0; });
+}
+
+int CSChunkFile::writeData(const butil::IOBuf& buf,
+                           off_t offset,
+                           size_t length) {
+    int rc = 0;
+    markUnsynced();
+    if (directIO_) {
+        rc = DirectIOHelper::Write(lfs_.get(), fd_, buf,
+                                   offset + pageSize_, length);
+    } else {
+        // 将IOBuf的各个block直接作为iovec写入，只取前length字节
+        std::vector<struct iovec> iov;
+        iov.reserve(buf.backing_block_num());
+        size_t remain = length;
+        for (size_t i = 0; i < buf.backing_block_num() && remain > 0; ++i) {
+            butil::StringPiece block = buf.backing_block(i);
+            struct iovec vec;
+            vec.iov_base = const_cast<char*>(block.data());
+            vec.iov_len = std::min(remain, block.size());
+            iov.push_back(vec);
+            remain -= vec.iov_len;
+        }
+        rc = lfs_->Writev(fd_, iov.data(), iov.size(), offset + pageSize_);
+    }
+    if (rc < 0) {
+        // 文件中的数据可能已经被部分修改
+        invalidateReadCache();
+        return rc;
+    }
+    markDirtyPages(offset, length);
+    if (readCache_ != nullptr) {
+        readCache_->Update(chunkId_, metaPage_.sn, offset / pageSize_,
+                           length / pageSize_, buf);
+        ++cacheVersion_;
+    }
+    return rc;
+}
+
+CSErrorCode CSChunkFile::flush(uint32_t* ioCount) {
+    if (metaPage_.bitmap == nullptr || dirtyPages_ == nullptr) {
+        return CSErrorCode::Success;
+    }
+    std::vector<BitRange> dirtyRanges;
+    dirtyPages_->Divide(0, dirtyPages_->Size() - 1, nullptr, &dirtyRanges);
+    // 被写的page之前都已经写过时，bitmap不会变化
+    bool needUpdateMeta = false;
+    for (const auto& range : dirtyRanges) {
+        if (metaPage_.bitmap->NextClearBit(range.beginIndex, range.endIndex)
+            != Bitmap::NO_POS) {
+            needUpdateMeta = true;
+            break;
+        }
+    }
+    if (!needUpdateMeta) {
+        dirtyPages_->Clear();
+        return CSErrorCode::Success;
+    }
+
+    ChunkFileMetaPage tempMeta = metaPage_;
+    for (const auto& range : dirtyRanges) {
+        tempMeta.bitmap->Set(range.beginIndex, range.endIndex);
+    }
+    // 如果所有的page都被写过,将Chunk标记为非clone chunk，并且不再需要bitmap
+    bool allWritten = tempMeta.bitmap->NextClearBit(0) == Bitmap::NO_POS;
+    if (allWritten) {
+        tempMeta.version = FORMAT_VERSION;
+        tempMeta.location = "";
+        tempMeta.bitmap = nullptr;
+    }
+    // 去掉bitmap时需要立即持久化，其余情况可以延迟到Sync
+    if (batchBitmapFlush_ && !allWritten) {
         metaPage_.bitmap = tempMeta.bitmap;
-        metaPage_.location = tempMeta.location;
-        dirtyPages_.clear();
-        if (clearClone) {
-            if (metric_ != nullptr) {
-                metric_->cloneChunkCount << -1;
-            }
-            isCloneChunk_ = false;
+        dirtyPages_->Clear();
+        bitmapPending_.store(true, std::memory_order_relaxed);
+        return CSErrorCode::Success;
+    }
+    CSErrorCode errorCode = updateMetaPage(&tempMeta);
+    if (errorCode != CSErrorCode::Success) {
+        LOG(ERROR) << "Update metapage failed."
+                    << "ChunkID: " << chunkId_
+                    << ",chunk sn: " << metaPage_.sn;
+        return errorCode;
+    }
+    if (ioCount != nullptr) {
+        ++*ioCount;
+    }
+    metaPage_.version = tempMeta.version;
+    metaPage_.bitmap = tempMeta.bitmap;
+    metaPage_.location = tempMeta.location;
+    dirtyPages_->Clear();
+    bitmapPending_.store(false, std::memory_order_relaxed);
+    if (allWritten) {
+        if (isCloneChunk_ && metric_ != nullptr) {
+            metric_->cloneChunkCount << -1;
         }
+        isCloneChunk_ = false;
+        dirtyPages_ = nullptr;
+        reportMeta();
     }
     return CSErrorCode::Success;
 }
 
+int CSChunkFile::readWrittenData(char* buf, off_t offset, size_t length) {
+    if (readCache_ == nullptr) {
+        return readWrittenDataFromFile(buf, offset, length);
+    }
+    uint32_t beginIndex = offset / pageSize_;
+    uint32_t count = length / pageSize_;
+    std::vector<bool> hits;
+    uint32_t hitCount = readCache_->Get(chunkId_, metaPage_.sn, beginIndex,
+                                        count, buf, &hits);
+    if (metric_ != nullptr) {
+        metric_->readCacheHit << hitCount;
+        metric_->readCacheMiss << count - hitCount;
+    }
+    if (hitCount == count) {
+        return length;
+    }
+    // 按连续未命中的page读文件
+    uint32_t i = 0;
+    while (i < count) {
+        if (hits[i]) {
+            ++i;
+            continue;
+        }
+        uint32_t j = i + 1;
+        while (j < count && !hits[j]) {
+            ++j;
+        }
+        int rc = readWrittenDataFromFile(buf + i * pageSize_,
+                                         offset + i * pageSize_,
+                                         (j - i) * pageSize_);
+        if (rc < 0) {
+            return rc;
+        }
+        i = j;
+    }
+    readCache_->Put(chunkId_, metaPage_.sn, beginIndex, count, buf, &hits);
+    return length;
+}
+
+bool CSChunkFile::readFromCache(char* buf, off_t offset, size_t length) {
+    if (readCache_ == nullptr) {
+        return false;
+    }
+    uint32_t count = length / pageSize_;
+    std::vector<bool> hits;
+    bool hit = readCache_->Get(chunkId_, metaPage_.sn, offset / pageSize_,
+                               count, buf, &hits) == count;
+    // 部分命中时整个区域都需要读盘，全部计为未命中
+    if (metric_ != nullptr) {
+        if (hit) {
+            metric_->readCacheHit << count;
+        } else {
+            metric_->readCacheMiss << count;
+        }
+    }
+    return hit;
+}
+
+int CSChunkFile::readWrittenDataFromFile(char* buf,
+                                         off_t offset,
+                                         size_t length) {
+    if (!hasUnwrittenPages(offset, length)) {
+        return readData(buf, offset, length);
+    }
+    uint32_t beginIndex = offset / pageSize_;
+    uint32_t endIndex = (offset + length - 1) / pageSize_;
+    std::vector<BitRange> unwrittenRanges;
+    std::vector<BitRange> writtenRanges;
+    metaPage_.bitmap->Divide(beginIndex,
+                             endIndex,
+                             &unwrittenRanges,
+                             &writtenRanges);
+    off_t readOff;
+    size_t readSize;
+    for (auto& range : unwrittenRanges) {
+        readOff = range.beginIndex * pageSize_;
+        readSize = (range.endIndex - range.beginIndex + 1) * pageSize_;
+        memset(buf + (readOff - offset), 0, readSize);
+    }
+    for (auto& range : writtenRanges) {
+        readOff = range.beginIndex * pageSize_;
+        readSize = (range.endIndex - range.beginIndex + 1) * pageSize_;
+        int rc = readData(buf + (readOff - offset), readOff, readSize);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    return length;
+}
+
+CSErrorCode CSChunkFile::flushPendingBitmap() {
+    if (!bitmapPending_.exchange(false, std::memory_order_relaxed)) {
+        return CSErrorCode::Success;
+    }
+    // 持有读锁，写请求不会修改metaPage_
+    ChunkFileMetaPage tempMeta = metaPage_;
+    CSErrorCode errorCode = updateMetaPage(&tempMeta);
+    if (errorCode != CSErrorCode::Success) {
+        bitmapPending_.store(true, std::memory_order_relaxed);
+        LOG(ERROR) << "Flush pending bitmap failed."
+                   << "ChunkID: " << chunkId_
+                   << ",chunk sn: " << metaPage_.sn;
+    }
+    return errorCode;
+}
+
 }  // namespace chunkserver
 }  // namespace curve
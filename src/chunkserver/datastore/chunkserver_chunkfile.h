@@ -23,12 +23,14 @@
 #define SRC_CHUNKSERVER_DATASTORE_CHUNKSERVER_CHUNKFILE_H_
 
 #include <glog/logging.h>
+#include <butil/iobuf.h>
 #include <string>
 #include <vector>
-#include <set>
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>  // NOLINT
+#include <condition_variable>  // NOLINT
 
 #include "include/curve_compiler_specific.h"
 #include "include/chunkserver/chunkserver_common.h"
@@ -39,6 +41,10 @@
 #include "src/chunkserver/datastore/chunkserver_snapshot.h"
 #include "src/chunkserver/datastore/define.h"
 #include "src/chunkserver/datastore/chunkfile_pool.h"
+#include "src/chunkserver/datastore/direct_io.h"
+#include "src/chunkserver/datastore/chunkfile_fd_cache.h"
+#include "src/chunkserver/datastore/chunk_manifest.h"
+#include "src/chunkserver/datastore/chunk_read_cache.h"
 
 namespace curve {
 namespace chunkserver {
@@ -48,6 +54,8 @@ using curve::common::RWLock;
 using curve::common::WriteLockGuard;
 using curve::common::ReadLockGuard;
 using curve::common::BitRange;
+using curve::common::AlignedBuffer;
+using curve::common::AlignedBufferPool;
 
 class ChunkfilePool;
 class CSSnapshot;
@@ -58,8 +66,12 @@ struct DataStoreMetric;
  * version: 1 byte
  * sn: 8 bytes
  * correctedSn: 8 bytes
+ * location size: 8 bytes
+ * location: location size bytes，非clone chunk没有
+ * bits: 4 bytes，version 1的非clone chunk没有
+ * bitmap: (bits + 7) / 8 bytes，version 1的非clone chunk没有
  * crc: 4 bytes
- * padding: 4075 bytes
+ * padding
  */
 struct ChunkFileMetaPage {
     // 文件格式的版本
@@ -70,7 +82,8 @@ struct ChunkFileMetaPage {
     SequenceNum correctedSn;
     // 表示数据源的位置信息，如果不是CloneChunk则为空
     string location;
-    // 表示当前Chunk中page的状态，如果不是CloneChunk则为nullptr
+    // 表示当前Chunk中page是否被写过，CloneChunk以及记录写入状态的chunk
+    // 不为nullptr，为nullptr表示所有page都已写过
     std::shared_ptr<Bitmap> bitmap;
 
     ChunkFileMetaPage() : version(FORMAT_VERSION)
@@ -81,7 +94,7 @@ struct ChunkFileMetaPage {
     ChunkFileMetaPage(const ChunkFileMetaPage& metaPage);
     ChunkFileMetaPage& operator = (const ChunkFileMetaPage& metaPage);
 
-    void encode(char* buf);
+    void encode(char* buf) const;
     CSErrorCode decode(const char* buf);
 };
 
@@ -102,6 +115,26 @@ struct ChunkOptions {
     PageSizeType    pageSize;
     // datastore内部统计指标
     std::shared_ptr<DataStoreMetric> metric;
+    // 为true时以O_DSYNC打开文件，每次写都同步落盘；
+    // 为false时由上层定期调用Sync批量刷盘
+    bool            syncWrite;
+    // 为true时以O_DIRECT打开文件，读写绕过page cache
+    bool            directIO;
+    // chunkserver共享的fd缓存，不为空时chunk在首次访问时才打开文件，
+    // 并且fd可能被淘汰；为空时chunk在Open时打开文件并一直持有fd
+    std::shared_ptr<ChunkFdCache> fdCache;
+    // chunk元数据(版本号、快照、clone信息)加载或变化时回调，用于更新manifest
+    std::function<void(const ChunkManifestEntry&)> metaListener;
+    // 为true表示sn、correctedSn、location来自已封存的manifest，是准确的
+    bool            metaLoaded;
+    // 为true时clone chunk的bitmap变化先只更新内存，在Sync时批量写入metapage，
+    // 掉电丢失的bitmap更新由上层回放raft日志重建
+    bool            batchBitmapFlush;
+    // 为true时新创建的非clone chunk也在metapage中记录page是否被写过，
+    // 读未写过的page直接返回0，chunk文件不需要预先写零
+    bool            trackWrittenPages;
+    // chunkserver共享的数据读缓存，为空时不缓存
+    std::shared_ptr<ChunkReadCache> readCache;
 
     ChunkOptions() : id(0)
                    , sn(0)
@@ -110,10 +143,18 @@ struct ChunkOptions {
                    , location("")
                    , chunkSize(0)
                    , pageSize(0)
-                   , metric(nullptr) {}
+                   , metric(nullptr)
+                   , syncWrite(true)
+                   , directIO(false)
+                   , fdCache(nullptr)
+                   , metaListener(nullptr)
+                   , metaLoaded(false)
+                   , batchBitmapFlush(false)
+                   , trackWrittenPages(false)
+                   , readCache(nullptr) {}
 };
 
-class CSChunkFile {
+class CSChunkFile : public FdCacheEntry {
  public:
     CSChunkFile(std::shared_ptr<LocalFileSystem> lfs,
                 std::shared_ptr<ChunkfilePool> ChunkfilePool,
@@ -151,6 +192,21 @@ class CSChunkFile {
                       off_t offset,
                       size_t length,
                       uint32_t* cost);
+    /**
+     * 写chunk文件，与上面的接口语义相同
+     * 数据直接以IOBuf的形式传入，通过writev写入文件，避免拷贝到连续内存
+     * @param sn: 当前写请求的文件版本号
+     * @param buf: 请求写入的数据
+     * @param offset: 请求写入的偏移位置
+     * @param length: 请求写入的数据长度
+     * @param cost: 此次请求实际产生的IO次数，用于QOS控制
+     * @return: 返回错误码
+     */
+    CSErrorCode Write(SequenceNum sn,
+                      const butil::IOBuf& buf,
+                      off_t offset,
+                      size_t length,
+                      uint32_t* cost);
     /**
      * 将拷贝的数据写入Chunk中
      * 只会写入未写过的区域，不会覆盖已经写过的区域
@@ -161,6 +217,14 @@ class CSChunkFile {
      * @return: 返回错误码
      */
     CSErrorCode Paste(const char * buf, off_t offset, size_t length);
+    /**
+     * 将拷贝的数据写入Chunk中，与上面的接口语义相同，数据以IOBuf形式传入
+     * @param buf: 请求Paste的数据
+     * @param offset: 请求Paste的数据起始偏移
+     * @param length: 请求Paste的数据长度
+     * @return: 返回错误码
+     */
+    CSErrorCode Paste(const butil::IOBuf& buf, off_t offset, size_t length);
     /**
      * 读chunk文件
      * 可能存在并发，加读锁
@@ -170,6 +234,17 @@ class CSChunkFile {
      * @return: 返回错误码
      */
     CSErrorCode Read(char * buf, off_t offset, size_t length);
+    /**
+     * 异步读chunk文件
+     * 参数检查在调用线程中完成，检查失败时直接在调用线程中调用done；
+     * 本地文件系统不支持异步IO时退化为同步读
+     * buf在done被调用前必须保持有效
+     * @param buf: 读到的数据
+     * @param offset: 请求读取的数据起始偏移
+     * @param length: 请求读取的数据长度
+     * @param done: 读完成时的回调
+     */
+    void ReadAsync(char * buf, off_t offset, size_t length, CSIOCallback done);
     /**
      * 读指定版本的chunk
      * 可能存在并发，加读锁
@@ -202,7 +277,7 @@ class CSChunkFile {
     /**
      * 调用fsync将snapshot文件在pagecache中的数据刷盘
      */
-    void GetInfo(CSChunkInfo* info);
+    CSErrorCode GetInfo(CSChunkInfo* info);
     /**
      * 获取chunk的hash值，此接口一般用于测试调用
      * @param[out]: chunk hash值
@@ -211,8 +286,37 @@ class CSChunkFile {
     CSErrorCode GetHash(off_t offset,
                         size_t length,
                         std::string *hash);
+    /**
+     * 将chunk文件在pagecache中的数据刷盘，非同步写模式下由上层批量调用
+     * 快照文件的数据在cow时已经刷盘，这里不需要处理
+     * @return: 返回错误码
+     */
+    CSErrorCode Sync();
+    /**
+     * 尝试关闭chunk和快照文件的fd，由fd缓存在淘汰时调用
+     * 文件正在被使用时不关闭，返回false
+     */
+    bool TryCloseFd() override;
 
  private:
+    // Open的实现，调用者需持有写锁
+    CSErrorCode open(bool createFile);
+    // LoadSnapshot的实现，调用者需持有写锁
+    CSErrorCode loadSnapshot(SequenceNum sn);
+    // 以当前的读写模式打开chunk文件
+    CSErrorCode openFd();
+    // 关闭chunk文件和快照文件的fd，不修改内存中的元数据
+    void closeFd();
+    /**
+     * 启用fd缓存时，保证chunk已经加载并且文件已经打开
+     * 调用者需持有读锁或写锁
+     * @param needFd: 为false时只需要元数据已经加载
+     * @return: 返回错误码
+     */
+    CSErrorCode ensureOpen(bool needFd = true);
+    // 将当前的元数据通知给metaListener_，调用者需持有锁
+    void reportMeta();
+
     /**
      * 判断是否需要创建新的快照
      * @param sn:写请求的版本号
@@ -225,6 +329,35 @@ class CSChunkFile {
      * @return: true 表示要cow；false 表示不需要cow
      */
     bool needCow(SequenceNum sn);
+    /**
+     * 写数据前的检查和准备工作，包括创建快照、更新metapage的sn以及cow
+     * 调用者需要持有写锁
+     * @param sn:写请求的版本号
+     * @param offset: 请求写入的偏移位置
+     * @param length: 请求写入的数据长度
+     * @param ioCount: 累加准备过程中实际产生的IO次数
+     * @return: 返回错误码
+     */
+    CSErrorCode prepareWrite(SequenceNum sn, off_t offset, size_t length,
+                             uint32_t* ioCount);
+    /**
+     * 两个Write接口的公共流程，加写锁后准备写入、写入数据并flush
+     * @param buf: 请求写入的数据，char*或者IOBuf，通过writeData写入
+     * 其余参数与Write相同
+     */
+    template <typename Buffer>
+    CSErrorCode doWrite(SequenceNum sn,
+                        const Buffer& buf,
+                        off_t offset,
+                        size_t length,
+                        uint32_t* cost);
+    /**
+     * 两个Paste接口的公共流程，只写入clone chunk中未被写过的page
+     * @param buf: 请求Paste的数据，char*或者IOBuf，通过writeDataFrom写入
+     * 其余参数与Paste相同
+     */
+    template <typename Buffer>
+    CSErrorCode doPaste(const Buffer& buf, off_t offset, size_t length);
     /**
      * 将metapage持久化
      * @param metaPage:需要持久化到磁盘的metapage,
@@ -232,6 +365,14 @@ class CSChunkFile {
      *                 如果失败，则不会更改
      */
     CSErrorCode updateMetaPage(ChunkFileMetaPage* metaPage);
+    /**
+     * 非同步写模式下，更新metapage前后需要调用此接口保证写入顺序：
+     * 1.clone chunk的数据要先于bitmap落盘
+     * 2.sn和correctedSn要先于新版本的数据落盘，否则重启后回放日志会
+     *   将新数据错误地拷贝到快照中
+     * 同步写模式下直接返回成功
+     */
+    CSErrorCode syncBarrier();
     /**
      * 将metapage加载到内存
      */
@@ -240,14 +381,17 @@ class CSChunkFile {
      * 将指定区域中未拷贝过的数据从chunk文件拷贝到快照文件
      * @param offset: 写入数据区域的起始偏移
      * @param length: 写入数据区域的长度
+     * @param ioCount: 累加拷贝过程中实际产生的IO次数
      * @return: 返回错误码
      */
-    CSErrorCode copy2Snapshot(off_t offset, size_t length);
+    CSErrorCode copy2Snapshot(off_t offset, size_t length, uint32_t* ioCount);
     /**
-     * 更新clone chunk的bitmap
-     * 如果所有的page都已写过，则将clone chunk转成普通chunk
+     * 更新chunk的bitmap
+     * 如果所有的page都已写过，则将clone chunk转成普通chunk，
+     * 记录写入状态的普通chunk不再需要bitmap
+     * @param ioCount: 不为空时累加持久化metapage产生的IO次数
      */
-    CSErrorCode flush();
+    CSErrorCode flush(uint32_t* ioCount = nullptr);
 
     inline string path() {
         return baseDir_ + "/" +
@@ -258,37 +402,134 @@ class CSChunkFile {
         return pageSize_ + size_;
     }
 
+    inline int readFile(char* buf, off_t offset, size_t length) {
+        if (directIO_) {
+            return DirectIOHelper::Read(lfs_.get(), fd_, buf, offset, length);
+        }
+        return lfs_->Read(fd_, buf, offset, length);
+    }
+
+    inline int writeFile(const char* buf, off_t offset, size_t length) {
+        markUnsynced();
+        if (directIO_) {
+            return DirectIOHelper::Write(lfs_.get(), fd_, buf, offset, length);
+        }
+        return lfs_->Write(fd_, buf, offset, length);
+    }
+
     inline int readMetaPage(char* buf) {
-        return lfs_->Read(fd_, buf, 0, pageSize_);
+        return readFile(buf, 0, pageSize_);
     }
 
     inline int writeMetaPage(const char* buf) {
-        return lfs_->Write(fd_, buf, 0, pageSize_);
+        return writeFile(buf, 0, pageSize_);
     }
 
+    // 非同步写模式下记录fd上有还未刷盘的写入，调用者需持有写锁
+    inline void markUnsynced() {
+        if (!syncWrite_) {
+            unsynced_.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    // 检查读请求的参数以及clone chunk的读取区域是否已经被写过
+    CSErrorCode checkReadable(off_t offset, size_t length);
+
+    // 等待在途的异步IO全部完成，关闭fd或者改写chunk数据之前持有写锁调用
+    void waitAsyncIODone();
+
     inline int readData(char* buf, off_t offset, size_t length) {
-        return lfs_->Read(fd_, buf, offset + pageSize_, length);
+        return readFile(buf, offset + pageSize_, length);
+    }
+
+    /**
+     * 读chunk数据，开启读缓存时先从缓存中读，未命中的page读文件后填充缓存
+     * offset和length需要按page对齐
+     * @return: 成功返回读取的长度，失败返回小于0
+     */
+    int readWrittenData(char* buf, off_t offset, size_t length);
+
+    /**
+     * 从文件读chunk数据，记录了写入状态时未写过的page直接填0，不读文件
+     * offset和length需要按page对齐
+     * @return: 成功返回读取的长度，失败返回小于0
+     */
+    int readWrittenDataFromFile(char* buf, off_t offset, size_t length);
+
+    /**
+     * 读请求的page是否全部在读缓存中，全部命中时数据拷贝到buf中
+     */
+    bool readFromCache(char* buf, off_t offset, size_t length);
+
+    /**
+     * 读取区域中是否有记录为未写过的page，clone chunk返回false
+     */
+    inline bool hasUnwrittenPages(off_t offset, size_t length) {
+        if (isCloneChunk_ || metaPage_.bitmap == nullptr) {
+            return false;
+        }
+        uint32_t beginIndex = offset / pageSize_;
+        uint32_t endIndex = (offset + length - 1) / pageSize_;
+        return metaPage_.bitmap->NextClearBit(beginIndex, endIndex)
+            != Bitmap::NO_POS;
     }
 
     inline int writeData(const char* buf, off_t offset, size_t length) {
-        int rc = lfs_->Write(fd_, buf, offset + pageSize_, length);
+        int rc = writeFile(buf, offset + pageSize_, length);
         if (rc < 0) {
+            // 文件中的数据可能已经被部分修改
+            invalidateReadCache();
             return rc;
         }
-        // 如果是clone chunk，需要判断是否需要更改bitmap并更新metapage
-        if (isCloneChunk_) {
+        markDirtyPages(offset, length);
+        if (readCache_ != nullptr) {
+            readCache_->Update(chunkId_, metaPage_.sn, offset / pageSize_,
+                               length / pageSize_, buf);
+            ++cacheVersion_;
+        }
+        return rc;
+    }
+
+    int writeData(const butil::IOBuf& buf, off_t offset, size_t length);
+
+    // 将buf中从bufOffset开始的length字节数据写到chunk的offset处
+    inline int writeDataFrom(const char* buf, off_t bufOffset,
+                             off_t offset, size_t length) {
+        return writeData(buf + bufOffset, offset, length);
+    }
+
+    // IOBuf从bufOffset处切出对应的数据写入，不会产生拷贝
+    inline int writeDataFrom(const butil::IOBuf& buf, off_t bufOffset,
+                             off_t offset, size_t length) {
+        butil::IOBuf data;
+        buf.append_to(&data, length, bufOffset);
+        return writeData(data, offset, length);
+    }
+
+    // 清除chunk在读缓存中的所有page，调用者需持有写锁
+    inline void invalidateReadCache() {
+        if (readCache_ != nullptr) {
+            readCache_->Invalidate(chunkId_);
+            ++cacheVersion_;
+        }
+    }
+
+    inline void markDirtyPages(off_t offset, size_t length) {
+        // 如果chunk有bitmap，记录dirty page，由flush判断是否需要更新bitmap
+        if (metaPage_.bitmap != nullptr) {
+            if (dirtyPages_ == nullptr) {
+                dirtyPages_ = std::make_shared<Bitmap>(
+                    metaPage_.bitmap->Size());
+            }
             uint32_t beginIndex = offset / pageSize_;
             uint32_t endIndex = (offset + length - 1) / pageSize_;
-            for (uint32_t i = beginIndex; i <= endIndex; ++i) {
-                // 记录dirty page
-                if (!metaPage_.bitmap->Test(i)) {
-                    dirtyPages_.insert(i);
-                }
-            }
+            dirtyPages_->Set(beginIndex, endIndex);
         }
-        return rc;
     }
 
+    // 将内存中已更新但还未写入metapage的bitmap落盘
+    CSErrorCode flushPendingBitmap();
+
     inline bool CheckOffsetAndLength(off_t offset, size_t len) {
         // 检查offset+len是否越界
         if (offset + len > size_) {
@@ -323,10 +564,22 @@ class CSChunkFile {
     bool isCloneChunk_;
     // chunk的metapage
     ChunkFileMetaPage metaPage_;
-    // 被写过但还未更新到metapage中的page索引
-    std::set<uint32_t> dirtyPages_;
+    // 被写过但还未合并到bitmap中的page，只有chunk有bitmap时会用到
+    std::shared_ptr<Bitmap> dirtyPages_;
+    // 是否批量持久化chunk的bitmap
+    bool batchBitmapFlush_;
+    // 新创建的非clone chunk是否记录page的写入状态
+    bool trackWrittenPages_;
+    // 内存中的bitmap有还未写入metapage的更新
+    std::atomic<bool> bitmapPending_;
+    // 非同步写模式下fd上有还未fdatasync的写入，此时fd不能被淘汰
+    std::atomic<bool> unsynced_;
     // 读写锁
     RWLock rwLock_;
+    // 在途的异步IO数量，异步IO完成前不能关闭fd，也不能改写chunk数据
+    uint32_t asyncIOCount_;
+    std::mutex asyncIOMtx_;
+    std::condition_variable asyncIOCond_;
     // 快照文件指针
     CSSnapshot* snapshot_;
     // 依赖chunkfilepool创建删除文件
@@ -335,6 +588,27 @@ class CSChunkFile {
     std::shared_ptr<LocalFileSystem> lfs_;
     // datastore内部统计指标
     std::shared_ptr<DataStoreMetric> metric_;
+    // 是否以O_DSYNC方式写文件
+    bool syncWrite_;
+    // 是否以O_DIRECT方式读写文件
+    bool directIO_;
+    // 是否已经加载metapage，启用fd缓存时在首次访问时加载
+    bool loaded_;
+    // chunk文件是否已经被删除
+    bool deleted_;
+    // 启动时发现的、等待首次访问时加载的快照版本号，0表示没有
+    SequenceNum pendingSnapSn_;
+    // 保护加载和重新打开fd的过程，同一个chunk可能被多个读请求并发访问
+    std::mutex fdMtx_;
+    // chunkserver共享的fd缓存
+    std::shared_ptr<ChunkFdCache> fdCache_;
+    // 元数据变化时的回调
+    std::function<void(const ChunkManifestEntry&)> metaListener_;
+    // chunkserver共享的数据读缓存，page大小不一致时为空
+    std::shared_ptr<ChunkReadCache> readCache_;
+    // 每次写入或清除缓存时加1，持有写锁时修改，
+    // 异步读完成时用于判断读到的数据是否还能放入缓存
+    uint64_t cacheVersion_;
 };
 }  // namespace chunkserver
 }  // namespace curve
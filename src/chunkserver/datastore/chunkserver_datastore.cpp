@@ -42,10 +42,24 @@ CSDataStore::CSDataStore(std::shared_ptr<LocalFileSystem> lfs,
       baseDir_(options.baseDir),
       locationLimit_(options.locationLimit),
       chunkfilePool_(chunkfilePool),
-      lfs_(lfs) {
+      lfs_(lfs),
+      syncWrite_(options.syncWrite),
+      directIO_(options.directIO),
+      batchBitmapFlush_(options.batchBitmapFlush),
+      trackWrittenPages_(options.trackWrittenPages),
+      fdCache_(options.fdCache),
+      readCache_(options.readCache) {
     CHECK(!baseDir_.empty()) << "Create datastore failed";
     CHECK(lfs_ != nullptr) << "Create datastore failed";
     CHECK(chunkfilePool_ != nullptr) << "Create datastore failed";
+    if (!options.manifestPath.empty()) {
+        manifest_ = std::make_shared<ChunkManifest>(lfs_,
+                                                    options.manifestPath);
+        auto manifest = manifest_;
+        metaListener_ = [manifest](const ChunkManifestEntry& entry) {
+            manifest->Put(entry);
+        };
+    }
 }
 
 CSDataStore::~CSDataStore() {
@@ -61,16 +75,29 @@ bool CSDataStore::Initialize() {
         }
     }
 
+    // 如果之前加载过，这里要重新加载
+    metaCache_.Clear();
+    metric_ = std::make_shared<DataStoreMetric>();
+    if (manifest_ != nullptr) {
+        if (loadFromManifest()) {
+            LOG(INFO) << "Initialize data store from manifest success.";
+            return true;
+        }
+        // manifest无效，清空后重新扫描目录，扫描过程中重新记录
+        metaCache_.Clear();
+        metric_ = std::make_shared<DataStoreMetric>();
+        if (manifest_->Reset() != 0) {
+            LOG(WARNING) << "Reset chunk manifest failed, "
+                         << "it will not be used at next start.";
+        }
+    }
+
     vector<string> files;
     int rc = lfs_->List(baseDir_, &files);
     if (rc < 0) {
         LOG(ERROR) << "List " << baseDir_ << " failed.";
         return false;
     }
-
-    // 如果之前加载过，这里要重新加载
-    metaCache_.Clear();
-    metric_ = std::make_shared<DataStoreMetric>();
     for (size_t i = 0; i < files.size(); ++i) {
         FileNameOperator::FileInfo info =
             FileNameOperator::ParseFileName(files[i]);
@@ -122,6 +149,9 @@ CSErrorCode CSDataStore::DeleteChunk(ChunkID id, SequenceNum sn) {
             return errorCode;
         }
         metaCache_.Remove(id);
+        if (manifest_ != nullptr) {
+            manifest_->Remove(id);
+        }
     }
     return CSErrorCode::Success;
 }
@@ -160,6 +190,33 @@ CSErrorCode CSDataStore::ReadChunk(ChunkID id,
     return CSErrorCode::Success;
 }
 
+void CSDataStore::ReadChunkAsync(ChunkID id,
+                                 SequenceNum sn,
+                                 char * buf,
+                                 off_t offset,
+                                 size_t length,
+                                 CSIOCallback done) {
+    auto chunkFile = metaCache_.Get(id);
+    if (chunkFile == nullptr) {
+        done(CSErrorCode::ChunkNotExistError);
+        return;
+    }
+
+    // 回调中持有chunkFile，保证异步读完成前chunk文件对象不会被析构
+    chunkFile->ReadAsync(buf, offset, length,
+        [id, chunkFile, done](CSErrorCode errorCode) {
+            if (errorCode != CSErrorCode::Success) {
+                LOG(WARNING) << "Read chunk file failed."
+                             << "ChunkID = " << id;
+            }
+            done(errorCode);
+        });
+}
+
+bool CSDataStore::SupportAsyncIO() {
+    return lfs_ != nullptr && lfs_->SupportAsyncIO();
+}
+
 CSErrorCode CSDataStore::ReadSnapshotChunk(ChunkID id,
                                            SequenceNum sn,
                                            char * buf,
@@ -207,9 +264,10 @@ CSErrorCode CSDataStore::CreateChunkFile(const ChunkOptions & options,
 }
 
 
-CSErrorCode CSDataStore::WriteChunk(ChunkID id,
+template <typename Buffer>
+CSErrorCode CSDataStore::doWriteChunk(ChunkID id,
                             SequenceNum sn,
-                            const char * buf,
+                            const Buffer& buf,
                             off_t offset,
                             size_t length,
                             uint32_t* cost,
@@ -231,6 +289,13 @@ CSErrorCode CSDataStore::WriteChunk(ChunkID id,
         options.location = cloneSourceLocation;
         options.pageSize = pageSize_;
         options.metric = metric_;
+        options.syncWrite = syncWrite_;
+        options.directIO = directIO_;
+        options.batchBitmapFlush = batchBitmapFlush_;
+        options.trackWrittenPages = trackWrittenPages_;
+        options.fdCache = fdCache_;
+        options.readCache = readCache_;
+        options.metaListener = metaListener_;
         CSErrorCode errorCode = CreateChunkFile(options, &chunkFile);
         if (errorCode != CSErrorCode::Success) {
             return errorCode;
@@ -247,9 +312,32 @@ CSErrorCode CSDataStore::WriteChunk(ChunkID id,
                      << "ChunkID = " << id;
         return errorCode;
     }
+    markDirty(id);
     return CSErrorCode::Success;
 }
 
+CSErrorCode CSDataStore::WriteChunk(ChunkID id,
+                            SequenceNum sn,
+                            const char * buf,
+                            off_t offset,
+                            size_t length,
+                            uint32_t* cost,
+                            const std::string & cloneSourceLocation)  {
+    return doWriteChunk(id, sn, buf, offset, length, cost,
+                        cloneSourceLocation);
+}
+
+CSErrorCode CSDataStore::WriteChunk(ChunkID id,
+                            SequenceNum sn,
+                            const butil::IOBuf& buf,
+                            off_t offset,
+                            size_t length,
+                            uint32_t* cost,
+                            const std::string & cloneSourceLocation)  {
+    return doWriteChunk(id, sn, buf, offset, length, cost,
+                        cloneSourceLocation);
+}
+
 CSErrorCode CSDataStore::CreateCloneChunk(ChunkID id,
                                           SequenceNum sn,
                                           SequenceNum correctedSn,
@@ -279,6 +367,13 @@ CSErrorCode CSDataStore::CreateCloneChunk(ChunkID id,
         options.chunkSize = chunkSize_;
         options.pageSize = pageSize_;
         options.metric = metric_;
+        options.syncWrite = syncWrite_;
+        options.directIO = directIO_;
+        options.batchBitmapFlush = batchBitmapFlush_;
+        options.trackWrittenPages = trackWrittenPages_;
+        options.fdCache = fdCache_;
+        options.readCache = readCache_;
+        options.metaListener = metaListener_;
         CSErrorCode errorCode = CreateChunkFile(options, &chunkFile);
         if (errorCode != CSErrorCode::Success) {
             return errorCode;
@@ -288,7 +383,12 @@ CSErrorCode CSDataStore::CreateCloneChunk(ChunkID id,
     // 不需要放到else当中，因为用户可能同时调用该接口
     // 参数中指定了不同版本或者位置信息，就可能并发冲突，也需要进行判断
     CSChunkInfo info;
-    chunkFile->GetInfo(&info);
+    CSErrorCode errorCode = chunkFile->GetInfo(&info);
+    if (errorCode != CSErrorCode::Success) {
+        LOG(WARNING) << "Get chunk info failed."
+                     << "ChunkID = " << id;
+        return errorCode;
+    }
     if (info.location.compare(location) != 0
         || info.curSn != sn
         || info.correctedSn != correctedSn) {
@@ -304,10 +404,11 @@ CSErrorCode CSDataStore::CreateCloneChunk(ChunkID id,
     return CSErrorCode::Success;
 }
 
-CSErrorCode CSDataStore::PasteChunk(ChunkID id,
-                                    const char * buf,
-                                    off_t offset,
-                                    size_t length) {
+template <typename Buffer>
+CSErrorCode CSDataStore::doPasteChunk(ChunkID id,
+                                      const Buffer& buf,
+                                      off_t offset,
+                                      size_t length) {
     auto chunkFile = metaCache_.Get(id);
     // Paste Chunk要求Chunk必须存在
     if (chunkFile == nullptr) {
@@ -317,13 +418,28 @@ CSErrorCode CSDataStore::PasteChunk(ChunkID id,
     }
     CSErrorCode errcode = chunkFile->Paste(buf, offset, length);
     if (errcode != CSErrorCode::Success) {
-        LOG(WARNING) << "Paste Chunk failed, Chunk not exists."
+        LOG(WARNING) << "Paste Chunk failed."
                      << "ChunkID = " << id;
         return errcode;
     }
+    markDirty(id);
     return CSErrorCode::Success;
 }
 
+CSErrorCode CSDataStore::PasteChunk(ChunkID id,
+                                    const char * buf,
+                                    off_t offset,
+                                    size_t length) {
+    return doPasteChunk(id, buf, offset, length);
+}
+
+CSErrorCode CSDataStore::PasteChunk(ChunkID id,
+                                    const butil::IOBuf& buf,
+                                    off_t offset,
+                                    size_t length) {
+    return doPasteChunk(id, buf, offset, length);
+}
+
 CSErrorCode CSDataStore::GetChunkInfo(ChunkID id,
                                       CSChunkInfo* chunkInfo) {
     auto chunkFile = metaCache_.Get(id);
@@ -332,8 +448,7 @@ CSErrorCode CSDataStore::GetChunkInfo(ChunkID id,
                   << "ChunkID = " << id;
         return CSErrorCode::ChunkNotExistError;
     }
-    chunkFile->GetInfo(chunkInfo);
-    return CSErrorCode::Success;
+    return chunkFile->GetInfo(chunkInfo);
 }
 
 CSErrorCode CSDataStore::GetChunkHash(ChunkID id,
@@ -354,9 +469,55 @@ DataStoreStatus CSDataStore::GetStatus() {
     status.chunkFileCount = metric_->chunkFileCount.get_value();
     status.cloneChunkCount = metric_->cloneChunkCount.get_value();
     status.snapshotCount = metric_->snapshotCount.get_value();
+    status.readCacheHitCount = metric_->readCacheHit.get_value();
+    status.readCacheMissCount = metric_->readCacheMiss.get_value();
     return status;
 }
 
+CSErrorCode CSDataStore::SyncChunkFiles() {
+    LockGuard syncGuard(syncMtx_);
+    std::unordered_set<ChunkID> dirtyChunks;
+    {
+        LockGuard lockGuard(dirtyMtx_);
+        dirtyChunks.swap(dirtyChunks_);
+    }
+    CSErrorCode errorCode = CSErrorCode::Success;
+    for (auto it = dirtyChunks.begin(); it != dirtyChunks.end();) {
+        auto chunkFile = metaCache_.Get(*it);
+        // chunk已经被删除，不需要刷盘
+        if (chunkFile != nullptr) {
+            errorCode = chunkFile->Sync();
+            if (errorCode != CSErrorCode::Success) {
+                LOG(ERROR) << "Sync chunk file failed."
+                           << "ChunkID = " << *it;
+                break;
+            }
+        }
+        it = dirtyChunks.erase(it);
+    }
+    // 未刷盘成功的chunk留到下次再刷
+    if (!dirtyChunks.empty()) {
+        LockGuard lockGuard(dirtyMtx_);
+        dirtyChunks_.insert(dirtyChunks.begin(), dirtyChunks.end());
+    }
+    // chunk的创建和删除是目录项的修改，需要fsync目录才能持久化
+    if (errorCode == CSErrorCode::Success &&
+        chunkfilePool_->SyncDirs() != 0) {
+        LOG(ERROR) << "Sync chunk dirs failed.";
+        errorCode = CSErrorCode::InternalError;
+    }
+    return errorCode;
+}
+
+void CSDataStore::markDirty(ChunkID id) {
+    // 同步写模式下只有批量持久化bitmap时才需要记录，由SyncChunkFiles写入bitmap
+    if (syncWrite_ && !batchBitmapFlush_) {
+        return;
+    }
+    LockGuard lockGuard(dirtyMtx_);
+    dirtyChunks_.insert(id);
+}
+
 CSErrorCode CSDataStore::loadChunkFile(ChunkID id) {
     // 如果chunk文件还未加载，则加载到metaCache当中
     if (metaCache_.Get(id) == nullptr) {
@@ -367,17 +528,101 @@ CSErrorCode CSDataStore::loadChunkFile(ChunkID id) {
         options.chunkSize = chunkSize_;
         options.pageSize = pageSize_;
         options.metric = metric_;
+        options.syncWrite = syncWrite_;
+        options.directIO = directIO_;
+        options.batchBitmapFlush = batchBitmapFlush_;
+        options.trackWrittenPages = trackWrittenPages_;
+        options.fdCache = fdCache_;
+        options.readCache = readCache_;
+        options.metaListener = metaListener_;
         CSChunkFilePtr chunkFilePtr =
             std::make_shared<CSChunkFile>(lfs_,
                                           chunkfilePool_,
                                           options);
-        CSErrorCode errorCode = chunkFilePtr->Open(false);
-        if (errorCode != CSErrorCode::Success)
-            return errorCode;
+        // 启用fd缓存时，chunk在首次访问时才打开文件并加载metapage
+        if (fdCache_ == nullptr) {
+            CSErrorCode errorCode = chunkFilePtr->Open(false);
+            if (errorCode != CSErrorCode::Success)
+                return errorCode;
+        } else if (manifest_ != nullptr) {
+            // 元数据还未加载，manifest中只记录chunk存在
+            ChunkManifestEntry entry;
+            entry.id = id;
+            manifest_->Put(entry);
+        }
         metaCache_.Set(id, chunkFilePtr);
     }
     return CSErrorCode::Success;
 }
 
+bool CSDataStore::loadFromManifest() {
+    DirStamp stamp;
+    if (ChunkManifest::GetDirStamp(lfs_, baseDir_, &stamp) != 0) {
+        return false;
+    }
+    std::vector<ChunkManifestEntry> entries;
+    if (manifest_->Load(stamp, &entries) != 0) {
+        return false;
+    }
+    for (const auto& entry : entries) {
+        ChunkOptions options;
+        options.id = entry.id;
+        options.sn = entry.sn;
+        options.correctedSn = entry.correctedSn;
+        options.location = entry.location;
+        options.baseDir = baseDir_;
+        options.chunkSize = chunkSize_;
+        options.pageSize = pageSize_;
+        options.metric = metric_;
+        options.syncWrite = syncWrite_;
+        options.directIO = directIO_;
+        options.batchBitmapFlush = batchBitmapFlush_;
+        options.trackWrittenPages = trackWrittenPages_;
+        options.fdCache = fdCache_;
+        options.readCache = readCache_;
+        options.metaListener = metaListener_;
+        // 存在快照或者需要加载bitmap时，仍然在首次访问时完整加载
+        options.metaLoaded = entry.metaValid
+                          && entry.snapSn == 0
+                          && !entry.hasBitmap;
+        CSChunkFilePtr chunkFilePtr =
+            std::make_shared<CSChunkFile>(lfs_,
+                                          chunkfilePool_,
+                                          options);
+        // 未启用fd缓存时chunk一直持有fd，需要在这里打开，
+        // 元数据有效的chunk只打开文件，不读metapage
+        if (fdCache_ == nullptr
+            && chunkFilePtr->Open(false) != CSErrorCode::Success) {
+            LOG(ERROR) << "Load chunk in manifest failed."
+                       << "ChunkID = " << entry.id;
+            return false;
+        }
+        metaCache_.Set(entry.id, chunkFilePtr);
+        if (entry.snapSn != 0
+            && chunkFilePtr->LoadSnapshot(entry.snapSn)
+               != CSErrorCode::Success) {
+            LOG(ERROR) << "Load snapshot in manifest failed."
+                       << "ChunkID = " << entry.id
+                       << ", snapshot sn = " << entry.snapSn;
+            return false;
+        }
+    }
+    return true;
+}
+
+CSErrorCode CSDataStore::SealManifest() {
+    if (manifest_ == nullptr) {
+        return CSErrorCode::Success;
+    }
+    DirStamp stamp;
+    if (ChunkManifest::GetDirStamp(lfs_, baseDir_, &stamp) != 0
+        || manifest_->Seal(stamp) != 0) {
+        LOG(WARNING) << "Seal chunk manifest failed, "
+                     << "it will not be used at next start.";
+        return CSErrorCode::InternalError;
+    }
+    return CSErrorCode::Success;
+}
+
 }  // namespace chunkserver
 }  // namespace curve
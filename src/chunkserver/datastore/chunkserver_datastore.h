@@ -24,10 +24,13 @@
 #define SRC_CHUNKSERVER_DATASTORE_CHUNKSERVER_DATASTORE_H_
 
 #include <bvar/bvar.h>
+#include <butil/iobuf.h>
 #include <glog/logging.h>
 #include <string>
 #include <vector>
+#include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
 
 #include "include/curve_compiler_specific.h"
@@ -43,6 +46,8 @@ namespace curve {
 namespace chunkserver {
 using curve::fs::LocalFileSystem;
 using ::curve::common::Atomic;
+using ::curve::common::Mutex;
+using ::curve::common::LockGuard;
 using CSChunkFilePtr = std::shared_ptr<CSChunkFile>;
 
 /**
@@ -50,12 +55,31 @@ using CSChunkFilePtr = std::shared_ptr<CSChunkFile>;
  * baseDir:DataStore管理的目录路径
  * chunkSize:DataStore中chunk文件或快照文件的大小
  * pageSize:最小读写单元的大小
+ * syncWrite:为true时每次写都同步落盘；为false时写入只进入pagecache，
+ *           由上层调用SyncChunkFiles批量刷盘
+ * directIO:为true时以O_DIRECT方式读写chunk文件和快照文件
+ * fdCache:chunkserver共享的fd缓存，不为空时chunk文件在首次访问时才打开，
+ *         并且同时打开的文件数受缓存容量限制
+ * manifestPath:chunk元数据清单的路径，为空表示不使用manifest，
+ *              不能放在baseDir下，否则会被当作chunk数据
+ * batchBitmapFlush:为true时clone chunk的bitmap变化不立即写入metapage，
+ *                  由SyncChunkFiles批量写入，上层需要保证能通过回放日志重建
+ * trackWrittenPages:为true时新创建的chunk也用bitmap记录page是否被写过，
+ *                   读未写过的page直接返回0，chunkfilepool中的文件不需要写零
+ * readCache:chunkserver共享的数据读缓存，为空时不缓存
  */
 struct DataStoreOptions {
     std::string                         baseDir;
     ChunkSizeType                       chunkSize;
     PageSizeType                        pageSize;
     uint32_t                            locationLimit;
+    bool                                syncWrite = true;
+    bool                                directIO = false;
+    std::shared_ptr<ChunkFdCache>       fdCache = nullptr;
+    std::string                         manifestPath;
+    bool                                batchBitmapFlush = false;
+    bool                                trackWrittenPages = false;
+    std::shared_ptr<ChunkReadCache>     readCache = nullptr;
 };
 
 /**
@@ -63,14 +87,20 @@ struct DataStoreOptions {
  * chunkFileCount:DataStore中chunk的数量
  * snapshotCount:DataStore中快照的数量
  * cloneChunkCount:clone chunk的数量
+ * readCacheHitCount:读缓存命中的page数
+ * readCacheMissCount:读缓存未命中的page数
  */
 struct DataStoreStatus {
     uint32_t chunkFileCount;
     uint32_t snapshotCount;
     uint32_t cloneChunkCount;
+    uint64_t readCacheHitCount;
+    uint64_t readCacheMissCount;
     DataStoreStatus() : chunkFileCount(0)
                     , snapshotCount(0)
-                    , cloneChunkCount(0) {}
+                    , cloneChunkCount(0)
+                    , readCacheHitCount(0)
+                    , readCacheMissCount(0) {}
 };
 
 /**
@@ -78,58 +108,103 @@ struct DataStoreStatus {
  * chunkFileCount:DataStore中chunk的数量
  * snapshotCount:DataStore中快照的数量
  * cloneChunkCount:clone chunk的数量
+ * readCacheHit/readCacheMiss:读缓存命中和未命中的page数
  */
 struct DataStoreMetric {
     bvar::Adder<uint32_t> chunkFileCount;
     bvar::Adder<uint32_t> snapshotCount;
     bvar::Adder<uint32_t> cloneChunkCount;
+    bvar::Adder<uint64_t> readCacheHit;
+    bvar::Adder<uint64_t> readCacheMiss;
 };
 using DataStoreMetricPtr = std::shared_ptr<DataStoreMetric>;
 
 using ChunkMap = std::unordered_map<ChunkID, CSChunkFilePtr>;
-// 为chunkid到chunkfile的映射，使用读写锁对map的操作进行保护
+/**
+ * 为chunkid到chunkfile的映射
+ * 按chunkid分成多个分片，每个分片使用独立的读写锁保护，
+ * 不同chunk的操作基本不会竞争同一把锁
+ */
 class CSMetaCache {
  public:
+    // 分片数为2的kShardBits次幂
+    static const uint32_t kShardBits = 6;
+    static const uint32_t kShardNum = 1 << kShardBits;
+
     CSMetaCache() {}
     virtual ~CSMetaCache() {}
 
-    ChunkMap GetMap() {
-        ReadLockGuard readGuard(rwLock_);
-        return chunkMap_;
-    }
-
     CSChunkFilePtr Get(ChunkID id) {
-        ReadLockGuard readGuard(rwLock_);
-        if (chunkMap_.find(id) == chunkMap_.end()) {
+        Shard& shard = getShard(id);
+        ReadLockGuard readGuard(shard.rwLock);
+        auto iter = shard.chunkMap.find(id);
+        if (iter == shard.chunkMap.end()) {
             return nullptr;
         }
-        return chunkMap_[id];
+        return iter->second;
     }
 
     CSChunkFilePtr Set(ChunkID id, CSChunkFilePtr chunkFile) {
-        WriteLockGuard writeGuard(rwLock_);
+        Shard& shard = getShard(id);
+        WriteLockGuard writeGuard(shard.rwLock);
         // 当两个写请求并发去创建chunk文件时，返回先Set的chunkFile
-        if (chunkMap_.find(id) == chunkMap_.end()) {
-            chunkMap_[id] = chunkFile;
-        }
-        return chunkMap_[id];
+        auto ret = shard.chunkMap.emplace(id, chunkFile);
+        return ret.first->second;
     }
 
     void Remove(ChunkID id) {
-        WriteLockGuard writeGuard(rwLock_);
-        if (chunkMap_.find(id) != chunkMap_.end()) {
-            chunkMap_.erase(id);
-        }
+        Shard& shard = getShard(id);
+        WriteLockGuard writeGuard(shard.rwLock);
+        shard.chunkMap.erase(id);
     }
 
     void Clear() {
-        WriteLockGuard writeGuard(rwLock_);
-        chunkMap_.clear();
+        for (uint32_t i = 0; i < kShardNum; ++i) {
+            WriteLockGuard writeGuard(shards_[i].rwLock);
+            shards_[i].chunkMap.clear();
+        }
+    }
+
+    /**
+     * 遍历所有chunk，不拷贝整个map
+     * 遍历某个分片时持有该分片的读锁，func中不能修改metacache
+     * 遍历过程中其他分片可能发生变化，不保证是某一时刻的快照
+     */
+    void ForEach(const std::function<void(ChunkID,
+                                          const CSChunkFilePtr&)>& func) {
+        for (uint32_t i = 0; i < kShardNum; ++i) {
+            ReadLockGuard readGuard(shards_[i].rwLock);
+            for (const auto& item : shards_[i].chunkMap) {
+                func(item.first, item.second);
+            }
+        }
+    }
+
+    uint64_t Size() {
+        uint64_t size = 0;
+        for (uint32_t i = 0; i < kShardNum; ++i) {
+            ReadLockGuard readGuard(shards_[i].rwLock);
+            size += shards_[i].chunkMap.size();
+        }
+        return size;
     }
 
  private:
-    RWLock      rwLock_;
-    ChunkMap    chunkMap_;
+    struct Shard {
+        RWLock      rwLock;
+        ChunkMap    chunkMap;
+        // 避免相邻分片的锁落在同一个cache line上
+        char        padding[64];
+    };
+
+    Shard& getShard(ChunkID id) {
+        // chunkid在copyset内不连续，乘法散列后取高位使分布更均匀
+        uint64_t hash = id * 0x9E3779B97F4A7C15ULL;
+        return shards_[hash >> (64 - kShardBits)];
+    }
+
+ private:
+    Shard shards_[kShardNum];
 };
 
 class CSDataStore {
@@ -144,6 +219,7 @@ class CSDataStore {
     /**
      * copyset初始化时调用
      * 初始化时遍历当前copyset目录下的所有文件，读取metapage加载到metacache
+     * 启用manifest并且manifest有效时，直接从manifest加载，不遍历目录
      * @return：成功返回true，失败返回false
      */
     virtual bool Initialize();
@@ -178,6 +254,28 @@ class CSDataStore {
                                   char * buf,
                                   off_t offset,
                                   size_t length);
+    /**
+     * 异步读当前chunk的内容
+     * 本地文件系统不支持异步IO时，在调用线程中同步读完后调用done
+     * buf在done被调用前必须保持有效
+     * @param id：要读取的chunk id
+     * @param sn：用于记录trace，实际逻辑处理用不到，表示当前用户文件的版本号
+     * @param buf：读取到的数据内容
+     * @param offset：请求读取的数据在chunk中的逻辑偏移
+     * @param length：请求读取的数据长度
+     * @param done：读完成时的回调，参数为错误码
+     */
+    virtual void ReadChunkAsync(ChunkID id,
+                                SequenceNum sn,
+                                char * buf,
+                                off_t offset,
+                                size_t length,
+                                CSIOCallback done);
+    /**
+     * 本地文件系统是否支持真正的异步IO
+     * @return 支持返回true，否则返回false
+     */
+    virtual bool SupportAsyncIO();
     /**
      * 读指定版本的数据，可能读当前chunk文件，也有可能读快照文件
      * @param id：要读取的chunk id
@@ -210,6 +308,25 @@ class CSDataStore {
                                 size_t length,
                                 uint32_t* cost,
                                 const std::string & cloneSourceLocation = "");
+    /**
+     * 写数据，数据以IOBuf形式传入，直接将IOBuf的block写入chunk文件
+     * 避免将数据拷贝到一段连续内存，其余语义与上面的接口相同
+     * @param id：要写入的chunk id
+     * @param sn：当前写请求发出时用户文件的版本号
+     * @param buf：要写入的数据内容
+     * @param offset：请求写入的偏移地址
+     * @param length：请求写入的数据长度
+     * @param cost：实际产生的IO次数，用于QOS控制
+     * @param cloneSource：表示从curvefs clone的地址
+     * @return：返回错误码
+     */
+    virtual CSErrorCode WriteChunk(ChunkID id,
+                                SequenceNum sn,
+                                const butil::IOBuf& buf,
+                                off_t offset,
+                                size_t length,
+                                uint32_t* cost,
+                                const std::string & cloneSourceLocation = "");
     /**
      * 创建克隆的Chunk，chunk中记录数据源位置信息
      * 该接口需要保证幂等性，重复以相同参数进行创建返回成功
@@ -238,6 +355,18 @@ class CSDataStore {
                                    const char* buf,
                                    off_t offset,
                                    size_t length);
+    /**
+     * 将从源端拷贝的数据写到本地，数据以IOBuf形式传入
+     * @param id：要写入的chunk id
+     * @param buf：要写入的数据内容
+     * @param offset：请求写入的偏移地址
+     * @param length：请求写入的数据长度
+     * @return：返回错误码
+     */
+    virtual CSErrorCode PasteChunk(ChunkID id,
+                                   const butil::IOBuf& buf,
+                                   off_t offset,
+                                   size_t length);
     /**
      * 获取Chunk的详细信息
      * @param id：请求获取的chunk的id
@@ -261,10 +390,43 @@ class CSDataStore {
      */
     virtual DataStoreStatus GetStatus();
 
+    /**
+     * 将上次调用以来被写过的chunk文件刷盘，包括延迟写入的clone chunk bitmap
+     * 返回成功时，调用前已经完成的写入以及chunk的创建和删除都已经持久化
+     * @return: 返回错误码
+     */
+    virtual CSErrorCode SyncChunkFiles();
+
+    /**
+     * 封存manifest，copyset正常退出并且数据已经刷盘后调用
+     * 下次初始化时如果数据目录没有变化，可以直接从manifest加载
+     * @return: 返回错误码
+     */
+    virtual CSErrorCode SealManifest();
+
  private:
     CSErrorCode loadChunkFile(ChunkID id);
+    // 从manifest加载chunk，manifest无效或者加载失败返回false
+    bool loadFromManifest();
     CSErrorCode CreateChunkFile(const ChunkOptions & ops,
                                 CSChunkFilePtr* chunkFile);
+    // 非同步写模式下记录被写过的chunk，等待SyncChunkFiles刷盘
+    void markDirty(ChunkID id);
+    // 两个WriteChunk接口的公共流程，buf为char*或者IOBuf
+    template <typename Buffer>
+    CSErrorCode doWriteChunk(ChunkID id,
+                             SequenceNum sn,
+                             const Buffer& buf,
+                             off_t offset,
+                             size_t length,
+                             uint32_t* cost,
+                             const std::string & cloneSourceLocation);
+    // 两个PasteChunk接口的公共流程，buf为char*或者IOBuf
+    template <typename Buffer>
+    CSErrorCode doPasteChunk(ChunkID id,
+                             const Buffer& buf,
+                             off_t offset,
+                             size_t length);
 
  private:
     // 每个chunk的大小
@@ -283,6 +445,27 @@ class CSDataStore {
     std::shared_ptr<LocalFileSystem>        lfs_;
     // datastore的内部统计信息
     DataStoreMetricPtr metric_;
+    // 是否以O_DSYNC方式写chunk文件
+    bool syncWrite_;
+    // 是否以O_DIRECT方式读写chunk文件
+    bool directIO_;
+    // 是否批量持久化clone chunk的bitmap
+    bool batchBitmapFlush_;
+    // 新创建的chunk是否记录page的写入状态
+    bool trackWrittenPages_;
+    // chunkserver共享的fd缓存
+    std::shared_ptr<ChunkFdCache> fdCache_;
+    // chunkserver共享的数据读缓存
+    std::shared_ptr<ChunkReadCache> readCache_;
+    // chunk元数据清单，为空表示不使用
+    std::shared_ptr<ChunkManifest> manifest_;
+    // chunk元数据变化时更新manifest
+    std::function<void(const ChunkManifestEntry&)> metaListener_;
+    // 写入后还未刷盘的chunk
+    std::unordered_set<ChunkID> dirtyChunks_;
+    Mutex dirtyMtx_;
+    // 串行化SyncChunkFiles，保证并发调用时返回前其他调用取走的chunk也已刷盘
+    Mutex syncMtx_;
 };
 
 }  // namespace chunkserver
@@ -114,7 +114,9 @@ CSSnapshot::CSSnapshot(std::shared_ptr<LocalFileSystem> lfs,
       baseDir_(options.baseDir),
       lfs_(lfs),
       chunkfilePool_(chunkfilePool),
-      metric_(options.metric) {
+      metric_(options.metric),
+      syncWrite_(options.syncWrite),
+      directIO_(options.directIO) {
     CHECK(!baseDir_.empty()) << "Create snapshot failed";
     CHECK(lfs_ != nullptr) << "Create snapshot failed";
     uint32_t bits = size_ / pageSize_;
@@ -153,15 +155,12 @@ CSErrorCode CSSnapshot::Open(bool createFile) {
             return CSErrorCode::InternalError;
         }
     }
-    int rc = lfs_->Open(snapshotPath, O_RDWR|O_NOATIME|O_DSYNC);
-    if (rc < 0) {
-        LOG(ERROR) << "Error occured when opening file."
-                   << " filepath = "<< snapshotPath;
-        return CSErrorCode::InternalError;
+    CSErrorCode errorCode = OpenFd();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
     }
-    fd_ = rc;
     struct stat fileInfo;
-    rc = lfs_->Fstat(fd_, &fileInfo);
+    int rc = lfs_->Fstat(fd_, &fileInfo);
     if (rc < 0) {
         LOG(ERROR) << "Error occured when stating file."
                    << " filepath = " << snapshotPath;
@@ -176,6 +175,32 @@ CSErrorCode CSSnapshot::Open(bool createFile) {
     return loadMetaPage();
 }
 
+CSErrorCode CSSnapshot::OpenFd() {
+    string snapshotPath = path();
+    int flags = O_RDWR|O_NOATIME;
+    if (syncWrite_) {
+        flags |= O_DSYNC;
+    }
+    if (directIO_) {
+        flags |= O_DIRECT;
+    }
+    int rc = lfs_->Open(snapshotPath, flags);
+    if (rc < 0) {
+        LOG(ERROR) << "Error occured when opening file."
+                   << " filepath = "<< snapshotPath;
+        return CSErrorCode::InternalError;
+    }
+    fd_ = rc;
+    return CSErrorCode::Success;
+}
+
+void CSSnapshot::CloseFd() {
+    if (fd_ >= 0) {
+        lfs_->Close(fd_);
+        fd_ = -1;
+    }
+}
+
 CSErrorCode CSSnapshot::Read(char * buf, off_t offset, size_t length) {
     // TODO(yyk) 是否需要对比偏移对应bit状态
     int rc = readData(buf, offset, length);
@@ -235,29 +260,54 @@ CSErrorCode CSSnapshot::Flush() {
 }
 
 CSErrorCode CSSnapshot::updateMetaPage(SnapshotMetaPage* metaPage) {
-    char buf[pageSize_];  // NOLINT
-    memset(buf, 0, sizeof(buf));
-    metaPage->encode(buf);
-    int rc = writeMetaPage(buf);
+    CSErrorCode errorCode = syncBarrier();
+    if (errorCode != CSErrorCode::Success) {
+        return errorCode;
+    }
+    // metapage使用对齐的内存，O_DIRECT方式下可以直接写入
+    AlignedBuffer buf = AlignedBufferPool::Get(pageSize_);
+    if (nullptr == buf.Data()) {
+        return CSErrorCode::InternalError;
+    }
+    memset(buf.Data(), 0, pageSize_);
+    metaPage->encode(buf.Data());
+    int rc = writeMetaPage(buf.Data());
     if (rc < 0) {
         LOG(ERROR) << "Update metapage failed."
                    << "ChunkID: " << chunkId_
                    << ",snapshot sn: " << metaPage_.sn;
         return CSErrorCode::InternalError;
     }
+    return syncBarrier();
+}
+
+CSErrorCode CSSnapshot::syncBarrier() {
+    if (syncWrite_) {
+        return CSErrorCode::Success;
+    }
+    int rc = lfs_->Fdatasync(fd_);
+    if (rc < 0) {
+        LOG(ERROR) << "Sync snapshot failed."
+                   << "ChunkID: " << chunkId_
+                   << ",snapshot sn: " << metaPage_.sn;
+        return CSErrorCode::InternalError;
+    }
     return CSErrorCode::Success;
 }
 
 CSErrorCode CSSnapshot::loadMetaPage() {
-    char buf[pageSize_];  // NOLINT
-    memset(buf, 0, sizeof(buf));
-    int rc = readMetaPage(buf);
+    AlignedBuffer buf = AlignedBufferPool::Get(pageSize_);
+    if (nullptr == buf.Data()) {
+        return CSErrorCode::InternalError;
+    }
+    memset(buf.Data(), 0, pageSize_);
+    int rc = readMetaPage(buf.Data());
     if (rc < 0) {
         LOG(ERROR) << "Error occured when reading metaPage_."
                    << " filepath = " << path();
         return CSErrorCode::InternalError;
     }
-    return metaPage_.decode(buf);
+    return metaPage_.decode(buf.Data());
 }
 
 }  // namespace chunkserver
@@ -34,12 +34,15 @@
 #include "src/chunkserver/datastore/define.h"
 #include "src/fs/local_filesystem.h"
 #include "src/chunkserver/datastore/chunkfile_pool.h"
+#include "src/chunkserver/datastore/direct_io.h"
 
 namespace curve {
 namespace chunkserver {
 
 using curve::common::Bitmap;
 using curve::fs::LocalFileSystem;
+using curve::common::AlignedBuffer;
+using curve::common::AlignedBufferPool;
 
 class ChunkfilePool;
 class CSChunkFile;
@@ -125,6 +128,22 @@ class CSSnapshot {
      * @return: 返回位图表
      */
     std::shared_ptr<const Bitmap> GetPageStatus() const;
+    /**
+     * 打开快照文件的fd，Open成功后fd被CloseFd关闭时调用
+     * 只打开文件，不重新加载metapage
+     * @return: 返回错误码
+     */
+    CSErrorCode OpenFd();
+    /**
+     * 关闭快照文件的fd，metapage仍保留在内存中
+     */
+    void CloseFd();
+    /**
+     * fd是否处于打开状态
+     */
+    bool IsFdOpened() const {
+        return fd_ >= 0;
+    }
 
  private:
     /**
@@ -134,6 +153,11 @@ class CSSnapshot {
      *                 如果失败，则不会更改
      */
     CSErrorCode updateMetaPage(SnapshotMetaPage* metaPage);
+    /**
+     * 非同步写模式下将快照文件在pagecache中的数据刷盘
+     * cow的数据要先于bitmap落盘，bitmap要先于chunk文件的覆盖写落盘
+     */
+    CSErrorCode syncBarrier();
     /**
      * 将metapage加载到内存
      */
@@ -148,20 +172,34 @@ class CSSnapshot {
         return pageSize_ + size_;
     }
 
+    inline int readFile(char* buf, off_t offset, size_t length) {
+        if (directIO_) {
+            return DirectIOHelper::Read(lfs_.get(), fd_, buf, offset, length);
+        }
+        return lfs_->Read(fd_, buf, offset, length);
+    }
+
+    inline int writeFile(const char* buf, off_t offset, size_t length) {
+        if (directIO_) {
+            return DirectIOHelper::Write(lfs_.get(), fd_, buf, offset, length);
+        }
+        return lfs_->Write(fd_, buf, offset, length);
+    }
+
     inline int readMetaPage(char* buf) {
-        return lfs_->Read(fd_, buf, 0, pageSize_);
+        return readFile(buf, 0, pageSize_);
     }
 
     inline int writeMetaPage(const char* buf) {
-        return lfs_->Write(fd_, buf, 0, pageSize_);
+        return writeFile(buf, 0, pageSize_);
     }
 
     inline int readData(char* buf, off_t offset, size_t length) {
-        return lfs_->Read(fd_, buf, offset + pageSize_, length);
+        return readFile(buf, offset + pageSize_, length);
     }
 
     inline int writeData(const char* buf, off_t offset, size_t length) {
-        return lfs_->Write(fd_, buf, offset + pageSize_, length);
+        return writeFile(buf, offset + pageSize_, length);
     }
 
  private:
@@ -185,6 +223,10 @@ class CSSnapshot {
     std::shared_ptr<ChunkfilePool> chunkfilePool_;
     // datastore内部统计指标
     std::shared_ptr<DataStoreMetric> metric_;
+    // 是否以O_DSYNC方式写文件
+    bool syncWrite_;
+    // 是否以O_DIRECT方式读写文件
+    bool directIO_;
 };
 
 }  // namespace chunkserver
@@ -25,6 +25,7 @@
 
 #include <string>
 #include <memory>
+#include <functional>
 
 #include "include/chunkserver/chunkserver_common.h"
 #include "src/common/bitmap.h"
@@ -35,6 +36,8 @@ namespace chunkserver {
 using curve::common::Bitmap;
 
 const uint8_t FORMAT_VERSION = 1;
+// 非clone chunk的metapage中也记录page写入状态时使用的格式版本
+const uint8_t FORMAT_VERSION_V2 = 2;
 const SequenceNum kInvalidSeq = 0;
 
 // define error code
@@ -69,6 +72,9 @@ enum CSErrorCode {
     PageNerverWrittenError = 13,
 };
 
+// 异步读写chunk完成时的回调，参数为操作的错误码
+using CSIOCallback = std::function<void(CSErrorCode)>;
+
 // Chunk的详细信息
 struct CSChunkInfo {
     // chunk的id
@@ -0,0 +1,179 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <glog/logging.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "src/chunkserver/datastore/direct_io.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::common::AlignedBuffer;
+using curve::common::AlignedBufferPool;
+using curve::common::kDirectIOAlignment;
+using curve::common::IsAlignedTo;
+using curve::common::AlignDown;
+using curve::common::AlignUp;
+
+namespace {
+
+// 读取一个完整的对齐块，文件末尾之后的部分补零
+int ReadBlock(LocalFileSystem* lfs, int fd, char* buf, uint64_t offset) {
+    int rc = lfs->Read(fd, buf, offset, kDirectIOAlignment);
+    if (rc < 0) {
+        return rc;
+    }
+    if (static_cast<size_t>(rc) < kDirectIOAlignment) {
+        memset(buf + rc, 0, kDirectIOAlignment - rc);
+    }
+    return 0;
+}
+
+}  // namespace
+
+bool DirectIOHelper::IsAligned(const void* buf,
+                               uint64_t offset,
+                               size_t length) {
+    return IsAlignedTo(reinterpret_cast<uintptr_t>(buf), kDirectIOAlignment)
+        && IsAlignedTo(offset, kDirectIOAlignment)
+        && IsAlignedTo(length, kDirectIOAlignment);
+}
+
+int DirectIOHelper::Read(LocalFileSystem* lfs,
+                         int fd,
+                         char* buf,
+                         uint64_t offset,
+                         size_t length) {
+    if (IsAligned(buf, offset, length)) {
+        return lfs->Read(fd, buf, offset, length);
+    }
+
+    uint64_t alignedOff = AlignDown(offset, kDirectIOAlignment);
+    size_t alignedLen =
+        AlignUp(offset + length, kDirectIOAlignment) - alignedOff;
+    AlignedBuffer tmp = AlignedBufferPool::Get(alignedLen);
+    if (tmp.Data() == nullptr) {
+        LOG(ERROR) << "Allocate aligned buffer failed, size: " << alignedLen;
+        return -ENOMEM;
+    }
+    int rc = lfs->Read(fd, tmp.Data(), alignedOff, alignedLen);
+    if (rc < 0) {
+        return rc;
+    }
+    size_t head = offset - alignedOff;
+    if (static_cast<size_t>(rc) <= head) {
+        return 0;
+    }
+    size_t readLen = std::min(length, rc - head);
+    memcpy(buf, tmp.Data() + head, readLen);
+    return readLen;
+}
+
+int DirectIOHelper::Write(LocalFileSystem* lfs,
+                          int fd,
+                          const char* buf,
+                          uint64_t offset,
+                          size_t length) {
+    if (IsAligned(buf, offset, length)) {
+        int rc = lfs->Write(fd, buf, offset, length);
+        return rc < 0 ? rc : length;
+    }
+
+    uint64_t alignedOff = AlignDown(offset, kDirectIOAlignment);
+    uint64_t alignedEnd = AlignUp(offset + length, kDirectIOAlignment);
+    size_t alignedLen = alignedEnd - alignedOff;
+    AlignedBuffer tmp = AlignedBufferPool::Get(alignedLen);
+    if (tmp.Data() == nullptr) {
+        LOG(ERROR) << "Allocate aligned buffer failed, size: " << alignedLen;
+        return -ENOMEM;
+    }
+
+    // 首尾不完整的块需要先读出原有数据
+    int rc = 0;
+    if (offset != alignedOff) {
+        rc = ReadBlock(lfs, fd, tmp.Data(), alignedOff);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+    uint64_t lastBlockOff = alignedEnd - kDirectIOAlignment;
+    if (offset + length != alignedEnd
+        && (lastBlockOff != alignedOff || offset == alignedOff)) {
+        rc = ReadBlock(lfs, fd, tmp.Data() + (lastBlockOff - alignedOff),
+                       lastBlockOff);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    memcpy(tmp.Data() + (offset - alignedOff), buf, length);
+    rc = lfs->Write(fd, tmp.Data(), alignedOff, alignedLen);
+    return rc < 0 ? rc : length;
+}
+
+int DirectIOHelper::Write(LocalFileSystem* lfs,
+                          int fd,
+                          const butil::IOBuf& buf,
+                          uint64_t offset,
+                          size_t length) {
+    if (IsAlignedTo(offset, kDirectIOAlignment)
+        && IsAlignedTo(length, kDirectIOAlignment)) {
+        std::vector<struct iovec> iov;
+        iov.reserve(buf.backing_block_num());
+        size_t remain = length;
+        bool aligned = true;
+        for (size_t i = 0; i < buf.backing_block_num() && remain > 0; ++i) {
+            butil::StringPiece block = buf.backing_block(i);
+            struct iovec vec;
+            vec.iov_base = const_cast<char*>(block.data());
+            vec.iov_len = std::min(remain, block.size());
+            if (!IsAligned(vec.iov_base, 0, vec.iov_len)) {
+                aligned = false;
+                break;
+            }
+            iov.push_back(vec);
+            remain -= vec.iov_len;
+        }
+        if (aligned) {
+            int rc = lfs->Writev(fd, iov.data(), iov.size(), offset);
+            return rc < 0 ? rc : length;
+        }
+    }
+
+    // 拷贝到对齐的内存后再写入，偏移或长度不对齐时由Write处理首尾的块
+    AlignedBuffer tmp = AlignedBufferPool::Get(length);
+    if (tmp.Data() == nullptr) {
+        LOG(ERROR) << "Allocate aligned buffer failed, size: " << length;
+        return -ENOMEM;
+    }
+    buf.copy_to(tmp.Data(), length);
+    return Write(lfs, fd, tmp.Data(), offset, length);
+}
+
+}  // namespace chunkserver
+}  // namespace curve
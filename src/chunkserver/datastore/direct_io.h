@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_DATASTORE_DIRECT_IO_H_
+#define SRC_CHUNKSERVER_DATASTORE_DIRECT_IO_H_
+
+#include <butil/iobuf.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "src/common/aligned_buffer_pool.h"
+#include "src/fs/local_filesystem.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::fs::LocalFileSystem;
+
+/**
+ * 对以O_DIRECT方式打开的文件进行读写
+ * 内存地址、偏移和长度都按kDirectIOAlignment对齐的请求直接下发；
+ * 否则借助AlignedBufferPool中的对齐内存中转:
+ * 1.内存地址不对齐时，先拷贝到对齐内存
+ * 2.偏移或长度不对齐时，读出首尾不完整的块，修改后整块写回
+ * 第2种情况是读-改-写，调用者需要保证同一个文件的写请求之间互斥
+ * （chunk和快照文件的写都在chunk的写锁下进行）
+ */
+class DirectIOHelper {
+ public:
+    /**
+     * 判断请求是否可以直接以O_DIRECT方式下发
+     */
+    static bool IsAligned(const void* buf, uint64_t offset, size_t length);
+
+    /**
+     * 读取数据，返回值同LocalFileSystem::Read
+     */
+    static int Read(LocalFileSystem* lfs, int fd, char* buf,
+                    uint64_t offset, size_t length);
+
+    /**
+     * 写入数据，成功返回写入的长度length，失败返回负值
+     */
+    static int Write(LocalFileSystem* lfs, int fd, const char* buf,
+                     uint64_t offset, size_t length);
+
+    /**
+     * 写入IOBuf的前length字节，成功返回length，失败返回负值
+     * IOBuf的所有block都对齐时直接以Writev写入，否则拷贝到对齐内存
+     */
+    static int Write(LocalFileSystem* lfs, int fd, const butil::IOBuf& buf,
+                     uint64_t offset, size_t length);
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_DATASTORE_DIRECT_IO_H_
@@ -27,13 +27,20 @@
 #include <butil/sys_byteorder.h>
 #include <brpc/closure_guard.h>
 
+#include <stdlib.h>
+
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "src/common/aligned_buffer_pool.h"
 #include "src/chunkserver/copyset_node.h"
 #include "src/chunkserver/chunk_closure.h"
 #include "src/chunkserver/clone_manager.h"
 #include "src/chunkserver/clone_task.h"
+#include "src/chunkserver/propose_batcher.h"
 
 namespace curve {
 namespace chunkserver {
@@ -44,7 +51,11 @@ ChunkOpRequest::ChunkOpRequest() :
     cntl_(nullptr),
     request_(nullptr),
     response_(nullptr),
-    done_(nullptr) {
+    done_(nullptr),
+    applyFromLog_(false),
+    applyIndex_(0),
+    applyDone_(nullptr),
+    logNode_(nullptr) {
 }
 
 ChunkOpRequest::ChunkOpRequest(std::shared_ptr<CopysetNode> nodePtr,
@@ -57,7 +68,53 @@ ChunkOpRequest::ChunkOpRequest(std::shared_ptr<CopysetNode> nodePtr,
     cntl_(dynamic_cast<brpc::Controller *>(cntl)),
     request_(request),
     response_(response),
-    done_(done) {
+    done_(done),
+    applyFromLog_(false),
+    applyIndex_(0),
+    applyDone_(nullptr),
+    logNode_(nullptr) {
+}
+
+ApplyTask* ChunkOpRequest::PrepareApply(uint64_t index,
+                                        ::google::protobuf::Closure *done) {
+    applySelf_ = shared_from_this();
+    applyFromLog_ = false;
+    applyIndex_ = index;
+    applyDone_ = done;
+    return this;
+}
+
+ApplyTask* ChunkOpRequest::PrepareApplyFromLog(
+    CopysetNode *node,
+    uint64_t index,
+    std::shared_ptr<CSDataStore> datastore,
+    ChunkRequest *request,
+    butil::IOBuf *data) {
+    applySelf_ = shared_from_this();
+    applyFromLog_ = true;
+    applyIndex_ = index;
+    logNode_ = node;
+    logDataStore_ = datastore;
+    logRequest_.Swap(request);
+    logData_.swap(*data);
+    return this;
+}
+
+void ChunkOpRequest::Run() {
+    // 局部变量持有引用，保证apply返回之前request不会析构
+    std::shared_ptr<ChunkOpRequest> self = std::move(applySelf_);
+    if (applyFromLog_) {
+        OnApplyFromLog(logDataStore_, logRequest_, logData_);
+        FinishApplyFromLog();
+    } else {
+        OnApply(applyIndex_, applyDone_);
+    }
+}
+
+void ChunkOpRequest::FinishApplyFromLog() {
+    if (logNode_ != nullptr) {
+        logNode_->UpdateAppliedIndex(applyIndex_);
+    }
 }
 
 void ChunkOpRequest::Process() {
@@ -87,21 +144,97 @@ int ChunkOpRequest::Propose(const ChunkRequest *request,
         response_->set_status(CHUNK_OP_STATUS::CHUNK_OP_STATUS_FAILURE_UNKNOWN);
         return -1;
     }
-    task.data = &log;
-    task.done = new ChunkClosure(shared_from_this());
     /**
      * 由于apply是异步的，有可能某个节点在term1是leader，apply了一条log，
      * 但是中间发生了主从切换，在很短的时间内这个节点又变为term3的leader，
      * 之前apply的日志才开始进行处理，这种情况下要实现严格意义上的复制状态
      * 机，需要解决这种ABA问题，可以在apply的时候设置leader当时的term
      */
-    task.expected_term = node_->LeaderTerm();
+    int64_t term = node_->LeaderTerm();
+
+    // 小写请求交给batcher，与同一copyset上相邻的写请求合并成一条日志
+    ProposeBatcher *batcher = node_->GetProposeBatcher();
+    if (nullptr != batcher
+        && request->optype() == CHUNK_OP_TYPE::CHUNK_OP_WRITE
+        && batcher->Accept(log.size())) {
+        batcher->Propose(shared_from_this(), &log, term);
+        return 0;
+    }
+
+    task.data = &log;
+    task.done = new ChunkClosure(shared_from_this());
+    task.expected_term = term;
 
     node_->Propose(task);
 
     return 0;
 }
 
+void ChunkOpRequest::ProposeBatch(
+    const std::vector<std::shared_ptr<ChunkOpRequest>> &requests) {
+    if (requests.empty()) {
+        return;
+    }
+    if (requests.size() == 1) {
+        requests[0]->Process();
+        return;
+    }
+
+    std::shared_ptr<CopysetNode> node = requests[0]->node_;
+    // 没有开启copyset.enable_propose_batch时，复制组内可能还有不能解析
+    // 合并日志的chunkserver，逐个propose
+    if (nullptr == node->GetProposeBatcher()) {
+        for (const auto &request : requests) {
+            request->Process();
+        }
+        return;
+    }
+    if (!node->IsLeaderTerm()) {
+        for (const auto &request : requests) {
+            brpc::ClosureGuard doneGuard(request->done_);
+            request->RedirectChunkRequest();
+        }
+        return;
+    }
+    int64_t term = node->LeaderTerm();
+
+    std::vector<butil::IOBuf> logs;
+    std::vector<ChunkClosure *> closures;
+    logs.reserve(requests.size());
+    closures.reserve(requests.size());
+    for (const auto &request : requests) {
+        butil::IOBuf log;
+        if (0 != Encode(request->request_,
+                        &request->cntl_->request_attachment(),
+                        &log)) {
+            LOG(ERROR) << "chunk op request encode failure";
+            brpc::ClosureGuard doneGuard(request->done_);
+            request->response_->set_status(
+                CHUNK_OP_STATUS::CHUNK_OP_STATUS_FAILURE_UNKNOWN);
+            continue;
+        }
+        logs.emplace_back();
+        logs.back().swap(log);
+        closures.push_back(new ChunkClosure(request));
+    }
+    if (logs.empty()) {
+        return;
+    }
+
+    braft::Task task;
+    butil::IOBuf log;
+    task.expected_term = term;
+    if (logs.size() == 1) {
+        task.data = &logs[0];
+        task.done = closures[0];
+    } else {
+        ProposeBatcher::EncodeBatchLog(logs, &log);
+        task.data = &log;
+        task.done = new BatchChunkClosure(std::move(closures));
+    }
+    node->Propose(task);
+}
+
 void ChunkOpRequest::RedirectChunkRequest() {
     // 编译时加上 --copt -DUSE_BTHREAD_MUTEX
     // 否则可能发生死锁: CLDCFS-1120
@@ -234,14 +367,36 @@ ReadChunkRequest::ReadChunkRequest(std::shared_ptr<CopysetNode> nodePtr,
     ChunkOpRequest(nodePtr, cntl, request, response, done),
     cloneMgr_(cloneMgr),
     concurrentApplyModule_(nodePtr->GetConcurrentApplyModule()),
-    applyIndex(0) {
+    applyIndex(0),
+    followerRead_(false) {
+}
+
+ReadChunkRequest::~ReadChunkRequest() {
+    if (followerRead_) {
+        node_->EndFollowerRead();
+    }
 }
 
 void ReadChunkRequest::Process() {
     brpc::ClosureGuard doneGuard(done_);
 
     if (!node_->IsLeaderTerm()) {
-        RedirectChunkRequest();
+        /**
+         * follower已经apply到请求携带的applied index时可以直接读，
+         * 分担leader的读压力，与leader上的applied index read一样
+         * 进入并发层，只会等待同一个chunk上此前的写请求apply完成
+         */
+        if (request_->optype() != CHUNK_OP_TYPE::CHUNK_OP_READ
+            || !request_->has_appliedindex()
+            || !node_->BeginFollowerRead(request_->appliedindex())) {
+            RedirectChunkRequest();
+            return;
+        }
+        followerRead_ = true;
+        concurrentApplyModule_->PushRead(
+            request_->chunkid(),
+            PrepareApply(node_->GetAppliedIndex(), doneGuard.release()),
+            true);
         return;
     }
 
@@ -253,13 +408,6 @@ void ReadChunkRequest::Process() {
     if ((request_->has_appliedindex()
         && node_->GetAppliedIndex() >= request_->appliedindex())
         || request_->optype() == CHUNK_OP_TYPE::CHUNK_OP_RECOVER) {
-        /**
-         * 构造shared_ptr<ReadChunkRequest>，因为在ChunkOpRequest只指定了
-         * std::enable_shared_from_this<ChunkOpRequest>，所以
-         * shared_from_this()返回的是shared_ptr<ChunkOpRequest>
-         */
-        auto thisPtr
-            = std::dynamic_pointer_cast<ReadChunkRequest>(shared_from_this());
         /*
          * 将read扔给并发层出于两个原因：
          *  (1). 将read I/O操作和write等其它I/O操作都放在并发层处理，以便隔离
@@ -277,13 +425,16 @@ void ReadChunkRequest::Process() {
          *  就是read也进并发层排队，那么需要read index=6的read request，必定会排在
          *  index=6的op的后面，也就是它们操作的是同一个chunk，并发层会将它们放在同一个
          *  队列中，这样就能保证index=6的op apply之后，read才会被执行，这样就不会出现
-         *  stale read，保证了read的线性一致性
+         *  stale read，保证了read的线性一致性。
+         *  读请求进入独立的读队列，并发层记录了每个chunk上未完成的写请求，
+         *  读请求只会等待同一个chunk上此前的写请求apply完成，不会被其他chunk阻塞
+         *  chunk上没有未完成的写请求时，读请求直接在当前bthread中执行，
+         *  省去一次线程切换和排队
          */
-        auto task = std::bind(&ReadChunkRequest::OnApply,
-                              thisPtr,
-                              node_->GetAppliedIndex(),
-                              doneGuard.release());
-        concurrentApplyModule_->Push(request_->chunkid(), task);
+        concurrentApplyModule_->PushRead(
+            request_->chunkid(),
+            PrepareApply(node_->GetAppliedIndex(), doneGuard.release()),
+            true);
         return;
     }
 
@@ -325,6 +476,11 @@ void ReadChunkRequest::OnApply(uint64_t index,
         }
         // 如果需要从源端拷贝数据，需要将请求转发给clone manager处理
         if ( needLazyClone || NeedClone(chunkInfo) ) {
+            // 拷贝的数据需要经过raft写入chunk，只能由leader处理
+            if (followerRead_) {
+                RedirectChunkRequest();
+                break;
+            }
             applyIndex = index;
             std::shared_ptr<CloneTask> cloneTask =
             cloneMgr_->GenerateCloneTask(
@@ -346,6 +502,11 @@ void ReadChunkRequest::OnApply(uint64_t index,
         }
         // 如果是ReadChunk请求还需要从本地读取数据
         if (request_->optype() == CHUNK_OP_TYPE::CHUNK_OP_READ) {
+            // 支持异步IO时不阻塞apply线程，读完成后在回调中返回
+            if (datastore_->SupportAsyncIO()) {
+                ReadChunkAsync(index, done);
+                return;
+            }
             ReadChunk();
         }
         // 如果是recover请求，说明请求区域已经被写过了，可以直接返回成功
@@ -354,6 +515,11 @@ void ReadChunkRequest::OnApply(uint64_t index,
         }
     } while (false);
 
+    FinishApply(index, done);
+}
+
+void ReadChunkRequest::FinishApply(uint64_t index,
+                                   ::google::protobuf::Closure *done) {
     if (response_->status() == CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS) {
         node_->UpdateAppliedIndex(index);
     }
@@ -388,15 +554,24 @@ bool ReadChunkRequest::NeedClone(const CSChunkInfo& chunkInfo) {
     return false;
 }
 
+// 读缓冲区按O_DIRECT的要求对齐，datastore以O_DIRECT方式读时无需再中转
+static char* NewReadBuffer(size_t size) {
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, curve::common::kDirectIOAlignment, size) != 0) {
+        return nullptr;
+    }
+    return static_cast<char*>(ptr);
+}
+
 static void ReadBufferDeleter(void* ptr) {
-    delete[] static_cast<char*>(ptr);
+    free(ptr);
 }
 
 void ReadChunkRequest::ReadChunk() {
     char *readBuffer = nullptr;
     size_t size = request_->size();
 
-    readBuffer = new(std::nothrow)char[size];
+    readBuffer = NewReadBuffer(size);
     CHECK(nullptr != readBuffer)
         << "new readBuffer failed " << strerror(errno);
 
@@ -405,6 +580,34 @@ void ReadChunkRequest::ReadChunk() {
                                      readBuffer,
                                      request_->offset(),
                                      size);
+    HandleReadResult(ret, readBuffer);
+}
+
+void ReadChunkRequest::ReadChunkAsync(uint64_t index,
+                                      ::google::protobuf::Closure *done) {
+    char *readBuffer = nullptr;
+    size_t size = request_->size();
+
+    readBuffer = NewReadBuffer(size);
+    CHECK(nullptr != readBuffer)
+        << "new readBuffer failed " << strerror(errno);
+
+    // 回调中持有请求本身，保证读完成前request/response不会被释放
+    auto self =
+        std::dynamic_pointer_cast<ReadChunkRequest>(shared_from_this());
+    datastore_->ReadChunkAsync(request_->chunkid(),
+                               request_->sn(),
+                               readBuffer,
+                               request_->offset(),
+                               size,
+        [self, readBuffer, index, done](CSErrorCode ret) {
+            self->HandleReadResult(ret, readBuffer);
+            self->FinishApply(index, done);
+        });
+}
+
+void ReadChunkRequest::HandleReadResult(CSErrorCode ret, char *readBuffer) {
+    size_t size = request_->size();
     butil::IOBuf wrapper;
     wrapper.append_user_data(readBuffer, size, ReadBufferDeleter);
     if (CSErrorCode::Success == ret) {
@@ -429,7 +632,7 @@ void ReadChunkRequest::ReadChunk() {
 void WriteChunkRequest::OnApply(uint64_t index,
                                 ::google::protobuf::Closure *done) {
     brpc::ClosureGuard doneGuard(done);
-    uint32_t cost;
+    uint32_t cost = 0;
 
     std::string  cloneSourceLocation;
     if (existCloneInfo(request_)) {
@@ -440,14 +643,19 @@ void WriteChunkRequest::OnApply(uint64_t index,
 
     auto ret = datastore_->WriteChunk(request_->chunkid(),
                                       request_->sn(),
-                                      cntl_->request_attachment().to_string().c_str(),  //NOLINT
+                                      cntl_->request_attachment(),
                                       request_->offset(),
                                       request_->size(),
                                       &cost,
                                       cloneSourceLocation);
+    HandleWriteResult(ret, index, cost);
+}
 
+void WriteChunkRequest::HandleWriteResult(CSErrorCode ret, uint64_t index,
+                                          uint32_t cost) {
     if (CSErrorCode::Success == ret) {
         response_->set_status(CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS);
+        response_->mutable_phasecost()->set_cost(cost);
         node_->UpdateAppliedIndex(index);
     } else if (CSErrorCode::BackwardRequestError == ret) {
         // 打快照那一刻是有可能出现旧版本的请求
@@ -504,11 +712,16 @@ void WriteChunkRequest::OnApplyFromLog(std::shared_ptr<CSDataStore> datastore,
 
     auto ret = datastore->WriteChunk(request.chunkid(),
                                      request.sn(),
-                                     data.to_string().c_str(),
+                                     data,
                                      request.offset(),
                                      request.size(),
                                      &cost,
                                      cloneSourceLocation);
+    HandleWriteResultFromLog(request, ret);
+}
+
+void WriteChunkRequest::HandleWriteResultFromLog(const ChunkRequest &request,
+                                                 CSErrorCode ret) {
      if (CSErrorCode::Success == ret) {
          return;
      } else if (CSErrorCode::BackwardRequestError == ret) {
@@ -537,12 +750,141 @@ void WriteChunkRequest::OnApplyFromLog(std::shared_ptr<CSDataStore> datastore,
     }
 }
 
+const ChunkRequest* WriteChunkRequest::ApplyRequest() {
+    return applyFromLog_ ? &logRequest_ : request_;
+}
+
+const butil::IOBuf& WriteChunkRequest::ApplyData() {
+    return applyFromLog_ ? logData_ : cntl_->request_attachment();
+}
+
+std::shared_ptr<CSDataStore> WriteChunkRequest::ApplyDataStore() {
+    return applyFromLog_ ? logDataStore_ : datastore_;
+}
+
+bool WriteChunkRequest::Merge(ApplyTask* next) {
+    auto write = dynamic_cast<WriteChunkRequest*>(next);
+    if (write == nullptr) {
+        return false;
+    }
+    const ChunkRequest* request = ApplyRequest();
+    const ChunkRequest* nextRequest = write->ApplyRequest();
+    // clone的写请求需要记录数据源，不参与合并
+    if (existCloneInfo(request)
+        || existCloneInfo(nextRequest)
+        || ApplyDataStore() != write->ApplyDataStore()
+        || request->chunkid() != nextRequest->chunkid()
+        || request->sn() != nextRequest->sn()) {
+        return false;
+    }
+    if (mergeNext_ == nullptr) {
+        mergeOffset_ = request->offset();
+        mergeLength_ = request->size();
+    }
+    off_t end = mergeOffset_ + mergeLength_;
+    off_t nextOffset = nextRequest->offset();
+    off_t nextEnd = nextOffset + nextRequest->size();
+    // 只合并地址连续或者重叠的写请求
+    if (nextOffset > end || nextEnd < mergeOffset_) {
+        return false;
+    }
+    mergeOffset_ = std::min(mergeOffset_, nextOffset);
+    mergeLength_ = std::max(end, nextEnd) - mergeOffset_;
+    if (mergeTail_ == nullptr) {
+        mergeNext_ = write;
+    } else {
+        mergeTail_->mergeNext_ = write;
+    }
+    mergeTail_ = write;
+    return true;
+}
+
+void WriteChunkRequest::Run() {
+    if (mergeNext_ == nullptr) {
+        ChunkOpRequest::Run();
+        return;
+    }
+
+    // 当前请求在FinishMergedWrite之后可能已经析构，先取出需要的信息
+    std::shared_ptr<CSDataStore> datastore = ApplyDataStore();
+    const ChunkRequest* request = ApplyRequest();
+    ChunkID id = request->chunkid();
+    SequenceNum sn = request->sn();
+    off_t offset = mergeOffset_;
+    size_t length = mergeLength_;
+
+    // 按顺序叠加各个请求的数据，后面的请求覆盖重叠部分
+    butil::IOBuf merged;
+    off_t mergedOffset = request->offset();
+    off_t mergedEnd = mergedOffset + request->size();
+    ApplyData().append_to(&merged, request->size());
+    int count = 1;
+    for (WriteChunkRequest* req = mergeNext_;
+         req != nullptr; req = req->mergeNext_) {
+        const ChunkRequest* partRequest = req->ApplyRequest();
+        off_t partOffset = partRequest->offset();
+        off_t partEnd = partOffset + partRequest->size();
+        butil::IOBuf buf;
+        if (mergedOffset < partOffset) {
+            merged.append_to(&buf, partOffset - mergedOffset);
+        }
+        req->ApplyData().append_to(&buf, partRequest->size());
+        if (mergedEnd > partEnd) {
+            merged.append_to(&buf, mergedEnd - partEnd,
+                             partEnd - mergedOffset);
+        }
+        merged.swap(buf);
+        mergedOffset = std::min(mergedOffset, partOffset);
+        mergedEnd = std::max(mergedEnd, partEnd);
+        ++count;
+    }
+
+    uint32_t cost = 0;
+    auto ret = datastore->WriteChunk(id, sn, merged, offset, length, &cost);
+    if (CSErrorCode::Success != ret) {
+        LOG(WARNING) << "Merged write failed, write one by one. "
+                     << "chunkid: " << id
+                     << ", offset: " << offset
+                     << ", length: " << length
+                     << ", merged: " << count
+                     << ", data store return: " << ret;
+    }
+
+    WriteChunkRequest* req = this;
+    while (req != nullptr) {
+        WriteChunkRequest* next = req->mergeNext_;
+        CSErrorCode result = ret;
+        // 合并写入产生的IO都记在第一个请求上
+        uint32_t partCost = (req == this) ? cost : 0;
+        if (CSErrorCode::Success != ret) {
+            const ChunkRequest* partRequest = req->ApplyRequest();
+            result = datastore->WriteChunk(id, sn, req->ApplyData(),
+                                           partRequest->offset(),
+                                           partRequest->size(), &partCost);
+        }
+        req->FinishMergedWrite(result, partCost);
+        req = next;
+    }
+}
+
+void WriteChunkRequest::FinishMergedWrite(CSErrorCode ret, uint32_t cost) {
+    // done中会释放closure持有的引用，先由局部变量持有引用
+    std::shared_ptr<ChunkOpRequest> self = std::move(applySelf_);
+    if (applyFromLog_) {
+        HandleWriteResultFromLog(logRequest_, ret);
+        FinishApplyFromLog();
+    } else {
+        brpc::ClosureGuard doneGuard(applyDone_);
+        HandleWriteResult(ret, applyIndex_, cost);
+    }
+}
+
 void ReadSnapshotRequest::OnApply(uint64_t index,
                                   ::google::protobuf::Closure *done) {
     brpc::ClosureGuard doneGuard(done);
     char *readBuffer = nullptr;
     uint32_t size = request_->size();
-    readBuffer = new(std::nothrow)char[size];
+    readBuffer = NewReadBuffer(size);
     CHECK(nullptr != readBuffer) << "new readBuffer failed, "
                                  << errno << ":" << strerror(errno);
     auto ret = datastore_->ReadSnapshotChunk(request_->chunkid(),
@@ -785,7 +1127,7 @@ void PasteChunkInternalRequest::OnApply(uint64_t index,
     brpc::ClosureGuard doneGuard(done);
 
     auto ret = datastore_->PasteChunk(request_->chunkid(),
-                                      data_.to_string().c_str(),  //NOLINT
+                                      data_,
                                       request_->offset(),
                                       request_->size());
 
@@ -820,7 +1162,7 @@ void PasteChunkInternalRequest::OnApplyFromLog(std::shared_ptr<CSDataStore> data
                                                const butil::IOBuf &data) {
     // NOTE: 处理过程中优先使用参数传入的datastore/request
     auto ret = datastore->PasteChunk(request.chunkid(),
-                                     data.to_string().c_str(),
+                                     data,
                                      request.offset(),
                                      request.size());
     if (CSErrorCode::Success == ret)
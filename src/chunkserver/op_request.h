@@ -28,6 +28,7 @@
 #include <brpc/controller.h>
 
 #include <memory>
+#include <vector>
 
 #include "proto/chunk.pb.h"
 #include "include/chunkserver/chunkserver_common.h"
@@ -57,7 +58,11 @@ inline bool existCloneInfo(const ChunkRequest *request) {
     return false;
 }
 
-class ChunkOpRequest : public std::enable_shared_from_this<ChunkOpRequest> {
+/**
+ * request同时也是并发模块中的侵入式任务，apply时不需要为任务额外分配内存
+ */
+class ChunkOpRequest : public std::enable_shared_from_this<ChunkOpRequest>,
+                       public ApplyTask {
  public:
     ChunkOpRequest();
     ChunkOpRequest(std::shared_ptr<CopysetNode> nodePtr,
@@ -95,6 +100,37 @@ class ChunkOpRequest : public std::enable_shared_from_this<ChunkOpRequest> {
                                 const ChunkRequest &request,
                                 const butil::IOBuf &data) = 0;
 
+    /**
+     * 准备在并发模块中执行OnApply，request自身作为任务入队
+     * 任务执行完之前request持有自身的引用
+     * @param index:此op log entry的index
+     * @param done:对应的ChunkClosure
+     * @return 要入队的任务，即request自身
+     */
+    ApplyTask* PrepareApply(uint64_t index,
+                            ::google::protobuf::Closure *done);
+
+    /**
+     * 准备在并发模块中执行OnApplyFromLog，request自身作为任务入队
+     * request和data的内容会被转移到任务中，apply完成后更新node的applied index
+     * @param node:日志所属的copyset node，为nullptr时不更新applied index
+     * @param index:此op log entry的index
+     * @param datastore:chunk数据持久化层
+     * @param request:反序列化后得到的request细信息
+     * @param data:反序列化后得到的request要处理的数据
+     * @return 要入队的任务，即request自身
+     */
+    ApplyTask* PrepareApplyFromLog(CopysetNode *node,
+                                   uint64_t index,
+                                   std::shared_ptr<CSDataStore> datastore,
+                                   ChunkRequest *request,
+                                   butil::IOBuf *data);
+
+    /**
+     * 在并发模块的后台线程中执行apply，执行完以后释放自身的引用
+     */
+    void Run() override;
+
     /**
      * 返回request的done成员
      */
@@ -152,6 +188,15 @@ class ChunkOpRequest : public std::enable_shared_from_this<ChunkOpRequest> {
                                                   ChunkRequest *request,
                                                   butil::IOBuf *data);
 
+    /**
+     * 同一个copyset上的多个请求编码后合并成一条日志，作为一个task propose
+     * 日志格式与ProposeBatcher合并的日志相同，apply时每个请求分别返回，
+     * copyset没有开启合并日志时逐个propose
+     * @param requests:要propose的请求，必须属于同一个copyset
+     */
+    static void ProposeBatch(
+        const std::vector<std::shared_ptr<ChunkOpRequest>> &requests);
+
  protected:
     /**
      * 打包request为braft::task，propose给相应的复制组
@@ -162,6 +207,12 @@ class ChunkOpRequest : public std::enable_shared_from_this<ChunkOpRequest> {
     int Propose(const ChunkRequest *request,
                 const butil::IOBuf *data);
 
+    /**
+     * 从日志apply完成，follower和重启回放时更新applied index，
+     * 使follower能够处理携带applied index的读请求
+     */
+    void FinishApplyFromLog();
+
  protected:
     // chunk持久化接口
     std::shared_ptr<CSDataStore> datastore_;
@@ -175,6 +226,20 @@ class ChunkOpRequest : public std::enable_shared_from_this<ChunkOpRequest> {
     ChunkResponse *response_;
     // rpc done closure
     ::google::protobuf::Closure *done_;
+
+    // 以下成员用于在并发模块中执行apply
+    // 任务执行完之前持有自身的引用
+    std::shared_ptr<ChunkOpRequest> applySelf_;
+    // 是否是从日志apply
+    bool applyFromLog_;
+    uint64_t applyIndex_;
+    ::google::protobuf::Closure *applyDone_;
+    // 从日志apply时使用的copyset node、datastore、request和数据，
+    // copyset node在Fini时会等待并发模块中的任务执行完
+    CopysetNode *logNode_;
+    std::shared_ptr<CSDataStore> logDataStore_;
+    ChunkRequest logRequest_;
+    butil::IOBuf logData_;
 };
 
 class DeleteChunkRequest : public ChunkOpRequest {
@@ -205,7 +270,8 @@ class ReadChunkRequest : public ChunkOpRequest {
 
  public:
     ReadChunkRequest() :
-        ChunkOpRequest() {}
+        ChunkOpRequest(),
+        followerRead_(false) {}
     ReadChunkRequest(std::shared_ptr<CopysetNode> nodePtr,
                      CloneManager* cloneMgr,
                      RpcController *cntl,
@@ -213,7 +279,7 @@ class ReadChunkRequest : public ChunkOpRequest {
                      ChunkResponse *response,
                      ::google::protobuf::Closure *done);
 
-    virtual ~ReadChunkRequest() = default;
+    virtual ~ReadChunkRequest();
 
     void Process() override;
     void OnApply(uint64_t index, ::google::protobuf::Closure *done) override;
@@ -230,6 +296,12 @@ class ReadChunkRequest : public ChunkOpRequest {
     bool NeedClone(const CSChunkInfo& chunkInfo);
     // 从chunk文件中读数据
     void ReadChunk();
+    // 从chunk文件中异步读数据，读完成后更新applied index并返回
+    void ReadChunkAsync(uint64_t index, ::google::protobuf::Closure *done);
+    // 根据读chunk的结果设置response，readBuffer的所有权转移给response
+    void HandleReadResult(CSErrorCode ret, char *readBuffer);
+    // 更新applied index并返回
+    void FinishApply(uint64_t index, ::google::protobuf::Closure *done);
 
  private:
     CloneManager* cloneMgr_;
@@ -237,12 +309,18 @@ class ReadChunkRequest : public ChunkOpRequest {
     ConcurrentApplyModule* concurrentApplyModule_;
     // 保存 apply index
     uint64_t applyIndex;
+    // 是否是在follower上直接处理的读请求
+    bool followerRead_;
 };
 
 class WriteChunkRequest : public ChunkOpRequest {
  public:
     WriteChunkRequest() :
-        ChunkOpRequest() {}
+        ChunkOpRequest(),
+        mergeNext_(nullptr),
+        mergeTail_(nullptr),
+        mergeOffset_(0),
+        mergeLength_(0) {}
     WriteChunkRequest(std::shared_ptr<CopysetNode> nodePtr,
                       RpcController *cntl,
                       const ChunkRequest *request,
@@ -252,13 +330,53 @@ class WriteChunkRequest : public ChunkOpRequest {
                        cntl,
                        request,
                        response,
-                       done) {}
+                       done),
+        mergeNext_(nullptr),
+        mergeTail_(nullptr),
+        mergeOffset_(0),
+        mergeLength_(0) {}
     virtual ~WriteChunkRequest() = default;
 
     void OnApply(uint64_t index, ::google::protobuf::Closure *done);
     void OnApplyFromLog(std::shared_ptr<CSDataStore> datastore,
                         const ChunkRequest &request,
                         const butil::IOBuf &data) override;
+
+    /**
+     * 同一个chunk上版本号相同、地址连续或者重叠的非clone写请求可以合并，
+     * 合并进来的请求组成链表，由当前请求负责完成
+     */
+    bool Merge(ApplyTask* next) override;
+
+    /**
+     * 合并了其他写请求时，按顺序叠加各个请求的数据后一次写入chunk文件，
+     * 每个请求仍然各自返回结果并更新applied index
+     * 合并后的写入失败时，按顺序逐个重新写入各个请求，
+     * 避免一个非法的请求导致合并进来的其他请求失败，各副本的结果不一致
+     */
+    void Run() override;
+
+ private:
+    // apply时使用的request、数据和datastore，区分是否从日志apply
+    const ChunkRequest* ApplyRequest();
+    const butil::IOBuf& ApplyData();
+    std::shared_ptr<CSDataStore> ApplyDataStore();
+    // 合并写入结束后返回结果并释放自身的引用，调用之后request可能已经析构
+    void FinishMergedWrite(CSErrorCode ret, uint32_t cost);
+    // 根据写chunk的结果设置response，成功时更新applied index，
+    // 并在response中返回实际产生的IO次数，用于QoS补扣
+    void HandleWriteResult(CSErrorCode ret, uint64_t index, uint32_t cost);
+    // 打印从日志apply写chunk的结果
+    static void HandleWriteResultFromLog(const ChunkRequest &request,
+                                         CSErrorCode ret);
+
+ private:
+    // 合并进来的写请求组成的链表
+    WriteChunkRequest* mergeNext_;
+    WriteChunkRequest* mergeTail_;
+    // 合并后的写入范围
+    off_t mergeOffset_;
+    size_t mergeLength_;
 };
 
 class ReadSnapshotRequest : public ChunkOpRequest {
@@ -68,6 +68,39 @@ uint32_t GetDatastoreCloneChunkCountFunc(void* arg) {
     return cloneChunkCount;
 }
 
+uint64_t GetDatastoreReadCacheHitFunc(void* arg) {
+    CSDataStore* dataStore = reinterpret_cast<CSDataStore*>(arg);
+    uint64_t hitCount = 0;
+    if (dataStore != nullptr) {
+        DataStoreStatus status = dataStore->GetStatus();
+        hitCount = status.readCacheHitCount;
+    }
+    return hitCount;
+}
+
+uint64_t GetDatastoreReadCacheMissFunc(void* arg) {
+    CSDataStore* dataStore = reinterpret_cast<CSDataStore*>(arg);
+    uint64_t missCount = 0;
+    if (dataStore != nullptr) {
+        DataStoreStatus status = dataStore->GetStatus();
+        missCount = status.readCacheMissCount;
+    }
+    return missCount;
+}
+
+double GetDatastoreReadCacheHitRatioFunc(void* arg) {
+    CSDataStore* dataStore = reinterpret_cast<CSDataStore*>(arg);
+    double hitRatio = 0;
+    if (dataStore != nullptr) {
+        DataStoreStatus status = dataStore->GetStatus();
+        uint64_t total = status.readCacheHitCount + status.readCacheMissCount;
+        if (total > 0) {
+            hitRatio = static_cast<double>(status.readCacheHitCount) / total;
+        }
+    }
+    return hitRatio;
+}
+
 uint32_t GetChunkTrashedFunc(void* arg) {
     Trash* trash = reinterpret_cast<Trash*>(arg);
     uint32_t chunkTrashed = 0;
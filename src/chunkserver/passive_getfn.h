@@ -45,6 +45,21 @@ namespace chunkserver {
      * @param arg: datastore的对象指针
      */
     uint32_t GetDatastoreCloneChunkCountFunc(void* arg);
+    /**
+     * 获取datastore读缓存命中的page数
+     * @param arg: datastore的对象指针
+     */
+    uint64_t GetDatastoreReadCacheHitFunc(void* arg);
+    /**
+     * 获取datastore读缓存未命中的page数
+     * @param arg: datastore的对象指针
+     */
+    uint64_t GetDatastoreReadCacheMissFunc(void* arg);
+    /**
+     * 获取datastore读缓存的命中率
+     * @param arg: datastore的对象指针
+     */
+    double GetDatastoreReadCacheHitRatioFunc(void* arg);
     /**
      * 获取chunkserver上chunk文件的数量
      * @param arg: nullptr
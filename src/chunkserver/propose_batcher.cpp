@@ -0,0 +1,202 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-26
+ * Author: curve
+ */
+
+#include "src/chunkserver/propose_batcher.h"
+
+#include <glog/logging.h>
+#include <butil/sys_byteorder.h>
+
+#include <utility>
+
+#include "src/chunkserver/chunk_closure.h"
+#include "src/chunkserver/op_request.h"
+#include "src/common/timeutility.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::common::TimeUtility;
+
+// 单条日志的第一个字段是request的长度，不可能达到该值
+const uint32_t kBatchLogMagic = 0xFFFFFFFF;
+const size_t kBatchLogHeaderSize = 2 * sizeof(uint32_t);
+
+void BatchChunkClosure::Run() {
+    std::unique_ptr<BatchChunkClosure> selfGuard(this);
+    /**
+     * 正常apply时closure已经被取走，这里只处理日志没有被apply就出错的情况，
+     * 例如leader step down，每个请求都需要返回错误
+     */
+    for (ChunkClosure* closure : closures_) {
+        closure->status() = status();
+        closure->Run();
+    }
+}
+
+std::vector<ChunkClosure*> BatchChunkClosure::ReleaseClosures() {
+    std::vector<ChunkClosure*> closures;
+    closures.swap(closures_);
+    return closures;
+}
+
+ProposeBatcher::ProposeBatcher(const ProposeBatcherOptions& options,
+                               ProposeFunc propose)
+    : options_(options),
+      propose_(std::move(propose)) {}
+
+void ProposeBatcher::Propose(std::shared_ptr<ChunkOpRequest> request,
+                             butil::IOBuf* log,
+                             int64_t term) {
+    std::unique_lock<bthread::Mutex> lk(mtx_);
+    std::vector<std::shared_ptr<Batch>> toPropose;
+    if (current_ != nullptr && current_->term != term) {
+        // term发生了变化，之前的批次立即propose
+        current_->sealed = true;
+        toPropose.push_back(current_);
+        current_ = nullptr;
+        cond_.notify_all();
+    }
+    bool owner = false;
+    if (current_ == nullptr) {
+        current_ = std::make_shared<Batch>();
+        current_->term = term;
+        owner = true;
+    }
+    std::shared_ptr<Batch> batch = current_;
+    batch->bytes += log->size();
+    batch->requests.push_back(request);
+    batch->logs.emplace_back();
+    batch->logs.back().swap(*log);
+    if (batch->requests.size() >= options_.maxCount
+        || batch->bytes >= options_.maxBytes) {
+        // 批次已满，由当前请求propose，等待窗口的请求被唤醒后直接返回
+        batch->sealed = true;
+        current_ = nullptr;
+        cond_.notify_all();
+        toPropose.push_back(batch);
+    }
+    if (!owner || batch->sealed) {
+        lk.unlock();
+        for (auto& b : toPropose) {
+            ProposeBatch(b);
+        }
+        return;
+    }
+    if (!toPropose.empty()) {
+        lk.unlock();
+        ProposeBatch(toPropose.front());
+        lk.lock();
+    }
+
+    // 批次的第一个请求等待窗口结束，期间批次可能因为满了被其他请求取走
+    uint64_t deadline = TimeUtility::GetTimeofDayUs() + options_.windowUs;
+    while (!batch->sealed) {
+        uint64_t now = TimeUtility::GetTimeofDayUs();
+        if (now >= deadline) {
+            break;
+        }
+        cond_.wait_for(lk, deadline - now);
+    }
+    if (batch->sealed) {
+        return;
+    }
+    batch->sealed = true;
+    if (current_ == batch) {
+        current_ = nullptr;
+    }
+    lk.unlock();
+    ProposeBatch(batch);
+}
+
+void ProposeBatcher::ProposeBatch(const std::shared_ptr<Batch>& batch) {
+    braft::Task task;
+    task.expected_term = batch->term;
+    // 只有一个请求时与不合并的格式相同
+    if (batch->requests.size() == 1) {
+        task.data = &batch->logs[0];
+        task.done = new ChunkClosure(batch->requests[0]);
+        propose_(task);
+        return;
+    }
+
+    butil::IOBuf log;
+    EncodeBatchLog(batch->logs, &log);
+    std::vector<ChunkClosure*> closures;
+    closures.reserve(batch->requests.size());
+    for (auto& request : batch->requests) {
+        closures.push_back(new ChunkClosure(request));
+    }
+    task.data = &log;
+    task.done = new BatchChunkClosure(std::move(closures));
+    propose_(task);
+}
+
+bool ProposeBatcher::IsBatchLog(const butil::IOBuf& log) {
+    if (log.size() < kBatchLogHeaderSize) {
+        return false;
+    }
+    uint32_t magic = 0;
+    log.copy_to(&magic, sizeof(magic));
+    return butil::NetToHost32(magic) == kBatchLogMagic;
+}
+
+void ProposeBatcher::EncodeBatchLog(const std::vector<butil::IOBuf>& entries,
+                                    butil::IOBuf* log) {
+    const uint32_t magic = butil::HostToNet32(kBatchLogMagic);
+    log->append(&magic, sizeof(magic));
+    const uint32_t count = butil::HostToNet32(entries.size());
+    log->append(&count, sizeof(count));
+    for (const auto& entry : entries) {
+        const uint32_t len = butil::HostToNet32(entry.size());
+        log->append(&len, sizeof(len));
+        log->append(entry);
+    }
+}
+
+int ProposeBatcher::DecodeBatchLog(butil::IOBuf log,
+                                   std::vector<butil::IOBuf>* entries) {
+    if (!IsBatchLog(log)) {
+        return -1;
+    }
+    uint32_t count = 0;
+    log.pop_front(sizeof(uint32_t));
+    log.cutn(&count, sizeof(count));
+    count = butil::NetToHost32(count);
+    entries->clear();
+    entries->reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t len = 0;
+        if (log.cutn(&len, sizeof(len)) != sizeof(len)) {
+            return -1;
+        }
+        len = butil::NetToHost32(len);
+        if (log.size() < len) {
+            return -1;
+        }
+        entries->emplace_back();
+        log.cutn(&entries->back(), len);
+    }
+    return log.empty() ? 0 : -1;
+}
+
+}  // namespace chunkserver
+}  // namespace curve
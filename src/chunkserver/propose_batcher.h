@@ -0,0 +1,153 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-26
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_PROPOSE_BATCHER_H_
+#define SRC_CHUNKSERVER_PROPOSE_BATCHER_H_
+
+#include <braft/raft.h>
+#include <bthread/mutex.h>
+#include <bthread/condition_variable.h>
+#include <butil/iobuf.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace curve {
+namespace chunkserver {
+
+class ChunkOpRequest;
+class ChunkClosure;
+
+struct ProposeBatcherOptions {
+    // 第一个请求到达后等待后续请求的时间，单位us
+    uint32_t windowUs = 200;
+    // 一次propose的最大请求数
+    uint32_t maxCount = 32;
+    // 一次propose的最大字节数，不小于该值的请求单独propose
+    uint32_t maxBytes = 256 * 1024;
+};
+
+/**
+ * 多个请求合并成一条日志时的closure
+ * apply时每个请求的closure被取出分别执行，
+ * 日志没有被apply就出错时，错误会传递给每个请求的closure
+ */
+class BatchChunkClosure : public braft::Closure {
+ public:
+    explicit BatchChunkClosure(std::vector<ChunkClosure*> closures)
+        : closures_(std::move(closures)) {}
+
+    ~BatchChunkClosure() = default;
+
+    void Run() override;
+
+    /**
+     * 取出所有请求的closure，由调用者负责执行
+     */
+    std::vector<ChunkClosure*> ReleaseClosures();
+
+ private:
+    std::vector<ChunkClosure*> closures_;
+};
+
+/**
+ * copyset级别的propose合并
+ * 短时间内到达的小写请求合并成一条raft日志，减少每条日志在编码、复制、
+ * 落盘以及apply回调上的开销。第一个进入批次的请求负责等待windowUs，
+ * 之后将整个批次propose；批次达到请求数或者字节数上限时立即propose
+ * 合并后的日志格式如下，每个entry是ChunkOpRequest::Encode的结果
+ * |  magic  |  count  | entry len | entry | entry len | entry | ...
+ * | 32 bit  | 32 bit  |  32 bit   | ....  |  32 bit   | ....  |
+ * 单条日志的第一个字段是request的长度，不会等于magic
+ */
+class ProposeBatcher {
+ public:
+    using ProposeFunc = std::function<void(const braft::Task&)>;
+
+    ProposeBatcher(const ProposeBatcherOptions& options, ProposeFunc propose);
+    ~ProposeBatcher() = default;
+
+    /**
+     * 编码后的请求是否可以合并
+     */
+    bool Accept(size_t logSize) const {
+        return logSize < options_.maxBytes;
+    }
+
+    /**
+     * 将请求加入批次，返回时请求可能还没有propose，
+     * 但是一定会在windowUs内propose
+     * @param request: 请求，propose之后由请求的closure返回结果
+     * @param log: 请求编码后的日志，内容会被转移走
+     * @param term: propose时期望的leader term，不同term的请求不会合并
+     */
+    void Propose(std::shared_ptr<ChunkOpRequest> request,
+                 butil::IOBuf* log,
+                 int64_t term);
+
+    /**
+     * 是否是合并后的日志
+     */
+    static bool IsBatchLog(const butil::IOBuf& log);
+
+    /**
+     * 合并多条日志
+     */
+    static void EncodeBatchLog(const std::vector<butil::IOBuf>& entries,
+                               butil::IOBuf* log);
+
+    /**
+     * 拆分合并后的日志
+     * @param log: 合并后的日志
+     * @param entries: 出参，每个请求的日志
+     * @return 0成功，-1日志格式错误
+     */
+    static int DecodeBatchLog(butil::IOBuf log,
+                              std::vector<butil::IOBuf>* entries);
+
+ private:
+    struct Batch {
+        int64_t term = 0;
+        size_t bytes = 0;
+        // 批次已经被取走，不再接收新的请求
+        bool sealed = false;
+        std::vector<std::shared_ptr<ChunkOpRequest>> requests;
+        std::vector<butil::IOBuf> logs;
+    };
+
+    // 将批次中的请求propose给raft，调用时不持有锁
+    void ProposeBatch(const std::shared_ptr<Batch>& batch);
+
+ private:
+    ProposeBatcherOptions options_;
+    ProposeFunc propose_;
+    bthread::Mutex mtx_;
+    bthread::ConditionVariable cond_;
+    // 当前正在接收请求的批次
+    std::shared_ptr<Batch> current_;
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_PROPOSE_BATCHER_H_
@@ -0,0 +1,398 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-27
+ * Author: curve
+ */
+
+#include "src/chunkserver/qos_scheduler.h"
+
+#include <glog/logging.h>
+#include <bthread/bthread.h>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "src/common/timeutility.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::common::TimeUtility;
+
+// 后台线程最长的等待时间，保证上限修改后能够及时生效
+const uint64_t kMaxWaitUs = 100 * 1000;
+// 回收空闲卷和client的间隔
+const uint64_t kCleanIntervalUs = 1000 * 1000;
+
+void TokenBucket::SetRate(uint64_t rate, uint64_t nowUs) {
+    if (rate_ == 0) {
+        // 从不限制变为限制时，桶是满的
+        tokens_ = rate;
+    } else {
+        Refill(nowUs);
+        tokens_ = std::min<double>(tokens_, rate);
+    }
+    rate_ = rate;
+    lastUs_ = nowUs;
+}
+
+void TokenBucket::Refill(uint64_t nowUs) {
+    if (rate_ == 0 || nowUs <= lastUs_) {
+        lastUs_ = nowUs;
+        return;
+    }
+    tokens_ += static_cast<double>(nowUs - lastUs_) * rate_ / 1000000;
+    tokens_ = std::min<double>(tokens_, rate_);
+    lastUs_ = nowUs;
+}
+
+uint64_t TokenBucket::WaitUs() const {
+    if (Ready()) {
+        return 0;
+    }
+    return static_cast<uint64_t>(-tokens_ * 1000000 / rate_) + 1;
+}
+
+void QosLimiter::SetLimit(const QosLimit& limit, uint64_t nowUs) {
+    iops_.SetRate(limit.iops, nowUs);
+    bps_.SetRate(limit.bps, nowUs);
+}
+
+QosLimit QosLimiter::GetLimit() const {
+    QosLimit limit;
+    limit.iops = iops_.Rate();
+    limit.bps = bps_.Rate();
+    return limit;
+}
+
+uint64_t QosLimiter::WaitUs() const {
+    return std::max(iops_.WaitUs(), bps_.WaitUs());
+}
+
+QosScheduler::QosScheduler(const QosSchedulerOptions& options)
+    : options_(options),
+      running_(false),
+      virtualTime_(0),
+      queued_(0),
+      runningTasks_(0),
+      lastCleanUs_(0) {
+    disk_.SetLimit(options_.diskLimit, TimeUtility::GetTimeofDayUs());
+}
+
+QosScheduler::~QosScheduler() {
+    Fini();
+}
+
+int QosScheduler::Init() {
+    if (running_.exchange(true)) {
+        return 0;
+    }
+    worker_ = std::thread(&QosScheduler::Run, this);
+    LOG(INFO) << "QosScheduler started, disk iops: "
+              << options_.diskLimit.iops
+              << ", disk bps: " << options_.diskLimit.bps
+              << ", volume iops: " << options_.volumeLimit.iops
+              << ", volume bps: " << options_.volumeLimit.bps
+              << ", client iops: " << options_.clientLimit.iops
+              << ", client bps: " << options_.clientLimit.bps;
+    return 0;
+}
+
+void QosScheduler::Fini() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    cond_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+bool QosScheduler::IsOverLoad(uint64_t volumeId) {
+    std::lock_guard<bthread::Mutex> lk(mtx_);
+    auto it = volumes_.find(volumeId);
+    return it != volumes_.end()
+        && it->second.queue.size() >= options_.maxVolumeQueueDepth;
+}
+
+void QosScheduler::Submit(const QosRequest& request, Task task) {
+    uint64_t nowUs = TimeUtility::GetTimeofDayUs();
+    std::unique_lock<bthread::Mutex> lk(mtx_);
+    if (!running_.load(std::memory_order_relaxed)) {
+        lk.unlock();
+        task();
+        return;
+    }
+    VolumeState* volume = GetVolume(request.volumeId, nowUs);
+    ClientState* client = GetClient(request.client, nowUs);
+    /**
+     * 所有卷上都没有排队的请求时直接尝试获取令牌，
+     * 否则即使令牌足够也要排队，不能越过其他卷上在等待磁盘的请求
+     */
+    if (queued_ == 0) {
+        disk_.Refill(nowUs);
+        volume->limiter.Refill(nowUs);
+        client->limiter.Refill(nowUs);
+        if (disk_.Ready() && volume->limiter.Ready()
+            && client->limiter.Ready()) {
+            Dispatch(volume, client, request);
+            lk.unlock();
+            task();
+            return;
+        }
+    }
+    volume->queue.push_back(Pending{request, std::move(task)});
+    ++queued_;
+    cond_.notify_one();
+}
+
+void QosScheduler::Charge(uint64_t volumeId, uint32_t ios) {
+    std::lock_guard<bthread::Mutex> lk(mtx_);
+    disk_.Consume(ios, 0);
+    auto it = volumes_.find(volumeId);
+    if (it != volumes_.end()) {
+        it->second.limiter.Consume(ios, 0);
+    }
+}
+
+void QosScheduler::SetDiskLimit(const QosLimit& limit) {
+    std::lock_guard<bthread::Mutex> lk(mtx_);
+    options_.diskLimit = limit;
+    disk_.SetLimit(limit, TimeUtility::GetTimeofDayUs());
+    cond_.notify_one();
+}
+
+void QosScheduler::SetClientLimit(const QosLimit& limit) {
+    std::lock_guard<bthread::Mutex> lk(mtx_);
+    uint64_t nowUs = TimeUtility::GetTimeofDayUs();
+    options_.clientLimit = limit;
+    for (auto& item : clients_) {
+        item.second.limiter.SetLimit(limit, nowUs);
+    }
+    cond_.notify_one();
+}
+
+void QosScheduler::SetDefaultVolumeLimit(const QosLimit& limit) {
+    std::lock_guard<bthread::Mutex> lk(mtx_);
+    uint64_t nowUs = TimeUtility::GetTimeofDayUs();
+    options_.volumeLimit = limit;
+    for (auto& item : volumes_) {
+        if (item.first != 0 && !item.second.custom) {
+            item.second.limiter.SetLimit(limit, nowUs);
+        }
+    }
+    cond_.notify_one();
+}
+
+void QosScheduler::SetVolumeLimit(uint64_t volumeId, const QosLimit& limit,
+                                  uint32_t weight) {
+    std::lock_guard<bthread::Mutex> lk(mtx_);
+    uint64_t nowUs = TimeUtility::GetTimeofDayUs();
+    VolumeState* volume = GetVolume(volumeId, nowUs);
+    volume->custom = true;
+    volume->weight = std::max<uint32_t>(weight, 1);
+    volume->limiter.SetLimit(limit, nowUs);
+    cond_.notify_one();
+}
+
+void QosScheduler::ResetVolumeLimit(uint64_t volumeId) {
+    std::lock_guard<bthread::Mutex> lk(mtx_);
+    auto it = volumes_.find(volumeId);
+    if (it == volumes_.end()) {
+        return;
+    }
+    VolumeState& volume = it->second;
+    volume.custom = false;
+    volume.weight = 1;
+    volume.limiter.SetLimit(volumeId == 0 ? QosLimit() : options_.volumeLimit,
+                            TimeUtility::GetTimeofDayUs());
+    cond_.notify_one();
+}
+
+QosScheduler::VolumeState* QosScheduler::GetVolume(uint64_t volumeId,
+                                                   uint64_t nowUs) {
+    auto ret = volumes_.emplace(volumeId, VolumeState());
+    VolumeState* volume = &ret.first->second;
+    if (ret.second && volumeId != 0) {
+        volume->limiter.SetLimit(options_.volumeLimit, nowUs);
+    }
+    volume->lastActiveUs = nowUs;
+    return volume;
+}
+
+QosScheduler::ClientState* QosScheduler::GetClient(const std::string& client,
+                                                   uint64_t nowUs) {
+    auto ret = clients_.emplace(client, ClientState());
+    ClientState* state = &ret.first->second;
+    if (ret.second) {
+        state->limiter.SetLimit(options_.clientLimit, nowUs);
+    }
+    state->lastActiveUs = nowUs;
+    return state;
+}
+
+void QosScheduler::Dispatch(VolumeState* volume, ClientState* client,
+                            const QosRequest& request) {
+    disk_.Consume(1, request.bytes);
+    volume->limiter.Consume(1, request.bytes);
+    client->limiter.Consume(1, request.bytes);
+    // 请求的开始时间是系统虚拟时间和卷上一个请求完成时间中较大的一个
+    double startTag = std::max(virtualTime_, volume->finishTag);
+    virtualTime_ = startTag;
+    volume->finishTag = startTag + 1.0 / volume->weight;
+}
+
+QosScheduler::VolumeState* QosScheduler::PickVolume(uint64_t nowUs,
+                                                    uint64_t* waitUs) {
+    disk_.Refill(nowUs);
+    if (!disk_.Ready()) {
+        *waitUs = std::min(disk_.WaitUs(), kMaxWaitUs);
+        return nullptr;
+    }
+    VolumeState* best = nullptr;
+    double bestTag = 0;
+    uint64_t minWaitUs = kMaxWaitUs;
+    for (auto& item : volumes_) {
+        VolumeState* volume = &item.second;
+        if (volume->queue.empty()) {
+            continue;
+        }
+        volume->limiter.Refill(nowUs);
+        ClientState* client =
+            GetClient(volume->queue.front().request.client, nowUs);
+        client->limiter.Refill(nowUs);
+        uint64_t wait = std::max(volume->limiter.WaitUs(),
+                                 client->limiter.WaitUs());
+        if (wait > 0) {
+            minWaitUs = std::min(minWaitUs, wait);
+            continue;
+        }
+        double startTag = std::max(virtualTime_, volume->finishTag);
+        if (best == nullptr || startTag < bestTag) {
+            best = volume;
+            bestTag = startTag;
+        }
+    }
+    *waitUs = minWaitUs;
+    return best;
+}
+
+void QosScheduler::CleanIdle(uint64_t nowUs) {
+    if (nowUs < lastCleanUs_ + kCleanIntervalUs) {
+        return;
+    }
+    lastCleanUs_ = nowUs;
+    uint64_t idleUs = static_cast<uint64_t>(options_.idleTimeoutS) * 1000000;
+    for (auto it = volumes_.begin(); it != volumes_.end();) {
+        const VolumeState& volume = it->second;
+        if (!volume.custom && volume.queue.empty()
+            && nowUs > volume.lastActiveUs + idleUs) {
+            it = volumes_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = clients_.begin(); it != clients_.end();) {
+        if (nowUs > it->second.lastActiveUs + idleUs) {
+            it = clients_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+struct QosTaskArg {
+    QosScheduler* scheduler;
+    QosScheduler::Task task;
+};
+
+void* QosScheduler::RunTask(void* arg) {
+    std::unique_ptr<QosTaskArg> taskArg(static_cast<QosTaskArg*>(arg));
+    taskArg->task();
+    QosScheduler* scheduler = taskArg->scheduler;
+    std::lock_guard<bthread::Mutex> lk(scheduler->mtx_);
+    if (--scheduler->runningTasks_ == 0) {
+        scheduler->cond_.notify_all();
+    }
+    return nullptr;
+}
+
+void QosScheduler::RunInBthread(Task task) {
+    {
+        std::lock_guard<bthread::Mutex> lk(mtx_);
+        ++runningTasks_;
+    }
+    QosTaskArg* arg = new QosTaskArg{this, std::move(task)};
+    bthread_t tid;
+    if (bthread_start_background(&tid, nullptr, RunTask, arg) != 0) {
+        LOG(ERROR) << "Fail to start bthread for qos task, run it inline";
+        RunTask(arg);
+    }
+}
+
+void QosScheduler::Run() {
+    std::unique_lock<bthread::Mutex> lk(mtx_);
+    while (running_.load(std::memory_order_relaxed)) {
+        uint64_t nowUs = TimeUtility::GetTimeofDayUs();
+        CleanIdle(nowUs);
+        if (queued_ == 0) {
+            cond_.wait_for(lk, kCleanIntervalUs);
+            continue;
+        }
+        uint64_t waitUs = 0;
+        VolumeState* volume = PickVolume(nowUs, &waitUs);
+        if (volume == nullptr) {
+            cond_.wait_for(lk, waitUs);
+            continue;
+        }
+        Pending pending = std::move(volume->queue.front());
+        volume->queue.pop_front();
+        --queued_;
+        Dispatch(volume, GetClient(pending.request.client, nowUs),
+                 pending.request);
+        lk.unlock();
+        RunInBthread(std::move(pending.task));
+        lk.lock();
+    }
+
+    // 停止后排队中的请求直接下发，由请求自身返回结果
+    std::vector<Task> left;
+    for (auto& item : volumes_) {
+        for (auto& pending : item.second.queue) {
+            left.push_back(std::move(pending.task));
+        }
+        item.second.queue.clear();
+    }
+    queued_ = 0;
+    lk.unlock();
+    for (auto& task : left) {
+        task();
+    }
+
+    // 等待已经下发到bthread中的请求执行完
+    lk.lock();
+    while (runningTasks_ > 0) {
+        cond_.wait(lk);
+    }
+}
+
+}  // namespace chunkserver
+}  // namespace curve
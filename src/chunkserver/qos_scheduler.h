@@ -0,0 +1,264 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-27
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_QOS_SCHEDULER_H_
+#define SRC_CHUNKSERVER_QOS_SCHEDULER_H_
+
+#include <bthread/mutex.h>
+#include <bthread/condition_variable.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <thread>    // NOLINT
+#include <unordered_map>
+
+namespace curve {
+namespace chunkserver {
+
+struct QosLimit {
+    // 每秒IO次数上限，0表示不限制
+    uint64_t iops = 0;
+    // 每秒字节数上限，0表示不限制
+    uint64_t bps = 0;
+};
+
+struct QosSchedulerOptions {
+    // 整个chunkserver的上限，一个chunkserver对应一块盘
+    QosLimit diskLimit;
+    // 没有单独设置时每个卷的上限
+    QosLimit volumeLimit;
+    // 每个client的上限，client按照请求的来源ip区分
+    QosLimit clientLimit;
+    // 每个卷最多排队的请求数，超过后返回过载
+    uint32_t maxVolumeQueueDepth = 1024;
+    // 空闲超过该时间的卷和client会被回收，单独设置过上限的卷不回收
+    uint32_t idleTimeoutS = 60;
+};
+
+struct QosRequest {
+    // 请求所属的卷，0表示client没有携带卷信息，不做卷级别的限制
+    uint64_t volumeId = 0;
+    // 请求来源的client
+    std::string client;
+    // 请求的数据量
+    uint64_t bytes = 0;
+};
+
+/**
+ * 令牌桶，最多积累1秒的令牌
+ * 令牌为正时即可放行，放行后令牌可以被扣成负数，
+ * 大请求以及执行后补扣的IO由之后的请求等待偿还
+ */
+class TokenBucket {
+ public:
+    /**
+     * 修改速率，rate为0表示不限制
+     */
+    void SetRate(uint64_t rate, uint64_t nowUs);
+
+    uint64_t Rate() const {
+        return rate_;
+    }
+
+    void Refill(uint64_t nowUs);
+
+    bool Ready() const {
+        return rate_ == 0 || tokens_ > 0;
+    }
+
+    void Consume(uint64_t count) {
+        if (rate_ != 0) {
+            tokens_ -= count;
+        }
+    }
+
+    /**
+     * 令牌恢复为正还需要等待的时间
+     */
+    uint64_t WaitUs() const;
+
+ private:
+    uint64_t rate_ = 0;
+    double tokens_ = 0;
+    uint64_t lastUs_ = 0;
+};
+
+/**
+ * IOPS和带宽两个令牌桶，两者都有令牌时才可以放行
+ */
+class QosLimiter {
+ public:
+    void SetLimit(const QosLimit& limit, uint64_t nowUs);
+
+    QosLimit GetLimit() const;
+
+    void Refill(uint64_t nowUs) {
+        iops_.Refill(nowUs);
+        bps_.Refill(nowUs);
+    }
+
+    bool Ready() const {
+        return iops_.Ready() && bps_.Ready();
+    }
+
+    void Consume(uint64_t ios, uint64_t bytes) {
+        iops_.Consume(ios);
+        bps_.Consume(bytes);
+    }
+
+    uint64_t WaitUs() const;
+
+ private:
+    TokenBucket iops_;
+    TokenBucket bps_;
+};
+
+/**
+ * chunkserver端的QoS调度
+ * 读写请求需要依次从所属client、所属卷以及磁盘的令牌桶中取得令牌才能下发，
+ * 没有令牌时请求按卷排队，磁盘有令牌时在可下发的卷之间按照权重公平调度
+ * (start-time fair queueing)，一个卷压满磁盘时其他卷仍然按权重获得带宽
+ * 请求下发后实际产生的额外IO(例如cow)通过Charge补扣到卷和磁盘上
+ */
+class QosScheduler {
+ public:
+    using Task = std::function<void()>;
+
+    explicit QosScheduler(const QosSchedulerOptions& options);
+    ~QosScheduler();
+
+    /**
+     * 启动后台调度线程
+     * @return 0成功，-1失败
+     */
+    int Init();
+
+    /**
+     * 停止后台调度线程，排队中的请求直接下发，
+     * 返回前等待已经下发的请求执行完
+     */
+    void Fini();
+
+    /**
+     * 卷的排队请求是否已经达到上限
+     */
+    bool IsOverLoad(uint64_t volumeId);
+
+    /**
+     * 提交请求，有令牌且没有其他请求排队时在当前线程直接执行task，
+     * 否则排队，由后台线程在获得令牌后放到bthread中执行
+     */
+    void Submit(const QosRequest& request, Task task);
+
+    /**
+     * 补扣请求实际产生的额外IO次数
+     */
+    void Charge(uint64_t volumeId, uint32_t ios);
+
+    void SetDiskLimit(const QosLimit& limit);
+
+    void SetClientLimit(const QosLimit& limit);
+
+    /**
+     * 修改卷的默认上限，单独设置过上限的卷不受影响
+     */
+    void SetDefaultVolumeLimit(const QosLimit& limit);
+
+    /**
+     * 单独设置卷的上限和权重
+     * @param weight: 卷之间调度的权重，0会被当作1
+     */
+    void SetVolumeLimit(uint64_t volumeId, const QosLimit& limit,
+                        uint32_t weight);
+
+    /**
+     * 卷恢复为默认上限和权重
+     */
+    void ResetVolumeLimit(uint64_t volumeId);
+
+ private:
+    struct Pending {
+        QosRequest request;
+        Task task;
+    };
+
+    struct ClientState {
+        QosLimiter limiter;
+        uint64_t lastActiveUs = 0;
+    };
+
+    struct VolumeState {
+        QosLimiter limiter;
+        uint32_t weight = 1;
+        // 是否单独设置过上限
+        bool custom = false;
+        // 卷上最后一个请求的虚拟完成时间
+        double finishTag = 0;
+        uint64_t lastActiveUs = 0;
+        std::deque<Pending> queue;
+    };
+
+    // 以下函数调用时需要持有mtx_
+    VolumeState* GetVolume(uint64_t volumeId, uint64_t nowUs);
+    ClientState* GetClient(const std::string& client, uint64_t nowUs);
+    // 请求取得令牌并推进卷的虚拟时间
+    void Dispatch(VolumeState* volume, ClientState* client,
+                  const QosRequest& request);
+    // 在队首请求可以下发的卷中选出虚拟完成时间最小的卷，
+    // 没有时返回nullptr，waitUs为最多需要等待的时间
+    VolumeState* PickVolume(uint64_t nowUs, uint64_t* waitUs);
+    void CleanIdle(uint64_t nowUs);
+
+    // 后台线程只负责调度，下发的请求在bthread中执行，
+    // 避免请求中阻塞的读盘或者propose拖慢后续请求的下发
+    void RunInBthread(Task task);
+    static void* RunTask(void* arg);
+
+    void Run();
+
+ private:
+    QosSchedulerOptions options_;
+    // Submit在brpc的bthread中调用，使用bthread的锁避免阻塞worker线程
+    bthread::Mutex mtx_;
+    bthread::ConditionVariable cond_;
+    std::thread worker_;
+    std::atomic<bool> running_;
+
+    QosLimiter disk_;
+    std::unordered_map<uint64_t, VolumeState> volumes_;
+    std::unordered_map<std::string, ClientState> clients_;
+    // 系统的虚拟时间，即最后下发的请求的开始时间
+    double virtualTime_;
+    // 排队中的请求数
+    uint64_t queued_;
+    // 已经下发到bthread中还没有执行完的请求数
+    uint64_t runningTasks_;
+    uint64_t lastCleanUs_;
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_QOS_SCHEDULER_H_
@@ -0,0 +1,256 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <glog/logging.h>
+#include <braft/configuration_manager.h>
+
+#include <map>
+#include <mutex>    // NOLINT
+
+#include "src/chunkserver/raftlog/curve_shared_log_storage.h"
+#include "src/chunkserver/raftsnapshot/define.h"
+
+namespace curve {
+namespace chunkserver {
+
+const char kSharedLogProtocol[] = "curve_shared";
+const char kSharedLogDir[] = "raftlog";
+
+namespace {
+
+// 同一块盘上的复制组共享同一个日志流，按copysets目录索引
+std::mutex gStreamMtx;
+std::map<std::string, std::shared_ptr<SharedLogStream>> gStreams;
+std::shared_ptr<LocalFileSystem> gFs;
+
+std::string TrimPath(std::string path) {
+    while (path.size() > 1 && path.back() == '/') {
+        path.pop_back();
+    }
+    return path;
+}
+
+// 拆分路径的父目录和最后一级名字
+void SplitPath(const std::string& path, std::string* parent,
+               std::string* name) {
+    size_t pos = path.find_last_of('/');
+    if (pos == std::string::npos) {
+        *parent = ".";
+        *name = path;
+    } else {
+        *parent = pos == 0 ? "/" : path.substr(0, pos);
+        *name = path.substr(pos + 1);
+    }
+}
+
+}  // namespace
+
+void CurveSharedLogStorage::set_file_system(
+    std::shared_ptr<LocalFileSystem> fs) {
+    std::lock_guard<std::mutex> lk(gStreamMtx);
+    gFs = fs;
+}
+
+std::shared_ptr<SharedLogStream> CurveSharedLogStorage::GetStream(
+    const std::string& copysetsPath) {
+    std::string base = TrimPath(copysetsPath);
+    std::lock_guard<std::mutex> lk(gStreamMtx);
+    auto iter = gStreams.find(base);
+    if (iter != gStreams.end()) {
+        return iter->second;
+    }
+    if (gFs == nullptr) {
+        LOG(ERROR) << "Shared log storage is not registered";
+        return nullptr;
+    }
+    std::string parent, name;
+    SplitPath(base, &parent, &name);
+    SharedLogStreamOptions options;
+    options.path = parent + "/" + kSharedLogDir;
+    options.fs = gFs;
+    auto stream = std::make_shared<SharedLogStream>(options);
+    if (stream->Init() != 0) {
+        LOG(ERROR) << "Failed to init shared log " << options.path;
+        return nullptr;
+    }
+    gStreams[base] = stream;
+    return stream;
+}
+
+braft::LogStorage* CurveSharedLogStorage::new_instance(
+    const std::string& uri) const {
+    // uri为${copysets目录}/${groupId}/log
+    std::string path = TrimPath(uri);
+    std::string groupPath, logDir;
+    SplitPath(path, &groupPath, &logDir);
+    if (logDir != RAFT_LOG_DIR) {
+        LOG(ERROR) << "Invalid shared log uri " << uri;
+        return nullptr;
+    }
+    std::string copysetsPath, groupName;
+    SplitPath(groupPath, &copysetsPath, &groupName);
+    char* end = nullptr;
+    GroupNid group = strtoull(groupName.c_str(), &end, 10);
+    if (groupName.empty() || *end != '\0') {
+        LOG(ERROR) << "Invalid group id in shared log uri " << uri;
+        return nullptr;
+    }
+    std::shared_ptr<SharedLogStream> stream = GetStream(copysetsPath);
+    if (stream == nullptr) {
+        return nullptr;
+    }
+    return new CurveSharedLogStorage(stream, group);
+}
+
+int CurveSharedLogStorage::DropGroup(const std::string& logUri,
+                                     GroupNid group) {
+    std::string prefix = std::string(kSharedLogProtocol) + "://";
+    if (logUri.compare(0, prefix.size(), prefix) != 0) {
+        return 0;
+    }
+    std::shared_ptr<SharedLogStream> stream =
+        GetStream(logUri.substr(prefix.size()));
+    if (stream == nullptr) {
+        return -1;
+    }
+    return stream->DropGroup(group);
+}
+
+int CurveSharedLogStorage::init(
+    braft::ConfigurationManager* configurationManager) {
+    // 加载所有配置变更日志
+    std::vector<int64_t> indexes;
+    stream_->ListEntries(group_, braft::ENTRY_TYPE_CONFIGURATION, &indexes);
+    for (int64_t index : indexes) {
+        braft::LogEntry* entry = get_entry(index);
+        if (entry == nullptr) {
+            LOG(ERROR) << "Failed to load configuration of group " << group_
+                       << ", index: " << index;
+            return -1;
+        }
+        braft::ConfigurationEntry confEntry(*entry);
+        configurationManager->add(confEntry);
+        entry->Release();
+    }
+    LOG(INFO) << "Init shared log storage of group " << group_
+              << ", first index: " << first_log_index()
+              << ", last index: " << last_log_index();
+    return 0;
+}
+
+int64_t CurveSharedLogStorage::first_log_index() {
+    return stream_->FirstLogIndex(group_);
+}
+
+int64_t CurveSharedLogStorage::last_log_index() {
+    return stream_->LastLogIndex(group_);
+}
+
+braft::LogEntry* CurveSharedLogStorage::get_entry(const int64_t index) {
+    SharedLogEntry sharedEntry;
+    if (stream_->Read(group_, index, &sharedEntry) != 0) {
+        return nullptr;
+    }
+    braft::LogEntry* entry = new braft::LogEntry();
+    entry->AddRef();
+    entry->type = static_cast<braft::EntryType>(sharedEntry.type);
+    entry->id.index = sharedEntry.index;
+    entry->id.term = sharedEntry.term;
+    if (entry->type == braft::ENTRY_TYPE_CONFIGURATION) {
+        butil::Status status =
+            braft::parse_configuration_meta(sharedEntry.data, entry);
+        if (!status.ok()) {
+            LOG(ERROR) << "Failed to parse configuration of group " << group_
+                       << ", index: " << index
+                       << ", error: " << status.error_cstr();
+            entry->Release();
+            return nullptr;
+        }
+    } else {
+        entry->data.swap(sharedEntry.data);
+    }
+    return entry;
+}
+
+int64_t CurveSharedLogStorage::get_term(const int64_t index) {
+    return stream_->GetTerm(group_, index);
+}
+
+int CurveSharedLogStorage::ToSharedLogEntry(const braft::LogEntry* entry,
+                                            SharedLogEntry* sharedEntry) {
+    sharedEntry->index = entry->id.index;
+    sharedEntry->term = entry->id.term;
+    sharedEntry->type = entry->type;
+    if (entry->type == braft::ENTRY_TYPE_CONFIGURATION) {
+        butil::Status status =
+            braft::serialize_configuration_meta(entry, sharedEntry->data);
+        if (!status.ok()) {
+            LOG(ERROR) << "Failed to serialize configuration, index: "
+                       << entry->id.index
+                       << ", error: " << status.error_cstr();
+            return -1;
+        }
+    } else {
+        sharedEntry->data = entry->data;
+    }
+    return 0;
+}
+
+int CurveSharedLogStorage::append_entry(const braft::LogEntry* entry) {
+    SharedLogEntry sharedEntry;
+    if (ToSharedLogEntry(entry, &sharedEntry) != 0) {
+        return -1;
+    }
+    return stream_->Append(group_, {&sharedEntry}) == 1 ? 0 : -1;
+}
+
+int CurveSharedLogStorage::append_entries(
+    const std::vector<braft::LogEntry*>& entries, braft::IOMetric* metric) {
+    std::vector<SharedLogEntry> sharedEntries(entries.size());
+    std::vector<SharedLogEntry*> ptrs;
+    ptrs.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (ToSharedLogEntry(entries[i], &sharedEntries[i]) != 0) {
+            break;
+        }
+        ptrs.push_back(&sharedEntries[i]);
+    }
+    if (ptrs.empty()) {
+        return entries.empty() ? 0 : -1;
+    }
+    return stream_->Append(group_, ptrs);
+}
+
+int CurveSharedLogStorage::truncate_prefix(const int64_t firstIndexKept) {
+    return stream_->TruncatePrefix(group_, firstIndexKept);
+}
+
+int CurveSharedLogStorage::truncate_suffix(const int64_t lastIndexKept) {
+    return stream_->TruncateSuffix(group_, lastIndexKept);
+}
+
+int CurveSharedLogStorage::reset(const int64_t nextLogIndex) {
+    return stream_->Reset(group_, nextLogIndex);
+}
+
+}  // namespace chunkserver
+}  // namespace curve
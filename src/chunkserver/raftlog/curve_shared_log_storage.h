@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_RAFTLOG_CURVE_SHARED_LOG_STORAGE_H_
+#define SRC_CHUNKSERVER_RAFTLOG_CURVE_SHARED_LOG_STORAGE_H_
+
+#include <braft/storage.h>
+#include <braft/log_entry.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "include/chunkserver/chunkserver_common.h"
+#include "src/chunkserver/raftlog/shared_log_stream.h"
+
+namespace curve {
+namespace chunkserver {
+
+// 共享日志在braft中注册的协议名
+extern const char kSharedLogProtocol[];
+// 共享日志流的目录名，与copysets目录在同一级
+extern const char kSharedLogDir[];
+
+/**
+ * 基于SharedLogStream的braft LogStorage
+ * 同一块盘上所有复制组的日志写入同一个共享日志流，每个复制组只维护自己的索引
+ * 复制组的log_uri为curve_shared://${copysets目录}/${groupId}/log，
+ * 日志流位于${copysets目录}/../raftlog
+ */
+class CurveSharedLogStorage : public braft::LogStorage {
+ public:
+    // 用于注册到braft的原型
+    CurveSharedLogStorage() : group_(0) {}
+    CurveSharedLogStorage(std::shared_ptr<SharedLogStream> stream,
+                          GroupNid group)
+        : stream_(stream), group_(group) {}
+    virtual ~CurveSharedLogStorage() {}
+
+    int init(braft::ConfigurationManager* configurationManager) override;
+
+    int64_t first_log_index() override;
+
+    int64_t last_log_index() override;
+
+    braft::LogEntry* get_entry(const int64_t index) override;
+
+    int64_t get_term(const int64_t index) override;
+
+    int append_entry(const braft::LogEntry* entry) override;
+
+    int append_entries(const std::vector<braft::LogEntry*>& entries,
+                       braft::IOMetric* metric) override;
+
+    int truncate_prefix(const int64_t firstIndexKept) override;
+
+    int truncate_suffix(const int64_t lastIndexKept) override;
+
+    int reset(const int64_t nextLogIndex) override;
+
+    braft::LogStorage* new_instance(const std::string& uri) const override;
+
+    /**
+     * 设置日志流使用的本地文件系统，需要在创建复制组之前调用
+     */
+    static void set_file_system(std::shared_ptr<LocalFileSystem> fs);
+
+    /**
+     * 删除复制组在共享日志中的所有日志，复制组被删除时调用
+     * @param logUri: 复制组的log uri的前缀，即copyset.raft_log_uri，
+     *                不是共享日志协议时直接返回
+     * @return 成功返回0，失败返回-1
+     */
+    static int DropGroup(const std::string& logUri, GroupNid group);
+
+ private:
+    // 将braft的日志转换为共享日志中的日志
+    static int ToSharedLogEntry(const braft::LogEntry* entry,
+                                SharedLogEntry* sharedEntry);
+    // 获取copysets目录对应的共享日志流，不存在时打开
+    static std::shared_ptr<SharedLogStream> GetStream(
+        const std::string& copysetsPath);
+
+ private:
+    std::shared_ptr<SharedLogStream> stream_;
+    GroupNid group_;
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_RAFTLOG_CURVE_SHARED_LOG_STORAGE_H_
@@ -0,0 +1,882 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <glog/logging.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "src/chunkserver/raftlog/shared_log_stream.h"
+#include "src/common/crc32.h"
+
+namespace curve {
+namespace chunkserver {
+
+namespace {
+
+const uint32_t kRecordMagic = 0x43534C47;
+/**
+ * 记录头的格式，之后紧跟dataLen字节的数据
+ * |magic(4)|recordType(1)|entryType(1)|reserved(2)|group(8)|index(8)|
+ * |term(8)|dataLen(4)|crc(4)|
+ * crc为记录头中crc之前的部分与数据的CRC32C
+ */
+const size_t kRecordHeaderSize = 40;
+const size_t kRecordCrcOffset = 36;
+const char kSegmentPrefix[] = "segment_";
+// 最老的segment中有效日志的比例不超过该值时整理它
+const double kCompactLiveRatio = 0.25;
+
+struct RecordHeader {
+    uint32_t magic;
+    uint8_t recordType;
+    uint8_t entryType;
+    uint64_t group;
+    int64_t index;
+    int64_t term;
+    uint32_t dataLen;
+    uint32_t crc;
+};
+
+void EncodeHeader(const RecordHeader& header, char* buf) {
+    memset(buf, 0, kRecordHeaderSize);
+    memcpy(buf, &header.magic, 4);
+    buf[4] = header.recordType;
+    buf[5] = header.entryType;
+    memcpy(buf + 8, &header.group, 8);
+    memcpy(buf + 16, &header.index, 8);
+    memcpy(buf + 24, &header.term, 8);
+    memcpy(buf + 32, &header.dataLen, 4);
+    memcpy(buf + 36, &header.crc, 4);
+}
+
+void DecodeHeader(const char* buf, RecordHeader* header) {
+    memcpy(&header->magic, buf, 4);
+    header->recordType = buf[4];
+    header->entryType = buf[5];
+    memcpy(&header->group, buf + 8, 8);
+    memcpy(&header->index, buf + 16, 8);
+    memcpy(&header->term, buf + 24, 8);
+    memcpy(&header->dataLen, buf + 32, 4);
+    memcpy(&header->crc, buf + 36, 4);
+}
+
+// 校验一条完整的记录，buf中包含记录头和数据
+bool CheckRecord(const char* buf, const RecordHeader& header) {
+    uint32_t crc = curve::common::CRC32(buf, kRecordCrcOffset);
+    crc = curve::common::CRC32(crc, buf + kRecordHeaderSize, header.dataLen);
+    return crc == header.crc;
+}
+
+}  // namespace
+
+SharedLogStream::SharedLogStream(const SharedLogStreamOptions& options)
+    : options_(options),
+      fs_(options.fs),
+      broken_(false),
+      committing_(false),
+      syncCount_(0) {}
+
+SharedLogStream::~SharedLogStream() {}
+
+std::string SharedLogStream::SegmentPath(uint64_t seq) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%s%020lu", kSegmentPrefix, seq);
+    return options_.path + "/" + name;
+}
+
+int SharedLogStream::Init() {
+    if (!fs_->DirExists(options_.path)) {
+        int ret = fs_->Mkdir(options_.path);
+        if (ret != 0) {
+            LOG(ERROR) << "Failed to create shared log dir " << options_.path
+                       << ", ret: " << ret;
+            return -1;
+        }
+    }
+
+    std::vector<std::string> names;
+    if (fs_->List(options_.path, &names) != 0) {
+        LOG(ERROR) << "Failed to list shared log dir " << options_.path;
+        return -1;
+    }
+    std::vector<uint64_t> seqs;
+    for (const auto& name : names) {
+        uint64_t seq;
+        if (name.compare(0, strlen(kSegmentPrefix), kSegmentPrefix) != 0
+            || sscanf(name.c_str() + strlen(kSegmentPrefix), "%lu", &seq) != 1) {
+            LOG(WARNING) << "Unknown file " << name << " in shared log dir "
+                         << options_.path;
+            continue;
+        }
+        seqs.push_back(seq);
+    }
+    std::sort(seqs.begin(), seqs.end());
+
+    for (size_t i = 0; i < seqs.size(); ++i) {
+        std::string path = SegmentPath(seqs[i]);
+        int fd = fs_->Open(path, O_RDWR);
+        if (fd < 0) {
+            LOG(ERROR) << "Failed to open shared log segment " << path
+                       << ", ret: " << fd;
+            return -1;
+        }
+        SegmentPtr segment =
+            std::make_shared<SegmentFile>(seqs[i], path, fd, fs_);
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            segments_[seqs[i]] = segment;
+        }
+        if (ReplaySegment(segment, i + 1 == seqs.size()) != 0) {
+            return -1;
+        }
+    }
+
+    std::vector<SegmentPtr> removed;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (const auto& item : groups_) {
+            for (size_t i = 0; i < item.second.entries.size(); ++i) {
+                if (item.second.entries[i].segment == 0) {
+                    LOG(ERROR) << "Shared log of group " << item.first
+                               << " misses entry "
+                               << item.second.firstIndex + i;
+                    return -1;
+                }
+            }
+        }
+        if (!segments_.empty()
+            && segments_.rbegin()->second->size < options_.maxSegmentSize) {
+            active_ = segments_.rbegin()->second;
+        }
+        CollectGarbageLocked(&removed);
+    }
+    RemoveSegments(removed);
+
+    if (active_ == nullptr && RollSegment() != 0) {
+        return -1;
+    }
+    LOG(INFO) << "Init shared log " << options_.path << " success, "
+              << "segments: " << segments_.size()
+              << ", groups: " << groups_.size();
+    return 0;
+}
+
+int SharedLogStream::ReplaySegment(const SegmentPtr& segment, bool isLast) {
+    struct stat info;
+    int ret = fs_->Fstat(segment->fd, &info);
+    if (ret != 0) {
+        LOG(ERROR) << "Failed to stat shared log segment " << segment->path
+                   << ", ret: " << ret;
+        return -1;
+    }
+    uint64_t fileSize = info.st_size;
+    std::string content(fileSize, '\0');
+    uint64_t done = 0;
+    while (done < fileSize) {
+        int length = std::min<uint64_t>(fileSize - done, INT_MAX);
+        ret = fs_->Read(segment->fd, &content[done], done, length);
+        if (ret <= 0) {
+            LOG(ERROR) << "Failed to read shared log segment "
+                       << segment->path << ", ret: " << ret;
+            return -1;
+        }
+        done += ret;
+    }
+
+    uint64_t offset = 0;
+    while (offset + kRecordHeaderSize <= fileSize) {
+        RecordHeader header;
+        DecodeHeader(content.data() + offset, &header);
+        uint64_t length = kRecordHeaderSize + header.dataLen;
+        if (header.magic != kRecordMagic
+            || offset + length > fileSize
+            || !CheckRecord(content.data() + offset, header)) {
+            break;
+        }
+        Record record;
+        record.recordType = static_cast<SharedLogRecordType>(header.recordType);
+        record.entryType = header.entryType;
+        record.group = header.group;
+        record.index = header.index;
+        record.term = header.term;
+        record.length = length;
+        LogLocation location{segment->seq, offset,
+                             static_cast<uint32_t>(length),
+                             header.term, header.entryType};
+        std::lock_guard<std::mutex> lk(mtx_);
+        ApplyRecordLocked(record, location);
+        offset += length;
+    }
+
+    if (offset != fileSize) {
+        if (!isLast) {
+            LOG(ERROR) << "Shared log segment " << segment->path
+                       << " is corrupted at offset " << offset
+                       << ", file size: " << fileSize;
+            return -1;
+        }
+        // 最后一个segment末尾可能有没写完的记录，截断后再接受写入，
+        // 否则新的记录比残留的数据短或者立即切换segment时，
+        // 残留的数据会变成中间segment的损坏
+        LOG(WARNING) << "Shared log segment " << segment->path
+                     << " has incomplete record at offset " << offset
+                     << ", file size: " << fileSize;
+        if (TruncateSegment(segment, offset) != 0) {
+            return -1;
+        }
+    }
+    std::lock_guard<std::mutex> lk(mtx_);
+    segment->size = offset;
+    return 0;
+}
+
+int SharedLogStream::RollSegment() {
+    uint64_t seq = 1;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!segments_.empty()) {
+            seq = segments_.rbegin()->first + 1;
+        }
+    }
+    std::string path = SegmentPath(seq);
+    int fd = fs_->Open(path, O_RDWR | O_CREAT);
+    if (fd < 0) {
+        LOG(ERROR) << "Failed to create shared log segment " << path
+                   << ", ret: " << fd;
+        return -1;
+    }
+    SegmentPtr segment = std::make_shared<SegmentFile>(seq, path, fd, fs_);
+    // 目录项落盘后才能在新的segment中写入，否则掉电后已经返回成功的日志可能丢失
+    if (SyncDir() != 0) {
+        return -1;
+    }
+    std::vector<SegmentPtr> removed;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        segments_[seq] = segment;
+        active_ = segment;
+        // 切换segment后原来的segment可能可以回收了
+        CollectGarbageLocked(&removed);
+    }
+    RemoveSegments(removed);
+    return 0;
+}
+
+int64_t SharedLogStream::FirstLogIndex(uint64_t group) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto iter = groups_.find(group);
+    if (iter == groups_.end()) {
+        return 1;
+    }
+    return iter->second.firstIndex;
+}
+
+int64_t SharedLogStream::LastLogIndex(uint64_t group) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto iter = groups_.find(group);
+    if (iter == groups_.end()) {
+        return 0;
+    }
+    return iter->second.firstIndex + iter->second.entries.size() - 1;
+}
+
+int64_t SharedLogStream::GetTerm(uint64_t group, int64_t index) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto iter = groups_.find(group);
+    if (iter == groups_.end()) {
+        return 0;
+    }
+    const GroupLog& log = iter->second;
+    if (index < log.firstIndex
+        || index >= log.firstIndex + static_cast<int64_t>(log.entries.size())) {
+        return 0;
+    }
+    return log.entries[index - log.firstIndex].term;
+}
+
+void SharedLogStream::ListEntries(uint64_t group, int type,
+                                  std::vector<int64_t>* indexes) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto iter = groups_.find(group);
+    if (iter == groups_.end()) {
+        return;
+    }
+    const GroupLog& log = iter->second;
+    for (size_t i = 0; i < log.entries.size(); ++i) {
+        if (log.entries[i].type == type) {
+            indexes->push_back(log.firstIndex + i);
+        }
+    }
+}
+
+int SharedLogStream::Read(uint64_t group, int64_t index,
+                          SharedLogEntry* entry) {
+    LogLocation location;
+    SegmentPtr segment;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto iter = groups_.find(group);
+        if (iter == groups_.end()) {
+            return -1;
+        }
+        const GroupLog& log = iter->second;
+        if (index < log.firstIndex
+            || index >= log.firstIndex
+                        + static_cast<int64_t>(log.entries.size())) {
+            return -1;
+        }
+        location = log.entries[index - log.firstIndex];
+        segment = segments_[location.segment];
+    }
+    return ReadRecord(segment, location, group, index, entry);
+}
+
+int SharedLogStream::ReadRecord(const SegmentPtr& segment,
+                                const LogLocation& location,
+                                uint64_t group, int64_t index,
+                                SharedLogEntry* entry) {
+    std::string buf(location.length, '\0');
+    int ret = fs_->Read(segment->fd, &buf[0], location.offset,
+                        location.length);
+    if (ret != static_cast<int>(location.length)) {
+        LOG(ERROR) << "Failed to read shared log " << segment->path
+                   << ", group: " << group << ", index: " << index
+                   << ", ret: " << ret;
+        return -1;
+    }
+    RecordHeader header;
+    DecodeHeader(buf.data(), &header);
+    if (header.magic != kRecordMagic
+        || header.group != group
+        || header.index != index
+        || kRecordHeaderSize + header.dataLen != location.length
+        || !CheckRecord(buf.data(), header)) {
+        LOG(ERROR) << "Shared log record is corrupted, segment: "
+                   << segment->path << ", offset: " << location.offset
+                   << ", group: " << group << ", index: " << index;
+        return -1;
+    }
+    entry->index = index;
+    entry->term = header.term;
+    entry->type = header.entryType;
+    entry->data.clear();
+    entry->data.append(buf.data() + kRecordHeaderSize, header.dataLen);
+    return 0;
+}
+
+void SharedLogStream::EncodeRecord(const Record& record,
+                                   const butil::IOBuf* data,
+                                   CommitRequest* request) {
+    RecordHeader header;
+    header.magic = kRecordMagic;
+    header.recordType = static_cast<uint8_t>(record.recordType);
+    header.entryType = record.entryType;
+    header.group = record.group;
+    header.index = record.index;
+    header.term = record.term;
+    header.dataLen = data == nullptr ? 0 : data->size();
+    header.crc = 0;
+
+    char buf[kRecordHeaderSize];
+    EncodeHeader(header, buf);
+    uint32_t crc = curve::common::CRC32(buf, kRecordCrcOffset);
+    if (data != nullptr) {
+        for (size_t i = 0; i < data->backing_block_num(); ++i) {
+            auto block = data->backing_block(i);
+            crc = curve::common::CRC32(crc, block.data(), block.size());
+        }
+    }
+    header.crc = crc;
+    EncodeHeader(header, buf);
+
+    request->buf.append(buf, kRecordHeaderSize);
+    if (data != nullptr) {
+        request->buf.append(*data);
+    }
+    request->records.push_back(record);
+    request->records.back().length = kRecordHeaderSize + header.dataLen;
+}
+
+int SharedLogStream::Append(uint64_t group,
+                            const std::vector<SharedLogEntry*>& entries) {
+    if (entries.empty()) {
+        return 0;
+    }
+    CommitRequest request;
+    for (auto entry : entries) {
+        Record record;
+        record.recordType = SharedLogRecordType::kEntry;
+        record.entryType = entry->type;
+        record.group = group;
+        record.index = entry->index;
+        record.term = entry->term;
+        EncodeRecord(record, &entry->data, &request);
+    }
+    if (Commit(&request) != 0) {
+        return -1;
+    }
+    return entries.size();
+}
+
+int SharedLogStream::CommitControl(SharedLogRecordType type, uint64_t group,
+                                   int64_t index) {
+    CommitRequest request;
+    Record record;
+    record.recordType = type;
+    record.entryType = 0;
+    record.group = group;
+    record.index = index;
+    record.term = 0;
+    EncodeRecord(record, nullptr, &request);
+    return Commit(&request);
+}
+
+int SharedLogStream::TruncatePrefix(uint64_t group, int64_t firstIndexKept) {
+    return CommitControl(SharedLogRecordType::kTruncatePrefix,
+                         group, firstIndexKept);
+}
+
+int SharedLogStream::TruncateSuffix(uint64_t group, int64_t lastIndexKept) {
+    return CommitControl(SharedLogRecordType::kTruncateSuffix,
+                         group, lastIndexKept);
+}
+
+int SharedLogStream::Reset(uint64_t group, int64_t nextLogIndex) {
+    return CommitControl(SharedLogRecordType::kReset, group, nextLogIndex);
+}
+
+int SharedLogStream::DropGroup(uint64_t group) {
+    return CommitControl(SharedLogRecordType::kDropGroup, group, 0);
+}
+
+size_t SharedLogStream::SegmentCount() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return segments_.size();
+}
+
+int SharedLogStream::Commit(CommitRequest* request) {
+    std::unique_lock<bthread::Mutex> lk(commitMtx_);
+    pending_.push_back(request);
+    while (!request->done && committing_) {
+        commitCv_.wait(lk);
+    }
+    if (request->done) {
+        return request->ret;
+    }
+
+    // 没有线程在提交，由当前线程提交所有积攒的请求
+    committing_ = true;
+    std::vector<CommitRequest*> batch;
+    batch.swap(pending_);
+    lk.unlock();
+
+    int ret = WriteBatch(batch);
+
+    lk.lock();
+    for (auto req : batch) {
+        req->ret = ret;
+        req->done = true;
+    }
+    commitCv_.notify_all();
+    lk.unlock();
+
+    // 整理时索引只会被当前线程修改，交还提交权之前进行
+    if (ret == 0) {
+        CompactOldest();
+    }
+
+    lk.lock();
+    committing_ = false;
+    commitCv_.notify_all();
+    return request->ret;
+}
+
+int SharedLogStream::CompactOldest() {
+    SegmentPtr oldest;
+    std::vector<std::pair<uint64_t, int64_t>> anchors;
+    std::vector<std::pair<uint64_t, int64_t>> entries;
+    std::vector<LogLocation> locations;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (segments_.size() < 2) {
+            return 0;
+        }
+        oldest = segments_.begin()->second;
+        if (oldest == active_ || oldest->live == 0
+            || oldest->liveBytes > oldest->size * kCompactLiveRatio) {
+            return 0;
+        }
+        // anchor只有一条控制记录，总是全部重写；日志达到上限后留到下次提交
+        uint64_t bytes = 0;
+        for (const auto& item : groups_) {
+            const GroupLog& log = item.second;
+            if (log.anchor == oldest->seq) {
+                anchors.emplace_back(item.first, log.firstIndex);
+            }
+            for (size_t i = 0; i < log.entries.size()
+                 && bytes < options_.maxCompactBytes; ++i) {
+                if (log.entries[i].segment == oldest->seq) {
+                    entries.emplace_back(item.first, log.firstIndex + i);
+                    locations.push_back(log.entries[i]);
+                    bytes += log.entries[i].length;
+                }
+            }
+        }
+    }
+
+    // anchor以截断前缀记录的形式重写，日志以搬迁记录的形式重写
+    CommitRequest request;
+    for (const auto& anchor : anchors) {
+        Record record;
+        record.recordType = SharedLogRecordType::kTruncatePrefix;
+        record.entryType = 0;
+        record.group = anchor.first;
+        record.index = anchor.second;
+        record.term = 0;
+        EncodeRecord(record, nullptr, &request);
+    }
+    for (size_t i = 0; i < entries.size(); ++i) {
+        SharedLogEntry entry;
+        if (ReadRecord(oldest, locations[i], entries[i].first,
+                       entries[i].second, &entry) != 0) {
+            return -1;
+        }
+        Record record;
+        record.recordType = SharedLogRecordType::kRelocate;
+        record.entryType = entry.type;
+        record.group = entries[i].first;
+        record.index = entry.index;
+        record.term = entry.term;
+        EncodeRecord(record, &entry.data, &request);
+    }
+    int ret = WriteBatch({&request});
+    if (ret != 0) {
+        LOG(ERROR) << "Failed to compact shared log segment " << oldest->path;
+        return -1;
+    }
+    LOG(INFO) << "Compact shared log segment " << oldest->path
+              << ", anchors: " << anchors.size()
+              << ", entries: " << entries.size();
+    return 0;
+}
+
+int SharedLogStream::WriteBatch(const std::vector<CommitRequest*>& batch) {
+    if (broken_) {
+        LOG(ERROR) << "Shared log " << options_.path
+                   << " failed to recover from a write error";
+        return -1;
+    }
+    uint64_t total = 0;
+    for (auto req : batch) {
+        total += req->buf.size();
+    }
+    if (active_->size > 0 && active_->size + total > options_.maxSegmentSize) {
+        if (RollSegment() != 0) {
+            return -1;
+        }
+    }
+
+    uint64_t offset = active_->size;
+    std::vector<struct iovec> iovs;
+    for (auto req : batch) {
+        for (size_t i = 0; i < req->buf.backing_block_num(); ++i) {
+            auto block = req->buf.backing_block(i);
+            if (block.size() == 0) {
+                continue;
+            }
+            struct iovec iov;
+            iov.iov_base = const_cast<char*>(block.data());
+            iov.iov_len = block.size();
+            iovs.push_back(iov);
+        }
+    }
+    size_t start = 0;
+    uint64_t writeOffset = offset;
+    while (start < iovs.size()) {
+        int count = std::min<size_t>(iovs.size() - start, IOV_MAX);
+        uint64_t length = 0;
+        for (int i = 0; i < count; ++i) {
+            length += iovs[start + i].iov_len;
+        }
+        int ret = fs_->Writev(active_->fd, &iovs[start], count, writeOffset);
+        if (ret < 0 || static_cast<uint64_t>(ret) != length) {
+            LOG(ERROR) << "Failed to write shared log " << active_->path
+                       << ", offset: " << writeOffset
+                       << ", length: " << length << ", ret: " << ret;
+            DiscardTail(offset);
+            return -1;
+        }
+        start += count;
+        writeOffset += length;
+    }
+    int ret = fs_->Fdatasync(active_->fd);
+    if (ret != 0) {
+        LOG(ERROR) << "Failed to sync shared log " << active_->path
+                   << ", ret: " << ret;
+        DiscardTail(offset);
+        return -1;
+    }
+    syncCount_.fetch_add(1, std::memory_order_relaxed);
+
+    // 落盘以后更新索引，之后才能被读到
+    std::vector<SegmentPtr> removed;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (auto req : batch) {
+            for (const auto& record : req->records) {
+                LogLocation location{active_->seq, offset, record.length,
+                                     record.term, record.entryType};
+                ApplyRecordLocked(record, location);
+                offset += record.length;
+            }
+        }
+        active_->size = offset;
+        CollectGarbageLocked(&removed);
+    }
+    RemoveSegments(removed);
+    return 0;
+}
+
+int SharedLogStream::TruncateSegment(const SegmentPtr& segment,
+                                     uint64_t size) {
+    int ret = fs_->Ftruncate(segment->fd, size);
+    if (ret != 0) {
+        LOG(ERROR) << "Failed to truncate shared log segment "
+                   << segment->path << " to " << size << ", ret: " << ret;
+        return -1;
+    }
+    ret = fs_->Fsync(segment->fd);
+    if (ret != 0) {
+        LOG(ERROR) << "Failed to sync shared log segment " << segment->path
+                   << " after truncate, ret: " << ret;
+        return -1;
+    }
+    return 0;
+}
+
+void SharedLogStream::DiscardTail(uint64_t size) {
+    // 写入失败的数据可能部分落盘，截断后之后的写入才能从size开始，
+    // 截断失败时不再接受写入，避免残留的数据在重启时被当作损坏
+    if (TruncateSegment(active_, size) != 0) {
+        broken_ = true;
+    }
+}
+
+int SharedLogStream::SyncDir() {
+    int fd = fs_->Open(options_.path, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        LOG(ERROR) << "Failed to open shared log dir " << options_.path
+                   << ", ret: " << fd;
+        return -1;
+    }
+    int ret = fs_->Fsync(fd);
+    fs_->Close(fd);
+    if (ret != 0) {
+        LOG(ERROR) << "Failed to sync shared log dir " << options_.path
+                   << ", ret: " << ret;
+        return -1;
+    }
+    return 0;
+}
+
+void SharedLogStream::ReleaseLocked(GroupLog* log, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        auto iter = segments_.find(log->entries[i].segment);
+        if (iter != segments_.end()) {
+            --iter->second->live;
+            iter->second->liveBytes -= log->entries[i].length;
+        }
+    }
+}
+
+void SharedLogStream::AddLiveLocked(const LogLocation& location) {
+    SegmentPtr& segment = segments_[location.segment];
+    ++segment->live;
+    segment->liveBytes += location.length;
+}
+
+void SharedLogStream::SetAnchorLocked(GroupLog* log, uint64_t segment) {
+    if (log->anchor != 0) {
+        auto iter = segments_.find(log->anchor);
+        if (iter != segments_.end()) {
+            --iter->second->live;
+        }
+    }
+    log->anchor = segment;
+    if (segment != 0) {
+        ++segments_[segment]->live;
+    }
+}
+
+void SharedLogStream::ApplyRecordLocked(const Record& record,
+                                        const LogLocation& location) {
+    switch (record.recordType) {
+    case SharedLogRecordType::kEntry: {
+        auto iter = groups_.find(record.group);
+        if (iter == groups_.end()) {
+            iter = groups_.emplace(record.group, GroupLog()).first;
+            iter->second.firstIndex = record.index;
+        }
+        GroupLog& log = iter->second;
+        int64_t lastIndex = log.firstIndex + log.entries.size() - 1;
+        if (record.index < log.firstIndex) {
+            // 已经被删除的日志，回放时直接跳过
+            LOG(WARNING) << "Skip shared log entry of group " << record.group
+                         << ", index: " << record.index
+                         << ", first index: " << log.firstIndex;
+            return;
+        }
+        if (record.index > lastIndex + 1) {
+            LOG(WARNING) << "Shared log entry of group " << record.group
+                         << " is not continuous, index: " << record.index
+                         << ", last index: " << lastIndex;
+            ReleaseLocked(&log, 0, log.entries.size());
+            log.entries.clear();
+            log.firstIndex = record.index;
+        } else if (record.index <= lastIndex) {
+            // 覆盖之前的日志，先删除index之后的日志
+            size_t keep = record.index - log.firstIndex;
+            ReleaseLocked(&log, keep, log.entries.size());
+            log.entries.resize(keep);
+        }
+        log.entries.push_back(location);
+        AddLiveLocked(location);
+        break;
+    }
+    case SharedLogRecordType::kRelocate: {
+        auto iter = groups_.find(record.group);
+        if (iter == groups_.end()) {
+            iter = groups_.emplace(record.group, GroupLog()).first;
+        }
+        GroupLog& log = iter->second;
+        if (log.entries.empty()) {
+            log.firstIndex = record.index;
+        }
+        /**
+         * 运行时搬迁的日志一定在索引中，只需要更新位置；回放时原来的segment
+         * 已经删除，复制组中更新的日志可能先被回放，中间还没有回放到的日志
+         * 用空位占住，回放结束时所有空位都会被填上
+         */
+        LogLocation hole{0, 0, 0, 0, 0};
+        if (record.index < log.firstIndex) {
+            log.entries.insert(log.entries.begin(),
+                               log.firstIndex - record.index, hole);
+            log.firstIndex = record.index;
+        }
+        int64_t lastIndex = log.firstIndex + log.entries.size() - 1;
+        if (record.index > lastIndex) {
+            log.entries.insert(log.entries.end(),
+                               record.index - lastIndex, hole);
+        }
+        size_t pos = record.index - log.firstIndex;
+        ReleaseLocked(&log, pos, pos + 1);
+        log.entries[pos] = location;
+        AddLiveLocked(location);
+        break;
+    }
+    case SharedLogRecordType::kTruncatePrefix: {
+        GroupLog& log = groups_[record.group];
+        size_t count = std::min<int64_t>(
+            std::max<int64_t>(record.index - log.firstIndex, 0),
+            log.entries.size());
+        ReleaseLocked(&log, 0, count);
+        log.entries.erase(log.entries.begin(), log.entries.begin() + count);
+        log.firstIndex = std::max(log.firstIndex, record.index);
+        SetAnchorLocked(&log, location.segment);
+        break;
+    }
+    case SharedLogRecordType::kTruncateSuffix: {
+        auto iter = groups_.find(record.group);
+        if (iter == groups_.end()) {
+            return;
+        }
+        GroupLog& log = iter->second;
+        size_t keep = std::min<int64_t>(
+            std::max<int64_t>(record.index - log.firstIndex + 1, 0),
+            log.entries.size());
+        ReleaseLocked(&log, keep, log.entries.size());
+        log.entries.resize(keep);
+        break;
+    }
+    case SharedLogRecordType::kReset: {
+        GroupLog& log = groups_[record.group];
+        ReleaseLocked(&log, 0, log.entries.size());
+        log.entries.clear();
+        log.firstIndex = record.index;
+        SetAnchorLocked(&log, location.segment);
+        break;
+    }
+    case SharedLogRecordType::kDropGroup: {
+        auto iter = groups_.find(record.group);
+        if (iter == groups_.end()) {
+            return;
+        }
+        ReleaseLocked(&iter->second, 0, iter->second.entries.size());
+        SetAnchorLocked(&iter->second, 0);
+        groups_.erase(iter);
+        break;
+    }
+    default:
+        LOG(ERROR) << "Unknown shared log record type "
+                   << static_cast<int>(record.recordType);
+        break;
+    }
+}
+
+void SharedLogStream::CollectGarbageLocked(std::vector<SegmentPtr>* removed) {
+    // 只从最老的segment开始回收，保证控制记录不会先于它影响的日志被删除
+    while (!segments_.empty()) {
+        SegmentPtr oldest = segments_.begin()->second;
+        if (oldest == active_ || oldest->live > 0) {
+            break;
+        }
+        segments_.erase(segments_.begin());
+        removed->push_back(oldest);
+    }
+}
+
+void SharedLogStream::RemoveSegments(const std::vector<SegmentPtr>& removed) {
+    if (removed.empty()) {
+        return;
+    }
+    for (const auto& segment : removed) {
+        int ret = fs_->Delete(segment->path);
+        if (ret != 0) {
+            LOG(ERROR) << "Failed to delete shared log segment "
+                       << segment->path << ", ret: " << ret;
+            continue;
+        }
+        LOG(INFO) << "Delete shared log segment " << segment->path;
+    }
+    // 删除的segment没有有效日志，目录项落盘失败只会导致重启时多回放它们
+    SyncDir();
+}
+
+}  // namespace chunkserver
+}  // namespace curve
@@ -0,0 +1,298 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_RAFTLOG_SHARED_LOG_STREAM_H_
+#define SRC_CHUNKSERVER_RAFTLOG_SHARED_LOG_STREAM_H_
+
+#include <butil/iobuf.h>
+#include <bthread/mutex.h>
+#include <bthread/condition_variable.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>    // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "src/fs/local_filesystem.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::fs::LocalFileSystem;
+
+// 共享日志中记录的类型
+enum class SharedLogRecordType : uint8_t {
+    // raft日志
+    kEntry = 1,
+    // 删除index之前的日志
+    kTruncatePrefix = 2,
+    // 删除index之后的日志
+    kTruncateSuffix = 3,
+    // 删除所有日志，下一条日志的index为index
+    kReset = 4,
+    // 删除复制组的所有日志
+    kDropGroup = 5,
+    // 整理segment时搬迁到新位置的raft日志
+    kRelocate = 6,
+};
+
+/**
+ * 写入共享日志的raft日志
+ */
+struct SharedLogEntry {
+    int64_t index = 0;
+    int64_t term = 0;
+    // raft日志的类型，由使用者解释
+    int type = 0;
+    butil::IOBuf data;
+};
+
+struct SharedLogStreamOptions {
+    // 共享日志所在的目录
+    std::string path;
+    // 单个segment文件的最大大小，超过后切换到新的文件
+    uint64_t maxSegmentSize = 64 * 1024 * 1024;
+    // 每次提交后整理最老的segment时最多搬迁的日志字节数，
+    // 整理期间其他复制组的追加需要等待，分多次提交完成整理
+    uint64_t maxCompactBytes = 1024 * 1024;
+    std::shared_ptr<LocalFileSystem> fs;
+};
+
+/**
+ * 同一块盘上所有复制组共享的raft日志流
+ * 1.所有复制组的日志追加到同一组segment文件中，并发的追加请求合并成一次写和一次
+ *   fdatasync（group commit），避免每个复制组各自对不同的文件做小的fsync
+ * 2.内存中为每个复制组维护index到日志位置的索引，截断和重置操作以控制记录的形式
+ *   写入日志流，重启时按顺序回放所有segment重建索引
+ * 3.segment按顺序回收，最老的segment中没有任何复制组的有效日志时删除，
+ *   保证控制记录删除时它影响的日志都已经删除
+ * 4.最老的segment中有效日志较少时，将其中的有效日志和anchor重写到当前segment，
+ *   避免空闲复制组的少量日志使之后的segment都无法回收，每次提交后最多搬迁
+ *   maxCompactBytes字节，避免长时间阻塞追加
+ */
+class SharedLogStream {
+ public:
+    explicit SharedLogStream(const SharedLogStreamOptions& options);
+    ~SharedLogStream();
+
+    /**
+     * 回放已有的segment，重建所有复制组的索引
+     * @return 成功返回0，失败返回-1
+     */
+    int Init();
+
+    /**
+     * 复制组的第一条日志的index，没有日志时为LastLogIndex() + 1
+     */
+    int64_t FirstLogIndex(uint64_t group);
+
+    /**
+     * 复制组的最后一条日志的index
+     */
+    int64_t LastLogIndex(uint64_t group);
+
+    /**
+     * 获取日志的term，日志不存在时返回0
+     */
+    int64_t GetTerm(uint64_t group, int64_t index);
+
+    /**
+     * 读取一条日志
+     * @return 成功返回0，日志不存在或者读取失败返回-1
+     */
+    int Read(uint64_t group, int64_t index, SharedLogEntry* entry);
+
+    /**
+     * 获取复制组中指定类型的所有日志的index，用于加载配置变更日志
+     */
+    void ListEntries(uint64_t group, int type, std::vector<int64_t>* indexes);
+
+    /**
+     * 追加一批日志，返回时日志已经落盘，与其他复制组的追加请求一起提交
+     * 日志的index需要连续，不大于最后一条日志的index时先删除之后的日志
+     * @return 成功返回追加的日志数，失败返回-1
+     */
+    int Append(uint64_t group, const std::vector<SharedLogEntry*>& entries);
+
+    /**
+     * 删除[FirstLogIndex, firstIndexKept)之间的日志
+     */
+    int TruncatePrefix(uint64_t group, int64_t firstIndexKept);
+
+    /**
+     * 删除(lastIndexKept, LastLogIndex]之间的日志
+     */
+    int TruncateSuffix(uint64_t group, int64_t lastIndexKept);
+
+    /**
+     * 删除所有日志，并将下一条日志的index设置为nextLogIndex
+     */
+    int Reset(uint64_t group, int64_t nextLogIndex);
+
+    /**
+     * 删除复制组的所有日志，复制组被删除时调用
+     */
+    int DropGroup(uint64_t group);
+
+    /**
+     * 当前的segment文件数
+     */
+    size_t SegmentCount();
+
+    /**
+     * 累计的fdatasync次数，用于观察group commit的效果
+     */
+    uint64_t SyncCount() const {
+        return syncCount_.load(std::memory_order_relaxed);
+    }
+
+ private:
+    // 日志在共享日志流中的位置
+    struct LogLocation {
+        // segment的序号从1开始，0表示回放过程中还没有读到的日志
+        uint64_t segment;
+        uint64_t offset;
+        uint32_t length;
+        int64_t term;
+        uint8_t type;
+    };
+
+    struct GroupLog {
+        int64_t firstIndex = 1;
+        // entries[i]为index是firstIndex + i的日志
+        std::deque<LogLocation> entries;
+        // 最近一条截断前缀或者重置记录所在的segment，0表示没有
+        // 复制组没有日志时firstIndex只能从这条记录恢复，所以它所在的segment不能回收
+        uint64_t anchor = 0;
+    };
+
+    struct SegmentFile {
+        SegmentFile(uint64_t s, const std::string& p, int f,
+                    std::shared_ptr<LocalFileSystem> lfs)
+            : seq(s), path(p), fd(f), size(0), live(0), liveBytes(0),
+              fs(lfs) {}
+        ~SegmentFile() {
+            fs->Close(fd);
+        }
+
+        uint64_t seq;
+        std::string path;
+        int fd;
+        // 以下成员由mtx_保护
+        uint64_t size;
+        // 文件中仍被复制组索引引用的日志数和anchor数
+        uint64_t live;
+        // 文件中仍被引用的日志的字节数
+        uint64_t liveBytes;
+        std::shared_ptr<LocalFileSystem> fs;
+    };
+    using SegmentPtr = std::shared_ptr<SegmentFile>;
+
+    // 一条待写入的记录
+    struct Record {
+        SharedLogRecordType recordType;
+        uint8_t entryType;
+        uint64_t group;
+        int64_t index;
+        int64_t term;
+        uint32_t length;
+    };
+
+    // 一次提交请求，来自同一个复制组
+    struct CommitRequest {
+        std::vector<Record> records;
+        butil::IOBuf buf;
+        int ret = 0;
+        bool done = false;
+    };
+
+    // 将记录编码到请求中
+    static void EncodeRecord(const Record& record, const butil::IOBuf* data,
+                             CommitRequest* request);
+    // 写入控制记录
+    int CommitControl(SharedLogRecordType type, uint64_t group, int64_t index);
+    // group commit，当前没有线程在提交时由自己提交积攒的所有请求
+    int Commit(CommitRequest* request);
+    // 将一批请求写入当前的segment并落盘
+    int WriteBatch(const std::vector<CommitRequest*>& batch);
+    // 最老的segment中有效日志较少时，将有效日志和anchor重写到当前segment，
+    // 每次最多搬迁maxCompactBytes字节，全部搬迁后最老的segment即可回收，
+    // 只能由正在提交的线程调用
+    int CompactOldest();
+    // 读取并校验一条日志记录
+    int ReadRecord(const SegmentPtr& segment, const LogLocation& location,
+                   uint64_t group, int64_t index, SharedLogEntry* entry);
+    // 创建新的segment并作为当前写入的segment
+    int RollSegment();
+    // 将segment截断到size并落盘
+    int TruncateSegment(const SegmentPtr& segment, uint64_t size);
+    // 写入失败后丢弃当前segment在size之后的数据
+    void DiscardTail(uint64_t size);
+    // 将segment的创建和删除落盘
+    int SyncDir();
+    // 回放一个segment，isLast表示是否是最后一个segment，允许末尾不完整
+    int ReplaySegment(const SegmentPtr& segment, bool isLast);
+    // 在持有mtx_的情况下将记录应用到索引
+    void ApplyRecordLocked(const Record& record, const LogLocation& location);
+    // 在持有mtx_的情况下删除索引中[begin, end)位置的日志
+    void ReleaseLocked(GroupLog* log, size_t begin, size_t end);
+    // 在持有mtx_的情况下增加日志所在segment的引用
+    void AddLiveLocked(const LogLocation& location);
+    // 在持有mtx_的情况下更新复制组的anchor，segment为0时只释放原来的anchor
+    void SetAnchorLocked(GroupLog* log, uint64_t segment);
+    // 在持有mtx_的情况下取出可以删除的segment
+    void CollectGarbageLocked(std::vector<SegmentPtr>* removed);
+    // 删除取出的segment文件
+    void RemoveSegments(const std::vector<SegmentPtr>& removed);
+    std::string SegmentPath(uint64_t seq) const;
+
+ private:
+    SharedLogStreamOptions options_;
+    std::shared_ptr<LocalFileSystem> fs_;
+
+    // 保护索引和segment列表
+    std::mutex mtx_;
+    std::unordered_map<uint64_t, GroupLog> groups_;
+    std::map<uint64_t, SegmentPtr> segments_;
+
+    // 以下成员只被正在提交的线程访问
+    SegmentPtr active_;
+    // 写入失败后没能截断残留的数据，不再接受写入
+    bool broken_;
+
+    // group commit的状态，提交请求来自braft的bthread，等待时不能阻塞worker线程
+    bthread::Mutex commitMtx_;
+    bthread::ConditionVariable commitCv_;
+    std::vector<CommitRequest*> pending_;
+    bool committing_;
+
+    std::atomic<uint64_t> syncCount_;
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_RAFTLOG_SHARED_LOG_STREAM_H_
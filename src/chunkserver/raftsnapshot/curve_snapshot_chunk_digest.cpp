@@ -0,0 +1,262 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-24
+ * Author: curve
+ */
+
+#include "src/chunkserver/raftsnapshot/curve_snapshot_chunk_digest.h"
+
+#include <glog/logging.h>
+#include <butil/iobuf.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "src/chunkserver/datastore/chunkserver_chunkfile.h"
+#include "src/common/bitmap.h"
+#include "src/common/crc32.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::common::Bitmap;
+
+int CurveSnapshotChunkDigest::FillMeta(const char* metaPage,
+                                       uint64_t fileSize,
+                                       ChunkDigest* digest) {
+    ChunkFileMetaPage meta;
+    if (meta.decode(metaPage) != CSErrorCode::Success) {
+        return -1;
+    }
+    digest->set_sn(meta.sn);
+    digest->set_correctedsn(meta.correctedSn);
+    digest->set_filesize(fileSize);
+    if (meta.bitmap != nullptr) {
+        uint32_t bits = meta.bitmap->Size();
+        digest->set_bitmapbits(bits);
+        digest->set_bitmap(meta.bitmap->GetBitmap(), (bits + 8 - 1) >> 3);
+    } else {
+        digest->clear_bitmapbits();
+        digest->clear_bitmap();
+    }
+    return 0;
+}
+
+int CurveSnapshotChunkDigest::Build(braft::FileSystemAdaptor* fs,
+                                    const std::string& path,
+                                    uint32_t blockSize,
+                                    bool withCrc,
+                                    ChunkDigest* digest) {
+    butil::File::Error e;
+    braft::FileAdaptor* file = fs->open(path, O_RDONLY | O_CLOEXEC, NULL, &e);
+    if (file == NULL) {
+        LOG(WARNING) << "Fail to open " << path
+                     << " : " << butil::File::ErrorToString(e);
+        return -1;
+    }
+    int ret = BuildFromFile(file, path, blockSize, withCrc, digest);
+    file->close();
+    delete file;
+    return ret;
+}
+
+int CurveSnapshotChunkDigest::BuildFromFile(braft::FileAdaptor* file,
+                                            const std::string& path,
+                                            uint32_t blockSize,
+                                            bool withCrc,
+                                            ChunkDigest* digest) {
+    ssize_t fileSize = file->size();
+    if (fileSize <= 0 || blockSize == 0) {
+        LOG(WARNING) << "Invalid chunk file size " << fileSize
+                     << " or block size " << blockSize << ", path: " << path;
+        return -1;
+    }
+    digest->clear_blockcrc();
+    uint32_t count = (fileSize + blockSize - 1) / blockSize;
+    std::string buf;
+    for (uint32_t index = 0; index < count; ++index) {
+        // 第0个块包含metapage，先解析出元数据，之后根据bitmap计算每个块的crc
+        if (index > 0 && !withCrc) {
+            break;
+        }
+        if (index > 0 && !IsBlockWritten(*digest, blockSize, index)) {
+            digest->add_blockcrc(0);
+            continue;
+        }
+        off_t offset = static_cast<off_t>(index) * blockSize;
+        size_t len = std::min<uint64_t>(blockSize, fileSize - offset);
+        if (ReadBlock(file, offset, len, &buf) != 0) {
+            LOG(WARNING) << "Fail to read " << path
+                         << ", offset: " << offset << ", len: " << len;
+            return -1;
+        }
+        if (index == 0) {
+            if (FillMeta(buf.data(), fileSize, digest) != 0) {
+                LOG(WARNING) << "Fail to decode metapage of " << path;
+                return -1;
+            }
+            if (!IsValidBlockSize(*digest, blockSize)) {
+                LOG(WARNING) << "Block size " << blockSize
+                             << " is not aligned with page size of " << path;
+                return -1;
+            }
+        }
+        if (withCrc) {
+            digest->add_blockcrc(BlockCrc(buf.data(), len));
+        }
+    }
+    return 0;
+}
+
+int CurveSnapshotChunkDigest::ReadBlock(braft::FileAdaptor* file,
+                                        off_t offset,
+                                        size_t len,
+                                        std::string* buf) {
+    butil::IOPortal portal;
+    if (file->read(&portal, offset, len) != static_cast<ssize_t>(len)) {
+        return -1;
+    }
+    buf->clear();
+    portal.copy_to(buf);
+    return 0;
+}
+
+int CurveSnapshotChunkDigest::CopyBlocks(const ChunkDigest& digest,
+                                         uint32_t blockSize,
+                                         braft::FileAdaptor* local,
+                                         braft::FileAdaptor* dest,
+                                         const BlockFetcher& fetch,
+                                         uint64_t* localBytes,
+                                         uint64_t* remoteBytes) {
+    uint64_t fileSize = digest.filesize();
+    uint32_t count = BlockCount(digest, blockSize);
+    // 需要复制哪些块以实际写入的metapage中的bitmap为准，
+    // 摘要生成之后leader上新写入的page也会被下载
+    ChunkDigest written = digest;
+    std::string buf;
+    for (uint32_t index = 0; index < count; ++index) {
+        if (!IsBlockWritten(written, blockSize, index)) {
+            continue;
+        }
+        off_t offset = static_cast<off_t>(index) * blockSize;
+        size_t len = std::min<uint64_t>(blockSize, fileSize - offset);
+        butil::IOBuf data;
+        if (local != NULL &&
+            IsBlockWritten(digest, blockSize, index) &&
+            ReadBlock(local, offset, len, &buf) == 0 &&
+            BlockCrc(buf.data(), len) == digest.blockcrc(index)) {
+            data.append(buf);
+            *localBytes += len;
+        } else {
+            if (fetch(offset, len, &data) != 0 || data.size() != len) {
+                return -1;
+            }
+            if (index == 0) {
+                data.copy_to(&buf);
+            }
+            *remoteBytes += len;
+        }
+        if (dest->write(data, offset) != static_cast<ssize_t>(len)) {
+            LOG(WARNING) << "Fail to write block, offset: " << offset
+                         << ", len: " << len;
+            return -1;
+        }
+        if (index == 0 && (FillMeta(buf.data(), fileSize, &written) != 0 ||
+            !IsValidBlockSize(written, blockSize))) {
+            LOG(WARNING) << "Fail to decode metapage";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int CurveSnapshotChunkDigest::ExtendFile(braft::FileAdaptor* file,
+                                         const std::string& path,
+                                         uint64_t fileSize) {
+    ssize_t size = file->size();
+    if (size < 0) {
+        LOG(WARNING) << "Fail to get size of " << path;
+        return -1;
+    }
+    if (static_cast<uint64_t>(size) >= fileSize) {
+        return 0;
+    }
+    if (::truncate(path.c_str(), fileSize) != 0) {
+        PLOG(WARNING) << "Fail to extend " << path << " to " << fileSize;
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t CurveSnapshotChunkDigest::PageSize(const ChunkDigest& digest) {
+    if (!digest.has_bitmapbits() || digest.bitmapbits() == 0) {
+        return 0;
+    }
+    return digest.filesize() / (digest.bitmapbits() + 1);
+}
+
+bool CurveSnapshotChunkDigest::IsValidBlockSize(const ChunkDigest& digest,
+                                                uint32_t blockSize) {
+    if (blockSize == 0) {
+        return false;
+    }
+    uint64_t pageSize = PageSize(digest);
+    return pageSize == 0 || blockSize % pageSize == 0;
+}
+
+uint32_t CurveSnapshotChunkDigest::BlockCount(const ChunkDigest& digest,
+                                              uint32_t blockSize) {
+    return (digest.filesize() + blockSize - 1) / blockSize;
+}
+
+bool CurveSnapshotChunkDigest::IsBlockWritten(const ChunkDigest& digest,
+                                              uint32_t blockSize,
+                                              uint32_t index) {
+    uint64_t pageSize = PageSize(digest);
+    uint32_t bits = digest.bitmapbits();
+    if (index == 0 || pageSize == 0 || blockSize % pageSize != 0
+        || digest.bitmap().size() < ((bits + 8 - 1) >> 3)) {
+        return true;
+    }
+    // 文件中的第0个page是metapage，bitmap的第i位对应文件中的第i+1个page
+    uint64_t pagesPerBlock = blockSize / pageSize;
+    uint64_t startPage = index * pagesPerBlock;
+    uint64_t endPage = std::min<uint64_t>(startPage + pagesPerBlock,
+                                          bits + 1);
+    if (startPage >= endPage) {
+        return false;
+    }
+    Bitmap bitmap(bits, digest.bitmap().data());
+    return bitmap.NextSetBit(startPage - 1, endPage - 2) != Bitmap::NO_POS;
+}
+
+bool CurveSnapshotChunkDigest::HasBlockCrc(const ChunkDigest& digest,
+                                           uint32_t blockSize) {
+    return digest.blockcrc_size() > 0 &&
+        static_cast<uint32_t>(digest.blockcrc_size())
+            == BlockCount(digest, blockSize);
+}
+
+uint32_t CurveSnapshotChunkDigest::BlockCrc(const char* buf, size_t len) {
+    return curve::common::CRC32(buf, len);
+}
+
+}  // namespace chunkserver
+}  // namespace curve
@@ -0,0 +1,134 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-24
+ * Author: curve
+ */
+
+#ifndef SRC_CHUNKSERVER_RAFTSNAPSHOT_CURVE_SNAPSHOT_CHUNK_DIGEST_H_
+#define SRC_CHUNKSERVER_RAFTSNAPSHOT_CURVE_SNAPSHOT_CHUNK_DIGEST_H_
+
+#include <braft/file_system_adaptor.h>
+#include <butil/iobuf.h>
+#include <functional>
+#include <string>
+
+#include "proto/curve_storage.pb.h"
+
+namespace curve {
+namespace chunkserver {
+
+typedef CurveSnapshotPbChunkDigest::Chunk ChunkDigest;
+
+// 从leader读取chunk文件中[offset, offset + len)范围的数据，成功返回0
+typedef std::function<int(off_t offset, size_t len, butil::IOBuf* out)>
+    BlockFetcher;
+
+/**
+ * 安装快照时的chunk摘要
+ * chunk文件从文件头开始按blockSize划分成块，第0个块包含metapage，
+ * 摘要记录chunk的版本号、bitmap以及每个块的crc，
+ * follower对比本地chunk后只下载被写过且内容不同的块
+ */
+class CurveSnapshotChunkDigest {
+ public:
+    /**
+     * 根据metapage填充摘要中的元数据
+     * @param metaPage: chunk文件的metapage内容
+     * @param fileSize: chunk文件大小
+     * @param digest: 出参
+     * @return 0成功；-1 metapage校验失败
+     */
+    static int FillMeta(const char* metaPage, uint64_t fileSize,
+                        ChunkDigest* digest);
+
+    /**
+     * 计算chunk文件的摘要
+     * @param fs: 读取chunk文件的文件系统
+     * @param path: chunk文件路径
+     * @param blockSize: 块大小，需要是page大小的整数倍
+     * @param withCrc: 是否计算每个被写过的块的crc
+     * @param digest: 出参
+     * @return 0成功；-1失败
+     */
+    static int Build(braft::FileSystemAdaptor* fs, const std::string& path,
+                     uint32_t blockSize, bool withCrc, ChunkDigest* digest);
+
+    /**
+     * chunk文件的page大小，即metapage大小
+     */
+    static uint64_t PageSize(const ChunkDigest& digest);
+
+    /**
+     * 块大小是否可以用于该chunk，块大小必须是page大小的整数倍
+     */
+    static bool IsValidBlockSize(const ChunkDigest& digest,
+                                 uint32_t blockSize);
+
+    static uint32_t BlockCount(const ChunkDigest& digest, uint32_t blockSize);
+
+    /**
+     * 判断第index个块是否被写过，第0个块包含metapage，总是需要复制
+     */
+    static bool IsBlockWritten(const ChunkDigest& digest, uint32_t blockSize,
+                               uint32_t index);
+
+    /**
+     * 摘要中是否带有每个块的crc
+     */
+    static bool HasBlockCrc(const ChunkDigest& digest, uint32_t blockSize);
+
+    static uint32_t BlockCrc(const char* buf, size_t len);
+
+    /**
+     * 读取文件中的一个块，读到的长度不足时返回-1
+     */
+    static int ReadBlock(braft::FileAdaptor* file, off_t offset, size_t len,
+                         std::string* buf);
+
+    /**
+     * 按摘要把chunk文件的块写入dest，被写过的块本地crc相同时从local复制，
+     * 否则通过fetch从leader下载；没有被写过的块不写入
+     * @param local: 本地的chunk文件，可以为NULL
+     * @param localBytes: 出参，从本地复制的字节数
+     * @param remoteBytes: 出参，从leader下载的字节数
+     * @return 0成功；-1失败
+     */
+    static int CopyBlocks(const ChunkDigest& digest, uint32_t blockSize,
+                          braft::FileAdaptor* local, braft::FileAdaptor* dest,
+                          const BlockFetcher& fetch, uint64_t* localBytes,
+                          uint64_t* remoteBytes);
+
+    /**
+     * 文件长度小于fileSize时扩展到fileSize，
+     * 最后的块没有被写过时CopyBlocks不会写到文件末尾
+     * @return 0成功；-1失败
+     */
+    static int ExtendFile(braft::FileAdaptor* file, const std::string& path,
+                          uint64_t fileSize);
+
+ private:
+    static int BuildFromFile(braft::FileAdaptor* file, const std::string& path,
+                             uint32_t blockSize, bool withCrc,
+                             ChunkDigest* digest);
+};
+
+}  // namespace chunkserver
+}  // namespace curve
+
+#endif  // SRC_CHUNKSERVER_RAFTSNAPSHOT_CURVE_SNAPSHOT_CHUNK_DIGEST_H_
@@ -39,11 +39,33 @@
 //          Zheng,Pengfei(zhengpengfei@baidu.com)
 //          Xiong,Kai(xiongkai@baidu.com)
 
+#include <braft/file_service.pb.h>
+#include <braft/util.h>
+#include <brpc/controller.h>
+#include <bthread/bthread.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
 #include "src/chunkserver/raftsnapshot/curve_snapshot_copier.h"
 
+namespace braft {
+DECLARE_int32(raft_max_byte_count_per_rpc);
+}
+
 namespace curve {
 namespace chunkserver {
 
+DEFINE_bool(raft_snapshot_delta_copy, true,
+            "only copy chunk blocks that differ from local chunk files "
+            "when installing snapshot");
+
+// 与braft RemoteFileCopier的默认值保持一致
+const int kDeltaCopyTimeoutMs = 10 * 1000;
+const int kDeltaCopyMaxRetry = 3;
+const int kDeltaCopyRetryIntervalMs = 1000;
+
 CurveSnapshotCopier::CurveSnapshotCopier(CurveSnapshotStorage* storage,
                                          bool filter_before_copy_remote,
                                          braft::FileSystemAdaptor* fs,
@@ -57,6 +79,9 @@ CurveSnapshotCopier::CurveSnapshotCopier(CurveSnapshotStorage* storage,
     , _storage(storage)
     , _reader(NULL)
     , _cur_session(NULL)
+    , _delta_enabled(false)
+    , _reader_id(0)
+    , _digest_block_size(0)
 {}
 
 CurveSnapshotCopier::~CurveSnapshotCopier() {
@@ -80,10 +105,19 @@ void CurveSnapshotCopier::copy() {
         if (!ok()) {
             break;
         }
+        // chunk有摘要时只下载有差异的块，否则完整下载
+        load_chunk_digest();
         std::vector<std::string> files;
         _remote_snapshot.list_files(&files);
         for (size_t i = 0; i < files.size() && ok(); ++i) {
-            copy_file(files[i]);
+            auto iter = _chunk_digests.find(files[i]);
+            if (iter != _chunk_digests.end() &&
+                copy_chunk_delta(files[i], iter->second) == 0) {
+                continue;
+            }
+            if (ok()) {
+                copy_file(files[i]);
+            }
         }
 
         // 下载snapshot attachment文件
@@ -305,34 +339,266 @@ void CurveSnapshotCopier::filter() {
     }
 }
 
-void CurveSnapshotCopier::copy_file(const std::string& filename, bool attch) {
+bool CurveSnapshotCopier::create_parent_directory(
+                const std::string& rfilename, butil::File::Error* e) {
+    butil::FilePath sub_path(rfilename);
+    if (sub_path == sub_path.DirName() || sub_path.DirName().value() == ".") {
+        return true;
+    }
+    if (braft::FLAGS_raft_create_parent_directories) {
+        butil::FilePath sub_dir = butil::FilePath(
+                        _writer->get_path()).Append(sub_path.DirName());
+        return _fs->create_directory(sub_dir.value(), e, true);
+    }
+    return create_sub_directory(
+            _writer->get_path(), sub_path.DirName().value(), _fs, e);
+}
+
+void CurveSnapshotCopier::load_chunk_digest() {
+    _chunk_digests.clear();
+    if (!_delta_enabled) {
+        return;
+    }
+    butil::IOBuf digest_buf;
+    std::unique_lock<braft::raft_mutex_t> lck(_mutex);
+    if (_cancelled) {
+        set_error(ECANCELED, "%s", berror(ECANCELED));
+        return;
+    }
+    scoped_refptr<braft::RemoteFileCopier::Session> session
+        = _copier.start_to_copy_to_iobuf(BRAFT_SNAPSHOT_CHUNK_DIGEST_FILE,
+                                         &digest_buf, NULL);
+    _cur_session = session.get();
+    lck.unlock();
+    session->join();
+    lck.lock();
+    _cur_session = NULL;
+    lck.unlock();
+    if (!session->status().ok()) {
+        // 老版本的leader不支持chunk摘要，此时完整下载所有chunk
+        LOG(WARNING) << "Fail to copy chunk digest, will copy whole chunks : "
+                     << session->status();
+        return;
+    }
+
+    CurveSnapshotPbChunkDigest pb_digest;
+    butil::IOBufAsZeroCopyInputStream wrapper(digest_buf);
+    if (!pb_digest.ParseFromZeroCopyStream(&wrapper)) {
+        LOG(WARNING) << "Bad chunk digest format, will copy whole chunks";
+        return;
+    }
+    _digest_block_size = pb_digest.blocksize();
+    for (int i = 0; i < pb_digest.chunks_size(); ++i) {
+        ChunkDigest* digest = pb_digest.mutable_chunks(i);
+        _chunk_digests[digest->name()].Swap(digest);
+    }
+    LOG(INFO) << "Loaded chunk digest, chunk count: " << _chunk_digests.size()
+              << ", block size: " << _digest_block_size
+              << ", path: " << _writer->get_path();
+}
+
+int CurveSnapshotCopier::copy_chunk_delta(const std::string& filename,
+                                          const ChunkDigest& digest) {
     if (_writer->get_file_meta(filename, NULL) == 0) {
         LOG(INFO) << "Skipped downloading " << filename
                   << " path: " << _writer->get_path();
-        return;
+        return 0;
+    }
+    if (!CurveSnapshotChunkDigest::IsValidBlockSize(digest,
+                                                    _digest_block_size)) {
+        return -1;
     }
     std::string rfilename = get_rfilename(filename);
     std::string file_path = _writer->get_path() + '/' + rfilename;
-    butil::FilePath sub_path(rfilename);
+    butil::File::Error e;
+    if (!create_parent_directory(rfilename, &e)) {
+        return -1;
+    }
+
+    // filename是相对于快照目录的路径，拼上writer的路径即为本地正在使用的chunk
+    braft::FileAdaptor* local = NULL;
+    if (CurveSnapshotChunkDigest::HasBlockCrc(digest, _digest_block_size)) {
+        std::string local_path = _writer->get_path() + '/' + filename;
+        local = _fs->open(local_path, O_RDONLY | O_CLOEXEC, NULL, &e);
+        if (local != NULL &&
+            local->size() != static_cast<ssize_t>(digest.filesize())) {
+            local->close();
+            delete local;
+            local = NULL;
+        }
+    }
+    braft::FileAdaptor* dest =
+        _fs->open(file_path, O_CREAT | O_WRONLY | O_CLOEXEC, NULL, &e);
+    if (dest == NULL) {
+        LOG(WARNING) << "Fail to open " << file_path
+                     << " : " << butil::File::ErrorToString(e);
+        if (local != NULL) {
+            local->close();
+            delete local;
+        }
+        return -1;
+    }
 
-    if (sub_path != sub_path.DirName() && sub_path.DirName().value() != ".") {
-        butil::File::Error e;
-        bool rc = false;
-        if (braft::FLAGS_raft_create_parent_directories) {
-            butil::FilePath sub_dir = butil::FilePath(
-                            _writer->get_path()).Append(sub_path.DirName());
-            rc = _fs->create_directory(sub_dir.value(), &e, true);
-        } else {
-            rc = create_sub_directory(
-                    _writer->get_path(), sub_path.DirName().value(), _fs, &e);
+    uint64_t local_bytes = 0;
+    uint64_t remote_bytes = 0;
+    BlockFetcher fetch = [this, &filename](off_t offset, size_t len,
+                                           butil::IOBuf* out) {
+        return fetch_range(filename, offset, len, out);
+    };
+    int ret = CurveSnapshotChunkDigest::CopyBlocks(
+        digest, _digest_block_size, local, dest, fetch,
+        &local_bytes, &remote_bytes);
+    // 没有被写过的尾部块不会写入，需要把文件扩展到原始大小，
+    // 否则打开chunk时会因为文件大小不对而失败
+    if (ret == 0) {
+        ret = CurveSnapshotChunkDigest::ExtendFile(dest, file_path,
+                                                   digest.filesize());
+    }
+    if (ret == 0 && !dest->sync()) {
+        LOG(WARNING) << "Fail to sync " << file_path;
+        ret = -1;
+    }
+    dest->close();
+    delete dest;
+    if (local != NULL) {
+        local->close();
+        delete local;
+    }
+    if (ret != 0) {
+        _fs->delete_file(file_path, false);
+        // 被取消时错误已经设置，不再完整下载
+        return ok() ? -1 : 0;
+    }
+
+    braft::LocalFileMeta meta;
+    _remote_snapshot.get_file_meta(filename, &meta);
+    if (_writer->add_file(filename, &meta) != 0) {
+        set_error(EIO, "Fail to add file to writer");
+        return 0;
+    }
+    if (_writer->sync() != 0) {
+        set_error(EIO, "Fail to sync writer");
+        return 0;
+    }
+    LOG(INFO) << "Delta copied " << filename
+              << ", local bytes: " << local_bytes
+              << ", remote bytes: " << remote_bytes
+              << ", path: " << _writer->get_path();
+    return 0;
+}
+
+int CurveSnapshotCopier::fetch_range(const std::string& filename,
+                                     off_t offset,
+                                     size_t count,
+                                     butil::IOBuf* out) {
+    out->clear();
+    braft::FileService_Stub stub(&_channel);
+    int retry = 0;
+    while (out->size() < count) {
+        {
+            BAIDU_SCOPED_LOCK(_mutex);
+            if (_cancelled) {
+                set_error(ECANCELED, "%s", berror(ECANCELED));
+                return -1;
+            }
+        }
+        size_t max_count = std::min<size_t>(count - out->size(),
+                            braft::FLAGS_raft_max_byte_count_per_rpc);
+        if (_throttle &&
+                braft::FLAGS_raft_enable_throttle_when_install_snapshot) {
+            max_count = _throttle->throttled_by_throughput(max_count);
+            if (max_count == 0) {
+                bthread_usleep(kDeltaCopyRetryIntervalMs * 1000L);
+                continue;
+            }
+        }
+        off_t cur_offset = offset + out->size();
+        brpc::Controller cntl;
+        cntl.set_timeout_ms(kDeltaCopyTimeoutMs);
+        braft::GetFileRequest request;
+        request.set_reader_id(_reader_id);
+        request.set_filename(filename);
+        request.set_offset(cur_offset);
+        request.set_count(max_count);
+        request.set_read_partly(true);
+        braft::GetFileResponse response;
+        stub.get_file(&cntl, &request, &response, NULL);
+        if (cntl.Failed()) {
+            // leader限流时返回EAGAIN，不计入重试次数
+            if (cntl.ErrorCode() == EAGAIN ||
+                ++retry <= kDeltaCopyMaxRetry) {
+                bthread_usleep(kDeltaCopyRetryIntervalMs * 1000L);
+                continue;
+            }
+            LOG(WARNING) << "Fail to read " << filename
+                         << ", offset: " << cur_offset
+                         << ", count: " << max_count
+                         << ", error: " << cntl.ErrorText();
+            return -1;
+        }
+        retry = 0;
+        braft::FileSegData data(cntl.response_attachment());
+        uint64_t seg_offset = 0;
+        butil::IOBuf seg;
+        while (0 != data.next(&seg_offset, &seg)) {
+            if (seg_offset != static_cast<uint64_t>(offset) + out->size()) {
+                LOG(WARNING) << "Unexpected segment of " << filename
+                             << ", offset: " << seg_offset
+                             << ", expected: " << offset + out->size();
+                return -1;
+            }
+            out->append(seg);
+            seg.clear();
         }
-        if (!rc) {
-            LOG(ERROR) << "Fail to create directory for " << file_path
-                       << " : " << butil::File::ErrorToString(e);
-            set_error(braft::file_error_to_os_error(e),
-                      "Fail to create directory");
+        if (static_cast<off_t>(offset + out->size()) == cur_offset) {
+            LOG(WARNING) << "Read nothing from " << filename
+                         << ", offset: " << cur_offset
+                         << ", eof: " << response.eof();
+            return -1;
         }
     }
+    if (out->size() > count) {
+        out->pop_back(out->size() - count);
+    }
+    return 0;
+}
+
+int CurveSnapshotCopier::init_delta_channel(const std::string& uri) {
+    // uri格式为remote://ip:port/reader_id
+    static const char kRemotePrefix[] = "remote://";
+    size_t prefix_size = strlen(kRemotePrefix);
+    if (uri.compare(0, prefix_size, kRemotePrefix) != 0) {
+        return -1;
+    }
+    size_t slash_pos = uri.find('/', prefix_size);
+    if (slash_pos == std::string::npos) {
+        return -1;
+    }
+    std::string addr = uri.substr(prefix_size, slash_pos - prefix_size);
+    std::string reader_id = uri.substr(slash_pos + 1);
+    char* end = NULL;
+    _reader_id = strtoll(reader_id.c_str(), &end, 10);
+    if (reader_id.empty() || *end != '\0') {
+        return -1;
+    }
+    return _channel.Init(addr.c_str(), NULL);
+}
+
+void CurveSnapshotCopier::copy_file(const std::string& filename, bool attch) {
+    if (_writer->get_file_meta(filename, NULL) == 0) {
+        LOG(INFO) << "Skipped downloading " << filename
+                  << " path: " << _writer->get_path();
+        return;
+    }
+    std::string rfilename = get_rfilename(filename);
+    std::string file_path = _writer->get_path() + '/' + rfilename;
+    butil::File::Error e;
+    if (!create_parent_directory(rfilename, &e)) {
+        LOG(ERROR) << "Fail to create directory for " << file_path
+                   << " : " << butil::File::ErrorToString(e);
+        set_error(braft::file_error_to_os_error(e),
+                  "Fail to create directory");
+    }
     braft::LocalFileMeta meta;
     _remote_snapshot.get_file_meta(filename, &meta);
     std::unique_lock<braft::raft_mutex_t> lck(_mutex);
@@ -417,7 +683,17 @@ void CurveSnapshotCopier::cancel() {
 }
 
 int CurveSnapshotCopier::init(const std::string& uri) {
-    return _copier.init(uri, _fs, _throttle);
+    int ret = _copier.init(uri, _fs, _throttle);
+    if (ret != 0 || !FLAGS_raft_snapshot_delta_copy) {
+        return ret;
+    }
+    if (init_delta_channel(uri) != 0) {
+        LOG(WARNING) << "Fail to init channel for delta copy, uri: " << uri
+                     << ", will copy whole chunks";
+        return 0;
+    }
+    _delta_enabled = true;
+    return 0;
 }
 
 }  // namespace chunkserver
@@ -43,14 +43,20 @@
 #define SRC_CHUNKSERVER_RAFTSNAPSHOT_CURVE_SNAPSHOT_COPIER_H_
 
 #include <braft/storage.h>
+#include <brpc/channel.h>
+#include <gflags/gflags.h>
+#include <map>
 #include <vector>
 #include <string>
 #include "src/chunkserver/raftsnapshot/curve_snapshot.h"
 #include "src/chunkserver/raftsnapshot/curve_snapshot_storage.h"
+#include "src/chunkserver/raftsnapshot/curve_snapshot_chunk_digest.h"
 
 namespace curve {
 namespace chunkserver {
 
+DECLARE_bool(raft_snapshot_delta_copy);
+
 class CurveSnapshotStorage;
 
 class CurveSnapshotCopier : public braft::SnapshotCopier {
@@ -74,6 +80,18 @@ class CurveSnapshotCopier : public braft::SnapshotCopier {
     int filter_before_copy(CurveSnapshotWriter* writer,
                            braft::SnapshotReader* last_snapshot);
     void filter();
+    // 从leader获取chunk摘要，leader不支持时摘要为空，所有chunk完整下载
+    void load_chunk_digest();
+    // 根据chunk摘要只下载本地没有或者内容不同的块
+    // 返回0表示已经处理（出错时会set_error），返回-1表示需要完整下载
+    int copy_chunk_delta(const std::string& filename,
+                         const ChunkDigest& digest);
+    // 从leader读取文件中[offset, offset + count)范围的数据
+    int fetch_range(const std::string& filename, off_t offset, size_t count,
+                    butil::IOBuf* out);
+    int init_delta_channel(const std::string& uri);
+    bool create_parent_directory(const std::string& rfilename,
+                                 butil::File::Error* e);
     void copy_file(const std::string& filename, bool attach = false);
     // 这里的filename是相对于快照目录的路径，为了先把文件下载到临时目录，需要把前面的..去掉
     std::string get_rfilename(const std::string& filename);
@@ -90,6 +108,12 @@ class CurveSnapshotCopier : public braft::SnapshotCopier {
     braft::RemoteFileCopier::Session* _cur_session;
     CurveSnapshot _remote_snapshot;
     braft::RemoteFileCopier _copier;
+    // 增量复制直接调用leader的FileService按范围读取
+    bool _delta_enabled;
+    brpc::Channel _channel;
+    int64_t _reader_id;
+    uint32_t _digest_block_size;
+    std::map<std::string, ChunkDigest> _chunk_digests;
 };
 }  // namespace chunkserver
 }  // namespace curve
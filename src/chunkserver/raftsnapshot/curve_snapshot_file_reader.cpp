@@ -41,9 +41,23 @@
 
 #include "src/chunkserver/raftsnapshot/curve_snapshot_file_reader.h"
 
+#include <bthread/bthread.h>
+#include <butil/files/file_path.h>
+#include <algorithm>
+
+#include "src/chunkserver/datastore/datastore_file_helper.h"
+#include "src/chunkserver/raftsnapshot/curve_snapshot_chunk_digest.h"
+
 namespace curve {
 namespace chunkserver {
 
+DEFINE_int32(raft_snapshot_digest_block_size, 1024 * 1024,
+             "block size of chunk digest used in snapshot install, "
+             "must be a multiple of page size");
+DEFINE_bool(raft_snapshot_digest_crc, true,
+            "compute crc of written blocks in chunk digest, follower "
+            "reuses its local blocks only when crc matches");
+
 CurveSnapshotAttachMetaTable::CurveSnapshotAttachMetaTable() {}
 
 CurveSnapshotAttachMetaTable::~CurveSnapshotAttachMetaTable() {}
@@ -137,6 +151,9 @@ int CurveSnapshotFileReader::read_file(butil::IOBuf* out,
         }
         return ret;
     }
+    if (filename == BRAFT_SNAPSHOT_CHUNK_DIGEST_FILE) {
+        return read_chunk_digest(out, offset, max_count, read_count, is_eof);
+    }
     braft::LocalFileMeta file_meta;
     if (_meta_table.get_file_meta(filename, &file_meta) != 0 &&
         _attach_meta_table.get_attach_file_meta(filename, nullptr)) {
@@ -173,5 +190,99 @@ int CurveSnapshotFileReader::read_file(butil::IOBuf* out,
                                     offset, new_max_count, read_count, is_eof);
 }
 
+int CurveSnapshotFileReader::read_chunk_digest(butil::IOBuf* out,
+                                               off_t offset,
+                                               size_t max_count,
+                                               size_t* read_count,
+                                               bool* is_eof) const {
+    std::lock_guard<bthread::Mutex> lk(_digest_mutex);
+    if (_digest_state == DIGEST_NONE) {
+        // bthread持有reader的引用，reader在摘要计算完成之前不会析构
+        AddRef();
+        bthread_t tid;
+        if (bthread_start_background(&tid, NULL, run_build_chunk_digest,
+                                     const_cast<CurveSnapshotFileReader*>(
+                                         this)) != 0) {
+            LOG(ERROR) << "Fail to start bthread to build chunk digest of "
+                       << path();
+            Release();
+            return EIO;
+        }
+        _digest_state = DIGEST_BUILDING;
+    }
+    if (_digest_state == DIGEST_BUILDING) {
+        return EAGAIN;
+    }
+    if (_digest_state == DIGEST_FAILED) {
+        return EIO;
+    }
+    size_t size = _digest_buf.size();
+    if (offset < 0 || static_cast<size_t>(offset) > size) {
+        return EINVAL;
+    }
+    size_t count = std::min(max_count, size - offset);
+    _digest_buf.append_to(out, count, offset);
+    *read_count = count;
+    *is_eof = (offset + count == size);
+    return 0;
+}
+
+void* CurveSnapshotFileReader::run_build_chunk_digest(void* arg) {
+    CurveSnapshotFileReader* reader =
+        reinterpret_cast<CurveSnapshotFileReader*>(arg);
+    butil::IOBuf buf;
+    int ret = reader->build_chunk_digest(&buf);
+    {
+        std::lock_guard<bthread::Mutex> lk(reader->_digest_mutex);
+        if (ret == 0) {
+            reader->_digest_buf.swap(buf);
+            reader->_digest_state = DIGEST_BUILT;
+        } else {
+            reader->_digest_state = DIGEST_FAILED;
+        }
+    }
+    reader->Release();
+    return NULL;
+}
+
+int CurveSnapshotFileReader::build_chunk_digest(butil::IOBuf* buf) const {
+    CurveSnapshotPbChunkDigest pb_digest;
+    uint32_t block_size = FLAGS_raft_snapshot_digest_block_size;
+    pb_digest.set_blocksize(block_size);
+    std::vector<std::string> files;
+    _meta_table.list_files(&files);
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string basename =
+            butil::FilePath(files[i]).BaseName().value();
+        if (!DatastoreFileHelper::IsChunkFile(basename)) {
+            continue;
+        }
+        // 计算失败的chunk不放入摘要，follower会完整下载
+        ChunkDigest digest;
+        digest.set_name(files[i]);
+        if (CurveSnapshotChunkDigest::Build(file_system().get(),
+                                            path() + "/" + files[i],
+                                            block_size,
+                                            FLAGS_raft_snapshot_digest_crc,
+                                            &digest) != 0) {
+            continue;
+        }
+        pb_digest.add_chunks()->Swap(&digest);
+    }
+    buf->clear();
+    {
+        // wrapper析构后buf的大小才是序列化后的实际大小
+        butil::IOBufAsZeroCopyOutputStream wrapper(buf);
+        if (!pb_digest.SerializeToZeroCopyStream(&wrapper)) {
+            LOG(ERROR) << "Fail to serialize chunk digest of " << path();
+            return -1;
+        }
+    }
+    LOG(INFO) << "Build chunk digest of " << path()
+              << ", chunk count: " << pb_digest.chunks_size()
+              << ", size: " << buf->size();
+    return 0;
+}
+
 }  // namespace chunkserver
 }  // namespace curve
@@ -44,6 +44,9 @@
 
 #include <braft/file_reader.h>
 #include <braft/snapshot.h>
+#include <bthread/mutex.h>
+#include <gflags/gflags.h>
+#include <mutex>  // NOLINT
 #include <utility>
 #include <vector>
 #include <string>
@@ -54,6 +57,9 @@
 namespace curve {
 namespace chunkserver {
 
+DECLARE_int32(raft_snapshot_digest_block_size);
+DECLARE_bool(raft_snapshot_digest_crc);
+
 /**
  * snapshot attachment文件元数据表，同上面的
  * CurveSnapshotAttachMetaTable接口，主要提供attach文件元数据信息
@@ -88,7 +94,8 @@ class CurveSnapshotFileReader : public braft::LocalDirReader {
                            const std::string& path,
                            braft::SnapshotThrottle* snapshot_throttle)
             : LocalDirReader(fs, path),
-              _snapshot_throttle(snapshot_throttle)
+              _snapshot_throttle(snapshot_throttle),
+              _digest_state(DIGEST_NONE)
     {}
     virtual ~CurveSnapshotFileReader() = default;
 
@@ -113,10 +120,32 @@ class CurveSnapshotFileReader : public braft::LocalDirReader {
         return _meta_table;
     }
 
+ private:
+    enum DigestState {
+        DIGEST_NONE,
+        DIGEST_BUILDING,
+        DIGEST_BUILT,
+        DIGEST_FAILED,
+    };
+
+    // 读取快照中chunk文件的摘要。摘要需要读取所有chunk，第一次读取时
+    // 在后台bthread中计算并缓存，计算完成之前返回EAGAIN，follower会重试
+    int read_chunk_digest(butil::IOBuf* out,
+                          off_t offset,
+                          size_t max_count,
+                          size_t* read_count,
+                          bool* is_eof) const;
+    static void* run_build_chunk_digest(void* arg);
+    int build_chunk_digest(butil::IOBuf* buf) const;
+
  private:
     braft::LocalSnapshotMetaTable _meta_table;
     CurveSnapshotAttachMetaTable _attach_meta_table;
     scoped_refptr<braft::SnapshotThrottle> _snapshot_throttle;
+    // 序列化后的chunk摘要，follower会分多次读取
+    mutable bthread::Mutex _digest_mutex;
+    mutable DigestState _digest_state;
+    mutable butil::IOBuf _digest_buf;
 };
 
 }  // namespace chunkserver
@@ -35,6 +35,7 @@ const char RAFT_SNAP_DIR[] = "raft_snapshot";
 const char RAFT_LOG_DIR[]  = "log";
 #define BRAFT_SNAPSHOT_PATTERN "snapshot_%020" PRId64
 #define BRAFT_SNAPSHOT_ATTACH_META_FILE "__raft_snapshot_attach_meta"
+#define BRAFT_SNAPSHOT_CHUNK_DIGEST_FILE "__raft_snapshot_chunk_digest"
 
 }  // namespace chunkserver
 }  // namespace curve
@@ -139,6 +139,7 @@ void Trash::DeleteEligibleFileInTrashInterval() {
 }
 
 void Trash::DeleteEligibleFileInTrash() {
+    LockGuard lock(deleteMtx_);
     // trash目录暂不存在
     if (!localFileSystem_->DirExists(trashPath_)) {
         return;
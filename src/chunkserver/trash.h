@@ -32,6 +32,8 @@
 
 using ::curve::common::Thread;
 using ::curve::common::Atomic;
+using ::curve::common::Mutex;
+using ::curve::common::LockGuard;
 using ::curve::common::InterruptibleSleeper;
 
 namespace curve {
@@ -58,6 +60,7 @@ class Trash {
 
     /*
     * @brief DeleteEligibleFileInTrash 回收trash目录下的物理空间
+    *        除周期扫描外，chunkfilepool的后台补充线程也会调用
     */
     void DeleteEligibleFileInTrash();
 
@@ -156,6 +159,9 @@ class Trash {
     Atomic<bool> isStop_;
 
     InterruptibleSleeper sleeper_;
+
+    // 保证同一时间只有一个线程在回收trash
+    Mutex deleteMtx_;
 };
 }  // namespace chunkserver
 }  // namespace curve
@@ -520,6 +520,10 @@ void WriteChunkClosure::OnSuccess() {
 }
 
 void ReadChunkClosure::SendRetryRequest() {
+    // 经过副本选择下发的请求失败，记一次重试，重试会发给leader
+    if (readPeerTracked_) {
+        reqDone_->IncremRetriedTimes();
+    }
     client_->ReadChunk(reqCtx_->idinfo_, reqCtx_->seq_,
                        reqCtx_->offset_,
                        reqCtx_->rawlength_,
@@ -528,6 +532,28 @@ void ReadChunkClosure::SendRetryRequest() {
                        done_);
 }
 
+void ReadChunkClosure::Run() {
+    if (readPeerTracked_) {
+        bool failed = cntl_->Failed();
+        bool redirected = !failed && GetResponseStatus() ==
+            CHUNK_OP_STATUS::CHUNK_OP_STATUS_REDIRECTED;
+        client_->GetMetaCache()->OnReadDone(chunkserverID_, failed,
+                                            redirected);
+    }
+
+    ClientClosure::Run();
+}
+
+void ReadChunkClosure::OnRedirected() {
+    // follower无法提供读时返回重定向，重试会发给leader，不需要刷新leader
+    if (followerRead_) {
+        retryDirectly_ = true;
+        return;
+    }
+
+    ClientClosure::OnRedirected();
+}
+
 void ReadChunkClosure::OnSuccess() {
     ClientClosure::OnSuccess();
 
@@ -623,6 +649,53 @@ void RecoverChunkClosure::SendRetryRequest() {
                           done_);
 }
 
+void BatchRequestClosure::Run() {
+    std::unique_ptr<BatchRequestClosure> selfGuard(this);
+    std::unique_ptr<brpc::Controller> cntlGuard(cntl_);
+
+    bool invalid = !cntl_->Failed() &&
+        response_.responses_size() != static_cast<int>(dones_.size());
+    if (invalid) {
+        LOG(ERROR) << "BatchChunk response count mismatch, request count = "
+                   << dones_.size()
+                   << ", response count = " << response_.responses_size()
+                   << ", remote side = " << cntl_->remote_side();
+    }
+
+    butil::IOBuf& data = cntl_->response_attachment();
+    for (size_t i = 0; i < dones_.size(); ++i) {
+        ClientClosure* done = dones_[i];
+        brpc::Controller* subCntl = new brpc::Controller();
+        done->SetCntl(subCntl);
+        ChunkResponse* subResponse = new ChunkResponse();
+        done->SetResponse(subResponse);
+
+        if (cntl_->Failed()) {
+            subCntl->SetFailed(cntl_->ErrorCode(), "%s",
+                               cntl_->ErrorText().c_str());
+        } else if (invalid) {
+            subCntl->SetFailed(brpc::ERESPONSE, "BatchChunk response invalid");
+        } else {
+            subResponse->CopyFrom(response_.responses(i));
+            // 读成功的数据按照请求的顺序放在attachment中
+            const RequestContext* req = requests_[i];
+            if (req->optype_ == OpType::READ &&
+                subResponse->status() ==
+                    CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS) {
+                if (data.size() < req->rawlength_) {
+                    subCntl->SetFailed(brpc::ERESPONSE,
+                                       "BatchChunk read data missing");
+                } else {
+                    data.cutn(&subCntl->response_attachment(),
+                              req->rawlength_);
+                }
+            }
+        }
+
+        done->Run();
+    }
+}
+
 int ClientClosure::UpdateLeaderWithRedirectInfo(const std::string& leaderInfo) {
     ChunkServerID leaderId = 0;
     ChunkServerAddr leaderAddr;
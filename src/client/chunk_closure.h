@@ -31,6 +31,7 @@
 #include <unordered_set>  // NOLINT
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "proto/chunk.pb.h"
 #include "src/client/client_config.h"
@@ -45,6 +46,7 @@ namespace client {
 
 using curve::chunkserver::CHUNK_OP_STATUS;
 using curve::chunkserver::ChunkResponse;
+using curve::chunkserver::BatchChunkResponse;
 using curve::chunkserver::GetChunkInfoResponse;
 using ::google::protobuf::Message;
 using ::google::protobuf::Closure;
@@ -333,9 +335,26 @@ class ReadChunkClosure : public ClientClosure {
     ReadChunkClosure(CopysetClient *client, Closure *done)
      : ClientClosure(client, done) {}
 
+    /**
+     * 设置读请求为副本选择后下发的请求
+     * @param: followerRead为true表示请求发给了follower
+     */
+    void SetFollowerRead(bool followerRead) {
+        readPeerTracked_ = true;
+        followerRead_ = followerRead;
+    }
+
+    void Run() override;
     void OnSuccess() override;
+    void OnRedirected() override;
     void OnChunkNotExist() override;
     void SendRetryRequest() override;
+
+ private:
+    // 请求是否经过副本选择下发，需要在返回时更新副本的读负载
+    bool readPeerTracked_{false};
+    // 请求是否发给了follower
+    bool followerRead_{false};
 };
 
 class ReadChunkSnapClosure : public ClientClosure {
@@ -392,6 +411,36 @@ class RecoverChunkClosure : public ClientClosure {
     void SendRetryRequest() override;
 };
 
+/**
+ * BatchChunk rpc的回调
+ * 将rpc的结果拆分给每个请求的closure，每个请求按照单个rpc返回的逻辑处理，
+ * 出错的请求各自按照单个请求的流程重试
+ */
+class BatchRequestClosure : public Closure {
+ public:
+    BatchRequestClosure(const std::vector<RequestContext*>& requests,
+                        const std::vector<ClientClosure*>& dones)
+     : cntl_(nullptr), requests_(requests), dones_(dones) {}
+
+    virtual ~BatchRequestClosure() = default;
+
+    void SetCntl(brpc::Controller* cntl) {
+        cntl_ = cntl;
+    }
+
+    BatchChunkResponse* GetResponse() {
+        return &response_;
+    }
+
+    void Run() override;
+
+ private:
+    brpc::Controller*                   cntl_;
+    BatchChunkResponse                  response_;
+    std::vector<RequestContext*>        requests_;
+    std::vector<ClientClosure*>         dones_;
+};
+
 }   // namespace client
 }   // namespace curve
 
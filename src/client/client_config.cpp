@@ -59,6 +59,18 @@ int ClientConfig::Init(const char* configpath) {
     LOG_IF(ERROR, ret == false) << "config no chunkserver.enableAppliedIndexRead info";     // NOLINT
     RETURN_IF_FALSE(ret)
 
+    ret = conf_.GetBoolValue("chunkserver.enableFollowerRead",
+          &fileServiceOption_.ioOpt.ioSenderOpt.chunkserverEnableFollowerRead);        // NOLINT
+    LOG_IF(WARNING, ret == false)
+        << "config no chunkserver.enableFollowerRead info, using default value "
+        << fileServiceOption_.ioOpt.ioSenderOpt.chunkserverEnableFollowerRead;
+
+    ret = conf_.GetUInt32Value("chunkserver.batchRequestMaxCount",
+          &fileServiceOption_.ioOpt.ioSenderOpt.chunkserverBatchRequestMaxCount);   // NOLINT
+    LOG_IF(WARNING, ret == false)
+        << "config no chunkserver.batchRequestMaxCount info, using default value "      // NOLINT
+        << fileServiceOption_.ioOpt.ioSenderOpt.chunkserverBatchRequestMaxCount;
+
     ret = conf_.GetUInt32Value("chunkserver.opMaxRetry",
           &fileServiceOption_.ioOpt.ioSenderOpt.failRequestOpt.chunkserverOPMaxRetry);    // NOLINT
     LOG_IF(ERROR, ret == false) << "config no chunkserver.opMaxRetry info";
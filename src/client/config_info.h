@@ -168,13 +168,25 @@ typedef struct FailureRequestOption {
 /**
  * 发送rpc给chunkserver的配置
  * @chunkserverEnableAppliedIndexRead: 是否开启使用appliedindex read
+ * @chunkserverEnableFollowerRead: 是否允许appliedindex read发给follower，
+ *                                 需要同时开启appliedindex read
+ * @chunkserverBatchRequestMaxCount: 一次IO拆分出的同一copyset上的读写请求合并成
+ *                                 BatchChunk rpc，每个rpc最多包含的请求数，
+ *                                 不大于1时不合并
  * @inflightOpt: 一个文件向chunkserver发送请求时的inflight 请求控制配置
  * @failRequestOpt: rpc发送失败之后，需要进行rpc重试的相关配置
  */
 typedef struct IOSenderOption {
     bool chunkserverEnableAppliedIndexRead;
+    bool chunkserverEnableFollowerRead;
+    uint32_t chunkserverBatchRequestMaxCount;
     InFlightIOCntlInfo_t inflightOpt;
     FailureRequestOption_t failRequestOpt;
+    IOSenderOption() {
+        chunkserverEnableAppliedIndexRead = false;
+        chunkserverEnableFollowerRead = false;
+        chunkserverBatchRequestMaxCount = 0;
+    }
 } IOSenderOption_t;
 
 /**
@@ -26,6 +26,7 @@
 #include <unistd.h>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "src/client/request_sender.h"
 #include "src/client/metacache.h"
@@ -122,6 +123,30 @@ int CopysetClient::ReadChunk(const ChunkIDInfo& idinfo, uint64_t sn,
         }
     }
 
+    // 开启follower read时，首次下发的读请求在副本间选择，不计入重试次数，
+    // 失败或者被重定向后重试次数加一，重试时统一发给leader
+    if (iosenderopt_.chunkserverEnableFollowerRead &&
+        iosenderopt_.chunkserverEnableAppliedIndexRead &&
+        appliedindex > 0 && reqclosure->GetRetriedTimes() == 0) {
+        ChunkServerID csId;
+        butil::EndPoint csAddr;
+        bool isLeader = false;
+        if (0 == metaCache_->GetReadPeer(idinfo.lpid_, idinfo.cpid_,
+                idinfo.cid_, &csId, &csAddr, &isLeader)) {
+            auto senderPtr = senderManager_->GetOrCreateSender(csId,
+                                            csAddr, iosenderopt_);
+            if (nullptr != senderPtr) {
+                ReadChunkClosure *readDone =
+                    new ReadChunkClosure(this, doneGuard.release());
+                readDone->SetFollowerRead(!isLeader);
+                metaCache_->OnReadSent(csId);
+                senderPtr->ReadChunk(idinfo, sn, offset, length,
+                                     appliedindex, sourceInfo, readDone);
+                return 0;
+            }
+        }
+    }
+
     auto task = [&](Closure* done, std::shared_ptr<RequestSender> senderPtr) {
         ReadChunkClosure *readDone = new ReadChunkClosure(this, done);
         senderPtr->ReadChunk(idinfo, sn, offset, length,
@@ -131,6 +156,49 @@ int CopysetClient::ReadChunk(const ChunkIDInfo& idinfo, uint64_t sn,
     return DoRPCTask(idinfo, task, doneGuard.release());
 }
 
+int CopysetClient::BatchChunk(const std::vector<RequestContext*>& requests) {
+    std::shared_ptr<RequestSender> senderPtr = nullptr;
+    ChunkServerID leaderId;
+    butil::EndPoint leaderAddr;
+
+    // session无效或者获取leader失败时，每个请求按照单个请求的逻辑下发，
+    // 由单个请求的流程负责重新入队或者重试
+    if (!sessionNotValid_ && requests.size() > 1) {
+        const ChunkIDInfo& idinfo = requests.front()->idinfo_;
+        if (FetchLeader(idinfo.lpid_, idinfo.cpid_, &leaderId, &leaderAddr)) {
+            senderPtr = senderManager_->GetOrCreateSender(leaderId,
+                                            leaderAddr, iosenderopt_);
+        }
+    }
+
+    if (nullptr == senderPtr) {
+        for (RequestContext* req : requests) {
+            if (req->optype_ == OpType::READ) {
+                ReadChunk(req->idinfo_, req->seq_, req->offset_,
+                          req->rawlength_, req->appliedindex_,
+                          req->sourceInfo_, req->done_);
+            } else {
+                WriteChunk(req->idinfo_, req->seq_, req->writeBuffer_,
+                           req->offset_, req->rawlength_,
+                           req->sourceInfo_, req->done_);
+            }
+        }
+        return 0;
+    }
+
+    std::vector<ClientClosure*> dones;
+    dones.reserve(requests.size());
+    for (RequestContext* req : requests) {
+        req->done_->IncremRetriedTimes();
+        if (req->optype_ == OpType::READ) {
+            dones.push_back(new ReadChunkClosure(this, req->done_));
+        } else {
+            dones.push_back(new WriteChunkClosure(this, req->done_));
+        }
+    }
+    return senderPtr->BatchChunk(requests, dones);
+}
+
 int CopysetClient::WriteChunk(const ChunkIDInfo& idinfo, uint64_t sn,
                               const char* buf, off_t offset, size_t length,
                               const RequestSourceInfo& sourceInfo,
@@ -30,6 +30,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "src/common/concurrent/concurrent.h"
 #include "src/client/client_metric.h"
@@ -115,6 +116,13 @@ class CopysetClient : public Uncopyable {
                   const RequestSourceInfo& sourceInfo,
                   Closure *done);
 
+    /**
+     * 将同一copyset上的多个读写请求合并成一个rpc发给leader
+     * 每个请求按照单个rpc的逻辑处理返回结果，出错的请求单独重试
+     * @param requests:同一copyset上的读写请求，请求的done负责返回结果
+     */
+    int BatchChunk(const std::vector<RequestContext*>& requests);
+
     /**
      * 读Chunk快照文件
      * @param idinfo为chunk相关的id信息
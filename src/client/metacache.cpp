@@ -33,17 +33,31 @@
 #include "src/client/mds_client.h"
 #include "src/client/client_common.h"
 #include "src/common/concurrent/concurrent.h"
+#include "src/common/net_common.h"
+#include "src/common/timeutility.h"
 
 using curve::common::WriteLockGuard;
 using curve::common::ReadLockGuard;
 using curve::client::ClientConfig;
+using curve::common::NetCommon;
+using curve::common::TimeUtility;
 
 namespace curve {
 namespace client {
 
+// follower read时副本读失败后被排除的时间
+const uint64_t kReadPeerExcludeUs = 10 * 1000 * 1000;
+// follower read时副本返回重定向后被排除的时间
+const uint64_t kReadPeerRedirectExcludeUs = 1000 * 1000;
+// 本机副本的在途读请求数比其他副本多出不超过该值时，仍然优先选择本机副本
+const int64_t kLocalReadPeerInflightBonus = 4;
+
 void MetaCache::Init(MetaCacheOption_t metaCacheOpt, MDSClient* mdsclient) {
     mdsclient_ = mdsclient;
     metacacheopt_ = metaCacheOpt;
+    if (!NetCommon::GetLocalIP(&localIp_)) {
+        localIp_.clear();
+    }
     LOG(INFO) << "metacache init success!"
               << ", get leader retry times = "
               << metacacheopt_.metacacheGetLeaderRetry
@@ -395,6 +409,87 @@ void MetaCache::UpdateChunkserverCopysetInfo(LogicPoolID lpid,
     }
 }
 
+int MetaCache::GetReadPeer(LogicPoolID logicPoolId,
+                           CopysetID copysetId,
+                           ChunkID chunkId,
+                           ChunkServerID* serverId,
+                           butil::EndPoint* serverAddr,
+                           bool* isLeader) {
+    CopysetInfo_t cpinfo = GetCopysetinfo(logicPoolId, copysetId);
+    size_t peerNum = cpinfo.csinfos_.size();
+    if (peerNum == 0) {
+        return -1;
+    }
+
+    uint64_t now = TimeUtility::GetTimeofDayUs();
+    int selected = -1;
+    int64_t minInflight = 0;
+    // 从chunkid对应的位置开始遍历，负载相同时不同chunk落到不同副本
+    for (size_t i = 0; i < peerNum; ++i) {
+        int index = (chunkId + i) % peerNum;
+        const CopysetPeerInfo_t& peer = cpinfo.csinfos_[index];
+        ReadPeerState* state = GetReadPeerState(peer.chunkserverid_);
+        if (state->excludeUntilUs.load(std::memory_order_relaxed) > now) {
+            continue;
+        }
+        int64_t inflight = state->inflight.load(std::memory_order_relaxed);
+        if (!localIp_.empty() &&
+            butil::ip2str(peer.csaddr_.addr_.ip).c_str() == localIp_) {
+            inflight -= kLocalReadPeerInflightBonus;
+        }
+        if (selected == -1 || inflight < minInflight) {
+            selected = index;
+            minInflight = inflight;
+        }
+    }
+
+    if (selected == -1) {
+        return -1;
+    }
+
+    *serverId = cpinfo.csinfos_[selected].chunkserverid_;
+    *serverAddr = cpinfo.csinfos_[selected].csaddr_.addr_;
+    *isLeader = (selected == cpinfo.GetCurrentLeaderIndex());
+    return 0;
+}
+
+void MetaCache::OnReadSent(ChunkServerID csid) {
+    GetReadPeerState(csid)->inflight.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MetaCache::OnReadDone(ChunkServerID csid, bool failed,
+                           bool redirected) {
+    ReadPeerState* state = GetReadPeerState(csid);
+    state->inflight.fetch_sub(1, std::memory_order_relaxed);
+    if (failed) {
+        state->excludeUntilUs.store(
+            TimeUtility::GetTimeofDayUs() + kReadPeerExcludeUs,
+            std::memory_order_relaxed);
+    } else if (redirected) {
+        // 副本落后或者正在切换leader，短时间内不再选择它
+        state->excludeUntilUs.store(
+            TimeUtility::GetTimeofDayUs() + kReadPeerRedirectExcludeUs,
+            std::memory_order_relaxed);
+    }
+}
+
+MetaCache::ReadPeerState* MetaCache::GetReadPeerState(ChunkServerID csid) {
+    {
+        ReadLockGuard rdlk(rwlock4ReadPeer_);
+        auto iter = readPeerStates_.find(csid);
+        if (iter != readPeerStates_.end()) {
+            return iter->second.get();
+        }
+    }
+
+    WriteLockGuard wrlk(rwlock4ReadPeer_);
+    auto& state = readPeerStates_[csid];
+    if (state == nullptr) {
+        state.reset(new ReadPeerState());
+    }
+    return state.get();
+}
+
 CopysetInfo_t MetaCache::GetCopysetinfo(LogicPoolID lpid, CopysetID csid) {
     ReadLockGuard rdlk(rwlock4CopysetInfo_);
     std::string mapkey = LogicPoolCopysetID2Str(lpid, csid);
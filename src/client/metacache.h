@@ -27,6 +27,8 @@
 #include <map>
 #include <set>
 #include <vector>
+#include <memory>
+#include <atomic>
 #include <unordered_map>
 
 #include "src/client/client_config.h"
@@ -245,6 +247,39 @@ class MetaCache {
     virtual bool IsLeaderMayChange(LogicPoolID logicpoolId,
                                    CopysetID copysetId);
 
+    /**
+     * 开启follower read时为读请求选择副本
+     * 选择在途读请求最少的副本，与client同机的副本负载不明显偏高时优先选择，
+     * 最近读失败或者返回重定向的副本在一段时间内不会被选中
+     * @param: logicPoolId逻辑池id
+     * @param: copysetId复制组id
+     * @param: chunkId为要读的chunk，负载相同时用于打散副本
+     * @param[out]: serverId为选中的副本的chunkserver id
+     * @param[out]: serverAddr为选中的副本的地址
+     * @param[out]: isLeader表示选中的副本是否为当前缓存的leader
+     * @return: 成功返回0，没有可用的副本返回-1
+     */
+    virtual int GetReadPeer(LogicPoolID logicPoolId,
+                            CopysetID copysetId,
+                            ChunkID chunkId,
+                            ChunkServerID* serverId,
+                            butil::EndPoint* serverAddr,
+                            bool* isLeader);
+
+    /**
+     * 读请求下发到chunkserver时调用，记录在途的读请求数
+     * @param: csid为读请求发往的chunkserver id
+     */
+    void OnReadSent(ChunkServerID csid);
+
+    /**
+     * 读请求返回时调用
+     * @param: csid为读请求发往的chunkserver id
+     * @param: failed为true表示rpc失败，该副本会被暂时排除
+     * @param: redirected为true表示副本返回了重定向，该副本会被短暂排除
+     */
+    void OnReadDone(ChunkServerID csid, bool failed, bool redirected);
+
     /**
      * 测试使用
      * 获取copysetinfo信息
@@ -291,6 +326,19 @@ class MetaCache {
        CopysetID copysetId,
        const ChunkServerAddr& leaderAddr);
 
+    // follower read时副本的读负载信息
+    struct ReadPeerState {
+        // 在途的读请求数
+        std::atomic<int64_t> inflight{0};
+        // 读失败后在该时间之前不再选择该副本
+        std::atomic<uint64_t> excludeUntilUs{0};
+    };
+
+    /**
+     * 获取chunkserver对应的读负载信息，不存在时创建
+     */
+    ReadPeerState* GetReadPeerState(ChunkServerID csid);
+
  private:
     MDSClient*          mdsclient_;
     MetaCacheOption_t   metacacheopt_;
@@ -319,6 +367,14 @@ class MetaCache {
     // 读写锁保护unStableCSMap
     CURVE_CACHELINE_ALIGNMENT RWLock    rwlock4CSCopysetIDMap_;
 
+    // chunkserver到读负载信息的映射，follower read时用于选择副本
+    std::unordered_map<ChunkServerID, std::unique_ptr<ReadPeerState>> readPeerStates_;  // NOLINT
+    // 读写锁保护readPeerStates_
+    CURVE_CACHELINE_ALIGNMENT RWLock    rwlock4ReadPeer_;
+
+    // client所在机器的ip，用于follower read时优先选择同机的副本
+    std::string localIp_;
+
     // 当前文件信息
     FInfo fileInfo_;
 };
@@ -35,9 +35,11 @@ RequestContext::RequestContext() {
     readBuffer_ = nullptr;
     writeBuffer_ = nullptr;
     chunkinfodetail_ = nullptr;
+    batchNext_ = nullptr;
 
     id_         = reqCtxID_.fetch_add(1);
 
+    fileId_     = 0;
     seq_        = 0;
     offset_     = 0;
     rawlength_  = 0;
@@ -61,6 +61,8 @@ class RequestContext {
 
     // chunk的ID信息，sender在发送rpc的时候需要附带其ID信息
     ChunkIDInfo         idinfo_;
+    // request所属文件的id，读写请求携带给chunkserver用于卷级别的QoS
+    uint64_t            fileId_;
 
     // 用户IO被拆分之后，其小IO有自己的offset和length
     off_t               offset_;
@@ -93,6 +95,9 @@ class RequestContext {
     // 当前request context id
     uint64_t            id_;
 
+    // 同一copyset上合并成一个BatchChunk rpc的下一个请求，为nullptr表示不合并
+    RequestContext*     batchNext_;
+
     // request context id生成器
     static std::atomic<uint64_t> reqCtxID_;
 };
@@ -25,6 +25,9 @@
 #include <brpc/closure_guard.h>
 #include <glog/logging.h>
 
+#include <map>
+#include <utility>
+
 #include "src/client/request_context.h"
 #include "src/client/request_closure.h"
 #include "src/client/chunk_closure.h"
@@ -90,6 +93,13 @@ int RequestScheduler::Fini() {
 int RequestScheduler::ScheduleRequest(const std::list<RequestContext *> requests) {   //NOLINT
     if (running_.load(std::memory_order_acquire)) {
         /* TODO(wudemiao): 后期考虑 qos */
+        if (reqschopt_.ioSenderOpt.chunkserverBatchRequestMaxCount > 1) {
+            for (auto it : MergeBatchRequests(requests)) {
+                BBQItem<RequestContext *> req(it);
+                queue_.PutBack(req);
+            }
+            return 0;
+        }
         for (auto it : requests) {
             BBQItem<RequestContext *> req(it);
             queue_.PutBack(req);
@@ -140,6 +150,10 @@ void RequestScheduler::Process() {
         BBQItem<RequestContext *> item = queue_.TakeFront();
         if (!item.IsStop()) {
             RequestContext *req = item.Item();
+            if (req->batchNext_ != nullptr) {
+                ProcessBatch(req);
+                continue;
+            }
             brpc::ClosureGuard guard(req->done_);
             switch (req->optype_) {
                 case OpType::READ:
@@ -214,5 +228,47 @@ void RequestScheduler::Process() {
     }
 }
 
+std::vector<RequestContext *> RequestScheduler::MergeBatchRequests(
+    const std::list<RequestContext *>& requests) {
+    const uint32_t maxCount =
+        reqschopt_.ioSenderOpt.chunkserverBatchRequestMaxCount;
+    // 每个copyset当前正在合并的链表的尾部和请求数
+    std::map<std::pair<LogicPoolID, CopysetID>,
+             std::pair<RequestContext *, uint32_t>> batches;
+    std::vector<RequestContext *> heads;
+    heads.reserve(requests.size());
+    for (auto it : requests) {
+        it->batchNext_ = nullptr;
+        if (it->optype_ != OpType::READ && it->optype_ != OpType::WRITE) {
+            heads.push_back(it);
+            continue;
+        }
+        auto key = std::make_pair(it->idinfo_.lpid_, it->idinfo_.cpid_);
+        auto iter = batches.find(key);
+        if (iter == batches.end() || iter->second.second >= maxCount) {
+            batches[key] = std::make_pair(it, 1);
+            heads.push_back(it);
+            continue;
+        }
+        iter->second.first->batchNext_ = it;
+        iter->second.first = it;
+        ++iter->second.second;
+    }
+    return heads;
+}
+
+void RequestScheduler::ProcessBatch(RequestContext *head) {
+    std::vector<RequestContext *> requests;
+    RequestContext *req = head;
+    while (req != nullptr) {
+        RequestContext *next = req->batchNext_;
+        req->batchNext_ = nullptr;
+        req->done_->GetInflightRPCToken();
+        requests.push_back(req);
+        req = next;
+    }
+    client_.BatchChunk(requests);
+}
+
 }   // namespace client
 }   // namespace curve
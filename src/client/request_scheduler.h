@@ -24,6 +24,7 @@
 #define SRC_CLIENT_REQUEST_SCHEDULER_H_
 
 #include <list>
+#include <vector>
 
 #include "src/common/uncopyable.h"
 #include "src/client/config_info.h"
@@ -138,6 +139,21 @@ class RequestScheduler : public Uncopyable {
      */
     void Process();
 
+    /**
+     * 将请求列表中同一copyset上的读写请求串成链表，
+     * 每个链表只有头部入队，出队后作为一个BatchChunk rpc下发
+     * @param requests:请求列表
+     * @return 需要入队的请求
+     */
+    std::vector<RequestContext *> MergeBatchRequests(
+        const std::list<RequestContext *>& requests);
+
+    /**
+     * 下发合并后的请求
+     * @param head:合并后的请求链表的头部
+     */
+    void ProcessBatch(RequestContext *head);
+
     inline void WaitValidSession() {
       // lease续约失败的时候需要阻塞IO直到续约成功
       if (blockIO_.load(std::memory_order_acquire) && blockingQueue_) {
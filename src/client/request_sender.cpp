@@ -28,6 +28,7 @@
 #include "proto/chunk.pb.h"
 #include "src/common/timeutility.h"
 #include "src/client/request_closure.h"
+#include "src/client/request_context.h"
 #include "src/common/location_operator.h"
 
 using curve::common::TimeUtility;
@@ -77,6 +78,9 @@ int RequestSender::ReadChunk(ChunkIDInfo idinfo,
     request.set_logicpoolid(idinfo.lpid_);
     request.set_copysetid(idinfo.cpid_);
     request.set_chunkid(idinfo.cid_);
+    if (rc->GetReqCtx() != nullptr && rc->GetReqCtx()->fileId_ > 0) {
+        request.set_volumeid(rc->GetReqCtx()->fileId_);
+    }
     request.set_offset(offset);
     request.set_size(length);
 
@@ -124,6 +128,9 @@ int RequestSender::WriteChunk(ChunkIDInfo idinfo,
     request.set_logicpoolid(idinfo.lpid_);
     request.set_copysetid(idinfo.cpid_);
     request.set_chunkid(idinfo.cid_);
+    if (rc->GetReqCtx() != nullptr && rc->GetReqCtx()->fileId_ > 0) {
+        request.set_volumeid(rc->GetReqCtx()->fileId_);
+    }
     request.set_sn(sn);
     request.set_offset(offset);
     request.set_size(length);
@@ -141,6 +148,67 @@ int RequestSender::WriteChunk(ChunkIDInfo idinfo,
     return 0;
 }
 
+int RequestSender::BatchChunk(const std::vector<RequestContext*>& requests,
+                              const std::vector<ClientClosure*>& dones) {
+    BatchRequestClosure* batchDone = new BatchRequestClosure(requests, dones);
+    brpc::ClosureGuard doneGuard(batchDone);
+
+    brpc::Controller *cntl = new brpc::Controller();
+    batchDone->SetCntl(cntl);
+    uint64_t timeoutMs = iosenderopt_.failRequestOpt.chunkserverRPCTimeoutMS;
+
+    BatchChunkRequest request;
+    request.set_logicpoolid(requests.front()->idinfo_.lpid_);
+    request.set_copysetid(requests.front()->idinfo_.cpid_);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        RequestContext* ctx = requests[i];
+        ClientClosure* done = dones[i];
+        RequestClosure* rc = static_cast<RequestClosure*>(done->GetClosure());
+        MetricHelper::IncremRPCRPSCount(rc->GetMetric(), ctx->optype_);
+        rc->SetStartTime(TimeUtility::GetTimeofDayUs());
+        timeoutMs = std::max(timeoutMs, rc->GetNextTimeoutMS());
+        done->SetChunkServerID(chunkServerId_);
+        done->SetChunkServerEndPoint(serverEndPoint_);
+
+        ChunkRequest* subRequest = request.add_requests();
+        subRequest->set_logicpoolid(ctx->idinfo_.lpid_);
+        subRequest->set_copysetid(ctx->idinfo_.cpid_);
+        subRequest->set_chunkid(ctx->idinfo_.cid_);
+        if (ctx->fileId_ > 0) {
+            subRequest->set_volumeid(ctx->fileId_);
+        }
+        subRequest->set_offset(ctx->offset_);
+        subRequest->set_size(ctx->rawlength_);
+        if (!ctx->sourceInfo_.cloneFileSource.empty()) {
+            subRequest->set_clonefilesource(ctx->sourceInfo_.cloneFileSource);
+            subRequest->set_clonefileoffset(ctx->sourceInfo_.cloneFileOffset);
+        }
+
+        if (ctx->optype_ == OpType::READ) {
+            subRequest->set_optype(
+                curve::chunkserver::CHUNK_OP_TYPE::CHUNK_OP_READ);
+            if (iosenderopt_.chunkserverEnableAppliedIndexRead &&
+                ctx->appliedindex_ > 0) {
+                subRequest->set_appliedindex(ctx->appliedindex_);
+            }
+        } else {
+            subRequest->set_optype(
+                curve::chunkserver::CHUNK_OP_TYPE::CHUNK_OP_WRITE);
+            subRequest->set_sn(ctx->seq_);
+            cntl->request_attachment().append_user_data(
+                const_cast<char*>(ctx->writeBuffer_), ctx->rawlength_,
+                EmptyDeleter);
+        }
+    }
+    cntl->set_timeout_ms(timeoutMs);
+
+    ChunkService_Stub stub(&channel_);
+    stub.BatchChunk(cntl, &request, batchDone->GetResponse(),
+                    doneGuard.release());
+
+    return 0;
+}
+
 int RequestSender::ReadChunkSnapshot(ChunkIDInfo idinfo,
                                      uint64_t sn,
                                      off_t offset,
@@ -27,6 +27,7 @@
 #include <butil/endpoint.h>
 
 #include <string>
+#include <vector>
 
 #include "src/client/client_config.h"
 #include "src/client/client_common.h"
@@ -39,6 +40,7 @@ namespace client {
 
 using curve::chunkserver::ChunkRequest;
 using curve::chunkserver::ChunkResponse;
+using curve::chunkserver::BatchChunkRequest;
 using curve::chunkserver::GetChunkInfoRequest;
 using curve::chunkserver::GetChunkInfoResponse;
 using curve::chunkserver::ChunkService_Stub;
@@ -95,6 +97,14 @@ class RequestSender {
                    const RequestSourceInfo& sourceInfo,
                    ClientClosure *done);
 
+    /**
+     * 将同一copyset上的多个读写请求合并成一个BatchChunk rpc
+     * @param requests:同一copyset上的读写请求
+     * @param dones:每个请求对应的closure，rpc返回后分别执行
+     */
+    int BatchChunk(const std::vector<RequestContext*>& requests,
+                   const std::vector<ClientClosure*>& dones);
+
     /**
      * 读Chunk快照文件
      * @param idinfo为chunk相关的id信息
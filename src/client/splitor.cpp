@@ -231,6 +231,7 @@ bool Splitor::AssignInternal(IOTracker* iotracker,
                                               buf, off, len, fileinfo->seqnum);
 
             for_each(templist.begin(), templist.end(), [&](RequestContext* it) {
+                it->fileId_ = fileinfo->id;
                 it->appliedindex_ = appliedindex_;
                 it->sourceInfo_ =
                     CalcRequestSourceInfo(iotracker, mc, chunkidx);
@@ -242,6 +243,7 @@ bool Splitor::AssignInternal(IOTracker* iotracker,
             if (newreqNode == nullptr) {
                 return -1;
             }
+            newreqNode->fileId_       = fileinfo->id;
             newreqNode->seq_          = fileinfo->seqnum;
             if (iotracker->Optype() == OpType::WRITE) {
                 newreqNode->writeBuffer_ = buf;
@@ -0,0 +1,159 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <stdlib.h>
+
+#include <vector>
+
+#include "src/common/aligned_buffer_pool.h"
+
+namespace curve {
+namespace common {
+
+const size_t AlignedBufferPool::kMinBufferSize;
+const size_t AlignedBufferPool::kMaxBufferSize;
+const size_t AlignedBufferPool::kMaxCachedBytesPerClass;
+
+namespace {
+
+// 大小等级个数，第i级的内存大小为kMinBufferSize << i
+const int kSizeClassCount = 9;
+static_assert((AlignedBufferPool::kMinBufferSize << (kSizeClassCount - 1))
+              == AlignedBufferPool::kMaxBufferSize,
+              "size class count mismatch with max buffer size");
+
+// 返回能容纳size的最小等级，超过最大等级时返回-1
+int SizeClassOf(size_t size) {
+    size_t classSize = AlignedBufferPool::kMinBufferSize;
+    for (int i = 0; i < kSizeClassCount; ++i) {
+        if (size <= classSize) {
+            return i;
+        }
+        classSize <<= 1;
+    }
+    return -1;
+}
+
+char* AllocateAligned(size_t size) {
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, kDirectIOAlignment, size) != 0) {
+        return nullptr;
+    }
+    return static_cast<char*>(ptr);
+}
+
+struct ThreadCache {
+    std::vector<char*> freeLists[kSizeClassCount];
+    size_t cachedBytes = 0;
+
+    ~ThreadCache();
+};
+
+// 线程退出时ThreadCache先于其他thread_local对象析构的情况下，
+// 之后归还的内存直接释放
+thread_local bool tlsCacheDestroyed = false;
+thread_local ThreadCache tlsCache;
+
+ThreadCache::~ThreadCache() {
+    for (int i = 0; i < kSizeClassCount; ++i) {
+        for (char* data : freeLists[i]) {
+            free(data);
+        }
+        freeLists[i].clear();
+    }
+    cachedBytes = 0;
+    tlsCacheDestroyed = true;
+}
+
+}  // namespace
+
+AlignedBuffer::~AlignedBuffer() {
+    Reset();
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer&& other)
+    : data_(other.data_), capacity_(other.capacity_) {
+    other.data_ = nullptr;
+    other.capacity_ = 0;
+}
+
+AlignedBuffer& AlignedBuffer::operator=(AlignedBuffer&& other) {
+    if (this != &other) {
+        Reset();
+        data_ = other.data_;
+        capacity_ = other.capacity_;
+        other.data_ = nullptr;
+        other.capacity_ = 0;
+    }
+    return *this;
+}
+
+void AlignedBuffer::Reset() {
+    if (data_ != nullptr) {
+        AlignedBufferPool::Put(data_, capacity_);
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+}
+
+AlignedBuffer AlignedBufferPool::Get(size_t size) {
+    int sizeClass = SizeClassOf(size);
+    if (sizeClass < 0) {
+        size_t capacity = AlignUp(size, kDirectIOAlignment);
+        return AlignedBuffer(AllocateAligned(capacity), capacity);
+    }
+
+    size_t capacity = kMinBufferSize << sizeClass;
+    if (!tlsCacheDestroyed) {
+        std::vector<char*>& freeList = tlsCache.freeLists[sizeClass];
+        if (!freeList.empty()) {
+            char* data = freeList.back();
+            freeList.pop_back();
+            tlsCache.cachedBytes -= capacity;
+            return AlignedBuffer(data, capacity);
+        }
+    }
+    return AlignedBuffer(AllocateAligned(capacity), capacity);
+}
+
+void AlignedBufferPool::Put(char* data, size_t capacity) {
+    int sizeClass = SizeClassOf(capacity);
+    if (sizeClass < 0 || tlsCacheDestroyed) {
+        free(data);
+        return;
+    }
+
+    std::vector<char*>& freeList = tlsCache.freeLists[sizeClass];
+    if ((freeList.size() + 1) * capacity > kMaxCachedBytesPerClass) {
+        free(data);
+        return;
+    }
+    freeList.push_back(data);
+    tlsCache.cachedBytes += capacity;
+}
+
+size_t AlignedBufferPool::ThreadCachedBytes() {
+    return tlsCacheDestroyed ? 0 : tlsCache.cachedBytes;
+}
+
+}  // namespace common
+}  // namespace curve
@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#ifndef SRC_COMMON_ALIGNED_BUFFER_POOL_H_
+#define SRC_COMMON_ALIGNED_BUFFER_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace curve {
+namespace common {
+
+// O_DIRECT读写要求内存地址、文件偏移和长度对齐到的大小
+const size_t kDirectIOAlignment = 4096;
+
+inline bool IsAlignedTo(uint64_t value, size_t align) {
+    return (value & (align - 1)) == 0;
+}
+
+inline uint64_t AlignDown(uint64_t value, size_t align) {
+    return value & ~(static_cast<uint64_t>(align) - 1);
+}
+
+inline uint64_t AlignUp(uint64_t value, size_t align) {
+    return AlignDown(value + align - 1, align);
+}
+
+/**
+ * 从AlignedBufferPool中申请的对齐内存，析构时自动归还给当前线程的缓存
+ * 只能移动，不能拷贝
+ */
+class AlignedBuffer {
+ public:
+    AlignedBuffer() : data_(nullptr), capacity_(0) {}
+    ~AlignedBuffer();
+
+    AlignedBuffer(AlignedBuffer&& other);
+    AlignedBuffer& operator=(AlignedBuffer&& other);
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    char* Data() const {
+        return data_;
+    }
+
+    // 实际可用的长度，不小于申请的长度
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+ private:
+    friend class AlignedBufferPool;
+    AlignedBuffer(char* data, size_t capacity)
+        : data_(data), capacity_(capacity) {}
+
+    void Reset();
+
+ private:
+    char* data_;
+    size_t capacity_;
+};
+
+/**
+ * 以kDirectIOAlignment对齐的内存池，用作O_DIRECT读写的中转缓冲区
+ * 1.按2的幂划分大小等级，从kMinBufferSize到kMaxBufferSize
+ * 2.每个线程各自缓存空闲内存，申请和归还都不需要加锁；
+ *   在其他线程归还的内存会进入归还线程的缓存
+ * 3.每个等级缓存的内存总量不超过kMaxCachedBytesPerClass，超出的部分直接释放
+ * 4.超过kMaxBufferSize的申请不经过缓存，直接分配和释放
+ */
+class AlignedBufferPool {
+ public:
+    static const size_t kMinBufferSize = kDirectIOAlignment;
+    static const size_t kMaxBufferSize = 1024 * 1024;
+    static const size_t kMaxCachedBytesPerClass = 4 * 1024 * 1024;
+
+    /**
+     * 申请一块对齐的内存
+     * @param size: 需要的长度
+     * @return 申请到的内存，失败时Data()为nullptr
+     */
+    static AlignedBuffer Get(size_t size);
+
+    /**
+     * 当前线程缓存中空闲内存的总量，用于测试
+     */
+    static size_t ThreadCachedBytes();
+
+ private:
+    static void Put(char* data, size_t capacity);
+
+    friend class AlignedBuffer;
+};
+
+}  // namespace common
+}  // namespace curve
+
+#endif  // SRC_COMMON_ALIGNED_BUFFER_POOL_H_
@@ -23,6 +23,11 @@
 #include <glog/logging.h>
 #include <memory.h>
 #include <utility>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 #include "src/common/bitmap.h"
 
 namespace curve {
@@ -30,21 +35,28 @@ namespace common {
 
 const uint32_t Bitmap::NO_POS = 0xFFFFFFFF;
 
+namespace {
+
+const uint32_t kWordBits = 64;
+const uint32_t kWordShift = 6;  // 2 ^ kWordShift = kWordBits
+const uint64_t kAllOnes = ~0ULL;
+
+inline int CountTrailingZeros(uint64_t word) {
+    return __builtin_ctzll(word);
+}
+
+}  // namespace
+
 Bitmap::Bitmap(uint32_t bits) : bits_(bits) {
-    int count = unitCount();
-    bitmap_ = new(std::nothrow) char[count];
-    CHECK(bitmap_ != nullptr) << "allocate bitmap failed.";
-    memset(bitmap_, 0, count);
+    bitmap_ = allocate();
+    memset(bitmap_, 0, allocSize());
 }
 
 Bitmap::Bitmap(uint32_t bits, const char* bitmap) : bits_(bits) {
-    int count = unitCount();
-    bitmap_ = new(std::nothrow) char[count];
-    CHECK(bitmap_ != nullptr) << "allocate bitmap failed.";
+    bitmap_ = allocate();
+    memset(bitmap_, 0, allocSize());
     if (bitmap != nullptr) {
-        memcpy(bitmap_, bitmap, count);
-    } else {
-        memset(bitmap_, 0, count);
+        memcpy(bitmap_, bitmap, unitCount());
     }
 }
 
@@ -57,10 +69,8 @@ Bitmap::~Bitmap() {
 
 Bitmap::Bitmap(const Bitmap& bitmap) {
     bits_ = bitmap.Size();
-    int count = unitCount();
-    bitmap_ = new(std::nothrow) char[count];
-    CHECK(bitmap_ != nullptr) << "allocate bitmap failed.";
-    memcpy(bitmap_, bitmap.GetBitmap(), count);
+    bitmap_ = allocate();
+    memcpy(bitmap_, bitmap.bitmap_, allocSize());
 }
 
 Bitmap& Bitmap::operator = (const Bitmap& bitmap) {
@@ -68,10 +78,8 @@ Bitmap& Bitmap::operator = (const Bitmap& bitmap) {
         return *this;
     delete[] bitmap_;
     bits_ = bitmap.Size();
-    int count = unitCount();
-    bitmap_ = new(std::nothrow) char[count];
-    CHECK(bitmap_ != nullptr) << "allocate bitmap failed.";
-    memcpy(bitmap_, bitmap.GetBitmap(), count);
+    bitmap_ = allocate();
+    memcpy(bitmap_, bitmap.bitmap_, allocSize());
     return *this;
 }
 
@@ -95,9 +103,7 @@ void Bitmap::Set(uint32_t index) {
 }
 
 void Bitmap::Set(uint32_t startIndex, uint32_t endIndex) {
-    for (uint32_t index = startIndex; index <= endIndex; ++index) {
-        Set(index);
-    }
+    setRange(startIndex, endIndex, true);
 }
 
 void Bitmap::Clear() {
@@ -110,8 +116,41 @@ void Bitmap::Clear(uint32_t index) {
 }
 
 void Bitmap::Clear(uint32_t startIndex, uint32_t endIndex) {
-    for (uint32_t index = startIndex; index <= endIndex; ++index) {
-        Clear(index);
+    setRange(startIndex, endIndex, false);
+}
+
+void Bitmap::setRange(uint32_t startIndex, uint32_t endIndex, bool value) {
+    if (bits_ == 0 || startIndex >= bits_ || endIndex < startIndex)
+        return;
+    if (endIndex >= bits_)
+        endIndex = bits_ - 1;
+
+    uint32_t startUnit = indexOfUnit(startIndex);
+    uint32_t endUnit = indexOfUnit(endIndex);
+    // 首尾两个字节中需要修改的位
+    char headMask = static_cast<char>(0xff << (startIndex % BITMAP_UNIT_SIZE));
+    char tailMask = static_cast<char>(
+        0xff >> (BITMAP_UNIT_SIZE - 1 - endIndex % BITMAP_UNIT_SIZE));
+    if (startUnit == endUnit) {
+        headMask &= tailMask;
+    }
+    if (value) {
+        bitmap_[startUnit] |= headMask;
+    } else {
+        bitmap_[startUnit] &= ~headMask;
+    }
+    if (startUnit == endUnit)
+        return;
+
+    // 中间的整字节直接memset
+    if (endUnit > startUnit + 1) {
+        memset(bitmap_ + startUnit + 1, value ? 0xff : 0,
+               endUnit - startUnit - 1);
+    }
+    if (value) {
+        bitmap_[endUnit] |= tailMask;
+    } else {
+        bitmap_[endUnit] &= ~tailMask;
     }
 }
 
@@ -123,54 +162,78 @@ bool Bitmap::Test(uint32_t index) const {
 }
 
 uint32_t Bitmap::NextSetBit(uint32_t index) const {
-    for (; index < bits_; ++index) {
-        if (Test(index))
-            break;
-    }
-    if (index >= bits_)
-        index = NO_POS;
-    return index;
+    return findNext(index, bits_ - 1, false);
 }
 
 uint32_t Bitmap::NextSetBit(uint32_t startIndex, uint32_t endIndex) const {
-    uint32_t index = startIndex;
-    // bitmap中最后一个bit的index值
-    uint32_t lastIndex = bits_ - 1;
-    // endIndex值不能超过lastIndex
-    if (endIndex > lastIndex)
-        endIndex = lastIndex;
-    for (; index <= endIndex; ++index) {
-        if (Test(index))
-            break;
-    }
-    if (index > endIndex)
-        index = NO_POS;
-    return index;
+    return findNext(startIndex, endIndex, false);
 }
 
 uint32_t Bitmap::NextClearBit(uint32_t index) const {
-    for (; index < bits_; ++index) {
-        if (!Test(index))
-            break;
-    }
-    if (index >= bits_)
-        index = NO_POS;
-    return index;
+    return findNext(index, bits_ - 1, true);
 }
 
 uint32_t Bitmap::NextClearBit(uint32_t startIndex, uint32_t endIndex) const {
-    uint32_t index = startIndex;
-    uint32_t lastIndex = bits_ - 1;
-    // endIndex值不能超过lastIndex
-    if (endIndex > lastIndex)
-        endIndex = lastIndex;
-    for (; index <= endIndex; ++index) {
-        if (!Test(index))
+    return findNext(startIndex, endIndex, true);
+}
+
+uint64_t Bitmap::loadWord(uint32_t wordIndex) const {
+    // 内存按8字节补齐，最后一个word也可以完整读取
+    uint64_t word;
+    memcpy(&word, bitmap_ + (wordIndex << (kWordShift - ALIGN_FACTOR)),
+           sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    // 第i位始终位于第i/8个字节，大端机器上需要转换成小端的word
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+uint32_t Bitmap::skipWords(uint32_t wordIndex,
+                           uint32_t lastWord,
+                           bool findClear) const {
+#ifdef __AVX2__
+    // 每次比较32字节，跳过全0(找1时)或全1(找0时)的区域
+    const __m256i skip = findClear ? _mm256_set1_epi8(static_cast<char>(0xff))
+                                   : _mm256_setzero_si256();
+    while (wordIndex + 4 <= lastWord) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+            bitmap_ + (wordIndex << (kWordShift - ALIGN_FACTOR))));
+        __m256i eq = _mm256_cmpeq_epi8(v, skip);
+        if (_mm256_movemask_epi8(eq) != -1)
             break;
+        wordIndex += 4;
     }
-    if (index > endIndex)
-        index = NO_POS;
-    return index;
+#endif
+    return wordIndex;
+}
+
+uint32_t Bitmap::findNext(uint32_t startIndex,
+                          uint32_t endIndex,
+                          bool findClear) const {
+    if (bits_ == 0 || startIndex >= bits_)
+        return NO_POS;
+    // endIndex值不能超过最后一个bit的index
+    if (endIndex >= bits_)
+        endIndex = bits_ - 1;
+    if (startIndex > endIndex)
+        return NO_POS;
+
+    uint32_t wordIndex = startIndex >> kWordShift;
+    uint32_t lastWord = endIndex >> kWordShift;
+    // 找0时将word取反，统一为查找首个为1的位
+    uint64_t flip = findClear ? kAllOnes : 0;
+    // 屏蔽掉startIndex之前的位
+    uint64_t word = (loadWord(wordIndex) ^ flip)
+                  & (kAllOnes << (startIndex & (kWordBits - 1)));
+    while (word == 0) {
+        if (++wordIndex > lastWord)
+            return NO_POS;
+        wordIndex = skipWords(wordIndex, lastWord, findClear);
+        word = loadWord(wordIndex) ^ flip;
+    }
+    uint32_t index = (wordIndex << kWordShift) + CountTrailingZeros(word);
+    return index > endIndex ? NO_POS : index;
 }
 
 void Bitmap::Divide(uint32_t startIndex,
@@ -232,6 +295,12 @@ void Bitmap::Divide(uint32_t startIndex,
     }
 }
 
+char* Bitmap::allocate() const {
+    char* bitmap = new(std::nothrow) char[allocSize()];
+    CHECK(bitmap != nullptr) << "allocate bitmap failed.";
+    return bitmap;
+}
+
 uint32_t Bitmap::Size() const {
     return bits_;
 }
@@ -185,6 +185,27 @@ class Bitmap {
         char mask = 0x01 << indexInUnit;
         return mask;
     }
+    // 实际分配的字节数，按8字节补齐以便按64位word扫描，补齐部分不会被持久化
+    uint32_t allocSize() const {
+        return ((bits_ + 63) >> 6) << 3;
+    }
+    char* allocate() const;
+    // 将指定范围的位置为value，首尾字节按位修改，中间的字节整体修改
+    void setRange(uint32_t startIndex, uint32_t endIndex, bool value);
+    // 读取第wordIndex个64位word，第i位对应word的第i%64位
+    uint64_t loadWord(uint32_t wordIndex) const;
+    // 从wordIndex开始跳过不可能包含目标位的word，返回需要检查的word
+    // 开启AVX2时每次检查4个word，否则直接返回wordIndex
+    uint32_t skipWords(uint32_t wordIndex,
+                       uint32_t lastWord,
+                       bool findClear) const;
+    /**
+     * 按64位word查找[startIndex, endIndex]内首个为1(findClear为false)
+     * 或为0(findClear为true)的位，不存在时返回NO_POS
+     */
+    uint32_t findNext(uint32_t startIndex,
+                      uint32_t endIndex,
+                      bool findClear) const;
 
  public:
     // 表示不存在的位置，值为0xffffffff
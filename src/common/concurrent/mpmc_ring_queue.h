@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-12-14
+ * Author: curve
+ */
+
+#ifndef SRC_COMMON_CONCURRENT_MPMC_RING_QUEUE_H_
+#define SRC_COMMON_CONCURRENT_MPMC_RING_QUEUE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "include/curve_compiler_specific.h"
+#include "src/common/concurrent/ring_queue_base.h"
+
+namespace curve {
+namespace common {
+
+/**
+ * 有界的无锁环形队列，支持多个生产者和多个消费者
+ * 1.入队以及槽位序号的规则见RingQueueBase，消费者同样通过CAS抢占读取位置
+ * 2.接口都是非阻塞的，队列满或者空时直接返回，阻塞和唤醒由使用者实现
+ */
+template <typename T>
+class MPMCRingQueue : public RingQueueBase<T> {
+ public:
+    explicit MPMCRingQueue(size_t capacity)
+        : RingQueueBase<T>(capacity),
+          dequeuePos_(0) {}
+
+    /**
+     * 从队首出队，可以被多个消费者并发调用
+     * @return 队列空时返回false
+     */
+    bool TryPop(T* value) {
+        Cell* cell;
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &this->cells_[pos & this->mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq)
+                          - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // 槽位中的数据还没有被生产者发布，队列为空
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        this->Consume(cell, pos, value);
+        return true;
+    }
+
+    /**
+     * 队列中的元素个数，返回的结果可能立刻过时
+     */
+    size_t Size() const {
+        size_t enqueue = this->enqueuePos_.load(std::memory_order_relaxed);
+        size_t dequeue = dequeuePos_.load(std::memory_order_relaxed);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+ private:
+    typedef typename RingQueueBase<T>::Cell Cell;
+
+    CURVE_CACHELINE_ALIGNMENT std::atomic<size_t> dequeuePos_;
+};
+
+}   // namespace common
+}   // namespace curve
+
+#endif  // SRC_COMMON_CONCURRENT_MPMC_RING_QUEUE_H_
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#ifndef SRC_COMMON_CONCURRENT_MPSC_RING_QUEUE_H_
+#define SRC_COMMON_CONCURRENT_MPSC_RING_QUEUE_H_
+
+#include <stdint.h>
+
+#include "include/curve_compiler_specific.h"
+#include "src/common/concurrent/ring_queue_base.h"
+
+namespace curve {
+namespace common {
+
+/**
+ * 有界的无锁环形队列，支持多个生产者和单个消费者
+ * 1.入队以及槽位序号的规则见RingQueueBase
+ * 2.接口都是非阻塞的，队列满或者空时直接返回，阻塞和唤醒由使用者实现
+ * 3.TryPop/Front/Empty只能由唯一的消费者线程调用
+ */
+template <typename T>
+class MPSCRingQueue : public RingQueueBase<T> {
+ public:
+    explicit MPSCRingQueue(size_t capacity)
+        : RingQueueBase<T>(capacity),
+          dequeuePos_(0) {}
+
+    /**
+     * 出队，只能由消费者调用
+     * @return 队列空时返回false
+     */
+    bool TryPop(T* value) {
+        Cell* cell = &this->cells_[dequeuePos_ & this->mask_];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (seq != dequeuePos_ + 1) {
+            return false;
+        }
+        this->Consume(cell, dequeuePos_, value);
+        ++dequeuePos_;
+        return true;
+    }
+
+    /**
+     * 返回队首元素的指针但不出队，只能由消费者调用
+     * @return 队列空时返回nullptr
+     */
+    T* Front() {
+        Cell* cell = &this->cells_[dequeuePos_ & this->mask_];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (seq != dequeuePos_ + 1) {
+            return nullptr;
+        }
+        return &cell->value;
+    }
+
+    /**
+     * 队列是否为空，只能由消费者调用
+     */
+    bool Empty() {
+        return Front() == nullptr;
+    }
+
+    /**
+     * 队列中的元素个数，只能由消费者调用，返回的结果可能立刻过时
+     */
+    size_t Size() const {
+        return this->enqueuePos_.load(std::memory_order_relaxed)
+             - dequeuePos_;
+    }
+
+ private:
+    typedef typename RingQueueBase<T>::Cell Cell;
+
+    CURVE_CACHELINE_ALIGNMENT size_t dequeuePos_;
+};
+
+}   // namespace common
+}   // namespace curve
+
+#endif  // SRC_COMMON_CONCURRENT_MPSC_RING_QUEUE_H_
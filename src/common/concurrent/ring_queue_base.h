@@ -0,0 +1,139 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-12-14
+ * Author: curve
+ */
+
+#ifndef SRC_COMMON_CONCURRENT_RING_QUEUE_BASE_H_
+#define SRC_COMMON_CONCURRENT_RING_QUEUE_BASE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+#include "include/curve_compiler_specific.h"
+
+namespace curve {
+namespace common {
+
+/**
+ * MPSCRingQueue和MPMCRingQueue共用的有界环形队列，只包含生产者一侧
+ * 1.每个槽位带有序号，生产者通过CAS抢占写入位置，写完数据后发布序号，
+ *   消费者根据序号判断槽位中的数据是否可读，读完后将槽位归还给生产者
+ * 2.容量向上取整为2的幂，且最小为2
+ * 3.消费者一侧的位置以及出队方式由子类实现
+ */
+template <typename T>
+class RingQueueBase {
+ public:
+    RingQueueBase(const RingQueueBase&) = delete;
+    RingQueueBase& operator=(const RingQueueBase&) = delete;
+
+    /**
+     * 入队，可以被多个生产者并发调用
+     * @return 队列满时返回false
+     */
+    bool TryPush(const T& value) {
+        Cell* cell;
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq)
+                          - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // 槽位还没有被消费者归还，队列已满
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * 队列是否已满，生产者用来判断是否需要等待，返回的结果可能立刻过时
+     */
+    bool Full() {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        size_t seq = cells_[pos & mask_].sequence.load(
+            std::memory_order_acquire);
+        return static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos) < 0;
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+ protected:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    explicit RingQueueBase(size_t capacity)
+        : capacity_(RoundUpCapacity(capacity)),
+          mask_(capacity_ - 1),
+          cells_(new Cell[capacity_]),
+          enqueuePos_(0) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~RingQueueBase() = default;
+
+    /**
+     * 读出pos位置槽位中的数据，并将槽位归还给生产者，
+     * 调用者需要保证已经独占了该位置
+     */
+    void Consume(Cell* cell, size_t pos, T* value) {
+        *value = cell->value;
+        cell->sequence.store(pos + capacity_, std::memory_order_release);
+    }
+
+ private:
+    static size_t RoundUpCapacity(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+ protected:
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    // 生产者的位置单独放在一个cacheline，子类中消费者的位置同样对齐，避免伪共享
+    CURVE_CACHELINE_ALIGNMENT std::atomic<size_t> enqueuePos_;
+};
+
+}   // namespace common
+}   // namespace curve
+
+#endif  // SRC_COMMON_CONCURRENT_RING_QUEUE_BASE_H_
@@ -25,6 +25,7 @@
 
 #include <pthread.h>
 #include <assert.h>
+#include <string.h>
 #include <glog/logging.h>
 #include <bthread/bthread.h>
 
@@ -25,6 +25,9 @@
 #include <sys/utsname.h>
 #include <linux/version.h>
 #include <dirent.h>
+#include <limits.h>
+
+#include <algorithm>
 
 #include "src/common/string_util.h"
 #include "src/fs/ext4_filesystem_impl.h"
@@ -46,6 +49,9 @@ Ext4FileSystemImpl::Ext4FileSystemImpl(
 }
 
 Ext4FileSystemImpl::~Ext4FileSystemImpl() {
+    if (ioUring_ != nullptr) {
+        ioUring_->Stop();
+    }
 }
 
 std::shared_ptr<Ext4FileSystemImpl> Ext4FileSystemImpl::getInstance() {
@@ -117,6 +123,17 @@ int Ext4FileSystemImpl::Init(const LocalFileSystemOption& option) {
         if (!CheckKernelVersion())
             return -1;
     }
+    // 文件系统是单例，重复初始化时沿用已经启动的io_uring引擎
+    if (option.enableIOUring && ioUring_ == nullptr) {
+        std::unique_ptr<IOUringEngine> engine(new IOUringEngine());
+        int rc = engine->Init(option.ioUringDepth);
+        if (rc == 0) {
+            ioUring_ = std::move(engine);
+        } else {
+            LOG(WARNING) << "Init io_uring failed: " << strerror(-rc)
+                         << ", fallback to synchronous io.";
+        }
+    }
     return 0;
 }
 
@@ -329,6 +346,49 @@ int Ext4FileSystemImpl::Write(int fd,
     return length;
 }
 
+int Ext4FileSystemImpl::Writev(int fd,
+                               const struct iovec *iov,
+                               int iovcnt,
+                               uint64_t offset) {
+    // pwritev可能只写入部分数据，需要在拷贝的iovec上跳过已写入的部分
+    vector<struct iovec> remain(iov, iov + iovcnt);
+    int length = 0;
+    for (auto& vec : remain) {
+        length += vec.iov_len;
+    }
+    size_t index = 0;
+    int retryTimes = 0;
+    while (index < remain.size()) {
+        // 单次调用的iovec个数不能超过IOV_MAX
+        int count = std::min(remain.size() - index,
+                             static_cast<size_t>(IOV_MAX));
+        ssize_t ret = posixWrapper_->pwritev(fd,
+                                             remain.data() + index,
+                                             count,
+                                             offset);
+        if (ret < 0) {
+            if (errno == EINTR && retryTimes < MAX_RETYR_TIME) {
+                ++retryTimes;
+                continue;
+            }
+            LOG(ERROR) << "pwritev failed: " << strerror(errno);
+            return -errno;
+        }
+        offset += ret;
+        size_t written = ret;
+        while (index < remain.size() && written >= remain[index].iov_len) {
+            written -= remain[index].iov_len;
+            ++index;
+        }
+        if (written > 0) {
+            remain[index].iov_base =
+                static_cast<char*>(remain[index].iov_base) + written;
+            remain[index].iov_len -= written;
+        }
+    }
+    return length;
+}
+
 int Ext4FileSystemImpl::Append(int fd,
                                const char *buf,
                                int length) {
@@ -348,6 +408,15 @@ int Ext4FileSystemImpl::Fallocate(int fd,
     return 0;
 }
 
+int Ext4FileSystemImpl::Ftruncate(int fd, uint64_t length) {
+    int rc = posixWrapper_->ftruncate(fd, length);
+    if (rc < 0) {
+        LOG(ERROR) << "ftruncate failed: " << strerror(errno);
+        return -errno;
+    }
+    return 0;
+}
+
 int Ext4FileSystemImpl::Fstat(int fd, struct stat *info) {
     int rc = posixWrapper_->fstat(fd, info);
     if (rc < 0) {
@@ -366,5 +435,85 @@ int Ext4FileSystemImpl::Fsync(int fd) {
     return 0;
 }
 
+int Ext4FileSystemImpl::Fdatasync(int fd) {
+    int rc = posixWrapper_->fdatasync(fd);
+    if (rc < 0) {
+        LOG(ERROR) << "fdatasync failed: " << strerror(errno);
+        return -errno;
+    }
+    return 0;
+}
+
+bool Ext4FileSystemImpl::SupportAsyncIO() {
+    return ioUring_ != nullptr && ioUring_->Running();
+}
+
+int Ext4FileSystemImpl::RegisterBuffers(const struct iovec* iov, int nr) {
+    if (!SupportAsyncIO()) {
+        return -ENOTSUP;
+    }
+    return ioUring_->RegisterBuffers(iov, nr);
+}
+
+int Ext4FileSystemImpl::ReadAsync(int fd,
+                                  char* buf,
+                                  uint64_t offset,
+                                  int length,
+                                  AioCallback done) {
+    if (SupportAsyncIO()) {
+        int rc = ioUring_->SubmitRead(fd, buf, offset, length, done);
+        if (rc == 0) {
+            return 0;
+        }
+        LOG(WARNING) << "Submit async read failed: " << strerror(-rc)
+                     << ", fallback to synchronous io.";
+    }
+    return LocalFileSystem::ReadAsync(fd, buf, offset, length, done);
+}
+
+int Ext4FileSystemImpl::WriteAsync(int fd,
+                                   const char* buf,
+                                   uint64_t offset,
+                                   int length,
+                                   AioCallback done) {
+    if (SupportAsyncIO()) {
+        int rc = ioUring_->SubmitWrite(fd, buf, offset, length, done);
+        if (rc == 0) {
+            return 0;
+        }
+        LOG(WARNING) << "Submit async write failed: " << strerror(-rc)
+                     << ", fallback to synchronous io.";
+    }
+    return LocalFileSystem::WriteAsync(fd, buf, offset, length, done);
+}
+
+int Ext4FileSystemImpl::WritevAsync(int fd,
+                                    const struct iovec* iov,
+                                    int iovcnt,
+                                    uint64_t offset,
+                                    AioCallback done) {
+    if (SupportAsyncIO()) {
+        int rc = ioUring_->SubmitWritev(fd, iov, iovcnt, offset, done);
+        if (rc == 0) {
+            return 0;
+        }
+        LOG(WARNING) << "Submit async writev failed: " << strerror(-rc)
+                     << ", fallback to synchronous io.";
+    }
+    return LocalFileSystem::WritevAsync(fd, iov, iovcnt, offset, done);
+}
+
+int Ext4FileSystemImpl::FsyncAsync(int fd, AioCallback done) {
+    if (SupportAsyncIO()) {
+        int rc = ioUring_->SubmitFsync(fd, false, done);
+        if (rc == 0) {
+            return 0;
+        }
+        LOG(WARNING) << "Submit async fsync failed: " << strerror(-rc)
+                     << ", fallback to synchronous io.";
+    }
+    return LocalFileSystem::FsyncAsync(fd, done);
+}
+
 }  // namespace fs
 }  // namespace curve
@@ -30,6 +30,7 @@
 
 #include "src/fs/local_filesystem.h"
 #include "src/fs/wrap_posix.h"
+#include "src/fs/io_uring_engine.h"
 
 const int MAX_RETYR_TIME = 3;
 
@@ -52,11 +53,26 @@ class Ext4FileSystemImpl : public LocalFileSystem {
     int List(const string& dirPath, vector<std::string>* names) override;
     int Read(int fd, char* buf, uint64_t offset, int length) override;
     int Write(int fd, const char* buf, uint64_t offset, int length) override;
+    int Writev(int fd,
+               const struct iovec* iov,
+               int iovcnt,
+               uint64_t offset) override;
     int Append(int fd, const char* buf, int length) override;
     int Fallocate(int fd, int op, uint64_t offset,
                   int length) override;
+    int Ftruncate(int fd, uint64_t length) override;
     int Fstat(int fd, struct stat* info) override;
     int Fsync(int fd) override;
+    int Fdatasync(int fd) override;
+    bool SupportAsyncIO() override;
+    int RegisterBuffers(const struct iovec* iov, int nr) override;
+    int ReadAsync(int fd, char* buf, uint64_t offset, int length,
+                  AioCallback done) override;
+    int WriteAsync(int fd, const char* buf, uint64_t offset, int length,
+                   AioCallback done) override;
+    int WritevAsync(int fd, const struct iovec* iov, int iovcnt,
+                    uint64_t offset, AioCallback done) override;
+    int FsyncAsync(int fd, AioCallback done) override;
 
  private:
     explicit Ext4FileSystemImpl(std::shared_ptr<PosixWrapper>);
@@ -70,6 +86,8 @@ class Ext4FileSystemImpl : public LocalFileSystem {
     static std::mutex mutex_;
     std::shared_ptr<PosixWrapper> posixWrapper_;
     bool enableRenameat2_;
+    // io_uring引擎，未开启或者内核不支持时为空，异步接口回退到同步IO
+    std::unique_ptr<IOUringEngine> ioUring_;
 };
 
 }  // namespace fs
@@ -23,6 +23,8 @@
 #ifndef SRC_FS_FS_COMMON_H_
 #define SRC_FS_FS_COMMON_H_
 
+#include <functional>
+
 namespace curve {
 namespace fs {
 
@@ -38,6 +40,13 @@ struct FileSystemInfo {
     uint64_t stored = 0;        // Bytes actually stored by the user
 };
 
+/**
+ * 异步IO完成时的回调
+ * 参数与同步接口的返回值含义一致：
+ * 读写返回成功的字节数，fsync返回0，失败返回-errno
+ */
+using AioCallback = std::function<void(int)>;
+
 }  // namespace fs
 }  // namespace curve
 #endif  // SRC_FS_FS_COMMON_H_
@@ -0,0 +1,621 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <glog/logging.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include "src/fs/io_uring_engine.h"
+
+namespace curve {
+namespace fs {
+
+// 与同步接口保持一致的重试次数
+const int AIO_MAX_RETRY_TIME = 3;
+
+struct AioRequest {
+    // 操作类型
+    enum class Type {
+        READ,
+        WRITE,
+        FSYNC,
+        NOP,
+    };
+    Type type;
+    int fd;
+    // 尚未完成的数据区域，短读写时会前移
+    std::vector<struct iovec> iovs;
+    uint64_t offset;
+    // 已完成的字节数
+    uint64_t done;
+    bool datasync;
+    int retryTimes;
+    AioCallback callback;
+
+    AioRequest() : type(Type::NOP), fd(-1), offset(0), done(0),
+                   datasync(false), retryTimes(0) {}
+
+    uint64_t Remain() const {
+        uint64_t remain = 0;
+        for (auto& iov : iovs) {
+            remain += iov.iov_len;
+        }
+        return remain;
+    }
+
+    // 跳过已经完成的n个字节
+    void Advance(uint64_t n) {
+        done += n;
+        offset += n;
+        size_t i = 0;
+        while (i < iovs.size() && n >= iovs[i].iov_len) {
+            n -= iovs[i].iov_len;
+            ++i;
+        }
+        iovs.erase(iovs.begin(), iovs.begin() + i);
+        if (n > 0 && !iovs.empty()) {
+            iovs[0].iov_base = static_cast<char*>(iovs[0].iov_base) + n;
+            iovs[0].iov_len -= n;
+        }
+    }
+};
+
+IOUringEngine::IOUringEngine()
+    : ringFd_(-1)
+    , depth_(0)
+    , running_(false)
+    , stopping_(false)
+    , sqRing_(nullptr)
+    , sqRingSize_(0)
+    , cqRing_(nullptr)
+    , cqRingSize_(0)
+    , sqes_(nullptr)
+    , sqesSize_(0)
+    , sqHead_(nullptr)
+    , sqTail_(nullptr)
+    , sqMask_(nullptr)
+    , sqArray_(nullptr)
+    , cqHead_(nullptr)
+    , cqTail_(nullptr)
+    , cqMask_(nullptr)
+    , cqes_(nullptr)
+    , inflight_(0) {}
+
+IOUringEngine::~IOUringEngine() {
+    Stop();
+}
+
+#ifdef CURVE_HAVE_IO_URING
+
+namespace {
+
+inline int SysIOUringSetup(unsigned entries, struct io_uring_params* p) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+inline int SysIOUringEnter(int fd, unsigned toSubmit, unsigned minComplete,
+                           unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit,
+                                      minComplete, flags, nullptr, 0));
+}
+
+inline int SysIOUringRegister(int fd, unsigned opcode, const void* arg,
+                              unsigned nrArgs) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode,
+                                      arg, nrArgs));
+}
+
+}  // namespace
+
+int IOUringEngine::Init(uint32_t depth) {
+    if (running_.load(std::memory_order_acquire)) {
+        return 0;
+    }
+    if (depth == 0) {
+        return -EINVAL;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = SysIOUringSetup(depth, &params);
+    if (fd < 0) {
+        int err = errno;
+        LOG(WARNING) << "io_uring_setup failed: " << strerror(err);
+        return -err;
+    }
+    ringFd_ = fd;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes +
+                  params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        singleMmap = true;
+        sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        cqRingSize_ = sqRingSize_;
+    }
+#endif
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        int err = errno;
+        sqRing_ = nullptr;
+        LOG(ERROR) << "mmap io_uring sq ring failed: " << strerror(err);
+        Release();
+        return -err;
+    }
+    if (singleMmap) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            int err = errno;
+            cqRing_ = nullptr;
+            LOG(ERROR) << "mmap io_uring cq ring failed: " << strerror(err);
+            Release();
+            return -err;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        int err = errno;
+        LOG(ERROR) << "mmap io_uring sqes failed: " << strerror(err);
+        Release();
+        return -err;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // 在途请求数不超过sq的大小，保证sq和cq都不会溢出
+    depth_ = params.sq_entries;
+    inflight_ = 0;
+    stopping_ = false;
+    running_.store(true, std::memory_order_release);
+    reaper_ = std::thread(&IOUringEngine::ReapLoop, this);
+    LOG(INFO) << "io_uring engine started, depth: " << depth_;
+    return 0;
+}
+
+void IOUringEngine::Stop() {
+    if (!running_.load(std::memory_order_acquire)) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(submitMtx_);
+        stopping_ = true;
+        inflightCond_.wait(lock, [this] { return inflight_ == 0; });
+        // 提交一个NOP请求唤醒收割线程，user_data为0表示退出
+        AioRequest nop;
+        nop.type = AioRequest::Type::NOP;
+        PrepareLocked(&nop);
+        std::vector<AioRequest*> dropped;
+        EnterLocked(&dropped);
+    }
+    reaper_.join();
+    running_.store(false, std::memory_order_release);
+    Release();
+    LOG(INFO) << "io_uring engine stopped.";
+}
+
+void IOUringEngine::Release() {
+    if (sqes_ != nullptr) {
+        munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+    if (cqRing_ != nullptr && cqRing_ != sqRing_) {
+        munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = nullptr;
+    if (sqRing_ != nullptr) {
+        munmap(sqRing_, sqRingSize_);
+        sqRing_ = nullptr;
+    }
+    if (ringFd_ >= 0) {
+        ::close(ringFd_);
+        ringFd_ = -1;
+    }
+    fixedBuffers_.clear();
+}
+
+int IOUringEngine::RegisterBuffers(const struct iovec* iov, int nr) {
+    if (!running_.load(std::memory_order_acquire)) {
+        return -ENOSYS;
+    }
+    std::lock_guard<std::mutex> lock(submitMtx_);
+    if (!fixedBuffers_.empty()) {
+        return -EBUSY;
+    }
+    int ret = SysIOUringRegister(ringFd_, IORING_REGISTER_BUFFERS, iov, nr);
+    if (ret < 0) {
+        int err = errno;
+        LOG(ERROR) << "io_uring register buffers failed: " << strerror(err);
+        return -err;
+    }
+    fixedBuffers_.assign(iov, iov + nr);
+    return 0;
+}
+
+int IOUringEngine::FindFixedBuffer(const void* addr, size_t len) const {
+    const char* begin = static_cast<const char*>(addr);
+    for (size_t i = 0; i < fixedBuffers_.size(); ++i) {
+        const char* base =
+            static_cast<const char*>(fixedBuffers_[i].iov_base);
+        if (begin >= base &&
+            begin + len <= base + fixedBuffers_[i].iov_len) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void IOUringEngine::PrepareLocked(AioRequest* req) {
+    unsigned tail = *sqTail_;
+    unsigned index = tail & *sqMask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = req->fd;
+    sqe->off = req->offset;
+    switch (req->type) {
+    case AioRequest::Type::READ:
+    case AioRequest::Type::WRITE: {
+        bool isRead = req->type == AioRequest::Type::READ;
+        int bufIndex = -1;
+        if (req->iovs.size() == 1) {
+            bufIndex = FindFixedBuffer(req->iovs[0].iov_base,
+                                       req->iovs[0].iov_len);
+        }
+        if (bufIndex >= 0) {
+            sqe->opcode = isRead ? IORING_OP_READ_FIXED
+                                 : IORING_OP_WRITE_FIXED;
+            sqe->addr = reinterpret_cast<uint64_t>(req->iovs[0].iov_base);
+            sqe->len = req->iovs[0].iov_len;
+            sqe->buf_index = bufIndex;
+        } else {
+            sqe->opcode = isRead ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->addr = reinterpret_cast<uint64_t>(req->iovs.data());
+            sqe->len = std::min<size_t>(req->iovs.size(), IOV_MAX);
+        }
+        break;
+    }
+    case AioRequest::Type::FSYNC:
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fsync_flags = req->datasync ? IORING_FSYNC_DATASYNC : 0;
+        break;
+    case AioRequest::Type::NOP:
+        sqe->opcode = IORING_OP_NOP;
+        sqe->fd = -1;
+        sqe->off = 0;
+        break;
+    }
+    sqe->user_data = req->type == AioRequest::Type::NOP
+                   ? 0 : reinterpret_cast<uint64_t>(req);
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+}
+
+int IOUringEngine::EnterLocked(std::vector<AioRequest*>* dropped) {
+    // 一次提交队列中所有已准备好的sqe，sq只在持有submitMtx_时被修改和提交，
+    // 没有开启SQPOLL，内核只会在io_uring_enter中消费sqe
+    int retryTimes = 0;
+    while (true) {
+        int ret = SysIOUringEnter(ringFd_, depth_, 0, 0);
+        if (ret >= 0) {
+            return 0;
+        }
+        int err = errno;
+        if ((err == EINTR || err == EAGAIN || err == EBUSY)
+            && retryTimes < AIO_MAX_RETRY_TIME) {
+            ++retryTimes;
+            continue;
+        }
+        // io_uring_enter返回错误时没有提交任何sqe，将它们从提交队列中撤回，
+        // 否则会随下一次io_uring_enter提交，而调用方已经按失败处理
+        LOG(ERROR) << "io_uring_enter failed: " << strerror(err);
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        unsigned tail = *sqTail_;
+        for (unsigned i = head; i != tail; ++i) {
+            uint64_t userData = sqes_[sqArray_[i & *sqMask_]].user_data;
+            if (userData != 0) {
+                dropped->push_back(reinterpret_cast<AioRequest*>(userData));
+            }
+        }
+        __atomic_store_n(sqTail_, head, __ATOMIC_RELEASE);
+        inflight_ -= dropped->size();
+        return -err;
+    }
+}
+
+void IOUringEngine::FailDropped(const std::vector<AioRequest*>& dropped,
+                                int err) {
+    if (!dropped.empty()) {
+        inflightCond_.notify_all();
+    }
+    for (AioRequest* req : dropped) {
+        AioCallback callback = std::move(req->callback);
+        delete req;
+        if (callback) {
+            callback(err);
+        }
+    }
+}
+
+int IOUringEngine::Submit(AioRequest* req) {
+    std::unique_lock<std::mutex> lock(submitMtx_);
+    if (!running_.load(std::memory_order_acquire)) {
+        return -ESHUTDOWN;
+    }
+    inflightCond_.wait(lock, [this] {
+        return stopping_ || inflight_ < depth_;
+    });
+    if (stopping_) {
+        return -ESHUTDOWN;
+    }
+    PrepareLocked(req);
+    ++inflight_;
+    std::vector<AioRequest*> dropped;
+    int ret = EnterLocked(&dropped);
+    lock.unlock();
+    if (ret == 0) {
+        return 0;
+    }
+    // 当前请求返回错误由调用方释放并走同步失败的路径，
+    // 其他线程准备好但被一并撤回的请求通过回调返回错误
+    auto iter = std::find(dropped.begin(), dropped.end(), req);
+    bool submitted = iter == dropped.end();
+    if (!submitted) {
+        dropped.erase(iter);
+        inflightCond_.notify_all();
+    }
+    FailDropped(dropped, ret);
+    return submitted ? 0 : ret;
+}
+
+void IOUringEngine::Complete(AioRequest* req, int res) {
+    AioCallback callback = std::move(req->callback);
+    delete req;
+    {
+        std::lock_guard<std::mutex> lock(submitMtx_);
+        --inflight_;
+    }
+    inflightCond_.notify_all();
+    if (callback) {
+        callback(res);
+    }
+}
+
+void IOUringEngine::HandleCompletion(AioRequest* req, int res) {
+    bool resubmit = false;
+    if (res < 0) {
+        if ((res == -EINTR || res == -EAGAIN)
+            && req->retryTimes < AIO_MAX_RETRY_TIME) {
+            ++req->retryTimes;
+            resubmit = true;
+        } else {
+            LOG(ERROR) << "io_uring request failed: " << strerror(-res)
+                       << ", fd: " << req->fd
+                       << ", offset: " << req->offset;
+            Complete(req, res);
+            return;
+        }
+    } else if (req->type == AioRequest::Type::READ
+               || req->type == AioRequest::Type::WRITE) {
+        // 与同步接口一致，读到文件末尾时返回已读取的长度
+        if (res == 0 && req->type == AioRequest::Type::READ) {
+            LOG(WARNING) << "io_uring read returns zero."
+                         << "offset: " << req->offset
+                         << ", length: " << req->Remain();
+            Complete(req, req->done);
+            return;
+        }
+        // 还有数据未写入时写入了0字节，重新提交不会有进展，按IO错误返回
+        if (res == 0 && req->Remain() > 0) {
+            LOG(ERROR) << "io_uring write returns zero."
+                       << "fd: " << req->fd
+                       << ", offset: " << req->offset
+                       << ", length: " << req->Remain();
+            Complete(req, -EIO);
+            return;
+        }
+        req->Advance(res);
+        resubmit = !req->iovs.empty();
+        if (!resubmit) {
+            Complete(req, req->done);
+            return;
+        }
+    } else {
+        Complete(req, res);
+        return;
+    }
+
+    if (resubmit) {
+        // 重新提交的请求已经占有在途名额，这里不需要等待
+        std::vector<AioRequest*> dropped;
+        int ret;
+        {
+            std::lock_guard<std::mutex> lock(submitMtx_);
+            PrepareLocked(req);
+            ret = EnterLocked(&dropped);
+        }
+        FailDropped(dropped, ret);
+    }
+}
+
+void IOUringEngine::ReapLoop() {
+    bool exit = false;
+    while (!exit) {
+        int ret = SysIOUringEnter(ringFd_, 0, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && errno != EINTR) {
+            LOG(ERROR) << "io_uring wait completion failed: "
+                       << strerror(errno);
+        }
+
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe* cqe = &cqes_[head & *cqMask_];
+            uint64_t userData = cqe->user_data;
+            int res = cqe->res;
+            ++head;
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+            if (userData == 0) {
+                exit = true;
+                continue;
+            }
+            HandleCompletion(reinterpret_cast<AioRequest*>(userData), res);
+        }
+    }
+}
+
+#else  // CURVE_HAVE_IO_URING
+
+int IOUringEngine::Init(uint32_t depth) {
+    LOG(WARNING) << "io_uring is not supported by this build.";
+    return -ENOSYS;
+}
+
+void IOUringEngine::Stop() {}
+
+void IOUringEngine::Release() {}
+
+int IOUringEngine::RegisterBuffers(const struct iovec* iov, int nr) {
+    return -ENOSYS;
+}
+
+int IOUringEngine::FindFixedBuffer(const void* addr, size_t len) const {
+    return -1;
+}
+
+void IOUringEngine::PrepareLocked(AioRequest* req) {}
+
+int IOUringEngine::EnterLocked(std::vector<AioRequest*>* dropped) {
+    return -ENOSYS;
+}
+
+void IOUringEngine::FailDropped(const std::vector<AioRequest*>& dropped,
+                                int err) {}
+
+int IOUringEngine::Submit(AioRequest* req) {
+    return -ENOSYS;
+}
+
+void IOUringEngine::Complete(AioRequest* req, int res) {}
+
+void IOUringEngine::HandleCompletion(AioRequest* req, int res) {}
+
+void IOUringEngine::ReapLoop() {}
+
+#endif  // CURVE_HAVE_IO_URING
+
+int IOUringEngine::SubmitRead(int fd, char* buf, uint64_t offset, int length,
+                              AioCallback done) {
+    if (length < 0) {
+        return -EINVAL;
+    }
+    AioRequest* req = new AioRequest();
+    req->type = AioRequest::Type::READ;
+    req->fd = fd;
+    req->offset = offset;
+    req->iovs.push_back({buf, static_cast<size_t>(length)});
+    req->callback = std::move(done);
+    int ret = Submit(req);
+    if (ret < 0) {
+        delete req;
+    }
+    return ret;
+}
+
+int IOUringEngine::SubmitWrite(int fd, const char* buf, uint64_t offset,
+                               int length, AioCallback done) {
+    if (length < 0) {
+        return -EINVAL;
+    }
+    AioRequest* req = new AioRequest();
+    req->type = AioRequest::Type::WRITE;
+    req->fd = fd;
+    req->offset = offset;
+    req->iovs.push_back({const_cast<char*>(buf),
+                         static_cast<size_t>(length)});
+    req->callback = std::move(done);
+    int ret = Submit(req);
+    if (ret < 0) {
+        delete req;
+    }
+    return ret;
+}
+
+int IOUringEngine::SubmitWritev(int fd, const struct iovec* iov, int iovcnt,
+                                uint64_t offset, AioCallback done) {
+    if (iovcnt < 0) {
+        return -EINVAL;
+    }
+    AioRequest* req = new AioRequest();
+    req->type = AioRequest::Type::WRITE;
+    req->fd = fd;
+    req->offset = offset;
+    for (int i = 0; i < iovcnt; ++i) {
+        if (iov[i].iov_len > 0) {
+            req->iovs.push_back(iov[i]);
+        }
+    }
+    req->callback = std::move(done);
+    int ret = Submit(req);
+    if (ret < 0) {
+        delete req;
+    }
+    return ret;
+}
+
+int IOUringEngine::SubmitFsync(int fd, bool datasync, AioCallback done) {
+    AioRequest* req = new AioRequest();
+    req->type = AioRequest::Type::FSYNC;
+    req->fd = fd;
+    req->datasync = datasync;
+    req->callback = std::move(done);
+    int ret = Submit(req);
+    if (ret < 0) {
+        delete req;
+    }
+    return ret;
+}
+
+}  // namespace fs
+}  // namespace curve
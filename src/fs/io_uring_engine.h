@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#ifndef SRC_FS_IO_URING_ENGINE_H_
+#define SRC_FS_IO_URING_ENGINE_H_
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "src/fs/fs_common.h"
+
+// 只有内核头文件中提供了io_uring的定义时才编译io_uring引擎，
+// 否则引擎的Init总是返回-ENOSYS，上层回退到同步IO
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && \
+    defined(__NR_io_uring_register)
+#define CURVE_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace curve {
+namespace fs {
+
+struct AioRequest;
+
+/**
+ * 基于io_uring的异步IO引擎
+ * 直接使用io_uring系统调用，不依赖liburing
+ * 1.提交接口线程安全，多个线程同时提交的sqe会由一次io_uring_enter批量提交
+ * 2.由一个后台线程收割完成事件，并在该线程中调用请求的回调，
+ *   因此回调中不应做耗时操作
+ * 3.同时在途的请求数不超过队列深度，队列满时提交者会阻塞等待
+ * 4.短读写以及EINTR/EAGAIN会在引擎内部重新提交，回调只会被调用一次
+ */
+class IOUringEngine {
+ public:
+    IOUringEngine();
+    ~IOUringEngine();
+
+    /**
+     * 初始化io_uring并启动完成事件收割线程
+     * @param depth: 队列深度，即同时在途的最大请求数
+     * @return 成功返回0，内核或编译环境不支持时返回-ENOSYS，其他失败返回-errno
+     */
+    int Init(uint32_t depth);
+
+    /**
+     * 等待在途请求全部完成后停止引擎，释放io_uring资源
+     */
+    void Stop();
+
+    /**
+     * 引擎是否处于可用状态
+     */
+    bool Running() const {
+        return running_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * 注册固定buffer，落在注册区域内的读写会使用READ_FIXED/WRITE_FIXED，
+     * 省去内核每次IO对用户内存的映射
+     * 一个io_uring实例只能注册一次，注册的内存在引擎停止前必须保持有效
+     * @param iov: 待注册的内存区域
+     * @param nr: 内存区域个数
+     * @return 成功返回0，失败返回-errno
+     */
+    int RegisterBuffers(const struct iovec* iov, int nr);
+
+    /**
+     * 提交异步读请求
+     * @return 提交成功返回0，此后done一定会被调用一次；
+     *         失败返回-errno，done不会被调用
+     */
+    int SubmitRead(int fd, char* buf, uint64_t offset, int length,
+                   AioCallback done);
+
+    /**
+     * 提交异步写请求，返回值含义同SubmitRead
+     */
+    int SubmitWrite(int fd, const char* buf, uint64_t offset, int length,
+                    AioCallback done);
+
+    /**
+     * 提交异步向量写请求，iov数组会被拷贝，调用返回后即可释放，
+     * 但iov指向的数据在done被调用前必须保持有效，返回值含义同SubmitRead
+     */
+    int SubmitWritev(int fd, const struct iovec* iov, int iovcnt,
+                     uint64_t offset, AioCallback done);
+
+    /**
+     * 提交异步fsync请求
+     * @param datasync: 为true时只同步数据，相当于fdatasync
+     */
+    int SubmitFsync(int fd, bool datasync, AioCallback done);
+
+    /**
+     * 当前在途请求数
+     */
+    uint32_t Inflight() {
+        std::lock_guard<std::mutex> lock(submitMtx_);
+        return inflight_;
+    }
+
+ private:
+    // 申请一个在途名额并提交请求，队列满时阻塞等待
+    int Submit(AioRequest* req);
+    // 在持有submitMtx_的情况下将请求填入sqe
+    void PrepareLocked(AioRequest* req);
+    // 在持有submitMtx_的情况下将提交队列中已准备好的sqe批量提交给内核，
+    // 失败时已准备好的sqe全部从提交队列中撤回，返回错误码
+    int EnterLocked(std::vector<AioRequest*>* dropped);
+    // 以错误码结束被撤回的请求，调用时不能持有submitMtx_
+    void FailDropped(const std::vector<AioRequest*>& dropped, int err);
+    // 处理一个完成事件，请求未完成时会重新提交
+    void HandleCompletion(AioRequest* req, int res);
+    // 请求完成，调用回调并释放在途名额
+    void Complete(AioRequest* req, int res);
+    // 收割线程主循环
+    void ReapLoop();
+    // 查找包含[addr, addr+len)的固定buffer，返回其下标，不存在返回-1
+    int FindFixedBuffer(const void* addr, size_t len) const;
+    void Release();
+
+ private:
+    int ringFd_;
+    uint32_t depth_;
+    std::atomic<bool> running_;
+    bool stopping_;
+
+    // 提交队列相关的内存映射
+    void* sqRing_;
+    size_t sqRingSize_;
+    void* cqRing_;
+    size_t cqRingSize_;
+    struct io_uring_sqe* sqes_;
+    size_t sqesSize_;
+
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqArray_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    // 保护sq以及在途请求计数
+    std::mutex submitMtx_;
+    std::condition_variable inflightCond_;
+    uint32_t inflight_;
+
+    // 已注册的固定buffer
+    std::vector<struct iovec> fixedBuffers_;
+
+    std::thread reaper_;
+};
+
+}  // namespace fs
+}  // namespace curve
+
+#endif  // SRC_FS_IO_URING_ENGINE_H_
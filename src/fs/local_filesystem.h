@@ -26,6 +26,8 @@
 #include <inttypes.h>
 #include <assert.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <errno.h>
 #include <memory>
 #include <vector>
 #include <map>
@@ -44,7 +46,13 @@ namespace fs {
 
 struct LocalFileSystemOption {
     bool enableRenameat2;
-    LocalFileSystemOption() : enableRenameat2(false) {}
+    // 是否使用io_uring提交异步IO，内核不支持时会回退到同步IO
+    bool enableIOUring;
+    // io_uring的队列深度
+    uint32_t ioUringDepth;
+    LocalFileSystemOption() : enableRenameat2(false)
+                            , enableIOUring(false)
+                            , ioUringDepth(128) {}
 };
 
 class LocalFileSystem {
@@ -159,6 +167,20 @@ class LocalFileSystem {
      */
     virtual int Write(int fd, const char* buf, uint64_t offset, int length) = 0;
 
+    /**
+     * 将多段不连续的内存数据写入文件的连续区域
+     * 用于直接写入IOBuf的各个block，避免将数据拷贝到一段连续内存
+     * @param fd：文件句柄id，通过Open接口获取
+     * @param iov：待写入数据的iovec数组
+     * @param iovcnt：iovec数组的长度
+     * @param offset：写入区域的起始偏移
+     * @return 返回成功写入的数据长度，失败返回负值
+     */
+    virtual int Writev(int fd,
+                       const struct iovec* iov,
+                       int iovcnt,
+                       uint64_t offset) = 0;
+
     /**
      * 向文件末尾追加数据
      * @param fd：文件句柄id，通过Open接口获取
@@ -178,6 +200,14 @@ class LocalFileSystem {
      */
     virtual int Fallocate(int fd, int op, uint64_t offset, int length) = 0;
 
+    /**
+     * 将文件截断或者扩展到指定长度
+     * @param fd：文件句柄id，通过Open接口获取
+     * @param length：文件的新长度
+     * @return 成功返回0
+     */
+    virtual int Ftruncate(int fd, uint64_t length) = 0;
+
     /**
      * 获取指定文件状态信息
      * @param fd：文件句柄id，通过Open接口获取
@@ -194,6 +224,83 @@ class LocalFileSystem {
      */
     virtual int Fsync(int fd) = 0;
 
+    /**
+     * 将文件数据刷新到磁盘，只在影响后续读取时才刷新元数据
+     * @param fd：文件句柄id，通过Open接口获取
+     * @return 成功返回0
+     */
+    virtual int Fdatasync(int fd) = 0;
+
+    /**
+     * 是否支持真正的异步IO
+     * 不支持时异步接口会在调用线程中同步完成IO后再调用回调
+     * @return 支持返回true，否则返回false
+     */
+    virtual bool SupportAsyncIO() {
+        return false;
+    }
+
+    /**
+     * 注册固定buffer，落在注册区域内的异步读写可以省去内核对用户内存的映射
+     * @param iov：待注册的内存区域
+     * @param nr：内存区域的个数
+     * @return 成功返回0，不支持或失败返回负值
+     */
+    virtual int RegisterBuffers(const struct iovec* iov, int nr) {
+        return -ENOTSUP;
+    }
+
+    /**
+     * 异步从文件指定区域读取数据
+     * buf在回调被调用前必须保持有效
+     * @param fd：文件句柄id，通过Open接口获取
+     * @param buf：接收读取数据的buffer
+     * @param offset：读取区域的起始偏移
+     * @param length：读取数据的长度
+     * @param done：IO完成时的回调，参数同Read的返回值
+     * @return 提交成功返回0，此后done一定会被调用一次；
+     *         失败返回负值，done不会被调用
+     */
+    virtual int ReadAsync(int fd, char* buf, uint64_t offset, int length,
+                          AioCallback done) {
+        done(Read(fd, buf, offset, length));
+        return 0;
+    }
+
+    /**
+     * 异步向文件指定区域写入数据
+     * buf在回调被调用前必须保持有效
+     * @param done：IO完成时的回调，参数同Write的返回值
+     * @return 返回值含义同ReadAsync
+     */
+    virtual int WriteAsync(int fd, const char* buf, uint64_t offset,
+                           int length, AioCallback done) {
+        done(Write(fd, buf, offset, length));
+        return 0;
+    }
+
+    /**
+     * 异步将多段不连续的内存数据写入文件的连续区域
+     * iov数组在调用返回后即可释放，iov指向的数据在回调被调用前必须保持有效
+     * @param done：IO完成时的回调，参数同Writev的返回值
+     * @return 返回值含义同ReadAsync
+     */
+    virtual int WritevAsync(int fd, const struct iovec* iov, int iovcnt,
+                            uint64_t offset, AioCallback done) {
+        done(Writev(fd, iov, iovcnt, offset));
+        return 0;
+    }
+
+    /**
+     * 异步将文件数据和元数据刷新到磁盘
+     * @param done：IO完成时的回调，参数同Fsync的返回值
+     * @return 返回值含义同ReadAsync
+     */
+    virtual int FsyncAsync(int fd, AioCallback done) {
+        done(Fsync(fd));
+        return 0;
+    }
+
  private:
     virtual int DoRename(const string& oldPath,
                          const string& newPath,
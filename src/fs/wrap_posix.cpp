@@ -96,6 +96,13 @@ ssize_t PosixWrapper::pwrite(int fd,
     return ::pwrite(fd, buf, count, offset);
 }
 
+ssize_t PosixWrapper::pwritev(int fd,
+                              const struct iovec *iov,
+                              int iovcnt,
+                              off_t offset) {
+    return ::pwritev(fd, iov, iovcnt, offset);
+}
+
 int PosixWrapper::fstat(int fd, struct stat *buf) {
     return ::fstat(fd, buf);
 }
@@ -104,10 +111,18 @@ int PosixWrapper::fallocate(int fd, int mode, off_t offset, off_t len) {
     return ::posix_fallocate(fd, offset, len);
 }
 
+int PosixWrapper::ftruncate(int fd, off_t length) {
+    return ::ftruncate(fd, length);
+}
+
 int PosixWrapper::fsync(int fd) {
     return ::fsync(fd);
 }
 
+int PosixWrapper::fdatasync(int fd) {
+    return ::fdatasync(fd);
+}
+
 int PosixWrapper::statfs(const char *path, struct statfs *buf) {
     return ::statfs(path, buf);
 }
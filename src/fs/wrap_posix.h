@@ -29,6 +29,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/utsname.h>
+#include <sys/uio.h>
 #include <dirent.h>
 #include <linux/fs.h>
 #include <string>
@@ -59,9 +60,15 @@ class PosixWrapper {
                            const void *buf,
                            size_t count,
                            off_t offset);
+    virtual ssize_t pwritev(int fd,
+                            const struct iovec *iov,
+                            int iovcnt,
+                            off_t offset);
     virtual int fstat(int fd, struct stat *buf);
     virtual int fallocate(int fd, int mode, off_t offset, off_t len);
+    virtual int ftruncate(int fd, off_t length);
     virtual int fsync(int fd);
+    virtual int fdatasync(int fd);
     virtual int statfs(const char *path, struct statfs *buf);
     virtual int uname(struct utsname *buf);
 };
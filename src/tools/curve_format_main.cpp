@@ -81,7 +81,8 @@ DEFINE_uint32(allocatepercent,
               80,
               "preallocate storage percent of total disk");
 
-// 测试情况下置为false，加快测试速度
+// 测试情况下置为false，加快测试速度；
+// chunkserver开启storeng.track_written_pages时也可以置为false
 DEFINE_bool(needWriteZero,
         true,
         "not write zero for test.");
@@ -0,0 +1,115 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+
+#include <memory>
+#include <string>
+
+#include "src/chunkserver/applied_index_file.h"
+#include "test/fs/mock_local_filesystem.h"
+
+namespace curve {
+namespace chunkserver {
+
+using ::testing::_;
+using ::testing::Return;
+
+using curve::fs::MockLocalFileSystem;
+using curve::fs::LocalFsFactory;
+using curve::fs::FileSystemType;
+
+const char kAppliedIndexTestPath[] = "./applied_index_test";
+
+TEST(AppliedIndexFileTest, load_save) {
+    std::string rmCmd("rm -f ");
+    rmCmd += kAppliedIndexTestPath;
+
+    // normal load/save
+    {
+        auto fs = LocalFsFactory::CreateFs(FileSystemType::EXT4, "");
+        AppliedIndexFile file(fs);
+        uint64_t index = 0;
+        ASSERT_EQ(-1, file.Load(kAppliedIndexTestPath, &index));
+        ASSERT_EQ(0, file.Save(kAppliedIndexTestPath, 1000));
+        ASSERT_EQ(0, file.Load(kAppliedIndexTestPath, &index));
+        ASSERT_EQ(1000, index);
+        // 原地覆盖
+        ASSERT_EQ(0, file.Save(kAppliedIndexTestPath, 20));
+        ASSERT_EQ(0, file.Load(kAppliedIndexTestPath, &index));
+        ASSERT_EQ(20, index);
+
+        // 破坏文件内容后校验失败
+        int fd = fs->Open(kAppliedIndexTestPath, O_RDWR);
+        ASSERT_GE(fd, 0);
+        char c = 1;
+        ASSERT_EQ(1, fs->Write(fd, &c, 9, 1));
+        fs->Close(fd);
+        ASSERT_EQ(-1, file.Load(kAppliedIndexTestPath, &index));
+
+        ::system(rmCmd.c_str());
+    }
+    // load: read failed
+    {
+        std::shared_ptr<MockLocalFileSystem> fs
+            = std::make_shared<MockLocalFileSystem>();
+        AppliedIndexFile file(fs);
+        uint64_t index;
+        EXPECT_CALL(*fs, Open(_, _)).Times(1).WillOnce(Return(10));
+        EXPECT_CALL(*fs, Read(_, _, _, _)).Times(1).WillOnce(Return(-1));
+        EXPECT_CALL(*fs, Close(_)).Times(1).WillOnce(Return(0));
+        ASSERT_EQ(-1, file.Load(kAppliedIndexTestPath, &index));
+    }
+    // save: open failed
+    {
+        std::shared_ptr<MockLocalFileSystem> fs
+            = std::make_shared<MockLocalFileSystem>();
+        AppliedIndexFile file(fs);
+        EXPECT_CALL(*fs, Open(_, _)).Times(1).WillOnce(Return(-1));
+        ASSERT_EQ(-1, file.Save(kAppliedIndexTestPath, 1));
+    }
+    // save: write failed
+    {
+        std::shared_ptr<MockLocalFileSystem> fs
+            = std::make_shared<MockLocalFileSystem>();
+        AppliedIndexFile file(fs);
+        EXPECT_CALL(*fs, Open(_, _)).Times(1).WillOnce(Return(10));
+        EXPECT_CALL(*fs, Write(_, _, _, _)).Times(1).WillOnce(Return(-1));
+        EXPECT_CALL(*fs, Close(_)).Times(1).WillOnce(Return(0));
+        ASSERT_EQ(-1, file.Save(kAppliedIndexTestPath, 1));
+    }
+    // save: sync failed
+    {
+        std::shared_ptr<MockLocalFileSystem> fs
+            = std::make_shared<MockLocalFileSystem>();
+        AppliedIndexFile file(fs);
+        EXPECT_CALL(*fs, Open(_, _)).Times(1).WillOnce(Return(10));
+        EXPECT_CALL(*fs, Write(_, _, _, _)).Times(1).WillOnce(Return(20));
+        EXPECT_CALL(*fs, Fdatasync(_)).Times(1).WillOnce(Return(-1));
+        EXPECT_CALL(*fs, Close(_)).Times(1).WillOnce(Return(0));
+        ASSERT_EQ(-1, file.Save(kAppliedIndexTestPath, 1));
+    }
+}
+
+}  // namespace chunkserver
+}  // namespace curve
@@ -0,0 +1,152 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-30
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+#include <brpc/controller.h>
+#include <brpc/closure_guard.h>
+
+#include <memory>
+#include <string>
+
+#include "src/chunkserver/batch_request.h"
+
+namespace curve {
+namespace chunkserver {
+
+class CountClosure : public google::protobuf::Closure {
+ public:
+    CountClosure() : count_(0) {}
+    void Run() override {
+        ++count_;
+    }
+    int count_;
+};
+
+static void AddRequest(BatchChunkRequest *request,
+                       CHUNK_OP_TYPE type,
+                       uint64_t chunkId,
+                       uint32_t size) {
+    ChunkRequest *subRequest = request->add_requests();
+    subRequest->set_optype(type);
+    subRequest->set_logicpoolid(1);
+    subRequest->set_copysetid(100);
+    subRequest->set_chunkid(chunkId);
+    subRequest->set_offset(0);
+    subRequest->set_size(size);
+}
+
+TEST(BatchRequestContextTest, SplitAndMergeTest) {
+    brpc::Controller cntl;
+    BatchChunkRequest request;
+    BatchChunkResponse response;
+    CountClosure done;
+    request.set_logicpoolid(1);
+    request.set_copysetid(100);
+    AddRequest(&request, CHUNK_OP_TYPE::CHUNK_OP_WRITE, 1, 4096);
+    AddRequest(&request, CHUNK_OP_TYPE::CHUNK_OP_READ, 2, 4096);
+    AddRequest(&request, CHUNK_OP_TYPE::CHUNK_OP_WRITE, 3, 8192);
+    AddRequest(&request, CHUNK_OP_TYPE::CHUNK_OP_READ, 4, 4096);
+    AddRequest(&request, CHUNK_OP_TYPE::CHUNK_OP_READ, 5, 4096);
+    cntl.request_attachment().append(std::string(4096, 'a'));
+    cntl.request_attachment().append(std::string(8192, 'b'));
+
+    {
+        auto context = std::make_shared<BatchRequestContext>(
+            &cntl, &request, &response, &done);
+        ASSERT_EQ(0, context->Init());
+        ASSERT_EQ(5, response.responses_size());
+        // 写请求的数据按顺序拆分
+        ASSERT_EQ(std::string(4096, 'a'),
+                  context->SubController(0)->request_attachment().to_string());
+        ASSERT_EQ(0, context->SubController(1)->request_attachment().size());
+        ASSERT_EQ(std::string(8192, 'b'),
+                  context->SubController(2)->request_attachment().to_string());
+
+        // 子请求全部返回后才返回rpc
+        for (int i = 0; i < request.requests_size(); ++i) {
+            brpc::ClosureGuard subGuard(
+                BatchRequestContext::NewSubClosure(context));
+            ChunkResponse *subResponse = context->SubResponse(i);
+            subResponse->set_status(CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS);
+            if (i == 1) {
+                context->SubController(i)->response_attachment().append(
+                    std::string(4096, 'c'));
+            } else if (i == 3) {
+                // 读失败的数据不返回
+                subResponse->set_status(
+                    CHUNK_OP_STATUS::CHUNK_OP_STATUS_CHUNK_NOTEXIST);
+            } else if (i == 4) {
+                context->SubController(i)->response_attachment().append(
+                    std::string(4096, 'd'));
+            }
+        }
+        ASSERT_EQ(0, done.count_);
+    }
+    ASSERT_EQ(1, done.count_);
+    ASSERT_EQ(CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS,
+              response.responses(0).status());
+    ASSERT_EQ(CHUNK_OP_STATUS::CHUNK_OP_STATUS_CHUNK_NOTEXIST,
+              response.responses(3).status());
+    ASSERT_EQ(std::string(4096, 'c') + std::string(4096, 'd'),
+              cntl.response_attachment().to_string());
+}
+
+TEST(BatchRequestContextTest, InvalidAttachmentTest) {
+    // attachment比写请求的数据多
+    {
+        brpc::Controller cntl;
+        BatchChunkRequest request;
+        BatchChunkResponse response;
+        CountClosure done;
+        AddRequest(&request, CHUNK_OP_TYPE::CHUNK_OP_WRITE, 1, 4096);
+        AddRequest(&request, CHUNK_OP_TYPE::CHUNK_OP_READ, 2, 4096);
+        cntl.request_attachment().append(std::string(8192, 'a'));
+        auto context = std::make_shared<BatchRequestContext>(
+            &cntl, &request, &response, &done);
+        ASSERT_EQ(-1, context->Init());
+        context->SetStatus(CHUNK_OP_STATUS::CHUNK_OP_STATUS_INVALID_REQUEST);
+        context.reset();
+        ASSERT_EQ(1, done.count_);
+        ASSERT_EQ(2, response.responses_size());
+        ASSERT_EQ(CHUNK_OP_STATUS::CHUNK_OP_STATUS_INVALID_REQUEST,
+                  response.responses(1).status());
+        ASSERT_EQ(0, cntl.response_attachment().size());
+    }
+    // attachment比写请求的数据少
+    {
+        brpc::Controller cntl;
+        BatchChunkRequest request;
+        BatchChunkResponse response;
+        CountClosure done;
+        AddRequest(&request, CHUNK_OP_TYPE::CHUNK_OP_WRITE, 1, 4096);
+        AddRequest(&request, CHUNK_OP_TYPE::CHUNK_OP_WRITE, 2, 4096);
+        cntl.request_attachment().append(std::string(4096, 'a'));
+        auto context = std::make_shared<BatchRequestContext>(
+            &cntl, &request, &response, &done);
+        ASSERT_EQ(-1, context->Init());
+        context.reset();
+        ASSERT_EQ(1, done.count_);
+    }
+}
+
+}  // namespace chunkserver
+}  // namespace curve
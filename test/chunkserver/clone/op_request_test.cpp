@@ -961,6 +961,52 @@ TEST_F(OpRequestTest, ReadChunkTest) {
         ASSERT_EQ(CHUNK_OP_STATUS::CHUNK_OP_STATUS_FAILURE_UNKNOWN,
                   response->status());
     }
+    /**
+     * 测试OnApply
+     * 用例：本地文件系统支持异步IO，请求的chunk不是 clone chunk
+     * 预期：异步读chunk，读完成后在回调中返回 CHUNK_OP_STATUS_SUCCESS
+     */
+    {
+        // 重置closure
+        closure->Reset();
+
+        // 设置预期
+        info.isClone = false;
+        EXPECT_CALL(*datastore_, GetChunkInfo(_, _))
+            .WillOnce(DoAll(SetArgPointee<1>(info),
+                            Return(CSErrorCode::Success)));
+        EXPECT_CALL(*datastore_, SupportAsyncIO())
+            .WillOnce(Return(true));
+        // 异步读chunk文件，回调先保存下来，模拟IO完成前apply已返回
+        char chunkData[length];  // NOLINT
+        memset(chunkData, 'b', length);
+        CSIOCallback readDone;
+        EXPECT_CALL(*datastore_, ReadChunk(_, _, _, _, _))
+            .Times(0);
+        EXPECT_CALL(*datastore_, ReadChunkAsync(_, _, _, offset, length, _))
+            .WillOnce(Invoke(
+                [&](ChunkID id, SequenceNum sn, char* buf, off_t off,
+                    size_t len, CSIOCallback done) {
+                    memcpy(buf, chunkData, len);
+                    readDone = done;
+                }));
+        EXPECT_CALL(*node_, UpdateAppliedIndex(_))
+            .Times(1);
+
+        opReq->OnApply(3, closure);
+        ASSERT_FALSE(closure->isDone_);
+
+        readDone(CSErrorCode::Success);
+
+        // 验证结果
+        ASSERT_TRUE(closure->isDone_);
+        ASSERT_EQ(LAST_INDEX, response->appliedindex());
+        ASSERT_EQ(CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS,
+                  response->status());
+        ASSERT_EQ(memcmp(chunkData,
+                         cntl->response_attachment().to_string().c_str(),  //NOLINT
+                         length), 0);
+    }
     /**
      * 测试 OnApplyFromLog
      * 预期：啥也没做
@@ -976,6 +1022,98 @@ TEST_F(OpRequestTest, ReadChunkTest) {
     closure->Release();
 }
 
+TEST_F(OpRequestTest, FollowerReadTest) {
+    LogicPoolID logicPoolId = 1;
+    CopysetID copysetId = 10001;
+    uint64_t chunkId = 12345;
+    uint32_t offset = 0;
+    uint32_t length = 5 * PAGE_SIZE;
+    ChunkRequest* request = new ChunkRequest();
+    request->set_logicpoolid(logicPoolId);
+    request->set_copysetid(copysetId);
+    request->set_chunkid(chunkId);
+    request->set_optype(CHUNK_OP_READ);
+    request->set_offset(offset);
+    request->set_size(length);
+    brpc::Controller *cntl = new brpc::Controller();
+    ChunkResponse *response = new ChunkResponse();
+    UnitTestClosure *closure = new UnitTestClosure();
+    closure->SetCntl(cntl);
+    closure->SetRequest(request);
+    closure->SetResponse(response);
+
+    EXPECT_CALL(*node_, IsLeaderTerm())
+        .WillRepeatedly(Return(false));
+    EXPECT_CALL(*node_, Propose(_))
+        .Times(0);
+    /**
+     * 测试Process
+     * 用例： follower还没有apply到请求的applied index
+     * 预期： 会要求转发请求，返回CHUNK_OP_STATUS_REDIRECTED
+     */
+    {
+        request->set_appliedindex(LAST_INDEX + 1);
+        std::shared_ptr<ReadChunkRequest> opReq =
+            std::make_shared<ReadChunkRequest>(node_,
+                                               cloneMgr_.get(),
+                                               cntl,
+                                               request,
+                                               response,
+                                               closure);
+        opReq->Process();
+
+        ASSERT_TRUE(closure->isDone_);
+        ASSERT_EQ(CHUNK_OP_STATUS::CHUNK_OP_STATUS_REDIRECTED,
+                  closure->response_->status());
+    }
+    /**
+     * 测试Process
+     * 用例： follower已经apply到请求的applied index
+     * 预期： 不会转发请求，请求提交给concurrentApplyModule_处理
+     */
+    {
+        closure->Reset();
+        request->set_appliedindex(LAST_INDEX);
+        std::shared_ptr<ReadChunkRequest> opReq =
+            std::make_shared<ReadChunkRequest>(node_,
+                                               cloneMgr_.get(),
+                                               cntl,
+                                               request,
+                                               response,
+                                               closure);
+        opReq->Process();
+
+        ASSERT_FALSE(closure->isDone_);
+        ASSERT_FALSE(closure->response_->has_status());
+
+        /**
+         * 测试OnApply
+         * 用例：follower上读的chunk需要从clone源拷贝数据
+         * 预期：不会转发给clone manager，返回CHUNK_OP_STATUS_REDIRECTED
+         */
+        CSChunkInfo info;
+        info.isClone = true;
+        info.pageSize = PAGE_SIZE;
+        info.chunkSize = CHUNK_SIZE;
+        info.bitmap = std::make_shared<Bitmap>(CHUNK_SIZE / PAGE_SIZE);
+        EXPECT_CALL(*datastore_, GetChunkInfo(_, _))
+            .WillOnce(DoAll(SetArgPointee<1>(info),
+                            Return(CSErrorCode::Success)));
+        EXPECT_CALL(*cloneMgr_, GenerateCloneTask(_, _))
+            .Times(0);
+        EXPECT_CALL(*node_, UpdateAppliedIndex(_))
+            .Times(0);
+
+        opReq->OnApply(LAST_INDEX, closure);
+
+        ASSERT_TRUE(closure->isDone_);
+        ASSERT_EQ(CHUNK_OP_STATUS::CHUNK_OP_STATUS_REDIRECTED,
+                  closure->response_->status());
+    }
+    // 释放资源
+    closure->Release();
+}
+
 TEST_F(OpRequestTest, RecoverChunkTest) {
     // 创建CreateCloneChunkRequest
     LogicPoolID logicPoolId = 1;
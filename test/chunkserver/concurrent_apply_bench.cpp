@@ -0,0 +1,164 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+/**
+ * 并发apply模块队列性能测试
+ * 对比基于锁和条件变量、任务为std::function的旧队列，
+ * 和基于无锁MPSC环形队列、任务为侵入式对象的新队列
+ * 多个生产者线程向同一个队列push任务，单个消费者线程执行任务
+ * 用法: concurrent-apply-bench --producers=4 --queuedepth=64 --ops=1000000
+ */
+
+#include <gflags/gflags.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <functional>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "src/chunkserver/concurrent_apply.h"
+#include "src/common/concurrent/task_queue.h"
+
+DEFINE_uint32(producers, 4, "Number of producer threads");
+DEFINE_uint32(queuedepth, 64, "Depth of the queue");
+DEFINE_uint64(ops, 1000000, "Tasks pushed by each producer");
+
+using curve::chunkserver::ApplyTask;
+using curve::chunkserver::ApplyTaskQueue;
+using curve::common::TaskQueue;
+
+namespace {
+
+// 返回每秒执行的任务数，单位百万
+double ToMops(uint64_t count,
+              std::chrono::steady_clock::time_point begin,
+              std::chrono::steady_clock::time_point end) {
+    double us = std::chrono::duration<double, std::micro>(end - begin).count();
+    return count / us;
+}
+
+double RunLegacy(uint32_t producers) {
+    TaskQueue queue(FLAGS_queuedepth);
+    uint64_t total = producers * FLAGS_ops;
+    uint64_t executed = 0;
+    std::thread consumer([&queue, &executed, total]() {
+        while (executed < total) {
+            queue.Pop()();
+        }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < producers; ++i) {
+        threads.emplace_back([&queue, &executed]() {
+            for (uint64_t j = 0; j < FLAGS_ops; ++j) {
+                // 和旧的Push一样，每个任务经过std::bind包装为std::function
+                queue.Push([&executed](uint64_t index) {
+                    ++executed;
+                }, j);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    consumer.join();
+    auto end = std::chrono::steady_clock::now();
+    return ToMops(total, begin, end);
+}
+
+// 侵入式任务，由生产者预先分配，入队时不需要分配内存
+class BenchTask : public ApplyTask {
+ public:
+    BenchTask() : executed_(nullptr), index_(0) {}
+
+    void Init(uint64_t* executed, uint64_t index) {
+        executed_ = executed;
+        index_ = index;
+    }
+
+    void Run() override {
+        ++(*executed_);
+    }
+
+ private:
+    uint64_t* executed_;
+    // 与旧队列的任务参数对应
+    uint64_t index_;
+};
+
+double RunRing(uint32_t producers) {
+    ApplyTaskQueue queue(FLAGS_queuedepth);
+    uint64_t total = producers * FLAGS_ops;
+    uint64_t executed = 0;
+    std::thread consumer([&queue, &executed, total]() {
+        while (executed < total) {
+            queue.Pop()->Run();
+        }
+    });
+
+    std::vector<std::vector<BenchTask>> tasks(producers);
+    for (auto& vec : tasks) {
+        vec.resize(FLAGS_ops);
+    }
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < producers; ++i) {
+        threads.emplace_back([&queue, &executed, &tasks, i]() {
+            for (uint64_t j = 0; j < FLAGS_ops; ++j) {
+                BenchTask* task = &tasks[i][j];
+                task->Init(&executed, j);
+                queue.Push(task);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    consumer.join();
+    auto end = std::chrono::steady_clock::now();
+    return ToMops(total, begin, end);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    if (FLAGS_producers == 0 || FLAGS_queuedepth == 0 || FLAGS_ops == 0) {
+        fprintf(stderr, "producers, queuedepth and ops must be positive\n");
+        return -1;
+    }
+
+    printf("%-10s %-10s %16s %16s %8s\n", "producers", "queuedepth",
+           "legacy(Mops/s)", "ring(Mops/s)", "speedup");
+    for (uint32_t producers = 1; producers <= FLAGS_producers;
+         producers *= 2) {
+        double legacy = RunLegacy(producers);
+        double ring = RunRing(producers);
+        printf("%-10u %-10u %16.2f %16.2f %8.2f\n", producers,
+               FLAGS_queuedepth, legacy, ring, ring / legacy);
+    }
+    return 0;
+}
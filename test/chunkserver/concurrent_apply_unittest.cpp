@@ -24,11 +24,56 @@
 
 #include <atomic>
 #include <functional>
+#include <future>     // NOLINT
+#include <memory>
+#include <vector>
 
 #include "src/common/timeutility.h"
 #include "src/chunkserver/concurrent_apply.h"
 
 using curve::chunkserver::ConcurrentApplyModule;
+using curve::chunkserver::ApplyTask;
+using curve::chunkserver::ChunkApplySlot;
+using curve::chunkserver::ConcurrentApplyOption;
+using curve::chunkserver::FunctionApplyTask;
+using curve::chunkserver::kMixedApplyGroup;
+
+/**
+ * 模拟写请求，同一个key上地址连续的任务可以合并
+ */
+class FakeMergeableTask : public ApplyTask {
+ public:
+    FakeMergeableTask(uint64_t key, uint64_t offset, uint64_t length,
+                      std::vector<std::vector<uint64_t>>* runs)
+        : key_(key), offset_(offset), length_(length), runs_(runs) {
+        parts_.push_back(offset);
+    }
+
+    bool Merge(ApplyTask* next) override {
+        auto task = dynamic_cast<FakeMergeableTask*>(next);
+        if (task == nullptr || task->key_ != key_
+            || task->offset_ != offset_ + length_) {
+            return false;
+        }
+        length_ += task->length_;
+        parts_.push_back(task->offset_);
+        merged_.emplace_back(task);
+        return true;
+    }
+
+    void Run() override {
+        runs_->push_back(parts_);
+        delete this;
+    }
+
+ private:
+    uint64_t key_;
+    uint64_t offset_;
+    uint64_t length_;
+    std::vector<uint64_t> parts_;
+    std::vector<std::unique_ptr<FakeMergeableTask>> merged_;
+    std::vector<std::vector<uint64_t>>* runs_;
+};
 
 TEST(ConcurrentApplyModule, ConcurrentApplyModuleInitTest) {
     /**
@@ -131,6 +176,441 @@ TEST(ConcurrentApplyModule, ConcurrentApplyModuleFlushConcurrentTest) {
     concurrentapply.Stop();
 }
 
+TEST(ConcurrentApplyModule, ConcurrentApplyModuleBarrierTest) {
+    /**
+     * barrier is done after all tasks pushed before it,
+     * and done is called only once
+     */
+    ConcurrentApplyModule concurrentapply;
+    std::atomic<uint32_t> donenum(0);
+    concurrentapply.PushBarrier([&donenum]() {
+        donenum.fetch_add(1);
+    });
+    ASSERT_EQ(1, donenum);
+
+    ASSERT_TRUE(concurrentapply.Init(4, 10000));
+    std::atomic<uint32_t> testnum(0);
+    auto runtask = [&testnum]() {
+        testnum.fetch_add(1);
+    };
+    for (int i = 0; i < 1000; i++) {
+        concurrentapply.Push(i, runtask);
+    }
+    uint32_t numAtBarrier = 0;
+    concurrentapply.PushBarrier([&donenum, &testnum, &numAtBarrier]() {
+        numAtBarrier = testnum.load();
+        donenum.fetch_add(1);
+    });
+    for (int i = 0; i < 1000; i++) {
+        concurrentapply.Push(i, runtask);
+    }
+
+    concurrentapply.Flush();
+    ASSERT_EQ(2, donenum);
+    ASSERT_GE(numAtBarrier, 1000);
+    ASSERT_EQ(2000, testnum);
+    concurrentapply.Stop();
+}
+
+TEST(ConcurrentApplyModule, ConcurrentApplyModuleMergeTest) {
+    /**
+     * adjacent mergeable tasks in the same queue are merged,
+     * plain tasks and non-contiguous tasks stop the merge
+     */
+    std::vector<std::vector<uint64_t>> runs;
+    auto newTask = [&runs](uint64_t key, uint64_t offset) {
+        return new FakeMergeableTask(key, offset, 4096, &runs);
+    };
+
+    ConcurrentApplyModule concurrentapply;
+    std::unique_ptr<FakeMergeableTask> task(newTask(0, 0));
+    ASSERT_FALSE(concurrentapply.PushTask(0, task.get()));
+    ASSERT_TRUE(concurrentapply.Init(1, 100, 2));
+
+    // 阻塞后台线程，让后续任务都在队列中等待
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool blocked = true;
+    concurrentapply.Push(0, [&mtx, &cv, &blocked]() {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [&blocked]() { return !blocked; });
+    });
+    // 前三个任务合并，第四个超过最大合并数
+    concurrentapply.PushTask(0, newTask(0, 0));
+    concurrentapply.PushTask(0, newTask(0, 4096));
+    concurrentapply.PushTask(0, newTask(0, 8192));
+    concurrentapply.PushTask(0, newTask(0, 12288));
+    // 地址不连续，不合并
+    concurrentapply.PushTask(0, newTask(0, 65536));
+    // 普通任务打断合并
+    concurrentapply.Push(0, []() {});
+    concurrentapply.PushTask(0, newTask(0, 69632));
+    // key不同，不合并
+    concurrentapply.PushTask(0, newTask(1, 73728));
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        blocked = false;
+        cv.notify_all();
+    }
+    concurrentapply.Flush();
+
+    std::vector<std::vector<uint64_t>> expect = {
+        {0, 4096, 8192}, {12288}, {65536}, {69632}, {73728}};
+    ASSERT_EQ(expect, runs);
+    ASSERT_EQ(2, concurrentapply.MergedTaskCount());
+    concurrentapply.Stop();
+
+    // 默认不合并
+    runs.clear();
+    ConcurrentApplyModule nomerge;
+    ASSERT_TRUE(nomerge.Init(1, 100));
+    nomerge.PushTask(0, newTask(0, 0));
+    nomerge.PushTask(0, newTask(0, 4096));
+    nomerge.Flush();
+    ASSERT_EQ(2, runs.size());
+    ASSERT_EQ(0, nomerge.MergedTaskCount());
+    nomerge.Stop();
+}
+
+TEST(ConcurrentApplyModule, ConcurrentApplyModuleStealTest) {
+    /**
+     * 空闲线程偷取繁忙线程上就绪的chunk，同一个chunk上的任务仍然按顺序执行
+     */
+    ConcurrentApplyModule concurrentapply;
+    ASSERT_TRUE(concurrentapply.Init(2, 100));
+    ASSERT_EQ(2, concurrentapply.WorkerCount());
+
+    // chunk 0和chunk 2都哈希到线程0，阻塞chunk 0
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool blocked = true;
+    concurrentapply.Push(0, [&mtx, &cv, &blocked]() {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [&blocked]() { return !blocked; });
+    });
+    std::promise<void> stolen;
+    concurrentapply.Push(2, [&stolen]() {
+        stolen.set_value();
+    });
+    ASSERT_EQ(std::future_status::ready,
+              stolen.get_future().wait_for(std::chrono::seconds(5)));
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        blocked = false;
+        cv.notify_all();
+    }
+    concurrentapply.Flush();
+    ASSERT_LT(0, concurrentapply.GetWorkerMetric(0)->stealCount.get_value()
+               + concurrentapply.GetWorkerMetric(1)->stealCount.get_value());
+
+    // 多个chunk上的任务在线程间迁移时保持各自的顺序
+    const int kChunkNum = 8;
+    const int kTaskNum = 1000;
+    std::vector<std::vector<int>> orders(kChunkNum);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < kChunkNum; c++) {
+        threads.emplace_back([&concurrentapply, &orders, c]() {
+            for (int i = 0; i < kTaskNum; i++) {
+                concurrentapply.Push(c, [&orders, c, i]() {
+                    orders[c].push_back(i);
+                });
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    concurrentapply.Flush();
+    uint64_t taskCount = 0;
+    for (int i = 0; i < concurrentapply.WorkerCount(); i++) {
+        taskCount += concurrentapply.GetWorkerMetric(i)->taskCount.get_value();
+    }
+    ASSERT_LT(kChunkNum * kTaskNum, taskCount);
+    for (int c = 0; c < kChunkNum; c++) {
+        ASSERT_EQ(kTaskNum, orders[c].size());
+        for (int i = 0; i < kTaskNum; i++) {
+            ASSERT_EQ(i, orders[c][i]);
+        }
+    }
+    concurrentapply.Stop();
+}
+
+TEST(ConcurrentApplyModule, ConcurrentApplyModuleGroupFlushTest) {
+    /**
+     * 按组flush只等待同一个组的写任务，不受其他组阻塞的影响
+     */
+    ConcurrentApplyModule concurrentapply;
+    ASSERT_TRUE(concurrentapply.Init(2, 100));
+
+    // 阻塞组1在chunk 0上的写任务
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool blocked = true;
+    concurrentapply.PushTask(0, new FunctionApplyTask(
+        [&mtx, &cv, &blocked]() {
+            std::unique_lock<std::mutex> lk(mtx);
+            cv.wait(lk, [&blocked]() { return !blocked; });
+        }), 1);
+
+    std::atomic<int> done(0);
+    concurrentapply.PushTask(1, new FunctionApplyTask([&done]() {
+        done.fetch_add(1);
+    }), 2);
+    concurrentapply.Flush(2);
+    ASSERT_EQ(1, done.load());
+
+    // 组1的屏障需要等待阻塞的任务执行完
+    std::atomic<bool> barrierDone(false);
+    concurrentapply.PushBarrier(1, [&barrierDone]() {
+        barrierDone.store(true);
+    });
+    concurrentapply.PushBarrier(2, [&done]() {
+        done.fetch_add(1);
+    });
+    concurrentapply.Flush(2);
+    ASSERT_EQ(2, done.load());
+    ASSERT_FALSE(barrierDone.load());
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        blocked = false;
+        cv.notify_all();
+    }
+    concurrentapply.Flush(1);
+    ASSERT_TRUE(barrierDone.load());
+    concurrentapply.Stop();
+}
+
+TEST(ConcurrentApplyModule, ChunkApplySlotMayContainTest) {
+    ChunkApplySlot slot;
+    // 没有未完成的任务时不匹配任何组
+    ASSERT_FALSE(slot.MayContain(1));
+
+    slot.pending.store(1);
+    ASSERT_TRUE(slot.MayContain(1));
+    slot.group.store(2);
+    ASSERT_FALSE(slot.MayContain(1));
+    ASSERT_TRUE(slot.MayContain(2));
+    slot.group.store(kMixedApplyGroup);
+    ASSERT_TRUE(slot.MayContain(1));
+
+    // 写线程重置组期间，组可能已经被其他组的生产者覆盖，按匹配处理
+    slot.group.store(2);
+    slot.resetSeq.fetch_add(1);
+    ASSERT_TRUE(slot.MayContain(1));
+    slot.resetSeq.fetch_add(1);
+    ASSERT_FALSE(slot.MayContain(1));
+}
+
+TEST(ConcurrentApplyModule, ConcurrentApplyModuleGroupFlushSharedSlotTest) {
+    /**
+     * 两个组的任务在同一个槽位上排队，按组flush返回时
+     * 本组之前的任务都已经执行完
+     */
+    ConcurrentApplyModule concurrentapply;
+    ASSERT_TRUE(concurrentapply.Init(2, 100));
+
+    // 其他组的生产者不断在同一个槽位上入队
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> others;
+    for (int t = 0; t < 3; t++) {
+        others.emplace_back([&concurrentapply, &stop, t]() {
+            while (!stop.load()) {
+                concurrentapply.PushTask(0, new FunctionApplyTask([]() {}),
+                                         2 + t);
+            }
+        });
+    }
+
+    std::atomic<int> done(0);
+    for (int i = 1; i <= 5000; i++) {
+        concurrentapply.PushTask(0, new FunctionApplyTask([&done]() {
+            done.fetch_add(1);
+        }), 1);
+        concurrentapply.Flush(1);
+        ASSERT_EQ(i, done.load());
+    }
+    stop.store(true);
+    for (auto& t : others) {
+        t.join();
+    }
+    concurrentapply.Stop();
+}
+
+TEST(ConcurrentApplyModule, ConcurrentApplyModuleReadLaneTest) {
+    /**
+     * 读任务只与同一个chunk上的写任务保序，
+     * 其他chunk上的写任务阻塞时不影响读任务执行
+     */
+    ConcurrentApplyOption option;
+    option.wconcurrentsize = 1;
+    option.wqueuedepth = 100;
+    option.rconcurrentsize = 2;
+    option.rqueuedepth = 10;
+    ConcurrentApplyModule concurrentapply;
+    ASSERT_TRUE(concurrentapply.Init(option));
+
+    // 阻塞chunk 0上的写任务
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool blocked = true;
+    int value = 0;
+    concurrentapply.Push(0, [&mtx, &cv, &blocked, &value]() {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [&blocked]() { return !blocked; });
+        value = 1;
+    });
+
+    // chunk 1上没有未完成的写任务，读任务立即执行
+    std::promise<void> coldRead;
+    concurrentapply.PushRead(1, new FunctionApplyTask([&coldRead]() {
+        coldRead.set_value();
+    }));
+    ASSERT_EQ(std::future_status::ready,
+              coldRead.get_future().wait_for(std::chrono::seconds(5)));
+
+    // chunk 0上的读任务需要等待写任务执行完
+    std::atomic<int> readValue(-1);
+    concurrentapply.PushRead(0, new FunctionApplyTask([&readValue, &value]() {
+        readValue.store(value);
+    }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(-1, readValue.load());
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        blocked = false;
+        cv.notify_all();
+    }
+    concurrentapply.Flush();
+    ASSERT_EQ(1, readValue.load());
+
+    // 写任务都执行完以后，读任务不再等待
+    std::promise<void> read;
+    concurrentapply.PushRead(0, new FunctionApplyTask([&read]() {
+        read.set_value();
+    }));
+    ASSERT_EQ(std::future_status::ready,
+              read.get_future().wait_for(std::chrono::seconds(5)));
+    concurrentapply.Stop();
+}
+
+TEST(ConcurrentApplyModule, ConcurrentApplyModuleReleasedReadTest) {
+    /**
+     * 写任务完成后释放的读任务不会因为读队列满而阻塞写线程
+     */
+    ConcurrentApplyOption option;
+    option.wconcurrentsize = 1;
+    option.wqueuedepth = 100;
+    option.rconcurrentsize = 1;
+    option.rqueuedepth = 1;
+    ConcurrentApplyModule concurrentapply;
+    ASSERT_TRUE(concurrentapply.Init(option));
+
+    // 阻塞唯一的读线程
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool readBlocked = true;
+    bool writeBlocked = true;
+    std::promise<void> readStarted;
+    concurrentapply.PushRead(1, new FunctionApplyTask(
+        [&mtx, &cv, &readBlocked, &readStarted]() {
+            readStarted.set_value();
+            std::unique_lock<std::mutex> lk(mtx);
+            cv.wait(lk, [&readBlocked]() { return !readBlocked; });
+        }));
+    ASSERT_EQ(std::future_status::ready,
+              readStarted.get_future().wait_for(std::chrono::seconds(5)));
+
+    // chunk 0上的读任务等待写任务，数量超过读队列的容量
+    concurrentapply.Push(0, [&mtx, &cv, &writeBlocked]() {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [&writeBlocked]() { return !writeBlocked; });
+    });
+    const int readNum = 8;
+    std::atomic<int> readCount(0);
+    for (int i = 0; i < readNum; ++i) {
+        concurrentapply.PushRead(0, new FunctionApplyTask([&readCount]() {
+            readCount.fetch_add(1);
+        }));
+    }
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        writeBlocked = false;
+        cv.notify_all();
+    }
+
+    // 读线程仍然阻塞，写线程可以继续执行其他写任务
+    std::promise<void> write;
+    concurrentapply.Push(2, [&write]() {
+        write.set_value();
+    });
+    ASSERT_EQ(std::future_status::ready,
+              write.get_future().wait_for(std::chrono::seconds(5)));
+    ASSERT_EQ(0, readCount.load());
+
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        readBlocked = false;
+        cv.notify_all();
+    }
+    concurrentapply.Flush();
+    ASSERT_EQ(readNum, readCount.load());
+    concurrentapply.Stop();
+}
+
+TEST(ConcurrentApplyModule, ConcurrentApplyModuleInplaceReadTest) {
+    /**
+     * chunk上没有未完成的写任务时，读任务直接在调用线程中执行，
+     * 否则仍然等待写任务执行完以后在读队列中执行
+     */
+    ConcurrentApplyOption option;
+    option.wconcurrentsize = 1;
+    option.wqueuedepth = 100;
+    option.rconcurrentsize = 1;
+    option.rqueuedepth = 10;
+    ConcurrentApplyModule concurrentapply;
+    ASSERT_TRUE(concurrentapply.Init(option));
+
+    std::thread::id caller = std::this_thread::get_id();
+    std::thread::id runner;
+    concurrentapply.PushRead(1, new FunctionApplyTask([&runner]() {
+        runner = std::this_thread::get_id();
+    }), true);
+    ASSERT_EQ(caller, runner);
+    ASSERT_EQ(1, concurrentapply.InplaceReadCount());
+
+    // 阻塞chunk 0上的写任务
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool blocked = true;
+    int value = 0;
+    concurrentapply.Push(0, [&mtx, &cv, &blocked, &value]() {
+        std::unique_lock<std::mutex> lk(mtx);
+        cv.wait(lk, [&blocked]() { return !blocked; });
+        value = 1;
+    });
+
+    std::promise<std::thread::id> read;
+    std::atomic<int> readValue(-1);
+    concurrentapply.PushRead(0, new FunctionApplyTask(
+        [&read, &readValue, &value]() {
+            readValue.store(value);
+            read.set_value(std::this_thread::get_id());
+        }), true);
+    ASSERT_EQ(-1, readValue.load());
+    ASSERT_EQ(1, concurrentapply.InplaceReadCount());
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        blocked = false;
+        cv.notify_all();
+    }
+    auto future = read.get_future();
+    ASSERT_EQ(std::future_status::ready,
+              future.wait_for(std::chrono::seconds(5)));
+    ASSERT_NE(caller, future.get());
+    ASSERT_EQ(1, readValue.load());
+    concurrentapply.Stop();
+}
+
 // ci暫時不跑性能测试
 #if 0
 TEST(ConcurrentApplyModule, MultiCopysetPerformanceTest) {
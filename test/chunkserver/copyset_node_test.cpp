@@ -35,6 +35,7 @@
 #include "test/fs/mock_local_filesystem.h"
 #include "src/chunkserver/copyset_node_manager.h"
 #include "src/chunkserver/copyset_node.h"
+#include "src/chunkserver/op_request.h"
 #include "test/chunkserver/fake_datastore.h"
 #include "test/chunkserver/mock_node.h"
 #include "src/chunkserver/conf_epoch_file.h"
@@ -251,6 +252,39 @@ TEST_F(CopysetNodeTest, error_test) {
 
         copysetNode.on_snapshot_save(&writer, &closure);
     }
+    // on_snapshot_save: sync chunk files failed
+    {
+        LogicPoolID logicPoolID = 123;
+        CopysetID copysetID = 1345;
+        Configuration conf;
+
+        CopysetNode copysetNode(logicPoolID, copysetID, conf);
+        ASSERT_EQ(0, copysetNode.Init(defaultOptions_));
+        FakeClosure closure;
+        FakeSnapshotWriter writer;
+        std::shared_ptr<MockLocalFileSystem>
+            mockfs = std::make_shared<MockLocalFileSystem>();
+        std::unique_ptr<ConfEpochFile>
+            epochFile(new ConfEpochFile(mockfs));
+        copysetNode.SetLocalFileSystem(mockfs);
+        copysetNode.SetConfEpochFile(std::move(epochFile));
+        DataStoreOptions options;
+        options.baseDir = "./test-temp";
+        options.chunkSize = 16 * 1024 * 1024;
+        options.pageSize = 4 * 1024;
+        std::shared_ptr<FakeCSDataStore> dataStore =
+            std::make_shared<FakeCSDataStore>(options, fs);
+        copysetNode.SetCSDateStore(dataStore);
+        dataStore->InjectError();
+
+        // 刷盘失败时不能保存快照，否则braft会截断还未落盘的日志
+        EXPECT_CALL(*mockfs, Open(_, _)).Times(0);
+        EXPECT_CALL(*mockfs, List(_, _)).Times(0);
+
+        copysetNode.on_snapshot_save(&writer, &closure);
+        ASSERT_FALSE(closure.status().ok());
+        ASSERT_EQ(EIO, closure.status().error_code());
+    }
 
     // on_snapshot_load: Dir not exist, File not exist, data init success
     {
@@ -1009,5 +1043,73 @@ TEST_F(CopysetNodeTest, get_leader_status) {
     }
 }
 
+TEST_F(CopysetNodeTest, follower_read_after_apply_from_log) {
+    LogicPoolID logicPoolID = 123;
+    CopysetID copysetID = 1345;
+    ChunkID chunkID = 1;
+    uint64_t index = 5;
+    Configuration conf;
+    std::shared_ptr<CopysetNode> copysetNode =
+        std::make_shared<CopysetNode>(logicPoolID, copysetID, conf);
+    ASSERT_EQ(0, copysetNode->Init(defaultOptions_));
+    std::shared_ptr<LocalFileSystem>
+        fs(LocalFsFactory::CreateFs(FileSystemType::EXT4, ""));
+    DataStoreOptions options;
+    options.baseDir = "./test-temp";
+    options.chunkSize = 16 * 1024 * 1024;
+    options.pageSize = 4 * 1024;
+    std::shared_ptr<FakeCSDataStore> dataStore =
+        std::make_shared<FakeCSDataStore>(options, fs);
+    copysetNode->SetCSDateStore(dataStore);
+
+    // follower还没有apply到index
+    ASSERT_FALSE(copysetNode->IsLeaderTerm());
+    ASSERT_FALSE(copysetNode->BeginFollowerRead(index));
+
+    // follower从日志apply写请求，apply完成后更新applied index
+    ChunkRequest writeRequest;
+    writeRequest.set_optype(CHUNK_OP_TYPE::CHUNK_OP_WRITE);
+    writeRequest.set_logicpoolid(logicPoolID);
+    writeRequest.set_copysetid(copysetID);
+    writeRequest.set_chunkid(chunkID);
+    writeRequest.set_sn(1);
+    writeRequest.set_offset(0);
+    writeRequest.set_size(8);
+    butil::IOBuf data;
+    data.append(std::string(8, 'a'));
+    butil::IOBuf log;
+    ASSERT_EQ(0, ChunkOpRequest::Encode(&writeRequest, &data, &log));
+    copysetNode->ApplyFromLog(log, index);
+    concurrentModule_.Flush(copysetNode->GroupNidValue());
+    ASSERT_EQ(index, copysetNode->GetAppliedIndex());
+
+    // 携带该applied index的读请求在follower上处理
+    ChunkRequest readRequest;
+    readRequest.set_optype(CHUNK_OP_TYPE::CHUNK_OP_READ);
+    readRequest.set_logicpoolid(logicPoolID);
+    readRequest.set_copysetid(copysetID);
+    readRequest.set_chunkid(chunkID);
+    readRequest.set_offset(0);
+    readRequest.set_size(8);
+    readRequest.set_appliedindex(index);
+    brpc::Controller cntl;
+    ChunkResponse response;
+    FakeClosure closure;
+    {
+        std::shared_ptr<ReadChunkRequest> opReq =
+            std::make_shared<ReadChunkRequest>(copysetNode,
+                                               nullptr,
+                                               &cntl,
+                                               &readRequest,
+                                               &response,
+                                               &closure);
+        opReq->Process();
+        concurrentModule_.Flush(copysetNode->GroupNidValue());
+    }
+    ASSERT_EQ(CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS, response.status());
+    ASSERT_EQ(index, response.appliedindex());
+    ASSERT_EQ(std::string(8, 'a'), cntl.response_attachment().to_string());
+}
+
 }  // namespace chunkserver
 }  // namespace curve
@@ -0,0 +1,211 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/chunkserver/datastore/chunk_manifest.h"
+#include "src/fs/local_filesystem.h"
+
+using curve::fs::LocalFsFactory;
+using curve::fs::FileSystemType;
+
+namespace curve {
+namespace chunkserver {
+
+const char kManifestTestDir[] = "./manifesttest";
+const char kManifestTestData[] = "./manifesttest/data";
+const char kManifestTestPath[] = "./manifesttest/chunk_manifest";
+
+class ChunkManifestTest : public testing::Test {
+ public:
+    void SetUp() {
+        lfs_ = LocalFsFactory::CreateFs(FileSystemType::EXT4, "");
+        lfs_->Mkdir(kManifestTestDir);
+        lfs_->Mkdir(kManifestTestData);
+        ASSERT_EQ(0, ChunkManifest::GetDirStamp(lfs_, kManifestTestData,
+                                                &stamp_));
+    }
+
+    void TearDown() {
+        lfs_->Delete(kManifestTestPath);
+        lfs_->Delete(kManifestTestData);
+        lfs_->Delete(kManifestTestDir);
+    }
+
+    ChunkManifestEntry MakeEntry(ChunkID id,
+                                 SequenceNum sn,
+                                 const std::string& location = "") {
+        ChunkManifestEntry entry;
+        entry.id = id;
+        entry.sn = sn;
+        entry.correctedSn = sn + 1;
+        entry.isClone = !location.empty();
+        entry.metaValid = true;
+        entry.location = location;
+        return entry;
+    }
+
+    int LoadManifest(std::vector<ChunkManifestEntry>* entries) {
+        ChunkManifest manifest(lfs_, kManifestTestPath);
+        int ret = manifest.Load(stamp_, entries);
+        std::sort(entries->begin(), entries->end(),
+                  [](const ChunkManifestEntry& a,
+                     const ChunkManifestEntry& b) {
+                      return a.id < b.id;
+                  });
+        return ret;
+    }
+
+ protected:
+    std::shared_ptr<LocalFileSystem> lfs_;
+    DirStamp stamp_;
+};
+
+TEST_F(ChunkManifestTest, SealAndLoadTest) {
+    std::vector<ChunkManifestEntry> entries;
+    // manifest不存在
+    ASSERT_EQ(-1, LoadManifest(&entries));
+
+    ChunkManifest manifest(lfs_, kManifestTestPath);
+    ASSERT_EQ(0, manifest.Reset());
+    manifest.Put(MakeEntry(1, 1));
+    manifest.Put(MakeEntry(2, 1, "/file1/0@curve"));
+    manifest.Put(MakeEntry(3, 1));
+    ChunkManifestEntry entry = MakeEntry(3, 2);
+    entry.snapSn = 1;
+    entry.hasBitmap = true;
+    manifest.Put(entry);
+    manifest.Remove(1);
+    manifest.Remove(100);
+    ASSERT_EQ(2, manifest.Size());
+
+    // 未封存的manifest不能使用
+    ASSERT_EQ(-1, LoadManifest(&entries));
+    ASSERT_EQ(0, manifest.Seal(stamp_));
+    ASSERT_EQ(0, LoadManifest(&entries));
+    ASSERT_EQ(2, entries.size());
+    ASSERT_EQ(MakeEntry(2, 1, "/file1/0@curve"), entries[0]);
+    ASSERT_EQ(entry, entries[1]);
+
+    // 加载后立即解封，不能再次加载
+    ASSERT_EQ(-1, LoadManifest(&entries));
+
+    // 重新加载并封存后可以继续使用
+    ChunkManifest manifest2(lfs_, kManifestTestPath);
+    ASSERT_EQ(-1, manifest2.Load(stamp_, &entries));
+    ASSERT_EQ(0, manifest.Seal(stamp_));
+    ASSERT_EQ(0, manifest2.Load(stamp_, &entries));
+    ASSERT_EQ(2, manifest2.Size());
+    manifest2.Remove(2);
+    ASSERT_EQ(0, manifest2.Seal(stamp_));
+    ASSERT_EQ(0, LoadManifest(&entries));
+    ASSERT_EQ(1, entries.size());
+    ASSERT_EQ(entry, entries[0]);
+}
+
+TEST_F(ChunkManifestTest, StaleTest) {
+    ChunkManifest manifest(lfs_, kManifestTestPath);
+    ASSERT_EQ(0, manifest.Reset());
+    manifest.Put(MakeEntry(1, 1));
+    ASSERT_EQ(0, manifest.Seal(stamp_));
+
+    // 数据目录下创建了文件，manifest过期
+    std::string path = std::string(kManifestTestData) + "/chunk_1";
+    int fd = lfs_->Open(path, O_RDWR|O_CREAT);
+    ASSERT_GE(fd, 0);
+    lfs_->Close(fd);
+    DirStamp stamp;
+    ASSERT_EQ(0, ChunkManifest::GetDirStamp(lfs_, kManifestTestData, &stamp));
+    lfs_->Delete(path);
+    ASSERT_FALSE(stamp == stamp_);
+    std::vector<ChunkManifestEntry> entries;
+    ChunkManifest reader(lfs_, kManifestTestPath);
+    ASSERT_EQ(-1, reader.Load(stamp, &entries));
+}
+
+TEST_F(ChunkManifestTest, CorruptTest) {
+    ChunkManifest manifest(lfs_, kManifestTestPath);
+    ASSERT_EQ(0, manifest.Reset());
+    manifest.Put(MakeEntry(1, 1));
+    manifest.Put(MakeEntry(2, 1));
+    ASSERT_EQ(0, manifest.Seal(stamp_));
+    std::vector<ChunkManifestEntry> entries;
+
+    int fd = lfs_->Open(kManifestTestPath, O_RDWR);
+    ASSERT_GE(fd, 0);
+    char c;
+    ASSERT_EQ(1, lfs_->Read(fd, &c, 20, 1));
+    // 修改记录中的一个字节，crc校验失败
+    char bad = c + 1;
+    ASSERT_EQ(1, lfs_->Write(fd, &bad, 20, 1));
+    ASSERT_EQ(-1, LoadManifest(&entries));
+    // 恢复后仍然是有效的
+    ASSERT_EQ(1, lfs_->Write(fd, &c, 20, 1));
+    lfs_->Close(fd);
+    ASSERT_EQ(0, LoadManifest(&entries));
+    ASSERT_EQ(2, entries.size());
+
+    // 末尾的记录不完整
+    ASSERT_EQ(0, manifest.Seal(stamp_));
+    fd = lfs_->Open(kManifestTestPath, O_RDWR);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(2, lfs_->Write(fd, "\x03\x00", 10000, 2));
+    lfs_->Close(fd);
+    ASSERT_EQ(-1, LoadManifest(&entries));
+}
+
+TEST_F(ChunkManifestTest, CompactTest) {
+    ChunkManifest manifest(lfs_, kManifestTestPath);
+    ASSERT_EQ(0, manifest.Reset());
+    // 反复修改同一批chunk，记录数远多于chunk数
+    for (SequenceNum sn = 1; sn <= 100; ++sn) {
+        for (ChunkID id = 1; id <= 20; ++id) {
+            manifest.Put(MakeEntry(id, sn));
+        }
+    }
+    ASSERT_EQ(0, manifest.Seal(stamp_));
+
+    // 重写后只保留有效的记录
+    int fd = lfs_->Open(kManifestTestPath, O_RDONLY);
+    ASSERT_GE(fd, 0);
+    struct stat info;
+    ASSERT_EQ(0, lfs_->Fstat(fd, &info));
+    lfs_->Close(fd);
+    ASSERT_LT(info.st_size, 100 * 20);
+    ASSERT_FALSE(lfs_->FileExists(std::string(kManifestTestPath) + ".tmp"));
+
+    std::vector<ChunkManifestEntry> entries;
+    ASSERT_EQ(0, LoadManifest(&entries));
+    ASSERT_EQ(20, entries.size());
+    for (ChunkID id = 1; id <= 20; ++id) {
+        ASSERT_EQ(MakeEntry(id, 100), entries[id - 1]);
+    }
+}
+
+}  // namespace chunkserver
+}  // namespace curve
@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-12-10
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+#include <butil/iobuf.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "src/chunkserver/datastore/chunk_read_cache.h"
+
+namespace curve {
+namespace chunkserver {
+
+const PageSizeType kPageSize = 4096;
+
+TEST(ChunkReadCacheTest, GetAndPutTest) {
+    ChunkReadCache cache(ChunkReadCache::kShardNum * 4 * kPageSize, kPageSize);
+    ASSERT_EQ(kPageSize, cache.PageSize());
+    char data[2 * kPageSize];
+    memset(data, 'a', kPageSize);
+    memset(data + kPageSize, 'b', kPageSize);
+
+    // 只放入未命中的page
+    std::vector<bool> hits = {false, true};
+    cache.Put(1, 2, 10, 2, data, &hits);
+    ASSERT_EQ(1, cache.Size());
+
+    char buf[3 * kPageSize];
+    memset(buf, 0, sizeof(buf));
+    ASSERT_EQ(1, cache.Get(1, 2, 9, 3, buf, &hits));
+    ASSERT_EQ(std::vector<bool>({false, true, false}), hits);
+    ASSERT_EQ(0, memcmp(buf + kPageSize, data, kPageSize));
+
+    // 版本号不同的page不会命中
+    ASSERT_EQ(0, cache.Get(1, 3, 10, 1, buf, &hits));
+    ASSERT_EQ(0, cache.Get(2, 2, 10, 1, buf, &hits));
+
+    cache.Put(1, 2, 10, 2, data);
+    ASSERT_EQ(2, cache.Size());
+    ASSERT_EQ(2, cache.Get(1, 2, 10, 2, buf, &hits));
+    ASSERT_EQ(0, memcmp(buf, data, 2 * kPageSize));
+}
+
+TEST(ChunkReadCacheTest, UpdateTest) {
+    ChunkReadCache cache(ChunkReadCache::kShardNum * 4 * kPageSize, kPageSize);
+    char data[2 * kPageSize];
+    memset(data, 'a', sizeof(data));
+    cache.Put(1, 2, 0, 1, data);
+
+    // 只更新已缓存的page
+    memset(data, 'b', sizeof(data));
+    cache.Update(1, 2, 0, 2, data);
+    ASSERT_EQ(1, cache.Size());
+    char buf[kPageSize];
+    std::vector<bool> hits;
+    ASSERT_EQ(1, cache.Get(1, 2, 0, 1, buf, &hits));
+    ASSERT_EQ(0, memcmp(buf, data, kPageSize));
+
+    // 用IOBuf更新
+    butil::IOBuf iobuf;
+    iobuf.append(std::string(kPageSize, 'c'));
+    cache.Update(1, 2, 0, 1, iobuf);
+    ASSERT_EQ(1, cache.Get(1, 2, 0, 1, buf, &hits));
+    ASSERT_EQ(iobuf.to_string(), std::string(buf, kPageSize));
+
+    // 其他版本的page不会被更新
+    memset(data, 'd', sizeof(data));
+    cache.Update(1, 3, 0, 1, data);
+    ASSERT_EQ(1, cache.Get(1, 2, 0, 1, buf, &hits));
+    ASSERT_EQ(iobuf.to_string(), std::string(buf, kPageSize));
+}
+
+TEST(ChunkReadCacheTest, InvalidateTest) {
+    ChunkReadCache cache(ChunkReadCache::kShardNum * 4 * kPageSize, kPageSize);
+    char data[kPageSize];
+    memset(data, 'a', kPageSize);
+    // chunk 1和chunk 1 + kShardNum在同一个分片
+    ChunkID other = 1 + ChunkReadCache::kShardNum;
+    cache.Put(1, 1, 0, 1, data);
+    cache.Put(1, 2, 0, 1, data);
+    cache.Put(other, 1, 0, 1, data);
+    ASSERT_EQ(3, cache.Size());
+
+    // 清除chunk所有版本的page，不影响同一分片的其他chunk
+    cache.Invalidate(1);
+    ASSERT_EQ(1, cache.Size());
+    std::vector<bool> hits;
+    ASSERT_EQ(0, cache.Get(1, 2, 0, 1, data, &hits));
+    ASSERT_EQ(1, cache.Get(other, 1, 0, 1, data, &hits));
+}
+
+TEST(ChunkReadCacheTest, EvictTest) {
+    // 每个分片最多缓存2个page
+    ChunkReadCache cache(ChunkReadCache::kShardNum * 2 * kPageSize, kPageSize);
+    char data[3 * kPageSize];
+    memset(data, 'a', sizeof(data));
+    cache.Put(1, 1, 0, 2, data);
+    ASSERT_EQ(2, cache.Size());
+
+    // 访问page 0后放入page 2，淘汰最久未访问的page 1
+    char buf[kPageSize];
+    std::vector<bool> hits;
+    ASSERT_EQ(1, cache.Get(1, 1, 0, 1, buf, &hits));
+    cache.Put(1, 1, 2, 1, data);
+    ASSERT_EQ(2, cache.Size());
+    ASSERT_EQ(1, cache.Get(1, 1, 0, 1, buf, &hits));
+    ASSERT_EQ(0, cache.Get(1, 1, 1, 1, buf, &hits));
+    ASSERT_EQ(1, cache.Get(1, 1, 2, 1, buf, &hits));
+
+    // 不同分片的容量相互独立
+    cache.Put(2, 1, 0, 2, data);
+    ASSERT_EQ(4, cache.Size());
+}
+
+}  // namespace chunkserver
+}  // namespace curve
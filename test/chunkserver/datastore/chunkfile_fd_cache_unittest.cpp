@@ -0,0 +1,133 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+
+#include "src/chunkserver/datastore/chunkfile_fd_cache.h"
+
+namespace curve {
+namespace chunkserver {
+
+class FakeEntry : public FdCacheEntry {
+ public:
+    FakeEntry() : opened(true), busy(false) {}
+
+    bool TryCloseFd() override {
+        if (busy) {
+            return false;
+        }
+        opened = false;
+        return true;
+    }
+
+    bool opened;
+    bool busy;
+};
+
+TEST(ChunkFdCacheTest, InsertAndRemoveTest) {
+    ChunkFdCache cache(2);
+    ASSERT_EQ(2, cache.Capacity());
+    FakeEntry e1, e2;
+    cache.Insert(&e1);
+    cache.Insert(&e2);
+    // 重复插入不会增加数量
+    cache.Insert(&e1);
+    ASSERT_EQ(2, cache.Size());
+    ASSERT_EQ(0, cache.EvictCount());
+    ASSERT_TRUE(e1.opened);
+    ASSERT_TRUE(e2.opened);
+
+    // Remove不会关闭fd，重复Remove没有影响
+    cache.Remove(&e1);
+    cache.Remove(&e1);
+    ASSERT_EQ(1, cache.Size());
+    ASSERT_TRUE(e1.opened);
+    cache.Remove(&e2);
+    ASSERT_EQ(0, cache.Size());
+}
+
+TEST(ChunkFdCacheTest, EvictTest) {
+    ChunkFdCache cache(3);
+    FakeEntry e1, e2, e3, e4, e5;
+    cache.Insert(&e1);
+    cache.Insert(&e2);
+    cache.Insert(&e3);
+
+    // 超过容量时淘汰最早加入的文件
+    cache.Insert(&e4);
+    ASSERT_EQ(3, cache.Size());
+    ASSERT_EQ(1, cache.EvictCount());
+    ASSERT_FALSE(e1.opened);
+    ASSERT_TRUE(e2.opened);
+    ASSERT_TRUE(e3.opened);
+    ASSERT_TRUE(e4.opened);
+
+    // 最近被访问过的文件跳过一轮
+    e2.MarkReferenced();
+    cache.Insert(&e5);
+    ASSERT_EQ(3, cache.Size());
+    ASSERT_EQ(2, cache.EvictCount());
+    ASSERT_TRUE(e2.opened);
+    ASSERT_FALSE(e3.opened);
+    ASSERT_TRUE(e4.opened);
+    ASSERT_TRUE(e5.opened);
+
+    // 被淘汰的文件可以重新加入
+    e1.opened = true;
+    cache.Insert(&e1);
+    ASSERT_EQ(3, cache.Size());
+    ASSERT_EQ(3, cache.EvictCount());
+    ASSERT_TRUE(e1.opened);
+
+    cache.Remove(&e1);
+    cache.Remove(&e2);
+    cache.Remove(&e4);
+    cache.Remove(&e5);
+    ASSERT_EQ(0, cache.Size());
+}
+
+TEST(ChunkFdCacheTest, BusyEntryTest) {
+    ChunkFdCache cache(1);
+    FakeEntry e1, e2, e3;
+    cache.Insert(&e1);
+
+    // 正在被使用的文件不会被淘汰，允许暂时超过容量
+    e1.busy = true;
+    cache.Insert(&e2);
+    ASSERT_EQ(2, cache.Size());
+    ASSERT_EQ(0, cache.EvictCount());
+    ASSERT_TRUE(e1.opened);
+    ASSERT_TRUE(e2.opened);
+
+    // 文件空闲后，下次插入时淘汰
+    e1.busy = false;
+    cache.Insert(&e3);
+    ASSERT_EQ(1, cache.Size());
+    ASSERT_EQ(2, cache.EvictCount());
+    ASSERT_FALSE(e1.opened);
+    ASSERT_FALSE(e2.opened);
+    ASSERT_TRUE(e3.opened);
+    cache.Remove(&e3);
+}
+
+}  // namespace chunkserver
+}  // namespace curve
@@ -980,5 +980,62 @@ TEST_F(CSChunkfilePoolMockTest, RecycleChunkTest) {
     }
 }
 
+TEST_F(CSChunkfilePoolMockTest, SyncDirsTest) {
+    // 初始化options
+    ChunkfilePoolOptions options;
+    options.getChunkFromPool = false;
+    memcpy(options.chunkFilePoolDir, poolDir.c_str(), poolDir.size());
+    options.chunkSize = CHUNK_SIZE;
+    options.metaPageSize = PAGE_SIZE;
+    memcpy(options.metaPath, poolMetaPath.c_str(), poolMetaPath.size());
+    options.cpMetaFileSize = metaFileSize;
+    options.retryTimes = 3;
+    const std::string dataDir = "./data";
+
+    ChunkfilePool pool(lfs_);
+    FakePool(&pool, options, 0);
+    // 没有修改过的目录，不需要fsync
+    EXPECT_CALL(*lfs_, Open(_, _))
+        .Times(0);
+    ASSERT_EQ(0, pool.SyncDirs());
+    Mock::VerifyAndClearExpectations(lfs_.get());
+
+    // 删除chunk后需要fsync chunk所在的目录，失败的目录下次重试
+    EXPECT_CALL(*lfs_, Delete(_))
+        .WillRepeatedly(Return(0));
+    ASSERT_EQ(0, pool.RecycleChunk(targetPath));
+    ASSERT_EQ(0, pool.RecycleChunk(filePath1));
+    EXPECT_CALL(*lfs_, DirExists(_))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(*lfs_, Open(poolDir, O_RDONLY | O_DIRECTORY))
+        .WillOnce(Return(10));
+    EXPECT_CALL(*lfs_, Fsync(10))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*lfs_, Close(10))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Open(dataDir, O_RDONLY | O_DIRECTORY))
+        .Times(2)
+        .WillRepeatedly(Return(11));
+    EXPECT_CALL(*lfs_, Fsync(11))
+        .WillOnce(Return(-1))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*lfs_, Close(11))
+        .Times(2);
+    ASSERT_EQ(-1, pool.SyncDirs());
+    ASSERT_EQ(0, pool.SyncDirs());
+    ASSERT_EQ(0, pool.SyncDirs());
+    Mock::VerifyAndClearExpectations(lfs_.get());
+
+    // 目录已经被删除，不需要fsync
+    EXPECT_CALL(*lfs_, Delete(targetPath))
+        .WillOnce(Return(0));
+    ASSERT_EQ(0, pool.RecycleChunk(targetPath));
+    EXPECT_CALL(*lfs_, DirExists(dataDir))
+        .WillOnce(Return(false));
+    EXPECT_CALL(*lfs_, Open(_, _))
+        .Times(0);
+    ASSERT_EQ(0, pool.SyncDirs());
+}
+
 }  // namespace chunkserver
 }  // namespace curve
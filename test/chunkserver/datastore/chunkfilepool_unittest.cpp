@@ -27,6 +27,8 @@
 #include <fcntl.h>
 #include <climits>
 #include <memory>
+#include <thread>  // NOLINT
+#include <chrono>  // NOLINT
 
 #include "src/common/crc32.h"
 #include "src/common/curve_define.h"
@@ -133,6 +135,17 @@ class CSChunkfilePool_test : public testing::Test {
     std::shared_ptr<LocalFileSystem>  fsptr;
 };
 
+// 等待后台补充线程把池中chunk数补充到expect，超时返回false
+static bool WaitPoolSize(std::shared_ptr<ChunkfilePool> pool, size_t expect) {
+    for (int i = 0; i < 500; ++i) {
+        if (pool->Size() == expect) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
 bool CheckFileOpenOrNot(const std::string& filename) {
     std::string syscmd;
     syscmd.append("lsof ").append(filename);
@@ -261,6 +274,132 @@ TEST_F(CSChunkfilePool_test, RecycleChunkTest) {
     ASSERT_EQ(0, fsptr->Delete("./cspooltest/chunkfilepool/4"));
 }
 
+TEST_F(CSChunkfilePool_test, RefillTest) {
+    std::string chunkfilepool = "./cspooltest/chunkfilepool.meta";
+    ChunkfilePoolOptions cfop;
+    cfop.chunkSize = 4096;
+    cfop.metaPageSize = 4096;
+    cfop.enableRefill = true;
+    cfop.refillLowWatermark = 50;
+    cfop.refillHighWatermark = 52;
+    memcpy(cfop.metaPath, chunkfilepool.c_str(), chunkfilepool.size());
+
+    // 高水位小于低水位，初始化失败
+    {
+        ChunkfilePoolOptions invalid = cfop;
+        invalid.refillHighWatermark = 10;
+        auto pool = std::make_shared<ChunkfilePool>(fsptr);
+        ASSERT_FALSE(pool->Initialize(invalid));
+    }
+
+    int reclaimCount = 0;
+    ChunkfilepoolPtr_->SetTrashReclaimer([&reclaimCount]() {
+        ++reclaimCount;
+    });
+    ASSERT_TRUE(ChunkfilepoolPtr_->Initialize(cfop));
+    // 池中chunk数不低于低水位，不会补充
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(50, ChunkfilepoolPtr_->Size());
+    ASSERT_EQ(0, reclaimCount);
+
+    // 取走一个chunk后低于低水位，先回收trash，然后补充到高水位
+    char metapage[4096];
+    memset(metapage, '1', 4096);
+    ASSERT_EQ(0, ChunkfilepoolPtr_->GetChunk("./new1", metapage));
+    ASSERT_TRUE(WaitPoolSize(ChunkfilepoolPtr_, 52));
+    ASSERT_EQ(1, reclaimCount);
+    ASSERT_EQ(52, ChunkfilepoolPtr_->GetState().preallocatedChunksLeft);
+    ASSERT_EQ(3, ChunkfilepoolPtr_->GetMetric()->refillChunkCount.get_value());
+    ASSERT_EQ(0,
+        ChunkfilepoolPtr_->GetMetric()->syncAllocChunkCount.get_value());
+
+    // 补充的chunk大小正确，内容全部为0
+    std::vector<std::string> files;
+    ASSERT_EQ(0, fsptr->List("./cspooltest/chunkfilepool", &files));
+    ASSERT_EQ(52, files.size());
+    std::string path = "./cspooltest/chunkfilepool/52";
+    int fd = fsptr->Open(path.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    struct stat info;
+    ASSERT_EQ(0, fsptr->Fstat(fd, &info));
+    ASSERT_EQ(8192, info.st_size);
+    char data[8192];
+    ASSERT_EQ(8192, fsptr->Read(fd, data, 0, 8192));
+    for (int i = 0; i < 8192; i++) {
+        ASSERT_EQ(0, data[i]);
+    }
+    ASSERT_EQ(0, fsptr->Close(fd));
+
+    ChunkfilepoolPtr_->UnInitialize();
+    ASSERT_EQ(0, fsptr->Delete("./new1"));
+}
+
+TEST(CSChunkfilePool, RefillWithoutPoolTest) {
+    std::shared_ptr<LocalFileSystem>  fsptr;
+    fsptr = LocalFsFactory::CreateFs(FileSystemType::EXT4, "");
+
+    // 不从池中取chunk时，补充目录中遗留的文件在初始化时被删除，
+    // 池目录中的其他文件不受影响
+    std::string  filename = "./cspooltest/chunkfilepool/refillpool/1000";
+    std::string  otherfile = "./cspooltest/chunkfilepool/chunkserver.dat";
+    fsptr->Mkdir("./cspooltest/chunkfilepool/refillpool");
+    int fd = fsptr->Open(filename.c_str(), O_RDWR | O_CREAT);
+    ASSERT_GE(fd, 0);
+    fsptr->Close(fd);
+    fd = fsptr->Open(otherfile.c_str(), O_RDWR | O_CREAT);
+    ASSERT_GE(fd, 0);
+    fsptr->Close(fd);
+
+    ChunkfilePoolOptions cspopt;
+    cspopt.getChunkFromPool = false;
+    cspopt.chunkSize = 16 * 1024;
+    cspopt.metaPageSize = 4 * 1024;
+    cspopt.enableRefill = true;
+    cspopt.refillLowWatermark = 1;
+    cspopt.refillHighWatermark = 2;
+    strcpy(cspopt.chunkFilePoolDir, "./cspooltest/chunkfilepool");                             // NOLINT
+
+    auto pool = std::make_shared<ChunkfilePool>(fsptr);
+    ASSERT_TRUE(pool->Initialize(cspopt));
+    ASSERT_FALSE(fsptr->FileExists(filename));
+    ASSERT_TRUE(fsptr->FileExists(otherfile));
+    ASSERT_TRUE(WaitPoolSize(pool, 2));
+
+    // 从池中取已格式化的chunk，不需要同步分配
+    char metapage[4096];
+    memset(metapage, '1', 4096);
+    ASSERT_EQ(0, pool->GetChunk("./new1", metapage));
+    ASSERT_EQ(0, pool->GetChunk("./new2", metapage));
+    ASSERT_TRUE(fsptr->FileExists("./new1"));
+    ASSERT_TRUE(fsptr->FileExists("./new2"));
+    ASSERT_EQ(0, pool->GetMetric()->syncAllocChunkCount.get_value());
+    ASSERT_TRUE(WaitPoolSize(pool, 2));
+    pool->UnInitialize();
+
+    // 回收的chunk直接删除
+    ASSERT_EQ(0, pool->RecycleChunk("./new1"));
+    ASSERT_EQ(0, pool->RecycleChunk("./new2"));
+    ASSERT_FALSE(fsptr->FileExists("./new1"));
+    ASSERT_FALSE(fsptr->FileExists("./new2"));
+
+    // 补充目录中有非chunk文件时拒绝启动，且不删除任何文件
+    std::string  foreign = "./cspooltest/chunkfilepool/refillpool/copysets";
+    std::vector<std::string> files;
+    ASSERT_EQ(0, fsptr->List("./cspooltest/chunkfilepool/refillpool",
+                             &files));
+    ASSERT_FALSE(files.empty());
+    ASSERT_EQ(0, fsptr->Mkdir(foreign));
+    auto pool2 = std::make_shared<ChunkfilePool>(fsptr);
+    ASSERT_FALSE(pool2->Initialize(cspopt));
+    ASSERT_TRUE(fsptr->DirExists(foreign));
+    std::vector<std::string> remain;
+    ASSERT_EQ(0, fsptr->List("./cspooltest/chunkfilepool/refillpool",
+                             &remain));
+    ASSERT_EQ(files.size() + 1, remain.size());
+
+    ASSERT_EQ(0, fsptr->Delete("./cspooltest"));
+}
+
 TEST(CSChunkfilePool, GetChunkDirectlyTest) {
     std::shared_ptr<ChunkfilePool>  ChunkfilepoolPtr_;
     std::shared_ptr<LocalFileSystem>  fsptr;
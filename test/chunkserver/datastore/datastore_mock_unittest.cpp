@@ -51,6 +51,8 @@ using ::testing::ReturnArg;
 using ::testing::ElementsAre;
 using ::testing::SetArgPointee;
 using ::testing::SetArrayArgument;
+using ::testing::Invoke;
+using ::testing::AnyNumber;
 
 using std::shared_ptr;
 using std::make_shared;
@@ -81,6 +83,7 @@ const char temp1[] = "chunk_1_tmp";
 const char temp1Path[]
     = "/home/chunkserver/copyset/data/chunk_1_tmp";
 const char location[] = "/file1/0@curve";
+const char manifestPath[] = "/home/chunkserver/copyset/chunk_manifest";
 const int UT_ERRNO = 1234;
 
 bool hasCreatFlag(int flag) {return flag & O_CREAT;}
@@ -480,7 +483,7 @@ TEST_F(CSDataStore_test, InitializeErrorTest3) {
         .WillOnce(DoAll(SetArgPointee<1>(fileInfo),
                         Return(0)));
     // read metapage success, but version incompatible
-    uint8_t version = FORMAT_VERSION + 1;
+    uint8_t version = FORMAT_VERSION_V2 + 1;
     memcpy(chunk1MetaPage, &version, sizeof(uint8_t));
     EXPECT_CALL(*lfs_, Read(1, NotNull(), 0, PAGE_SIZE))
                 .WillOnce(DoAll(SetArrayArgument<1>(chunk1MetaPage,
@@ -855,13 +858,16 @@ TEST_F(CSDataStore_test, WriteChunkTest4) {
     // will write data
     EXPECT_CALL(*lfs_, Write(3, NotNull(), PAGE_SIZE + offset, length))
         .Times(1);
+    uint32_t cost = 0;
     EXPECT_EQ(CSErrorCode::Success,
               dataStore->WriteChunk(id,
                                     sn,
                                     buf,
                                     offset,
                                     length,
-                                    nullptr));
+                                    &cost));
+    // 只产生了写数据一次IO
+    ASSERT_EQ(1, cost);
     CSChunkInfo info;
     dataStore->GetChunkInfo(id, &info);
     ASSERT_EQ(2, info.curSn);
@@ -943,13 +949,16 @@ TEST_F(CSDataStore_test, WriteChunkTest6) {
     EXPECT_CALL(*lfs_, Write(3, NotNull(), PAGE_SIZE + offset, length))
         .Times(1);
 
+    uint32_t cost = 0;
     EXPECT_EQ(CSErrorCode::Success,
               dataStore->WriteChunk(id,
                                     sn,
                                     buf,
                                     offset,
                                     length,
-                                    nullptr));
+                                    &cost));
+    // 更新metapage和写数据各一次IO
+    ASSERT_EQ(2, cost);
     CSChunkInfo info;
     dataStore->GetChunkInfo(id, &info);
     ASSERT_EQ(3, info.curSn);
@@ -2126,6 +2135,58 @@ TEST_F(CSDataStore_test, WriteChunkErrorTest5) {
         .Times(1);
 }
 
+/**
+ * WriteChunkTest
+ * case:chunk存在,数据以IOBuf形式写入
+ * 预期结果:通过Writev直接写入IOBuf中的数据
+ */
+TEST_F(CSDataStore_test, WriteChunkIOBufTest) {
+    // initialize
+    FakeEnv();
+    EXPECT_TRUE(dataStore->Initialize());
+
+    ChunkID id = 2;
+    SequenceNum sn = 2;
+    off_t offset = PAGE_SIZE;
+    size_t length = 2 * PAGE_SIZE;
+    char buf[length];  // NOLINT
+    memset(buf, 0, sizeof(buf));
+    butil::IOBuf data;
+    data.append(buf, length);
+
+    // 数据长度小于请求长度，返回InvalidArgError
+    butil::IOBuf shortData;
+    shortData.append(buf, PAGE_SIZE);
+    EXPECT_CALL(*lfs_, Writev(_, _, _, _))
+        .Times(0);
+    EXPECT_EQ(CSErrorCode::InvalidArgError,
+              dataStore->WriteChunk(id, sn, shortData, offset, length,
+                                    nullptr));
+
+    // 不会通过Write拷贝写入，而是通过Writev写入
+    EXPECT_CALL(*lfs_, Write(3, NotNull(), PAGE_SIZE + offset, length))
+        .Times(0);
+    EXPECT_CALL(*lfs_, Writev(3, NotNull(), Ge(1), PAGE_SIZE + offset))
+        .WillOnce(Return(length));
+    EXPECT_EQ(CSErrorCode::Success,
+              dataStore->WriteChunk(id, sn, data, offset, length, nullptr));
+    // IOBuf中的数据不会被消耗
+    ASSERT_EQ(length, data.size());
+
+    // Writev失败，返回InternalError
+    EXPECT_CALL(*lfs_, Writev(3, NotNull(), Ge(1), PAGE_SIZE + offset))
+        .WillOnce(Return(-UT_ERRNO));
+    EXPECT_EQ(CSErrorCode::InternalError,
+              dataStore->WriteChunk(id, sn, data, offset, length, nullptr));
+
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+}
+
 /*
  * WriteChunkErrorTest
  * 所写chunk为clone chunk
@@ -2490,6 +2551,61 @@ TEST_F(CSDataStore_test, ReadChunkErrorTest1) {
         .Times(1);
 }
 
+/**
+ * ReadChunkAsyncTest
+ * case1:chunk不存在
+ * 预期结果1:回调返回ChunkNotExistError
+ * case2:读取区域未对齐
+ * 预期结果2:回调返回InvalidArgError，不会读文件
+ * case3:本地文件系统不支持异步IO，正常读取存在的chunk
+ * 预期结果3:同步读文件后回调返回Success
+ * case4:读chunk文件时出错
+ * 预期结果4:回调返回InternalError
+ */
+TEST_F(CSDataStore_test, ReadChunkAsyncTest) {
+    // initialize
+    FakeEnv();
+    EXPECT_TRUE(dataStore->Initialize());
+    ASSERT_FALSE(dataStore->SupportAsyncIO());
+
+    SequenceNum sn = 2;
+    off_t offset = PAGE_SIZE;
+    size_t length = PAGE_SIZE;
+    char buf[length];  // NOLINT
+    memset(buf, 0, sizeof(buf));
+    CSErrorCode result = CSErrorCode::Success;
+    auto done = [&result](CSErrorCode errorCode) { result = errorCode; };
+
+    // case1
+    dataStore->ReadChunkAsync(3, sn, buf, offset, length, done);
+    ASSERT_EQ(CSErrorCode::ChunkNotExistError, result);
+
+    // case2
+    EXPECT_CALL(*lfs_, Read(1, _, _, length - 1))
+        .Times(0);
+    dataStore->ReadChunkAsync(1, sn, buf, offset, length - 1, done);
+    ASSERT_EQ(CSErrorCode::InvalidArgError, result);
+
+    // case3
+    EXPECT_CALL(*lfs_, Read(1, NotNull(), offset + PAGE_SIZE, length))
+        .WillOnce(Return(length));
+    dataStore->ReadChunkAsync(1, sn, buf, offset, length, done);
+    ASSERT_EQ(CSErrorCode::Success, result);
+
+    // case4
+    EXPECT_CALL(*lfs_, Read(1, NotNull(), offset + PAGE_SIZE, length))
+        .WillOnce(Return(-UT_ERRNO));
+    dataStore->ReadChunkAsync(1, sn, buf, offset, length, done);
+    ASSERT_EQ(CSErrorCode::InternalError, result);
+
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+}
+
 /**
  * ReadSnapshotChunkTest
  * case:chunk不存在
@@ -3857,6 +3973,79 @@ TEST_F(CSDataStore_test, PasteChunkTest1) {
         .Times(1);
 }
 
+/**
+ * PasteChunkTest
+ * case:clone chunk部分区域已写过，数据以IOBuf形式paste
+ * 预期结果:只将未写过的区域通过Writev写入
+ */
+TEST_F(CSDataStore_test, PasteChunkIOBufTest) {
+    // initialize
+    FakeEnv();
+    EXPECT_TRUE(dataStore->Initialize());
+
+    ChunkID id = 3;
+    SequenceNum sn = 1;
+    SequenceNum correctedSn = 2;
+    off_t offset = 0;
+    size_t length = 4 * PAGE_SIZE;
+    char buf[length];  // NOLINT
+    memset(buf, 0, sizeof(buf));
+    butil::IOBuf data;
+    data.append(buf, length);
+    // 创建 clone chunk，其中第1个page已经被写过
+    {
+        char chunk3MetaPage[PAGE_SIZE];
+        memset(chunk3MetaPage, 0, sizeof(chunk3MetaPage));
+        shared_ptr<Bitmap> bitmap =
+            make_shared<Bitmap>(CHUNK_SIZE / PAGE_SIZE);
+        bitmap->Set(1);
+        FakeEncodeChunk(chunk3MetaPage, correctedSn, sn, bitmap, location);
+        string chunk3Path = string(baseDir) + "/" +
+                            FileNameOperator::GenerateChunkFileName(id);
+        EXPECT_CALL(*lfs_, FileExists(chunk3Path))
+            .WillOnce(Return(false));
+        EXPECT_CALL(*fpool_, GetChunk(chunk3Path, NotNull()))
+            .WillOnce(Return(0));
+        EXPECT_CALL(*lfs_, Open(chunk3Path, _))
+            .Times(1)
+            .WillOnce(Return(4));
+        EXPECT_CALL(*lfs_, Read(4, NotNull(), 0, PAGE_SIZE))
+            .WillOnce(DoAll(SetArrayArgument<1>(chunk3MetaPage,
+                            chunk3MetaPage + PAGE_SIZE),
+                            Return(PAGE_SIZE)));
+        EXPECT_EQ(CSErrorCode::Success,
+                  dataStore->CreateCloneChunk(id,
+                                              sn,
+                                              correctedSn,
+                                              CHUNK_SIZE,
+                                              location));
+    }
+
+    // [0, PAGE_SIZE)和[2 * PAGE_SIZE, 4 * PAGE_SIZE)未写过
+    EXPECT_CALL(*lfs_, Writev(4, NotNull(), Ge(1), PAGE_SIZE))
+        .WillOnce(Return(PAGE_SIZE));
+    EXPECT_CALL(*lfs_, Writev(4, NotNull(), Ge(1), 3 * PAGE_SIZE))
+        .WillOnce(Return(2 * PAGE_SIZE));
+    // update metapage
+    EXPECT_CALL(*lfs_, Write(4, NotNull(), 0, PAGE_SIZE))
+        .Times(1);
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->PasteChunk(id, data, offset, length));
+    CSChunkInfo info;
+    ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(id, &info));
+    ASSERT_EQ(true, info.isClone);
+    ASSERT_EQ(4, info.bitmap->NextClearBit(0));
+
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(4))
+        .Times(1);
+}
+
 /*
  * PasteChunkErrorTest
  * case1:写数据时失败
@@ -4033,5 +4222,770 @@ TEST_F(CSDataStore_test, GetStatusTest) {
         .Times(1);
 }
 
+/**
+ * SyncChunkFilesTest
+ * case:非同步写模式下写chunk，然后批量刷盘
+ * 预期结果:打开文件时不带O_DSYNC，写入时不刷盘；
+ *         SyncChunkFiles只对写过的chunk调用fdatasync，刷盘失败的chunk下次重试；
+ *         chunk刷盘后fsync被修改过的目录，失败时返回错误；
+ *         更新sn类的metapage前后都会调用fdatasync
+ */
+TEST_F(CSDataStore_test, SyncChunkFilesTest) {
+    DataStoreOptions options;
+    options.baseDir = baseDir;
+    options.chunkSize = CHUNK_SIZE;
+    options.pageSize = PAGE_SIZE;
+    options.locationLimit = kLocationLimit;
+    options.syncWrite = false;
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+
+    // initialize
+    FakeEnv();
+    EXPECT_CALL(*lfs_, Open(_, Truly([](int flag) {
+            return (flag & O_DSYNC) == O_DSYNC;
+        })))
+        .Times(0);
+    EXPECT_TRUE(dataStore->Initialize());
+
+    ChunkID id = 2;
+    SequenceNum sn = 2;
+    off_t offset = 0;
+    size_t length = PAGE_SIZE;
+    char buf[length];  // NOLINT
+    memset(buf, 0, sizeof(buf));
+
+    // 写入时不会刷盘
+    EXPECT_CALL(*lfs_, Write(3, NotNull(), PAGE_SIZE + offset, length))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Fdatasync(_))
+        .Times(0);
+    EXPECT_EQ(CSErrorCode::Success,
+              dataStore->WriteChunk(id, sn, buf, offset, length, nullptr));
+
+    // 只刷被写过的chunk2，chunk1没有被写过
+    EXPECT_CALL(*lfs_, Fdatasync(3))
+        .WillOnce(Return(0));
+    EXPECT_EQ(CSErrorCode::Success, dataStore->SyncChunkFiles());
+    // 没有新的写入，不会再刷盘
+    EXPECT_CALL(*lfs_, Fdatasync(_))
+        .Times(0);
+    EXPECT_EQ(CSErrorCode::Success, dataStore->SyncChunkFiles());
+
+    // 刷盘失败，下次调用时重试
+    EXPECT_CALL(*lfs_, Write(3, NotNull(), PAGE_SIZE + offset, length))
+        .Times(1);
+    EXPECT_EQ(CSErrorCode::Success,
+              dataStore->WriteChunk(id, sn, buf, offset, length, nullptr));
+    EXPECT_CALL(*lfs_, Fdatasync(3))
+        .WillOnce(Return(-UT_ERRNO))
+        .WillOnce(Return(0));
+    EXPECT_EQ(CSErrorCode::InternalError, dataStore->SyncChunkFiles());
+    EXPECT_EQ(CSErrorCode::Success, dataStore->SyncChunkFiles());
+
+    // chunk刷盘后fsync被修改过的目录，失败时返回错误
+    EXPECT_CALL(*fpool_, SyncDirs())
+        .WillOnce(Return(-1))
+        .WillOnce(Return(0));
+    EXPECT_EQ(CSErrorCode::InternalError, dataStore->SyncChunkFiles());
+    EXPECT_EQ(CSErrorCode::Success, dataStore->SyncChunkFiles());
+
+    // 更新correctedSn，metapage写入前后各刷一次盘
+    EXPECT_CALL(*lfs_, Write(3, NotNull(), 0, PAGE_SIZE))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Fdatasync(3))
+        .Times(2)
+        .WillRepeatedly(Return(0));
+    EXPECT_EQ(CSErrorCode::Success,
+              dataStore->DeleteSnapshotChunkOrCorrectSn(id, 3));
+
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+}
+
+/**
+ * BatchBitmapFlushTest
+ * case:批量持久化clone chunk的bitmap，写入和paste未写过的page
+ * 预期结果:写入和paste时只更新内存中的bitmap，不写metapage；
+ *         SyncChunkFiles时将多次更新合并为一次metapage写入；
+ *         chunk被写满转为普通chunk时立即更新metapage
+ */
+TEST_F(CSDataStore_test, BatchBitmapFlushTest) {
+    DataStoreOptions options;
+    options.baseDir = baseDir;
+    options.chunkSize = CHUNK_SIZE;
+    options.pageSize = PAGE_SIZE;
+    options.locationLimit = kLocationLimit;
+    options.batchBitmapFlush = true;
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+
+    // initialize
+    FakeEnv();
+    EXPECT_TRUE(dataStore->Initialize());
+
+    ChunkID id = 3;
+    SequenceNum sn = 1;
+    SequenceNum correctedSn = 0;
+    char buf[PAGE_SIZE];  // NOLINT
+    memset(buf, 0, sizeof(buf));
+    CSChunkInfo info;
+    // 创建 clone chunk
+    {
+        char chunk3MetaPage[PAGE_SIZE];
+        memset(chunk3MetaPage, 0, sizeof(chunk3MetaPage));
+        shared_ptr<Bitmap> bitmap =
+            make_shared<Bitmap>(CHUNK_SIZE / PAGE_SIZE);
+        FakeEncodeChunk(chunk3MetaPage, correctedSn, sn, bitmap, location);
+        string chunk3Path = string(baseDir) + "/" +
+                            FileNameOperator::GenerateChunkFileName(id);
+        EXPECT_CALL(*lfs_, FileExists(chunk3Path))
+            .WillOnce(Return(false));
+        EXPECT_CALL(*fpool_, GetChunk(chunk3Path, NotNull()))
+            .WillOnce(Return(0));
+        EXPECT_CALL(*lfs_, Open(chunk3Path, _))
+            .WillOnce(Return(4));
+        EXPECT_CALL(*lfs_, Read(4, NotNull(), 0, PAGE_SIZE))
+            .WillOnce(DoAll(SetArrayArgument<1>(chunk3MetaPage,
+                            chunk3MetaPage + PAGE_SIZE),
+                            Return(PAGE_SIZE)));
+        EXPECT_EQ(CSErrorCode::Success,
+                  dataStore->CreateCloneChunk(id,
+                                              sn,
+                                              correctedSn,
+                                              CHUNK_SIZE,
+                                              location));
+    }
+
+    // case1:多次写入和paste未写过的page，只更新内存中的bitmap
+    {
+        const int kWriteNum = 16;
+        EXPECT_CALL(*lfs_, Write(4, NotNull(), 0, PAGE_SIZE))
+            .Times(0);
+        EXPECT_CALL(*lfs_, Fdatasync(_))
+            .Times(0);
+        for (int i = 0; i < kWriteNum; ++i) {
+            off_t offset = 2 * i * PAGE_SIZE;
+            EXPECT_CALL(*lfs_, Write(4, NotNull(), PAGE_SIZE + offset,
+                                     PAGE_SIZE))
+                .Times(1);
+            ASSERT_EQ(CSErrorCode::Success,
+                      dataStore->WriteChunk(id, sn, buf, offset, PAGE_SIZE,
+                                            nullptr));
+        }
+        // paste最后一个写过的page及其后一个page，已写过的page不会被覆盖
+        off_t pasteOff = 2 * (kWriteNum - 1) * PAGE_SIZE;
+        EXPECT_CALL(*lfs_, Write(4, NotNull(), 2 * PAGE_SIZE + pasteOff,
+                                 PAGE_SIZE))
+            .Times(1);
+        std::unique_ptr<char[]> pasteData(new char[2 * PAGE_SIZE]);
+        ASSERT_EQ(CSErrorCode::Success,
+                  dataStore->PasteChunk(id, pasteData.get(), pasteOff,
+                                        2 * PAGE_SIZE));
+        // 读请求看到的是内存中最新的bitmap
+        ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(id, &info));
+        ASSERT_EQ(true, info.isClone);
+        for (int i = 0; i < kWriteNum - 1; ++i) {
+            ASSERT_TRUE(info.bitmap->Test(2 * i));
+            ASSERT_FALSE(info.bitmap->Test(2 * i + 1));
+        }
+        ASSERT_EQ(2 * kWriteNum, info.bitmap->NextClearBit(2 * kWriteNum - 2));
+    }
+
+    // case2:SyncChunkFiles时合并写入一次metapage，写入的bitmap与内存一致
+    {
+        char metaPage[PAGE_SIZE];
+        EXPECT_CALL(*lfs_, Write(4, NotNull(), 0, PAGE_SIZE))
+            .WillOnce(Invoke([&](int fd, const char* data,
+                                 uint64_t offset, int len) {
+                memcpy(metaPage, data, len);
+                return len;
+            }));
+        EXPECT_CALL(*lfs_, Fdatasync(4))
+            .WillOnce(Return(0));
+        ASSERT_EQ(CSErrorCode::Success, dataStore->SyncChunkFiles());
+        ChunkFileMetaPage decoded;
+        ASSERT_EQ(CSErrorCode::Success, decoded.decode(metaPage));
+        ASSERT_EQ(*info.bitmap, *decoded.bitmap);
+        // 没有新的写入，不会再写metapage
+        ASSERT_EQ(CSErrorCode::Success, dataStore->SyncChunkFiles());
+    }
+
+    // case3:写满整个chunk，转为普通chunk时立即更新metapage
+    {
+        EXPECT_CALL(*lfs_, Write(4, NotNull(), PAGE_SIZE, CHUNK_SIZE))
+            .Times(1);
+        EXPECT_CALL(*lfs_, Write(4, NotNull(), 0, PAGE_SIZE))
+            .Times(1);
+        std::unique_ptr<char[]> chunkData(new char[CHUNK_SIZE]);
+        ASSERT_EQ(CSErrorCode::Success,
+                  dataStore->WriteChunk(id, sn, chunkData.get(), 0,
+                                        CHUNK_SIZE, nullptr));
+        ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(id, &info));
+        ASSERT_EQ(false, info.isClone);
+    }
+
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(4))
+        .Times(1);
+}
+
+/**
+ * TrackWrittenPagesTest
+ * case:开启trackWrittenPages，创建新chunk并读写
+ * 预期结果:新chunk的metapage中记录bitmap；
+ *         读未写过的page直接返回0，不读文件；
+ *         所有page都写过后去掉bitmap，metapage恢复为原来的格式
+ */
+TEST_F(CSDataStore_test, TrackWrittenPagesTest) {
+    DataStoreOptions options;
+    options.baseDir = baseDir;
+    options.chunkSize = CHUNK_SIZE;
+    options.pageSize = PAGE_SIZE;
+    options.locationLimit = kLocationLimit;
+    options.trackWrittenPages = true;
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+
+    // initialize
+    FakeEnv();
+    EXPECT_TRUE(dataStore->Initialize());
+
+    ChunkID id = 3;
+    SequenceNum sn = 1;
+    char buf[4 * PAGE_SIZE];  // NOLINT
+    char chunk3MetaPage[PAGE_SIZE];
+    string chunk3Path = string(baseDir) + "/" +
+                        FileNameOperator::GenerateChunkFileName(id);
+    auto saveMetaPage = [&](int fd, const char* data,
+                            uint64_t offset, int len) {
+        memcpy(chunk3MetaPage, data, len);
+        return len;
+    };
+    // case1:创建新chunk，metapage中记录全部未写过的bitmap
+    {
+        EXPECT_CALL(*lfs_, FileExists(chunk3Path))
+            .WillOnce(Return(false));
+        EXPECT_CALL(*fpool_, GetChunk(chunk3Path, NotNull()))
+            .WillOnce(Invoke([&](const std::string& path, char* metapage) {
+                memcpy(chunk3MetaPage, metapage, PAGE_SIZE);
+                return 0;
+            }));
+        EXPECT_CALL(*lfs_, Open(chunk3Path, _))
+            .WillOnce(Return(4));
+        EXPECT_CALL(*lfs_, Read(4, NotNull(), 0, PAGE_SIZE))
+            .WillOnce(Invoke([&](int fd, char* data,
+                                 uint64_t offset, int len) {
+                memcpy(data, chunk3MetaPage, len);
+                return len;
+            }));
+        // 写入的page之前未写过，需要更新metapage
+        EXPECT_CALL(*lfs_, Write(4, NotNull(), 2 * PAGE_SIZE, PAGE_SIZE))
+            .Times(1);
+        EXPECT_CALL(*lfs_, Write(4, NotNull(), 0, PAGE_SIZE))
+            .WillOnce(Invoke(saveMetaPage));
+        memset(buf, 'a', PAGE_SIZE);
+        ASSERT_EQ(CSErrorCode::Success,
+                  dataStore->WriteChunk(id, sn, buf, PAGE_SIZE, PAGE_SIZE,
+                                        nullptr));
+        ChunkFileMetaPage decoded;
+        ASSERT_EQ(CSErrorCode::Success, decoded.decode(chunk3MetaPage));
+        ASSERT_EQ(FORMAT_VERSION_V2, decoded.version);
+        ASSERT_TRUE(decoded.location.empty());
+        ASSERT_NE(nullptr, decoded.bitmap);
+        ASSERT_EQ(1, decoded.bitmap->NextSetBit(0));
+        ASSERT_EQ(Bitmap::NO_POS, decoded.bitmap->NextSetBit(2));
+
+        CSChunkInfo info;
+        ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(id, &info));
+        ASSERT_FALSE(info.isClone);
+    }
+
+    // case2:读请求只读已写过的page，未写过的page填0
+    {
+        EXPECT_CALL(*lfs_, Read(4, _, _, _))
+            .Times(0);
+        EXPECT_CALL(*lfs_, Read(4, NotNull(), 2 * PAGE_SIZE, PAGE_SIZE))
+            .WillOnce(Invoke([](int fd, char* data,
+                                uint64_t offset, int len) {
+                memset(data, 'a', len);
+                return len;
+            }));
+        memset(buf, 'x', sizeof(buf));
+        ASSERT_EQ(CSErrorCode::Success,
+                  dataStore->ReadChunk(id, sn, buf, 0, 4 * PAGE_SIZE));
+        for (int i = 0; i < 4 * PAGE_SIZE; ++i) {
+            ASSERT_EQ(i / PAGE_SIZE == 1 ? 'a' : 0, buf[i]);
+        }
+        // 读取区域全部未写过，不会读文件
+        memset(buf, 'x', sizeof(buf));
+        ASSERT_EQ(CSErrorCode::Success,
+                  dataStore->ReadChunk(id, sn, buf, 4 * PAGE_SIZE,
+                                       4 * PAGE_SIZE));
+        for (int i = 0; i < 4 * PAGE_SIZE; ++i) {
+            ASSERT_EQ(0, buf[i]);
+        }
+    }
+
+    // case3:所有page都写过后去掉bitmap，之后的读请求直接读文件
+    {
+        EXPECT_CALL(*lfs_, Write(4, NotNull(), PAGE_SIZE, CHUNK_SIZE))
+            .Times(1);
+        EXPECT_CALL(*lfs_, Write(4, NotNull(), 0, PAGE_SIZE))
+            .WillOnce(Invoke(saveMetaPage));
+        std::unique_ptr<char[]> chunkData(new char[CHUNK_SIZE]);
+        ASSERT_EQ(CSErrorCode::Success,
+                  dataStore->WriteChunk(id, sn, chunkData.get(), 0,
+                                        CHUNK_SIZE, nullptr));
+        ChunkFileMetaPage decoded;
+        ASSERT_EQ(CSErrorCode::Success, decoded.decode(chunk3MetaPage));
+        ASSERT_EQ(FORMAT_VERSION, decoded.version);
+        ASSERT_EQ(nullptr, decoded.bitmap);
+
+        EXPECT_CALL(*lfs_, Read(4, NotNull(), 5 * PAGE_SIZE, 4 * PAGE_SIZE))
+            .WillOnce(Return(4 * PAGE_SIZE));
+        ASSERT_EQ(CSErrorCode::Success,
+                  dataStore->ReadChunk(id, sn, buf, 4 * PAGE_SIZE,
+                                       4 * PAGE_SIZE));
+    }
+
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(4))
+        .Times(1);
+}
+
+/**
+ * DirectIOTest
+ * case:以O_DIRECT方式读写chunk
+ * 预期结果:打开文件时带O_DIRECT；
+ *         下发到文件系统的读写请求，内存地址、偏移和长度都是对齐的；
+ *         IOBuf中不对齐的数据拷贝到对齐内存后写入
+ */
+TEST_F(CSDataStore_test, DirectIOTest) {
+    DataStoreOptions options;
+    options.baseDir = baseDir;
+    options.chunkSize = CHUNK_SIZE;
+    options.pageSize = PAGE_SIZE;
+    options.locationLimit = kLocationLimit;
+    options.directIO = true;
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+
+    auto aligned = [](const char* buf) {
+        return DirectIOHelper::IsAligned(buf, 0, 0);
+    };
+
+    // initialize
+    FakeEnv();
+    EXPECT_CALL(*lfs_, Open(_, Truly([](int flag) {
+            return (flag & O_DIRECT) != O_DIRECT;
+        })))
+        .Times(0);
+    EXPECT_TRUE(dataStore->Initialize());
+
+    ChunkID id = 2;
+    SequenceNum sn = 2;
+    off_t offset = 0;
+    size_t length = PAGE_SIZE;
+    char buf[length + 1];  // NOLINT
+    memset(buf, 0, sizeof(buf));
+
+    // 用户内存不对齐，拷贝到对齐内存后写入
+    EXPECT_CALL(*lfs_, Write(3, Truly(aligned), PAGE_SIZE + offset, length))
+        .Times(1);
+    EXPECT_EQ(CSErrorCode::Success,
+              dataStore->WriteChunk(id, sn, buf + 1, offset, length, nullptr));
+
+    // IOBuf中的数据不对齐，不会通过Writev写入
+    butil::IOBuf data;
+    data.append(buf, length);
+    EXPECT_CALL(*lfs_, Writev(_, _, _, _))
+        .Times(0);
+    EXPECT_CALL(*lfs_, Write(3, Truly(aligned), PAGE_SIZE + offset, length))
+        .Times(1);
+    EXPECT_EQ(CSErrorCode::Success,
+              dataStore->WriteChunk(id, sn, data, offset, length, nullptr));
+
+    // 读到不对齐的用户内存
+    EXPECT_CALL(*lfs_, Read(3, Truly(aligned), PAGE_SIZE + offset, length))
+        .Times(1);
+    EXPECT_EQ(CSErrorCode::Success,
+              dataStore->ReadChunk(id, sn, buf + 1, offset, length));
+
+    // 更新metapage时使用对齐的内存
+    EXPECT_CALL(*lfs_, Write(3, Truly(aligned), 0, PAGE_SIZE))
+        .Times(1);
+    EXPECT_EQ(CSErrorCode::Success,
+              dataStore->DeleteSnapshotChunkOrCorrectSn(id, 3));
+
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+}
+
+/**
+ * LazyOpenTest
+ * case:启用fd缓存，缓存容量为1
+ * 预期结果:Initialize时不打开chunk文件；首次访问时打开并加载快照；
+ *         超过容量时关闭最近未被访问的chunk；fd被关闭后GetChunkInfo不需要重新打开
+ */
+TEST_F(CSDataStore_test, LazyOpenTest) {
+    auto fdCache = std::make_shared<ChunkFdCache>(1);
+    DataStoreOptions options;
+    options.baseDir = baseDir;
+    options.chunkSize = CHUNK_SIZE;
+    options.pageSize = PAGE_SIZE;
+    options.locationLimit = kLocationLimit;
+    options.fdCache = fdCache;
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+
+    // initialize
+    FakeEnv();
+    EXPECT_CALL(*lfs_, Open(_, _))
+        .Times(0);
+    EXPECT_TRUE(dataStore->Initialize());
+    ASSERT_EQ(0, fdCache->Size());
+
+    EXPECT_CALL(*lfs_, Open(chunk1Path, _))
+        .Times(2)
+        .WillRepeatedly(Return(1));
+    EXPECT_CALL(*lfs_, Open(chunk1snap1Path, _))
+        .Times(2)
+        .WillRepeatedly(Return(2));
+    EXPECT_CALL(*lfs_, Open(chunk2Path, _))
+        .Times(1)
+        .WillRepeatedly(Return(3));
+
+    // 首次访问chunk1，加载chunk1及其快照
+    CSChunkInfo info;
+    ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(1, &info));
+    ASSERT_EQ(2, info.curSn);
+    ASSERT_EQ(1, info.snapSn);
+    ASSERT_EQ(1, fdCache->Size());
+
+    // 访问chunk2，超过容量，关闭chunk1及其快照的fd
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(2);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(2);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+    char buf[PAGE_SIZE];  // NOLINT
+    EXPECT_CALL(*lfs_, Read(3, NotNull(), PAGE_SIZE, PAGE_SIZE))
+        .Times(1);
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->ReadChunk(2, 2, buf, 0, PAGE_SIZE));
+    ASSERT_EQ(1, fdCache->Size());
+    ASSERT_EQ(1, fdCache->EvictCount());
+
+    // 元数据仍在内存中，不需要重新打开文件
+    ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(1, &info));
+    ASSERT_EQ(2, info.curSn);
+    ASSERT_EQ(1, info.snapSn);
+
+    // 读chunk1需要重新打开chunk1及其快照，chunk2被关闭
+    EXPECT_CALL(*lfs_, Read(1, NotNull(), PAGE_SIZE, PAGE_SIZE))
+        .Times(1);
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->ReadChunk(1, 2, buf, 0, PAGE_SIZE));
+    ASSERT_EQ(1, fdCache->Size());
+    ASSERT_EQ(2, fdCache->EvictCount());
+}
+
+/**
+ * DirtyFdEvictTest
+ * case:启用fd缓存，缓存容量为1，非同步写模式下写chunk后访问其他chunk
+ * 预期结果:有未刷盘写入的chunk不会被淘汰，SyncChunkFiles可以直接对其fdatasync
+ */
+TEST_F(CSDataStore_test, DirtyFdEvictTest) {
+    auto fdCache = std::make_shared<ChunkFdCache>(1);
+    DataStoreOptions options;
+    options.baseDir = baseDir;
+    options.chunkSize = CHUNK_SIZE;
+    options.pageSize = PAGE_SIZE;
+    options.locationLimit = kLocationLimit;
+    options.syncWrite = false;
+    options.fdCache = fdCache;
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+
+    // initialize
+    FakeEnv();
+    EXPECT_TRUE(dataStore->Initialize());
+
+    EXPECT_CALL(*lfs_, Open(chunk2Path, _))
+        .Times(1)
+        .WillRepeatedly(Return(3));
+    char buf[PAGE_SIZE];  // NOLINT
+    memset(buf, 0, sizeof(buf));
+    EXPECT_CALL(*lfs_, Write(3, NotNull(), PAGE_SIZE, PAGE_SIZE))
+        .Times(1);
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->WriteChunk(2, 2, buf, 0, PAGE_SIZE, nullptr));
+    ASSERT_EQ(1, fdCache->Size());
+
+    // 访问chunk1超过容量，chunk2有未刷盘的写入，不会被关闭
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(0);
+    EXPECT_CALL(*lfs_, Read(1, NotNull(), PAGE_SIZE, PAGE_SIZE))
+        .Times(1);
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->ReadChunk(1, 2, buf, 0, PAGE_SIZE));
+    ASSERT_EQ(2, fdCache->Size());
+    ASSERT_EQ(0, fdCache->EvictCount());
+
+    // 刷盘使用的仍然是写入时的fd
+    EXPECT_CALL(*lfs_, Fdatasync(3))
+        .WillOnce(Return(0));
+    EXPECT_EQ(CSErrorCode::Success, dataStore->SyncChunkFiles());
+
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+}
+
+/**
+ * ReadCacheTest
+ * case1:第一次读未命中，读盘后放入缓存，再次读命中，不读盘
+ * case2:写入后更新已缓存的page，读到写入的数据
+ * case3:chunk版本号变化后清除缓存，需要重新读盘
+ * case4:删除chunk后清除缓存
+ * 预期结果:读到的数据正确，命中和未命中的page数统计正确
+ */
+TEST_F(CSDataStore_test, ReadCacheTest) {
+    auto readCache = std::make_shared<ChunkReadCache>(
+        ChunkReadCache::kShardNum * 16 * PAGE_SIZE, PAGE_SIZE);
+    DataStoreOptions options;
+    options.baseDir = baseDir;
+    options.chunkSize = CHUNK_SIZE;
+    options.pageSize = PAGE_SIZE;
+    options.locationLimit = kLocationLimit;
+    options.readCache = readCache;
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+
+    // initialize
+    FakeEnv();
+    EXPECT_TRUE(dataStore->Initialize());
+
+    ChunkID id = 2;
+    off_t offset = PAGE_SIZE;
+    size_t length = PAGE_SIZE;
+    char data[PAGE_SIZE];  // NOLINT
+    char buf[PAGE_SIZE];  // NOLINT
+    memset(data, 'a', sizeof(data));
+
+    // case1
+    EXPECT_CALL(*lfs_, Read(3, NotNull(), offset + PAGE_SIZE, length))
+        .WillOnce(DoAll(SetArrayArgument<1>(data, data + PAGE_SIZE),
+                        Return(length)));
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->ReadChunk(id, 2, buf, offset, length));
+    ASSERT_EQ(0, memcmp(buf, data, length));
+    memset(buf, 0, sizeof(buf));
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->ReadChunk(id, 2, buf, offset, length));
+    ASSERT_EQ(0, memcmp(buf, data, length));
+    ASSERT_EQ(1, readCache->Size());
+    DataStoreStatus status = dataStore->GetStatus();
+    ASSERT_EQ(1, status.readCacheHitCount);
+    ASSERT_EQ(1, status.readCacheMissCount);
+
+    // case2
+    memset(data, 'b', sizeof(data));
+    EXPECT_CALL(*lfs_, Write(3, NotNull(), offset + PAGE_SIZE, length))
+        .WillOnce(Return(length));
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->WriteChunk(id, 2, data, offset, length, nullptr));
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->ReadChunk(id, 2, buf, offset, length));
+    ASSERT_EQ(0, memcmp(buf, data, length));
+    status = dataStore->GetStatus();
+    ASSERT_EQ(2, status.readCacheHitCount);
+    ASSERT_EQ(1, status.readCacheMissCount);
+
+    // case3
+    // 先修正correctedSn，版本号增加时不创建快照
+    EXPECT_CALL(*lfs_, Write(3, NotNull(), 0, PAGE_SIZE))
+        .Times(2)
+        .WillRepeatedly(Return(PAGE_SIZE));
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->DeleteSnapshotChunkOrCorrectSn(id, 3));
+    ASSERT_EQ(1, readCache->Size());
+    EXPECT_CALL(*lfs_, Write(3, NotNull(), 2 * PAGE_SIZE + PAGE_SIZE, length))
+        .WillOnce(Return(length));
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->WriteChunk(id, 3, data, 2 * PAGE_SIZE, length,
+                                    nullptr));
+    ASSERT_EQ(0, readCache->Size());
+    EXPECT_CALL(*lfs_, Read(3, NotNull(), offset + PAGE_SIZE, length))
+        .WillOnce(DoAll(SetArrayArgument<1>(data, data + PAGE_SIZE),
+                        Return(length)));
+    ASSERT_EQ(CSErrorCode::Success,
+              dataStore->ReadChunk(id, 3, buf, offset, length));
+    ASSERT_EQ(0, memcmp(buf, data, length));
+    ASSERT_EQ(1, readCache->Size());
+
+    // case4
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(1);
+    ASSERT_EQ(CSErrorCode::Success, dataStore->DeleteChunk(id, 3));
+    ASSERT_EQ(0, readCache->Size());
+
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(1);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(1);
+}
+
+/**
+ * ManifestTest
+ * case1:manifest不存在，扫描数据目录，扫描过程中记录chunk元数据，正常退出时封存
+ * case2:manifest有效，从manifest加载，不扫描目录，不读非clone chunk的metapage
+ * case3:未启用fd缓存时从manifest加载，非clone chunk只打开文件，不读metapage
+ * 预期结果:三次加载的chunk信息一致
+ */
+TEST_F(CSDataStore_test, ManifestTest) {
+    DataStoreOptions options;
+    options.baseDir = baseDir;
+    options.chunkSize = CHUNK_SIZE;
+    options.pageSize = PAGE_SIZE;
+    options.locationLimit = kLocationLimit;
+    options.manifestPath = manifestPath;
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+
+    FakeEnv();
+    // 用内存模拟manifest文件
+    std::string manifest;
+    int manifestFd = 50;
+    EXPECT_CALL(*lfs_, Open(manifestPath, _))
+        .WillRepeatedly(Return(manifestFd));
+    EXPECT_CALL(*lfs_, Write(manifestFd, NotNull(), _, _))
+        .WillRepeatedly(Invoke([&manifest](int fd, const char* buf,
+                                           uint64_t offset, int length) {
+            if (manifest.size() < offset + length) {
+                manifest.resize(offset + length);
+            }
+            memcpy(&manifest[offset], buf, length);
+            return length;
+        }));
+    EXPECT_CALL(*lfs_, Read(manifestFd, NotNull(), 0, _))
+        .WillRepeatedly(Invoke([&manifest](int fd, char* buf,
+                                           uint64_t offset, int length) {
+            memcpy(buf, manifest.data(), length);
+            return length;
+        }));
+    EXPECT_CALL(*lfs_, Fstat(manifestFd, NotNull()))
+        .WillRepeatedly(Invoke([&manifest](int fd, struct stat* info) {
+            info->st_size = manifest.size();
+            return 0;
+        }));
+    EXPECT_CALL(*lfs_, Fdatasync(manifestFd))
+        .WillRepeatedly(Return(0));
+    // 数据目录的状态
+    int dirFd = 60;
+    struct stat dirInfo;
+    memset(&dirInfo, 0, sizeof(dirInfo));
+    dirInfo.st_ino = 1234;
+    dirInfo.st_mtim.tv_sec = 10;
+    dirInfo.st_mtim.tv_nsec = 20;
+    EXPECT_CALL(*lfs_, Open(baseDir, _))
+        .WillRepeatedly(Return(dirFd));
+    EXPECT_CALL(*lfs_, Fstat(dirFd, NotNull()))
+        .WillRepeatedly(DoAll(SetArgPointee<1>(dirInfo), Return(0)));
+    EXPECT_CALL(*lfs_, Close(dirFd))
+        .Times(AnyNumber());
+    // 三个datastore各关闭一次，最后检查时加载失败关闭一次
+    EXPECT_CALL(*lfs_, Close(manifestFd))
+        .Times(4);
+
+    // case1
+    EXPECT_CALL(*lfs_, FileExists(manifestPath))
+        .WillOnce(Return(false));
+    EXPECT_TRUE(dataStore->Initialize());
+    ASSERT_EQ(CSErrorCode::Success, dataStore->SealManifest());
+    ASSERT_FALSE(manifest.empty());
+
+    // case2
+    EXPECT_CALL(*lfs_, Close(1))
+        .Times(3);
+    EXPECT_CALL(*lfs_, Close(2))
+        .Times(3);
+    EXPECT_CALL(*lfs_, Close(3))
+        .Times(2);
+    options.fdCache = std::make_shared<ChunkFdCache>(10);
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+    EXPECT_CALL(*lfs_, FileExists(manifestPath))
+        .WillRepeatedly(Return(true));
+    EXPECT_CALL(*lfs_, List(_, _))
+        .Times(0);
+    EXPECT_CALL(*lfs_, Open(chunk2Path, _))
+        .Times(0);
+    EXPECT_CALL(*lfs_, Open(chunk1Path, _))
+        .Times(1)
+        .WillOnce(Return(1));
+    EXPECT_CALL(*lfs_, Open(chunk1snap1Path, _))
+        .Times(1)
+        .WillOnce(Return(2));
+    EXPECT_TRUE(dataStore->Initialize());
+
+    // chunk2的元数据来自manifest，不需要打开文件
+    CSChunkInfo info;
+    ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(2, &info));
+    ASSERT_EQ(2, info.curSn);
+    ASSERT_EQ(0, info.snapSn);
+    // chunk1存在快照，首次访问时加载chunk和快照
+    ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(1, &info));
+    ASSERT_EQ(2, info.curSn);
+    ASSERT_EQ(1, info.snapSn);
+    ASSERT_EQ(CSErrorCode::Success, dataStore->SealManifest());
+
+    // case3
+    options.fdCache = nullptr;
+    dataStore = std::make_shared<CSDataStore>(lfs_, fpool_, options);
+    EXPECT_CALL(*lfs_, Open(chunk2Path, _))
+        .Times(1)
+        .WillOnce(Return(3));
+    EXPECT_CALL(*lfs_, Read(3, NotNull(), 0, PAGE_SIZE))
+        .Times(0);
+    EXPECT_CALL(*lfs_, Fstat(3, NotNull()))
+        .Times(0);
+    EXPECT_CALL(*lfs_, Open(chunk1Path, _))
+        .Times(1)
+        .WillOnce(Return(1));
+    EXPECT_CALL(*lfs_, Open(chunk1snap1Path, _))
+        .Times(1)
+        .WillOnce(Return(2));
+    EXPECT_TRUE(dataStore->Initialize());
+    ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(2, &info));
+    ASSERT_EQ(2, info.curSn);
+    ASSERT_EQ(0, info.snapSn);
+    ASSERT_EQ(CSErrorCode::Success, dataStore->GetChunkInfo(1, &info));
+    ASSERT_EQ(2, info.curSn);
+    ASSERT_EQ(1, info.snapSn);
+
+    // 加载后manifest已经解封，异常退出后不能再使用
+    std::shared_ptr<ChunkManifest> reader =
+        std::make_shared<ChunkManifest>(lfs_, manifestPath);
+    std::vector<ChunkManifestEntry> entries;
+    DirStamp stamp;
+    ASSERT_EQ(0, ChunkManifest::GetDirStamp(lfs_, baseDir, &stamp));
+    ASSERT_EQ(-1, reader->Load(stamp, &entries));
+}
+
 }  // namespace chunkserver
 }  // namespace curve
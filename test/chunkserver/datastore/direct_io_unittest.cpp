@@ -0,0 +1,264 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "src/chunkserver/datastore/direct_io.h"
+#include "test/fs/mock_local_filesystem.h"
+
+using curve::fs::MockLocalFileSystem;
+using curve::common::AlignedBuffer;
+using curve::common::AlignedBufferPool;
+using curve::common::kDirectIOAlignment;
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+namespace curve {
+namespace chunkserver {
+
+const size_t kBlock = kDirectIOAlignment;
+
+static bool IsAlignedIO(const void* buf, uint64_t offset, int length) {
+    return DirectIOHelper::IsAligned(buf, offset, length);
+}
+
+/**
+ * 用内存模拟以O_DIRECT方式打开的文件，
+ * 所有下发到文件系统的请求都必须是对齐的
+ */
+class DirectIOHelperTest : public testing::Test {
+ public:
+    void SetUp() {
+        lfs_ = std::make_shared<MockLocalFileSystem>();
+        file_.resize(4 * kBlock);
+        for (size_t i = 0; i < file_.size(); ++i) {
+            file_[i] = 'a' + i % 26;
+        }
+        ON_CALL(*lfs_, Read(_, _, _, _))
+            .WillByDefault(Invoke([this](int fd, char* buf,
+                                         uint64_t offset, int length) {
+                EXPECT_TRUE(IsAlignedIO(buf, offset, length));
+                if (offset >= file_.size()) {
+                    return 0;
+                }
+                size_t len = std::min<size_t>(length, file_.size() - offset);
+                memcpy(buf, file_.data() + offset, len);
+                return static_cast<int>(len);
+            }));
+        ON_CALL(*lfs_, Write(_, _, _, _))
+            .WillByDefault(Invoke([this](int fd, const char* buf,
+                                         uint64_t offset, int length) {
+                EXPECT_TRUE(IsAlignedIO(buf, offset, length));
+                if (offset + length > file_.size()) {
+                    file_.resize(offset + length);
+                }
+                memcpy(file_.data() + offset, buf, length);
+                return length;
+            }));
+        ON_CALL(*lfs_, Writev(_, _, _, _))
+            .WillByDefault(Invoke([this](int fd, const struct iovec* iov,
+                                         int iovcnt, uint64_t offset) {
+                int total = 0;
+                for (int i = 0; i < iovcnt; ++i) {
+                    EXPECT_TRUE(IsAlignedIO(iov[i].iov_base, offset,
+                                            iov[i].iov_len));
+                    memcpy(file_.data() + offset, iov[i].iov_base,
+                           iov[i].iov_len);
+                    offset += iov[i].iov_len;
+                    total += iov[i].iov_len;
+                }
+                return total;
+            }));
+    }
+
+ protected:
+    std::shared_ptr<MockLocalFileSystem> lfs_;
+    std::vector<char> file_;
+};
+
+TEST_F(DirectIOHelperTest, ReadTest) {
+    // case1:对齐的请求直接读到用户内存
+    {
+        AlignedBuffer buf = AlignedBufferPool::Get(kBlock);
+        EXPECT_CALL(*lfs_, Read(1, buf.Data(), kBlock, kBlock))
+            .Times(1);
+        ASSERT_EQ(kBlock, DirectIOHelper::Read(lfs_.get(), 1, buf.Data(),
+                                               kBlock, kBlock));
+        ASSERT_EQ(0, memcmp(buf.Data(), file_.data() + kBlock, kBlock));
+    }
+    // case2:内存地址、偏移和长度都不对齐
+    {
+        std::vector<char> buf(kBlock + 1);
+        EXPECT_CALL(*lfs_, Read(1, _, 0, 2 * kBlock))
+            .Times(1);
+        ASSERT_EQ(kBlock, DirectIOHelper::Read(lfs_.get(), 1, buf.data() + 1,
+                                               100, kBlock));
+        ASSERT_EQ(0, memcmp(buf.data() + 1, file_.data() + 100, kBlock));
+    }
+    // case3:读超过文件末尾，返回实际读到的长度
+    {
+        std::vector<char> buf(2 * kBlock);
+        EXPECT_CALL(*lfs_, Read(1, _, 3 * kBlock, 3 * kBlock))
+            .Times(1);
+        ASSERT_EQ(kBlock - 100,
+                  DirectIOHelper::Read(lfs_.get(), 1, buf.data(),
+                                       3 * kBlock + 100, 2 * kBlock));
+    }
+    // case4:读失败
+    {
+        char buf[512];
+        EXPECT_CALL(*lfs_, Read(1, _, 0, kBlock))
+            .WillOnce(Return(-EIO));
+        ASSERT_EQ(-EIO, DirectIOHelper::Read(lfs_.get(), 1, buf, 0, 512));
+    }
+}
+
+TEST_F(DirectIOHelperTest, WriteTest) {
+    std::vector<char> expect = file_;
+    // case1:对齐的请求直接写入
+    {
+        AlignedBuffer buf = AlignedBufferPool::Get(kBlock);
+        memset(buf.Data(), 'x', kBlock);
+        EXPECT_CALL(*lfs_, Read(_, _, _, _))
+            .Times(0);
+        EXPECT_CALL(*lfs_, Write(1, buf.Data(), 0, kBlock))
+            .Times(1);
+        ASSERT_EQ(kBlock, DirectIOHelper::Write(lfs_.get(), 1, buf.Data(),
+                                                0, kBlock));
+        memset(expect.data(), 'x', kBlock);
+        ASSERT_EQ(expect, file_);
+    }
+    // case2:只有内存地址不对齐，拷贝后写入，不需要读
+    {
+        std::vector<char> buf(kBlock + 1, 'y');
+        EXPECT_CALL(*lfs_, Read(_, _, _, _))
+            .Times(0);
+        EXPECT_CALL(*lfs_, Write(1, _, kBlock, kBlock))
+            .Times(1);
+        ASSERT_EQ(kBlock, DirectIOHelper::Write(lfs_.get(), 1,
+                                                buf.data() + 1,
+                                                kBlock, kBlock));
+        memset(expect.data() + kBlock, 'y', kBlock);
+        ASSERT_EQ(expect, file_);
+    }
+    // case3:偏移和长度都不对齐，首尾两个块需要读出后合并写回
+    {
+        std::vector<char> buf(kBlock, 'z');
+        EXPECT_CALL(*lfs_, Read(1, _, kBlock, kBlock))
+            .Times(1);
+        EXPECT_CALL(*lfs_, Read(1, _, 2 * kBlock, kBlock))
+            .Times(1);
+        EXPECT_CALL(*lfs_, Write(1, _, kBlock, 2 * kBlock))
+            .Times(1);
+        ASSERT_EQ(kBlock, DirectIOHelper::Write(lfs_.get(), 1, buf.data(),
+                                                kBlock + 100, kBlock));
+        memset(expect.data() + kBlock + 100, 'z', kBlock);
+        ASSERT_EQ(expect, file_);
+    }
+    // case4:首尾在同一个块内，只读一次
+    {
+        char buf[512];
+        memset(buf, 'w', sizeof(buf));
+        EXPECT_CALL(*lfs_, Read(1, _, 3 * kBlock, kBlock))
+            .Times(1);
+        EXPECT_CALL(*lfs_, Write(1, _, 3 * kBlock, kBlock))
+            .Times(1);
+        ASSERT_EQ(512, DirectIOHelper::Write(lfs_.get(), 1, buf,
+                                             3 * kBlock + 512, 512));
+        memset(expect.data() + 3 * kBlock + 512, 'w', 512);
+        ASSERT_EQ(expect, file_);
+    }
+    // case5:读首部的块失败，不会写入
+    {
+        char buf[512];
+        EXPECT_CALL(*lfs_, Read(1, _, 0, kBlock))
+            .WillOnce(Return(-EIO));
+        EXPECT_CALL(*lfs_, Write(_, _, _, _))
+            .Times(0);
+        ASSERT_EQ(-EIO, DirectIOHelper::Write(lfs_.get(), 1, buf, 512, 512));
+    }
+    // case6:写失败
+    {
+        AlignedBuffer buf = AlignedBufferPool::Get(kBlock);
+        EXPECT_CALL(*lfs_, Write(1, buf.Data(), 0, kBlock))
+            .WillOnce(Return(-EIO));
+        ASSERT_EQ(-EIO, DirectIOHelper::Write(lfs_.get(), 1, buf.Data(),
+                                              0, kBlock));
+    }
+}
+
+TEST_F(DirectIOHelperTest, WriteIOBufTest) {
+    std::vector<char> expect = file_;
+    // case1:IOBuf中的数据不对齐，拷贝到对齐的内存后写入
+    {
+        butil::IOBuf buf;
+        std::string data(2 * kBlock, 'm');
+        buf.append(data);
+        EXPECT_CALL(*lfs_, Writev(_, _, _, _))
+            .Times(0);
+        EXPECT_CALL(*lfs_, Write(1, _, 0, 2 * kBlock))
+            .Times(1);
+        ASSERT_EQ(2 * kBlock, DirectIOHelper::Write(lfs_.get(), 1, buf,
+                                                    0, 2 * kBlock));
+        memset(expect.data(), 'm', 2 * kBlock);
+        ASSERT_EQ(expect, file_);
+    }
+    // case2:IOBuf中只取前length字节，偏移不对齐
+    {
+        butil::IOBuf buf;
+        std::string data(kBlock, 'n');
+        buf.append(data);
+        EXPECT_CALL(*lfs_, Read(1, _, 2 * kBlock, kBlock))
+            .Times(1);
+        EXPECT_CALL(*lfs_, Write(1, _, 2 * kBlock, kBlock))
+            .Times(1);
+        ASSERT_EQ(100, DirectIOHelper::Write(lfs_.get(), 1, buf,
+                                             2 * kBlock + 10, 100));
+        memset(expect.data() + 2 * kBlock + 10, 'n', 100);
+        ASSERT_EQ(expect, file_);
+    }
+    // case3:IOBuf的block都对齐时直接以Writev写入
+    {
+        AlignedBuffer block = AlignedBufferPool::Get(kBlock);
+        memset(block.Data(), 'o', kBlock);
+        butil::IOBuf buf;
+        buf.append_user_data(block.Data(), kBlock, [](void*) {});
+        EXPECT_CALL(*lfs_, Write(_, _, _, _))
+            .Times(0);
+        EXPECT_CALL(*lfs_, Writev(1, _, 1, 3 * kBlock))
+            .Times(1);
+        ASSERT_EQ(kBlock, DirectIOHelper::Write(lfs_.get(), 1, buf,
+                                                3 * kBlock, kBlock));
+        memset(expect.data() + 3 * kBlock, 'o', kBlock);
+        ASSERT_EQ(expect, file_);
+    }
+}
+
+}  // namespace chunkserver
+}  // namespace curve
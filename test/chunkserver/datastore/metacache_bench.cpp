@@ -0,0 +1,158 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+/**
+ * CSMetaCache多线程查找性能测试
+ * 对比单把读写锁保护的map和分片后的CSMetaCache在不同线程数下的吞吐
+ * 用法: metacache-bench --thread_nums=1,8,32,64 --chunk_num=100000
+ */
+
+#include <gflags/gflags.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "src/chunkserver/datastore/chunkserver_datastore.h"
+#include "src/common/string_util.h"
+#include "src/fs/local_filesystem.h"
+
+DEFINE_string(thread_nums, "1,4,8,16,32,64", "Thread numbers to test");
+DEFINE_uint64(chunk_num, 100000, "Chunk number in metacache");
+DEFINE_uint64(ops_per_thread, 1000000, "Operations performed by each thread");
+DEFINE_int32(write_percentage, 1, "Percentage of Set/Remove operations");
+
+using curve::chunkserver::ChunkID;
+using curve::chunkserver::ChunkMap;
+using curve::chunkserver::ChunkOptions;
+using curve::chunkserver::CSChunkFile;
+using curve::chunkserver::CSChunkFilePtr;
+using curve::chunkserver::CSMetaCache;
+using curve::common::RWLock;
+using curve::common::ReadLockGuard;
+using curve::common::WriteLockGuard;
+using curve::fs::FileSystemType;
+using curve::fs::LocalFileSystem;
+using curve::fs::LocalFsFactory;
+
+// 分片之前的实现，所有chunk共用一把读写锁
+class LegacyMetaCache {
+ public:
+    CSChunkFilePtr Get(ChunkID id) {
+        ReadLockGuard readGuard(rwLock_);
+        auto iter = chunkMap_.find(id);
+        if (iter == chunkMap_.end()) {
+            return nullptr;
+        }
+        return iter->second;
+    }
+
+    CSChunkFilePtr Set(ChunkID id, CSChunkFilePtr chunkFile) {
+        WriteLockGuard writeGuard(rwLock_);
+        return chunkMap_.emplace(id, chunkFile).first->second;
+    }
+
+    void Remove(ChunkID id) {
+        WriteLockGuard writeGuard(rwLock_);
+        chunkMap_.erase(id);
+    }
+
+ private:
+    RWLock      rwLock_;
+    ChunkMap    chunkMap_;
+};
+
+template <typename Cache>
+double RunBench(Cache* cache,
+                const std::vector<CSChunkFilePtr>& chunks,
+                int threadNum) {
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadNum; ++i) {
+        threads.emplace_back([&, i] {
+            // 各线程使用独立的伪随机序列，避免引入额外的同步
+            uint64_t seed = 0x12345678ULL + i;
+            while (!start.load(std::memory_order_acquire)) {}
+            for (uint64_t n = 0; n < FLAGS_ops_per_thread; ++n) {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                uint64_t idx = (seed >> 33) % chunks.size();
+                ChunkID id = idx + 1;
+                if (static_cast<int>((seed >> 20) % 100)
+                    < FLAGS_write_percentage) {
+                    cache->Remove(id);
+                    cache->Set(id, chunks[idx]);
+                } else {
+                    cache->Get(id);
+                }
+            }
+        });
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - begin).count();
+    return threadNum * FLAGS_ops_per_thread / seconds / 1000000;
+}
+
+int main(int argc, char* argv[]) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    std::shared_ptr<LocalFileSystem> lfs =
+        LocalFsFactory::CreateFs(FileSystemType::EXT4, "");
+    std::vector<CSChunkFilePtr> chunks;
+    chunks.reserve(FLAGS_chunk_num);
+    LegacyMetaCache legacy;
+    CSMetaCache sharded;
+    for (uint64_t i = 0; i < FLAGS_chunk_num; ++i) {
+        ChunkOptions options;
+        options.id = i + 1;
+        options.baseDir = "./metacachebench";
+        options.chunkSize = 16 * 1024 * 1024;
+        options.pageSize = 4096;
+        chunks.push_back(std::make_shared<CSChunkFile>(lfs, nullptr, options));
+        legacy.Set(options.id, chunks.back());
+        sharded.Set(options.id, chunks.back());
+    }
+
+    std::vector<std::string> threadNums;
+    curve::common::SplitString(FLAGS_thread_nums, ",", &threadNums);
+    printf("%-10s %-16s %-16s %-8s\n",
+           "threads", "legacy(Mops/s)", "sharded(Mops/s)", "speedup");
+    for (const auto& str : threadNums) {
+        int threadNum = std::stoi(str);
+        if (threadNum <= 0) {
+            continue;
+        }
+        double legacyOps = RunBench(&legacy, chunks, threadNum);
+        double shardedOps = RunBench(&sharded, chunks, threadNum);
+        printf("%-10d %-16.2f %-16.2f %-8.2f\n",
+               threadNum, legacyOps, shardedOps, shardedOps / legacyOps);
+    }
+    return 0;
+}
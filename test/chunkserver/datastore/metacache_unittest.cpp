@@ -0,0 +1,137 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>  // NOLINT
+#include <unordered_set>
+#include <vector>
+
+#include "src/chunkserver/datastore/chunkserver_datastore.h"
+#include "test/fs/mock_local_filesystem.h"
+
+using curve::fs::MockLocalFileSystem;
+
+namespace curve {
+namespace chunkserver {
+
+class CSMetaCacheTest : public testing::Test {
+ public:
+    void SetUp() {
+        lfs_ = std::make_shared<MockLocalFileSystem>();
+    }
+
+    CSChunkFilePtr NewChunk(ChunkID id) {
+        ChunkOptions options;
+        options.id = id;
+        options.baseDir = "./metacachetest";
+        options.chunkSize = 16 * 4096;
+        options.pageSize = 4096;
+        return std::make_shared<CSChunkFile>(lfs_, nullptr, options);
+    }
+
+ protected:
+    std::shared_ptr<MockLocalFileSystem> lfs_;
+};
+
+TEST_F(CSMetaCacheTest, BasicTest) {
+    CSMetaCache cache;
+    ASSERT_EQ(nullptr, cache.Get(1));
+    ASSERT_EQ(0, cache.Size());
+
+    // Set不存在的chunk，返回Set进去的chunk
+    CSChunkFilePtr chunk1 = NewChunk(1);
+    ASSERT_EQ(chunk1, cache.Set(1, chunk1));
+    ASSERT_EQ(chunk1, cache.Get(1));
+
+    // 重复Set同一个chunk，返回先Set的chunk
+    CSChunkFilePtr chunk1New = NewChunk(1);
+    ASSERT_EQ(chunk1, cache.Set(1, chunk1New));
+    ASSERT_EQ(chunk1, cache.Get(1));
+
+    CSChunkFilePtr chunk2 = NewChunk(2);
+    ASSERT_EQ(chunk2, cache.Set(2, chunk2));
+    ASSERT_EQ(2, cache.Size());
+
+    // Remove不存在的chunk不影响其他chunk
+    cache.Remove(3);
+    ASSERT_EQ(2, cache.Size());
+    cache.Remove(1);
+    ASSERT_EQ(nullptr, cache.Get(1));
+    ASSERT_EQ(chunk2, cache.Get(2));
+    ASSERT_EQ(1, cache.Size());
+
+    cache.Clear();
+    ASSERT_EQ(nullptr, cache.Get(2));
+    ASSERT_EQ(0, cache.Size());
+}
+
+TEST_F(CSMetaCacheTest, ForEachTest) {
+    CSMetaCache cache;
+    const ChunkID kChunkNum = 1000;
+    for (ChunkID id = 1; id <= kChunkNum; ++id) {
+        cache.Set(id, NewChunk(id));
+    }
+    ASSERT_EQ(kChunkNum, cache.Size());
+
+    // 每个chunk都被遍历且只遍历一次
+    std::unordered_set<ChunkID> ids;
+    cache.ForEach([&](ChunkID id, const CSChunkFilePtr& chunk) {
+        ASSERT_EQ(chunk, cache.Get(id));
+        ASSERT_TRUE(ids.insert(id).second);
+    });
+    ASSERT_EQ(kChunkNum, ids.size());
+}
+
+TEST_F(CSMetaCacheTest, ConcurrentTest) {
+    CSMetaCache cache;
+    const int kThreadNum = 8;
+    const ChunkID kChunkPerThread = 500;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreadNum; ++i) {
+        threads.emplace_back([&, i] {
+            ChunkID begin = i * kChunkPerThread;
+            for (ChunkID id = begin; id < begin + kChunkPerThread; ++id) {
+                CSChunkFilePtr chunk = NewChunk(id);
+                ASSERT_EQ(chunk, cache.Set(id, chunk));
+                ASSERT_EQ(chunk, cache.Get(id));
+                // 其他线程并发访问同一批chunk
+                cache.Get((id + kChunkPerThread) %
+                          (kThreadNum * kChunkPerThread));
+            }
+            for (ChunkID id = begin; id < begin + kChunkPerThread; id += 2) {
+                cache.Remove(id);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(kThreadNum * kChunkPerThread / 2, cache.Size());
+    for (ChunkID id = 0; id < kThreadNum * kChunkPerThread; ++id) {
+        ASSERT_EQ(id % 2 == 0, nullptr == cache.Get(id));
+    }
+}
+
+}  // namespace chunkserver
+}  // namespace curve
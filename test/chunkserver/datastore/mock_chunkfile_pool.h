@@ -42,6 +42,7 @@ class MockChunkfilePool : public ChunkfilePool {
     MOCK_METHOD1(RecycleChunk, int(const std::string&  chunkpath));
     MOCK_METHOD0(UnInitialize, void());
     MOCK_METHOD0(Size, size_t());
+    MOCK_METHOD0(SyncDirs, int());
 };
 
 }  // namespace chunkserver
@@ -44,6 +44,13 @@ class MockDataStore : public CSDataStore {
                                         char*,
                                         off_t,
                                         size_t));
+    MOCK_METHOD6(ReadChunkAsync, void(ChunkID,
+                                      SequenceNum,
+                                      char*,
+                                      off_t,
+                                      size_t,
+                                      CSIOCallback));
+    MOCK_METHOD0(SupportAsyncIO, bool());
     MOCK_METHOD5(ReadSnapshotChunk, CSErrorCode(ChunkID,
                                                 SequenceNum,
                                                 char*,
@@ -51,7 +58,7 @@ class MockDataStore : public CSDataStore {
                                                 size_t));
     MOCK_METHOD7(WriteChunk, CSErrorCode(ChunkID,
                                          SequenceNum,
-                                         const char*,
+                                         const butil::IOBuf&,
                                          off_t,
                                          size_t,
                                          uint32_t*,
@@ -62,11 +69,13 @@ class MockDataStore : public CSDataStore {
                                                ChunkSizeType,
                                                const string&));
     MOCK_METHOD4(PasteChunk, CSErrorCode(ChunkID,
-                                         const char*,
+                                         const butil::IOBuf&,
                                          off_t,
                                          size_t));
     MOCK_METHOD2(GetChunkInfo, CSErrorCode(ChunkID, CSChunkInfo*));
     MOCK_METHOD0(GetStatus, DataStoreStatus());
+    MOCK_METHOD0(SyncChunkFiles, CSErrorCode());
+    MOCK_METHOD0(SealManifest, CSErrorCode());
 };
 
 }  // namespace chunkserver
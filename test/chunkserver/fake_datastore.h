@@ -146,6 +146,24 @@ class FakeCSDataStore : public CSDataStore {
         return CSErrorCode::Success;
     }
 
+    CSErrorCode WriteChunk(ChunkID id,
+                           SequenceNum sn,
+                           const butil::IOBuf& buf,
+                           off_t offset,
+                           size_t length,
+                           uint32_t *cost,
+                           const std::string & csl = "") override {
+        CSErrorCode errorCode = HasInjectError();
+        if (errorCode != CSErrorCode::Success) {
+            return errorCode;
+        }
+        buf.copy_to(chunk_+offset, length);
+        *cost = length;
+        chunkIds_.insert(id);
+        sn_ = sn;
+        return CSErrorCode::Success;
+    }
+
     CSErrorCode CreateCloneChunk(ChunkID id,
                                  SequenceNum sn,
                                  SequenceNum correctedSn,
@@ -175,6 +193,21 @@ class FakeCSDataStore : public CSDataStore {
         return CSErrorCode::Success;
     }
 
+    CSErrorCode PasteChunk(ChunkID id,
+                           const butil::IOBuf& buf,
+                           off_t offset,
+                           size_t length) override {
+        CSErrorCode errorCode = HasInjectError();
+        if (errorCode != CSErrorCode::Success) {
+            return errorCode;
+        }
+        if (chunkIds_.find(id) == chunkIds_.end()) {
+            return CSErrorCode::ChunkNotExistError;
+        }
+        buf.copy_to(chunk_+offset, length);
+        return CSErrorCode::Success;
+    }
+
     CSErrorCode GetChunkInfo(ChunkID id,
                              CSChunkInfo* info) override {
         CSErrorCode errorCode = HasInjectError();
@@ -204,6 +237,10 @@ class FakeCSDataStore : public CSDataStore {
         }
     }
 
+    CSErrorCode SyncChunkFiles() override {
+        return HasInjectError();
+    }
+
     void InjectError(CSErrorCode errorCode = CSErrorCode::InternalError) {
         error_ = errorCode;
     }
@@ -32,6 +32,7 @@
 
 #include "src/common/configuration.h"
 #include "src/chunkserver/chunkserver_metrics.h"
+#include "src/chunkserver/concurrent_apply.h"
 #include "src/chunkserver/trash.h"
 #include "src/chunkserver/copyset_node_manager.h"
 #include "src/chunkserver/datastore/chunkfile_pool.h"
@@ -195,6 +196,12 @@ TEST_F(CSMetricTest, CopysetMetricTest) {
     copysetMetric = metric_->GetCopysetMetric(logicId, copysetId);
     ASSERT_NE(copysetMetric, nullptr);
 
+    // 记录打快照时apply阻塞的时间
+    copysetMetric->OnSnapshotFlush(100);
+    copysetMetric->OnSnapshotFlush(300);
+    ASSERT_EQ(2, copysetMetric->GetSnapshotFlushLatency().count());
+    ASSERT_EQ(300, copysetMetric->GetSnapshotFlushLatency().max_latency());
+
     // 删除copyset metric后，再去获取返回nullptr
     rc = metric_->RemoveCopysetMetric(logicId, copysetId);
     ASSERT_EQ(rc, 0);
@@ -570,6 +577,35 @@ TEST_F(CSMetricTest, ConfigTest) {
                  "{\"conf_name\":\"port\",\"conf_value\":\"9999\"}");
 }
 
+TEST_F(CSMetricTest, ConcurrentApplyTest) {
+    ConcurrentApplyModule concurrentApply;
+    ASSERT_TRUE(concurrentApply.Init(2, 1));
+    metric_->MonitorConcurrentApply(&concurrentApply);
+    for (int i = 0; i < 10; ++i) {
+        concurrentApply.Push(i, []() {});
+    }
+    concurrentApply.Flush();
+
+    std::string prefix = "chunkserver_127_0_0_1_9401_concurrentapply_worker_";
+    uint64_t taskCount = 0;
+    for (int i = 0; i < concurrentApply.WorkerCount(); ++i) {
+        std::string worker = prefix + std::to_string(i);
+        ASSERT_FALSE(bvar::Variable::describe_exposed(
+            worker + "_busy_us").empty());
+        ASSERT_FALSE(bvar::Variable::describe_exposed(
+            worker + "_busy_us_per_second").empty());
+        ASSERT_FALSE(bvar::Variable::describe_exposed(
+            worker + "_steal_count").empty());
+        std::string count = bvar::Variable::describe_exposed(
+            worker + "_task_count");
+        ASSERT_FALSE(count.empty());
+        taskCount += std::stoull(count);
+    }
+    // 包括Flush的屏障任务
+    ASSERT_LE(10, taskCount);
+    concurrentApply.Stop();
+}
+
 TEST_F(CSMetricTest, OnOffTest) {
     ASSERT_EQ(0, metric_->Fini());
     ChunkServerMetricOptions metricOptions;
@@ -27,6 +27,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "proto/chunk.pb.h"
 #include "src/chunkserver/copyset_node.h"
@@ -690,5 +691,83 @@ TEST(ChunkOpRequestTest, OnApplyFromLogTest) {
     }
 }
 
+TEST(ChunkOpRequestTest, MergeWriteTest) {
+    LogicPoolID logicPoolId = 1;
+    CopysetID copysetId = 10001;
+    uint64_t chunkId = 12345;
+    uint64_t sn = 1;
+
+    std::shared_ptr<LocalFileSystem> fs(LocalFsFactory::CreateFs(FileSystemType::EXT4, ""));    //NOLINT
+    DataStoreOptions options;
+    options.baseDir = "./test-temp";
+    options.chunkSize = 16 * 1024 * 1024;
+    options.pageSize = 4 * 1024;
+    std::shared_ptr<FakeCSDataStore> dataStore =
+        std::make_shared<FakeCSDataStore>(options, fs);
+
+    // 构造从日志apply的写请求任务
+    auto newTask = [&](ChunkID id, SequenceNum sn, off_t offset,
+                       size_t length, char c) {
+        ChunkRequest request;
+        request.set_optype(CHUNK_OP_TYPE::CHUNK_OP_WRITE);
+        request.set_logicpoolid(logicPoolId);
+        request.set_copysetid(copysetId);
+        request.set_chunkid(id);
+        request.set_sn(sn);
+        request.set_offset(offset);
+        request.set_size(length);
+        butil::IOBuf data;
+        data.append(std::string(length, c));
+        auto req = std::make_shared<WriteChunkRequest>();
+        return req->PrepareApplyFromLog(nullptr, 0, dataStore,
+                                        &request, &data);
+    };
+
+    // 地址连续或者重叠的写合并成一次写入，后面的写覆盖重叠部分
+    {
+        ApplyTask* task = newTask(chunkId, sn, 0, 8, 'a');
+        ASSERT_TRUE(task->Merge(newTask(chunkId, sn, 8, 8, 'b')));
+        ASSERT_TRUE(task->Merge(newTask(chunkId, sn, 4, 8, 'c')));
+        // chunk不同、版本号不同、地址不连续的写以及其他请求不合并
+        std::vector<ApplyTask*> others = {
+            newTask(chunkId + 1, sn, 16, 8, 'd'),
+            newTask(chunkId, sn + 1, 16, 8, 'd'),
+            newTask(chunkId, sn, 17, 8, 'd'),
+        };
+        for (auto other : others) {
+            ASSERT_FALSE(task->Merge(other));
+        }
+        ChunkRequest request;
+        request.set_optype(CHUNK_OP_TYPE::CHUNK_OP_DELETE);
+        request.set_chunkid(chunkId);
+        butil::IOBuf data;
+        auto deleteReq = std::make_shared<DeleteChunkRequest>();
+        ASSERT_FALSE(task->Merge(
+            deleteReq->PrepareApplyFromLog(nullptr, 0, dataStore,
+                                           &request, &data)));
+
+        task->Run();
+        char buf[16];
+        ASSERT_EQ(CSErrorCode::Success,
+                  dataStore->ReadChunk(chunkId, sn, buf, 0, 16));
+        ASSERT_EQ("aaaaccccccccbbbb", std::string(buf, 16));
+        for (auto other : others) {
+            other->Run();
+        }
+        deleteReq->Run();
+    }
+    // 合并后的写入失败时逐个重新写入
+    {
+        ApplyTask* task = newTask(chunkId, sn, 0, 8, 'e');
+        ASSERT_TRUE(task->Merge(newTask(chunkId, sn, 8, 8, 'f')));
+        dataStore->InjectError(CSErrorCode::InvalidArgError);
+        task->Run();
+        char buf[16];
+        ASSERT_EQ(CSErrorCode::Success,
+                  dataStore->ReadChunk(chunkId, sn, buf, 0, 16));
+        ASSERT_EQ("eeeeeeeeffffffff", std::string(buf, 16));
+    }
+}
+
 }  // namespace chunkserver
 }  // namespace curve
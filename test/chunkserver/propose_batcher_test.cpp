@@ -0,0 +1,215 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-26
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+#include <butil/sys_byteorder.h>
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "src/chunkserver/propose_batcher.h"
+#include "src/chunkserver/chunk_closure.h"
+#include "src/chunkserver/op_request.h"
+
+namespace curve {
+namespace chunkserver {
+
+// 记录propose给raft的日志，并释放closure
+class FakeRaft {
+ public:
+    void Propose(const braft::Task& task) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        logs_.push_back(task.data->to_string());
+        terms_.push_back(task.expected_term);
+        BatchChunkClosure* batchClosure =
+            dynamic_cast<BatchChunkClosure*>(task.done);
+        if (nullptr != batchClosure) {
+            std::vector<ChunkClosure*> closures =
+                batchClosure->ReleaseClosures();
+            counts_.push_back(closures.size());
+            for (ChunkClosure* closure : closures) {
+                delete closure;
+            }
+            delete batchClosure;
+        } else {
+            ASSERT_TRUE(nullptr != dynamic_cast<ChunkClosure*>(task.done));
+            counts_.push_back(1);
+            delete task.done;
+        }
+    }
+
+    std::mutex mtx_;
+    std::vector<std::string> logs_;
+    std::vector<int64_t> terms_;
+    std::vector<size_t> counts_;
+};
+
+static butil::IOBuf MakeLog(const std::string& content) {
+    butil::IOBuf log;
+    // 与ChunkOpRequest::Encode相同，第一个字段是request的长度
+    uint32_t len = butil::HostToNet32(content.size());
+    log.append(&len, sizeof(len));
+    log.append(content);
+    return log;
+}
+
+TEST(ProposeBatcherTest, EncodeDecodeTest) {
+    std::vector<butil::IOBuf> entries;
+    entries.push_back(MakeLog("first"));
+    entries.push_back(MakeLog(""));
+    entries.push_back(MakeLog(std::string(4096, 'a')));
+    ASSERT_FALSE(ProposeBatcher::IsBatchLog(entries[0]));
+
+    butil::IOBuf log;
+    ProposeBatcher::EncodeBatchLog(entries, &log);
+    ASSERT_TRUE(ProposeBatcher::IsBatchLog(log));
+
+    std::vector<butil::IOBuf> decoded;
+    ASSERT_EQ(0, ProposeBatcher::DecodeBatchLog(log, &decoded));
+    ASSERT_EQ(entries.size(), decoded.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        ASSERT_EQ(entries[i].to_string(), decoded[i].to_string());
+    }
+
+    // 普通日志
+    ASSERT_EQ(-1, ProposeBatcher::DecodeBatchLog(entries[0], &decoded));
+    // 日志被截断
+    butil::IOBuf truncated;
+    log.append_to(&truncated, log.size() - 1);
+    ASSERT_EQ(-1, ProposeBatcher::DecodeBatchLog(truncated, &decoded));
+    // 日志尾部有多余的数据
+    butil::IOBuf tailed = log;
+    tailed.append("x", 1);
+    ASSERT_EQ(-1, ProposeBatcher::DecodeBatchLog(tailed, &decoded));
+}
+
+TEST(ProposeBatcherTest, BatchTest) {
+    FakeRaft raft;
+    auto propose = [&raft](const braft::Task& task) { raft.Propose(task); };
+
+    // 窗口内只有一个请求，与不合并时的日志相同
+    {
+        ProposeBatcherOptions options;
+        options.windowUs = 1000;
+        ProposeBatcher batcher(options, propose);
+        butil::IOBuf log = MakeLog("single");
+        std::string expect = log.to_string();
+        batcher.Propose(std::make_shared<WriteChunkRequest>(), &log, 1);
+        ASSERT_EQ(1, raft.logs_.size());
+        ASSERT_EQ(expect, raft.logs_[0]);
+        ASSERT_EQ(1, raft.terms_[0]);
+        ASSERT_EQ(1, raft.counts_[0]);
+    }
+
+    // 请求数达到上限时立即propose，不需要等到窗口结束
+    {
+        raft.logs_.clear();
+        raft.terms_.clear();
+        raft.counts_.clear();
+        ProposeBatcherOptions options;
+        options.windowUs = 60 * 1000 * 1000;
+        options.maxCount = 4;
+        ProposeBatcher batcher(options, propose);
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i < options.maxCount; ++i) {
+            threads.emplace_back([&batcher, i]() {
+                butil::IOBuf log = MakeLog(std::to_string(i));
+                batcher.Propose(
+                    std::make_shared<WriteChunkRequest>(), &log, 2);
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        ASSERT_EQ(1, raft.logs_.size());
+        ASSERT_EQ(2, raft.terms_[0]);
+        ASSERT_EQ(options.maxCount, raft.counts_[0]);
+        butil::IOBuf log;
+        log.append(raft.logs_[0]);
+        std::vector<butil::IOBuf> entries;
+        ASSERT_EQ(0, ProposeBatcher::DecodeBatchLog(log, &entries));
+        ASSERT_EQ(options.maxCount, entries.size());
+    }
+
+    // 字节数达到上限时立即propose
+    {
+        raft.logs_.clear();
+        raft.terms_.clear();
+        raft.counts_.clear();
+        ProposeBatcherOptions options;
+        options.windowUs = 60 * 1000 * 1000;
+        options.maxBytes = 1024;
+        ProposeBatcher batcher(options, propose);
+        std::thread owner([&batcher]() {
+            butil::IOBuf log = MakeLog(std::string(512, 'a'));
+            batcher.Propose(std::make_shared<WriteChunkRequest>(), &log, 3);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        butil::IOBuf log = MakeLog(std::string(512, 'b'));
+        ASSERT_TRUE(batcher.Accept(log.size()));
+        batcher.Propose(std::make_shared<WriteChunkRequest>(), &log, 3);
+        owner.join();
+        ASSERT_EQ(1, raft.logs_.size());
+        ASSERT_EQ(2, raft.counts_[0]);
+    }
+
+    // term变化时之前的批次立即propose，不同term的请求不会合并
+    {
+        raft.logs_.clear();
+        raft.terms_.clear();
+        raft.counts_.clear();
+        ProposeBatcherOptions options;
+        options.windowUs = 60 * 1000 * 1000;
+        options.maxCount = 2;
+        ProposeBatcher batcher(options, propose);
+        std::thread owner([&batcher]() {
+            butil::IOBuf log = MakeLog("term4");
+            batcher.Propose(std::make_shared<WriteChunkRequest>(), &log, 4);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 2; ++i) {
+            threads.emplace_back([&batcher]() {
+                butil::IOBuf log = MakeLog("term5");
+                batcher.Propose(
+                    std::make_shared<WriteChunkRequest>(), &log, 5);
+            });
+        }
+        owner.join();
+        for (auto& t : threads) {
+            t.join();
+        }
+        // 两个批次由不同的线程propose，先后顺序不确定
+        ASSERT_EQ(2, raft.logs_.size());
+        int term4 = raft.terms_[0] == 4 ? 0 : 1;
+        ASSERT_EQ(4, raft.terms_[term4]);
+        ASSERT_EQ(1, raft.counts_[term4]);
+        ASSERT_EQ(5, raft.terms_[1 - term4]);
+        ASSERT_EQ(2, raft.counts_[1 - term4]);
+    }
+}
+
+}  // namespace chunkserver
+}  // namespace curve
@@ -0,0 +1,218 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-27
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "src/chunkserver/qos_scheduler.h"
+
+namespace curve {
+namespace chunkserver {
+
+TEST(QosSchedulerTest, TokenBucketTest) {
+    TokenBucket bucket;
+    // 不限制
+    ASSERT_TRUE(bucket.Ready());
+    bucket.Consume(100);
+    ASSERT_TRUE(bucket.Ready());
+    ASSERT_EQ(0, bucket.WaitUs());
+
+    // 开始限制时桶是满的
+    uint64_t now = 1000000;
+    bucket.SetRate(10, now);
+    ASSERT_EQ(10, bucket.Rate());
+    bucket.Consume(10);
+    ASSERT_FALSE(bucket.Ready());
+    // 令牌可以被扣成负数
+    bucket.Consume(10);
+    ASSERT_FALSE(bucket.Ready());
+    ASSERT_NEAR(1000000, bucket.WaitUs(), 10);
+    now += 500000;
+    bucket.Refill(now);
+    ASSERT_FALSE(bucket.Ready());
+    now += 600000;
+    bucket.Refill(now);
+    ASSERT_TRUE(bucket.Ready());
+    // 最多积累1秒的令牌
+    now += 10 * 1000000;
+    bucket.Refill(now);
+    bucket.Consume(10);
+    ASSERT_FALSE(bucket.Ready());
+}
+
+TEST(QosSchedulerTest, VolumeLimitTest) {
+    QosSchedulerOptions options;
+    options.volumeLimit.bps = 1024 * 1024;
+    QosScheduler scheduler(options);
+    ASSERT_EQ(0, scheduler.Init());
+
+    std::atomic<int> done(0);
+    QosRequest request;
+    request.volumeId = 1;
+    request.client = "127.0.0.1";
+    // 有令牌时大请求也直接在当前线程执行，令牌被扣成负数
+    request.bytes = 2 * 1024 * 1024;
+    scheduler.Submit(request, [&done]() { ++done; });
+    ASSERT_EQ(1, done.load());
+    // 令牌用完后排队，由后台线程在令牌恢复后下发
+    request.bytes = 4096;
+    for (int i = 0; i < 5; ++i) {
+        scheduler.Submit(request, [&done]() { ++done; });
+    }
+    ASSERT_EQ(1, done.load());
+
+    // 不携带卷信息的请求不受卷的限制，其他卷上有排队的请求时
+    // 不在当前线程直接执行，由后台线程按公平调度下发
+    QosRequest noVolume = request;
+    noVolume.volumeId = 0;
+    std::thread::id caller = std::this_thread::get_id();
+    std::atomic<bool> inplace(false);
+    scheduler.Submit(noVolume, [&done, &inplace, caller]() {
+        inplace = std::this_thread::get_id() == caller;
+        ++done;
+    });
+    for (int i = 0; i < 50 && done.load() < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(2, done.load());
+    ASSERT_FALSE(inplace.load());
+
+    // 单独放开卷的限制后排队的请求立即下发
+    scheduler.SetVolumeLimit(1, QosLimit(), 1);
+    for (int i = 0; i < 50 && done.load() < 7; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(7, done.load());
+    scheduler.Fini();
+}
+
+TEST(QosSchedulerTest, OverLoadTest) {
+    QosSchedulerOptions options;
+    options.volumeLimit.bps = 1024 * 1024;
+    options.maxVolumeQueueDepth = 2;
+    QosScheduler scheduler(options);
+    ASSERT_EQ(0, scheduler.Init());
+
+    std::atomic<int> done(0);
+    QosRequest request;
+    request.volumeId = 1;
+    request.bytes = 2 * 1024 * 1024;
+    ASSERT_FALSE(scheduler.IsOverLoad(1));
+    for (int i = 0; i < 3; ++i) {
+        scheduler.Submit(request, [&done]() { ++done; });
+    }
+    ASSERT_EQ(1, done.load());
+    ASSERT_TRUE(scheduler.IsOverLoad(1));
+    ASSERT_FALSE(scheduler.IsOverLoad(2));
+
+    // 停止后排队的请求直接下发
+    scheduler.Fini();
+    ASSERT_EQ(3, done.load());
+    // 停止后提交的请求直接执行
+    scheduler.Submit(request, [&done]() { ++done; });
+    ASSERT_EQ(4, done.load());
+}
+
+TEST(QosSchedulerTest, BlockingTaskTest) {
+    QosSchedulerOptions options;
+    options.volumeLimit.bps = 1024 * 1024;
+    QosScheduler scheduler(options);
+    ASSERT_EQ(0, scheduler.Init());
+
+    QosRequest request;
+    request.volumeId = 1;
+    request.bytes = 2 * 1024 * 1024;
+    scheduler.Submit(request, []() {});
+
+    // 排队的第一个请求阻塞时，不影响之后的请求下发
+    std::atomic<bool> secondDone(false);
+    std::atomic<bool> firstSawSecond(false);
+    request.bytes = 4096;
+    scheduler.Submit(request, [&secondDone, &firstSawSecond]() {
+        for (int i = 0; i < 200 && !secondDone.load(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        firstSawSecond = secondDone.load();
+    });
+    scheduler.Submit(request, [&secondDone]() { secondDone = true; });
+    scheduler.SetVolumeLimit(1, QosLimit(), 1);
+
+    // 停止时等待已经下发的请求执行完
+    for (int i = 0; i < 200 && !secondDone.load(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    scheduler.Fini();
+    ASSERT_TRUE(secondDone.load());
+    ASSERT_TRUE(firstSawSecond.load());
+}
+
+TEST(QosSchedulerTest, FairQueueTest) {
+    QosSchedulerOptions options;
+    options.diskLimit.iops = 200;
+    QosScheduler scheduler(options);
+    ASSERT_EQ(0, scheduler.Init());
+    scheduler.SetVolumeLimit(1, QosLimit(), 1);
+    scheduler.SetVolumeLimit(2, QosLimit(), 3);
+    // 补扣的IO使磁盘的令牌为负，之后的请求都需要排队
+    scheduler.Charge(1, 240);
+
+    std::mutex mtx;
+    std::vector<uint64_t> order;
+    const int kCount = 100;
+    for (int i = 0; i < kCount; ++i) {
+        for (uint64_t volumeId : {1, 2}) {
+            QosRequest request;
+            request.volumeId = volumeId;
+            scheduler.Submit(request, [&mtx, &order, volumeId]() {
+                std::lock_guard<std::mutex> lk(mtx);
+                order.push_back(volumeId);
+            });
+        }
+    }
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::lock_guard<std::mutex> lk(mtx);
+        if (order.size() >= 40) {
+            break;
+        }
+    }
+    scheduler.Fini();
+
+    // 磁盘成为瓶颈时，两个卷按照1:3的权重下发
+    int volume2 = 0;
+    for (int i = 0; i < 40; ++i) {
+        if (order[i] == 2) {
+            ++volume2;
+        }
+    }
+    ASSERT_GE(volume2, 27);
+    ASSERT_LE(volume2, 33);
+    ASSERT_EQ(2 * kCount, order.size());
+}
+
+}  // namespace chunkserver
+}  // namespace curve
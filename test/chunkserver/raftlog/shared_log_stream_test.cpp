@@ -0,0 +1,345 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <memory>
+#include <string>
+#include <thread>    // NOLINT
+#include <vector>
+
+#include "src/chunkserver/raftlog/shared_log_stream.h"
+#include "src/fs/local_filesystem.h"
+
+using curve::fs::LocalFsFactory;
+using curve::fs::FileSystemType;
+
+namespace curve {
+namespace chunkserver {
+
+const char kSharedLogTestDir[] = "./sharedlogtest";
+
+class SharedLogStreamTest : public testing::Test {
+ public:
+    void SetUp() {
+        ::system("rm -rf ./sharedlogtest");
+        lfs_ = LocalFsFactory::CreateFs(FileSystemType::EXT4, "");
+        options_.path = kSharedLogTestDir;
+        options_.fs = lfs_;
+    }
+
+    void TearDown() {
+        ::system("rm -rf ./sharedlogtest");
+    }
+
+    std::shared_ptr<SharedLogStream> Open() {
+        auto stream = std::make_shared<SharedLogStream>(options_);
+        EXPECT_EQ(0, stream->Init());
+        return stream;
+    }
+
+    std::string EntryData(uint64_t group, int64_t index) {
+        return std::to_string(group) + "-" + std::to_string(index);
+    }
+
+    // 追加[first, last]之间的日志
+    void AppendRange(SharedLogStream* stream, uint64_t group,
+                     int64_t first, int64_t last, int64_t term = 1) {
+        std::vector<SharedLogEntry> entries(last - first + 1);
+        std::vector<SharedLogEntry*> ptrs;
+        for (int64_t i = first; i <= last; ++i) {
+            SharedLogEntry* entry = &entries[i - first];
+            entry->index = i;
+            entry->term = term;
+            entry->type = 1;
+            entry->data.append(EntryData(group, i));
+            ptrs.push_back(entry);
+        }
+        ASSERT_EQ(ptrs.size(), stream->Append(group, ptrs));
+    }
+
+    void CheckEntry(SharedLogStream* stream, uint64_t group, int64_t index,
+                    int64_t term = 1) {
+        SharedLogEntry entry;
+        ASSERT_EQ(0, stream->Read(group, index, &entry));
+        ASSERT_EQ(index, entry.index);
+        ASSERT_EQ(term, entry.term);
+        ASSERT_EQ(1, entry.type);
+        ASSERT_EQ(EntryData(group, index), entry.data.to_string());
+    }
+
+ protected:
+    std::shared_ptr<LocalFileSystem> lfs_;
+    SharedLogStreamOptions options_;
+};
+
+TEST_F(SharedLogStreamTest, AppendAndReadTest) {
+    auto stream = Open();
+    ASSERT_EQ(1, stream->FirstLogIndex(1));
+    ASSERT_EQ(0, stream->LastLogIndex(1));
+
+    AppendRange(stream.get(), 1, 1, 10);
+    AppendRange(stream.get(), 2, 1, 5, 2);
+    AppendRange(stream.get(), 1, 11, 20);
+
+    ASSERT_EQ(1, stream->FirstLogIndex(1));
+    ASSERT_EQ(20, stream->LastLogIndex(1));
+    ASSERT_EQ(5, stream->LastLogIndex(2));
+    ASSERT_EQ(2, stream->GetTerm(2, 3));
+    ASSERT_EQ(0, stream->GetTerm(2, 6));
+    for (int64_t i = 1; i <= 20; ++i) {
+        CheckEntry(stream.get(), 1, i);
+    }
+    for (int64_t i = 1; i <= 5; ++i) {
+        CheckEntry(stream.get(), 2, i, 2);
+    }
+    SharedLogEntry entry;
+    ASSERT_EQ(-1, stream->Read(1, 21, &entry));
+    ASSERT_EQ(-1, stream->Read(3, 1, &entry));
+
+    std::vector<int64_t> indexes;
+    stream->ListEntries(2, 1, &indexes);
+    ASSERT_EQ(5, indexes.size());
+    indexes.clear();
+    stream->ListEntries(2, 2, &indexes);
+    ASSERT_TRUE(indexes.empty());
+
+    // 覆盖已有的日志
+    AppendRange(stream.get(), 2, 4, 6, 3);
+    ASSERT_EQ(6, stream->LastLogIndex(2));
+    CheckEntry(stream.get(), 2, 3, 2);
+    CheckEntry(stream.get(), 2, 4, 3);
+}
+
+TEST_F(SharedLogStreamTest, TruncateTest) {
+    auto stream = Open();
+    AppendRange(stream.get(), 1, 1, 10);
+    AppendRange(stream.get(), 2, 1, 10);
+
+    ASSERT_EQ(0, stream->TruncatePrefix(1, 4));
+    ASSERT_EQ(4, stream->FirstLogIndex(1));
+    ASSERT_EQ(10, stream->LastLogIndex(1));
+    SharedLogEntry entry;
+    ASSERT_EQ(-1, stream->Read(1, 3, &entry));
+    CheckEntry(stream.get(), 1, 4);
+
+    ASSERT_EQ(0, stream->TruncateSuffix(1, 8));
+    ASSERT_EQ(8, stream->LastLogIndex(1));
+    ASSERT_EQ(-1, stream->Read(1, 9, &entry));
+
+    ASSERT_EQ(0, stream->Reset(2, 100));
+    ASSERT_EQ(100, stream->FirstLogIndex(2));
+    ASSERT_EQ(99, stream->LastLogIndex(2));
+    AppendRange(stream.get(), 2, 100, 101);
+    CheckEntry(stream.get(), 2, 101);
+
+    // 截断前缀超过最后一条日志
+    ASSERT_EQ(0, stream->TruncatePrefix(1, 20));
+    ASSERT_EQ(20, stream->FirstLogIndex(1));
+    ASSERT_EQ(19, stream->LastLogIndex(1));
+
+    ASSERT_EQ(0, stream->DropGroup(2));
+    ASSERT_EQ(1, stream->FirstLogIndex(2));
+    ASSERT_EQ(0, stream->LastLogIndex(2));
+}
+
+TEST_F(SharedLogStreamTest, ReplayTest) {
+    {
+        auto stream = Open();
+        AppendRange(stream.get(), 1, 1, 10);
+        AppendRange(stream.get(), 2, 1, 10);
+        AppendRange(stream.get(), 3, 1, 10);
+        ASSERT_EQ(0, stream->TruncatePrefix(1, 5));
+        ASSERT_EQ(0, stream->TruncateSuffix(2, 6));
+        ASSERT_EQ(0, stream->Reset(3, 50));
+    }
+    {
+        auto stream = Open();
+        ASSERT_EQ(5, stream->FirstLogIndex(1));
+        ASSERT_EQ(10, stream->LastLogIndex(1));
+        ASSERT_EQ(1, stream->FirstLogIndex(2));
+        ASSERT_EQ(6, stream->LastLogIndex(2));
+        ASSERT_EQ(50, stream->FirstLogIndex(3));
+        ASSERT_EQ(49, stream->LastLogIndex(3));
+        for (int64_t i = 5; i <= 10; ++i) {
+            CheckEntry(stream.get(), 1, i);
+        }
+        for (int64_t i = 1; i <= 6; ++i) {
+            CheckEntry(stream.get(), 2, i);
+        }
+        AppendRange(stream.get(), 2, 7, 8);
+    }
+
+    // 模拟最后一条记录没有写完
+    std::vector<std::string> names;
+    ASSERT_EQ(0, lfs_->List(kSharedLogTestDir, &names));
+    ASSERT_EQ(1, names.size());
+    std::string path = std::string(kSharedLogTestDir) + "/" + names[0];
+    int fd = lfs_->Open(path, O_RDWR);
+    ASSERT_GE(fd, 0);
+    struct stat info;
+    ASSERT_EQ(0, lfs_->Fstat(fd, &info));
+    ASSERT_EQ(0, ::ftruncate(fd, info.st_size - 3));
+    lfs_->Close(fd);
+    {
+        auto stream = Open();
+        ASSERT_EQ(7, stream->LastLogIndex(2));
+        CheckEntry(stream.get(), 2, 7);
+        // 不完整的记录在启动时被截断，记录头40字节，数据为"2-8"
+        struct stat truncated;
+        ASSERT_EQ(0, ::stat(path.c_str(), &truncated));
+        ASSERT_EQ(info.st_size - 43, truncated.st_size);
+        AppendRange(stream.get(), 2, 8, 9);
+    }
+    {
+        auto stream = Open();
+        ASSERT_EQ(9, stream->LastLogIndex(2));
+        CheckEntry(stream.get(), 2, 8);
+        CheckEntry(stream.get(), 2, 9);
+    }
+}
+
+TEST_F(SharedLogStreamTest, GarbageCollectTest) {
+    options_.maxSegmentSize = 4096;
+    std::string data(1000, 'a');
+    {
+        auto stream = Open();
+        for (int64_t i = 1; i <= 40; ++i) {
+            for (uint64_t group = 1; group <= 2; ++group) {
+                SharedLogEntry entry;
+                entry.index = i;
+                entry.term = 1;
+                entry.data.append(data);
+                ASSERT_EQ(1, stream->Append(group, {&entry}));
+            }
+        }
+        size_t count = stream->SegmentCount();
+        ASSERT_GT(count, 10);
+
+        // 只有一个复制组删除了日志，segment不能回收
+        ASSERT_EQ(0, stream->TruncatePrefix(1, 30));
+        ASSERT_EQ(count, stream->SegmentCount());
+
+        ASSERT_EQ(0, stream->TruncatePrefix(2, 30));
+        ASSERT_LT(stream->SegmentCount(), count);
+        ASSERT_EQ(30, stream->FirstLogIndex(1));
+        SharedLogEntry entry;
+        ASSERT_EQ(0, stream->Read(2, 30, &entry));
+        ASSERT_EQ(data, entry.data.to_string());
+
+        // 删除所有日志后只剩下包含截断记录的segment
+        ASSERT_EQ(0, stream->Reset(1, 100));
+        ASSERT_EQ(0, stream->DropGroup(2));
+        ASSERT_LE(stream->SegmentCount(), 2);
+    }
+    {
+        auto stream = Open();
+        ASSERT_EQ(100, stream->FirstLogIndex(1));
+        ASSERT_EQ(99, stream->LastLogIndex(1));
+        ASSERT_EQ(0, stream->LastLogIndex(2));
+    }
+}
+
+TEST_F(SharedLogStreamTest, CompactTest) {
+    options_.maxSegmentSize = 4096;
+    std::string data(1000, 'a');
+    // 每次提交后最多搬迁一条日志时，整理分多次提交完成
+    for (uint64_t maxCompactBytes : {options_.maxCompactBytes, 1UL}) {
+        ::system("rm -rf ./sharedlogtest");
+        options_.maxCompactBytes = maxCompactBytes;
+        {
+            auto stream = Open();
+            // 复制组1只有少量日志，之后一直空闲，复制组3只剩下anchor
+            AppendRange(stream.get(), 1, 1, 3);
+            AppendRange(stream.get(), 3, 1, 3);
+            ASSERT_EQ(0, stream->TruncatePrefix(3, 4));
+            // 复制组2持续写入并删除旧的日志
+            for (int64_t i = 1; i <= 200; ++i) {
+                SharedLogEntry entry;
+                entry.index = i;
+                entry.term = 1;
+                entry.data.append(data);
+                ASSERT_EQ(1, stream->Append(2, {&entry}));
+                if (i % 10 == 0) {
+                    ASSERT_EQ(0, stream->TruncatePrefix(2, i - 5));
+                }
+                // 复制组1之后的日志在另一个segment中，前面的日志搬迁后
+                // 回放时会先读到之后的日志
+                if (i == 5) {
+                    AppendRange(stream.get(), 1, 4, 5);
+                }
+            }
+            // 空闲复制组的日志被搬迁，不会使之后的segment都无法回收
+            ASSERT_LE(stream->SegmentCount(), 10);
+            for (int64_t i = 1; i <= 5; ++i) {
+                CheckEntry(stream.get(), 1, i);
+            }
+            ASSERT_EQ(4, stream->FirstLogIndex(3));
+            ASSERT_EQ(195, stream->FirstLogIndex(2));
+        }
+        {
+            auto stream = Open();
+            ASSERT_EQ(1, stream->FirstLogIndex(1));
+            ASSERT_EQ(5, stream->LastLogIndex(1));
+            for (int64_t i = 1; i <= 5; ++i) {
+                CheckEntry(stream.get(), 1, i);
+            }
+            ASSERT_EQ(4, stream->FirstLogIndex(3));
+            ASSERT_EQ(3, stream->LastLogIndex(3));
+            ASSERT_EQ(195, stream->FirstLogIndex(2));
+            ASSERT_EQ(200, stream->LastLogIndex(2));
+            SharedLogEntry entry;
+            ASSERT_EQ(0, stream->Read(2, 200, &entry));
+            ASSERT_EQ(data, entry.data.to_string());
+            AppendRange(stream.get(), 1, 6, 7);
+            CheckEntry(stream.get(), 1, 7);
+        }
+    }
+}
+
+TEST_F(SharedLogStreamTest, GroupCommitTest) {
+    auto stream = Open();
+    const int kThreadNum = 16;
+    const int kEntryNum = 100;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreadNum; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int64_t i = 1; i <= kEntryNum; ++i) {
+                AppendRange(stream.get(), t + 1, i, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // 并发的追加请求被合并提交
+    ASSERT_LT(stream->SyncCount(), kThreadNum * kEntryNum);
+    for (int t = 0; t < kThreadNum; ++t) {
+        ASSERT_EQ(kEntryNum, stream->LastLogIndex(t + 1));
+        CheckEntry(stream.get(), t + 1, kEntryNum);
+    }
+}
+
+}  // namespace chunkserver
+}  // namespace curve
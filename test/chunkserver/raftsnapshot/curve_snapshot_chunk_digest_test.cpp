@@ -0,0 +1,320 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-24
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/chunkserver/raftsnapshot/curve_snapshot_chunk_digest.h"
+#include "src/chunkserver/datastore/chunkserver_chunkfile.h"
+#include "src/common/bitmap.h"
+
+namespace curve {
+namespace chunkserver {
+
+using curve::common::Bitmap;
+
+const uint32_t kPageSize = 4096;
+const uint32_t kPageCount = 16;
+const uint64_t kFileSize = kPageSize * (kPageCount + 1);
+const uint32_t kBlockSize = kPageSize * 2;
+const char kDigestTestFile[] = "./chunk_digest_test_file";
+const char kDigestLocalFile[] = "./chunk_digest_local_file";
+const char kDigestDestFile[] = "./chunk_digest_dest_file";
+
+class CurveSnapshotChunkDigestTest : public testing::Test {
+ protected:
+    void SetUp() {
+        ::unlink(kDigestTestFile);
+        ::unlink(kDigestLocalFile);
+        ::unlink(kDigestDestFile);
+    }
+    void TearDown() {
+        ::unlink(kDigestTestFile);
+        ::unlink(kDigestLocalFile);
+        ::unlink(kDigestDestFile);
+    }
+
+    // 生成metapage，bitmap为nullptr时表示所有page都已写过
+    std::string EncodeMetaPage(std::shared_ptr<Bitmap> bitmap) {
+        ChunkFileMetaPage metaPage;
+        metaPage.version = bitmap != nullptr ? FORMAT_VERSION_V2
+                                             : FORMAT_VERSION;
+        metaPage.sn = 3;
+        metaPage.correctedSn = 2;
+        metaPage.bitmap = bitmap;
+        std::string buf(kPageSize, 0);
+        metaPage.encode(&buf[0]);
+        return buf;
+    }
+
+    void WriteChunkFile(const std::string& metaPage,
+                        const char* path = kDigestTestFile) {
+        std::string content(kFileSize, 'a');
+        content.replace(0, metaPage.size(), metaPage);
+        for (uint64_t i = kPageSize; i < kFileSize; i += kPageSize) {
+            content[i] = 'a' + i / kPageSize;
+        }
+        int fd = ::open(path, O_CREAT | O_RDWR, 0644);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(kFileSize, ::pwrite(fd, content.data(), kFileSize, 0));
+        ::close(fd);
+    }
+};
+
+TEST_F(CurveSnapshotChunkDigestTest, FillMetaAndBlockWritten) {
+    // 没有bitmap时所有块都需要复制
+    {
+        ChunkDigest digest;
+        std::string metaPage = EncodeMetaPage(nullptr);
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::FillMeta(
+            metaPage.data(), kFileSize, &digest));
+        ASSERT_EQ(3, digest.sn());
+        ASSERT_EQ(2, digest.correctedsn());
+        ASSERT_EQ(kFileSize, digest.filesize());
+        ASSERT_FALSE(digest.has_bitmap());
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::PageSize(digest));
+        ASSERT_TRUE(CurveSnapshotChunkDigest::IsValidBlockSize(digest, 1000));
+        ASSERT_EQ(9, CurveSnapshotChunkDigest::BlockCount(digest, kBlockSize));
+        for (uint32_t i = 0; i < 9; ++i) {
+            ASSERT_TRUE(CurveSnapshotChunkDigest::IsBlockWritten(
+                digest, kBlockSize, i));
+        }
+    }
+    // 根据bitmap判断块是否被写过，第0个块包含metapage总是需要复制
+    {
+        std::shared_ptr<Bitmap> bitmap =
+            std::make_shared<Bitmap>(kPageCount);
+        // 文件中的第4个page，属于第2个块
+        bitmap->Set(3);
+        // 文件中的最后一个page，单独属于第8个块
+        bitmap->Set(kPageCount - 1);
+        ChunkDigest digest;
+        std::string metaPage = EncodeMetaPage(bitmap);
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::FillMeta(
+            metaPage.data(), kFileSize, &digest));
+        ASSERT_EQ(kPageCount, digest.bitmapbits());
+        ASSERT_EQ(kPageSize, CurveSnapshotChunkDigest::PageSize(digest));
+        ASSERT_FALSE(CurveSnapshotChunkDigest::IsValidBlockSize(
+            digest, kPageSize + 1));
+        ASSERT_FALSE(CurveSnapshotChunkDigest::IsValidBlockSize(digest, 0));
+        ASSERT_TRUE(CurveSnapshotChunkDigest::IsValidBlockSize(
+            digest, kBlockSize));
+        for (uint32_t i = 0; i < 9; ++i) {
+            bool written = (i == 0 || i == 2 || i == 8);
+            ASSERT_EQ(written, CurveSnapshotChunkDigest::IsBlockWritten(
+                digest, kBlockSize, i)) << "block " << i;
+        }
+    }
+    // metapage损坏
+    {
+        ChunkDigest digest;
+        std::string metaPage = EncodeMetaPage(nullptr);
+        metaPage[1] += 1;
+        ASSERT_EQ(-1, CurveSnapshotChunkDigest::FillMeta(
+            metaPage.data(), kFileSize, &digest));
+    }
+}
+
+TEST_F(CurveSnapshotChunkDigestTest, Build) {
+    scoped_refptr<braft::PosixFileSystemAdaptor> fs(
+                new braft::PosixFileSystemAdaptor());
+    // 文件不存在
+    {
+        ChunkDigest digest;
+        ASSERT_EQ(-1, CurveSnapshotChunkDigest::Build(
+            fs.get(), kDigestTestFile, kBlockSize, true, &digest));
+    }
+
+    std::shared_ptr<Bitmap> bitmap = std::make_shared<Bitmap>(kPageCount);
+    bitmap->Set(3);
+    WriteChunkFile(EncodeMetaPage(bitmap));
+
+    // 不计算crc
+    {
+        ChunkDigest digest;
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::Build(
+            fs.get(), kDigestTestFile, kBlockSize, false, &digest));
+        ASSERT_EQ(3, digest.sn());
+        ASSERT_EQ(kFileSize, digest.filesize());
+        ASSERT_FALSE(CurveSnapshotChunkDigest::HasBlockCrc(
+            digest, kBlockSize));
+    }
+    // 只计算被写过的块的crc
+    {
+        ChunkDigest digest;
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::Build(
+            fs.get(), kDigestTestFile, kBlockSize, true, &digest));
+        ASSERT_TRUE(CurveSnapshotChunkDigest::HasBlockCrc(
+            digest, kBlockSize));
+
+        braft::FileAdaptor* file =
+            fs->open(kDigestTestFile, O_RDONLY, NULL, NULL);
+        ASSERT_TRUE(file != NULL);
+        std::string buf;
+        for (uint32_t i = 0; i < 9; ++i) {
+            if (i == 0 || i == 2) {
+                ASSERT_EQ(0, CurveSnapshotChunkDigest::ReadBlock(
+                    file, i * kBlockSize, kBlockSize, &buf));
+                ASSERT_EQ(CurveSnapshotChunkDigest::BlockCrc(
+                    buf.data(), buf.size()), digest.blockcrc(i));
+            } else {
+                ASSERT_EQ(0, digest.blockcrc(i));
+            }
+        }
+        // 读取超出文件范围
+        ASSERT_EQ(-1, CurveSnapshotChunkDigest::ReadBlock(
+            file, 8 * kBlockSize, kBlockSize, &buf));
+        file->close();
+        delete file;
+    }
+    // 块大小没有按page对齐
+    {
+        ChunkDigest digest;
+        ASSERT_EQ(-1, CurveSnapshotChunkDigest::Build(
+            fs.get(), kDigestTestFile, kPageSize + 1, true, &digest));
+    }
+}
+
+TEST_F(CurveSnapshotChunkDigestTest, CopyBlocks) {
+    scoped_refptr<braft::PosixFileSystemAdaptor> fs(
+                new braft::PosixFileSystemAdaptor());
+    // 第2和第4个块被写过，最后一个块没有被写过
+    std::shared_ptr<Bitmap> bitmap = std::make_shared<Bitmap>(kPageCount);
+    bitmap->Set(3);
+    bitmap->Set(7);
+    std::string metaPage = EncodeMetaPage(bitmap);
+    WriteChunkFile(metaPage);
+    // 本地chunk的第2个块与leader不同，第4个块相同
+    WriteChunkFile(metaPage, kDigestLocalFile);
+    int fd = ::open(kDigestLocalFile, O_RDWR);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(1, ::pwrite(fd, "z", 1, 2 * kBlockSize));
+    ::close(fd);
+
+    ChunkDigest digest;
+    ASSERT_EQ(0, CurveSnapshotChunkDigest::Build(
+        fs.get(), kDigestTestFile, kBlockSize, true, &digest));
+
+    braft::FileAdaptor* leader =
+        fs->open(kDigestTestFile, O_RDONLY, NULL, NULL);
+    ASSERT_TRUE(leader != NULL);
+    std::vector<off_t> fetched;
+    BlockFetcher fetch = [&](off_t offset, size_t len, butil::IOBuf* out) {
+        fetched.push_back(offset);
+        butil::IOPortal portal;
+        if (leader->read(&portal, offset, len) != static_cast<ssize_t>(len)) {
+            return -1;
+        }
+        out->swap(portal);
+        return 0;
+    };
+
+    // crc相同的块从本地复制，不同的块从leader下载，没有写过的块不写入
+    {
+        braft::FileAdaptor* local =
+            fs->open(kDigestLocalFile, O_RDONLY, NULL, NULL);
+        ASSERT_TRUE(local != NULL);
+        braft::FileAdaptor* dest =
+            fs->open(kDigestDestFile, O_CREAT | O_RDWR, NULL, NULL);
+        ASSERT_TRUE(dest != NULL);
+        uint64_t localBytes = 0;
+        uint64_t remoteBytes = 0;
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::CopyBlocks(
+            digest, kBlockSize, local, dest, fetch,
+            &localBytes, &remoteBytes));
+        ASSERT_EQ(1, fetched.size());
+        ASSERT_EQ(2 * kBlockSize, fetched[0]);
+        ASSERT_EQ(2 * kBlockSize, localBytes);
+        ASSERT_EQ(kBlockSize, remoteBytes);
+        // 最后一个块没有写入，文件需要扩展到原始大小
+        ASSERT_EQ(5 * kBlockSize, dest->size());
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::ExtendFile(
+            dest, kDigestDestFile, kFileSize));
+        ASSERT_EQ(kFileSize, dest->size());
+        // 文件已经足够大时不做修改
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::ExtendFile(
+            dest, kDigestDestFile, kBlockSize));
+        ASSERT_EQ(kFileSize, dest->size());
+
+        std::string expected;
+        std::string actual;
+        for (uint32_t i : {0, 2, 4}) {
+            ASSERT_EQ(0, CurveSnapshotChunkDigest::ReadBlock(
+                leader, i * kBlockSize, kBlockSize, &expected));
+            ASSERT_EQ(0, CurveSnapshotChunkDigest::ReadBlock(
+                dest, i * kBlockSize, kBlockSize, &actual));
+            ASSERT_EQ(expected, actual) << "block " << i;
+        }
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::ReadBlock(
+            dest, 8 * kBlockSize, kPageSize, &actual));
+        ASSERT_EQ(std::string(kPageSize, 0), actual);
+        local->close();
+        delete local;
+        dest->close();
+        delete dest;
+    }
+    // 没有本地chunk时被写过的块都从leader下载
+    {
+        ::unlink(kDigestDestFile);
+        fetched.clear();
+        braft::FileAdaptor* dest =
+            fs->open(kDigestDestFile, O_CREAT | O_RDWR, NULL, NULL);
+        ASSERT_TRUE(dest != NULL);
+        uint64_t localBytes = 0;
+        uint64_t remoteBytes = 0;
+        ASSERT_EQ(0, CurveSnapshotChunkDigest::CopyBlocks(
+            digest, kBlockSize, NULL, dest, fetch,
+            &localBytes, &remoteBytes));
+        ASSERT_EQ(3, fetched.size());
+        ASSERT_EQ(0, localBytes);
+        ASSERT_EQ(3 * kBlockSize, remoteBytes);
+        dest->close();
+        delete dest;
+    }
+    // 下载失败
+    {
+        ::unlink(kDigestDestFile);
+        braft::FileAdaptor* dest =
+            fs->open(kDigestDestFile, O_CREAT | O_RDWR, NULL, NULL);
+        ASSERT_TRUE(dest != NULL);
+        BlockFetcher failFetch = [](off_t, size_t, butil::IOBuf*) {
+            return -1;
+        };
+        uint64_t localBytes = 0;
+        uint64_t remoteBytes = 0;
+        ASSERT_EQ(-1, CurveSnapshotChunkDigest::CopyBlocks(
+            digest, kBlockSize, NULL, dest, failFetch,
+            &localBytes, &remoteBytes));
+        dest->close();
+        delete dest;
+    }
+    leader->close();
+    delete leader;
+}
+
+}  // namespace chunkserver
+}  // namespace curve
@@ -2323,5 +2323,59 @@ TEST_F(MDSClientRefreshSessionTest, NoStartDummyServerTest) {
     ASSERT_FALSE(request.has_clientip());
 }
 
+TEST(MetaCacheReadPeerTest, GetReadPeerTest) {
+    curve::client::MetaCache mc;
+    ChunkServerID csId;
+    curve::client::EndPoint csAddr;
+    bool isLeader = false;
+    // copyset不存在
+    ASSERT_EQ(-1, mc.GetReadPeer(1, 1, 0, &csId, &csAddr, &isLeader));
+
+    curve::client::CopysetInfo_t cpinfo;
+    for (int i = 1; i <= 3; ++i) {
+        curve::client::EndPoint ep;
+        butil::str2endpoint("192.0.2.1", 8200 + i, &ep);
+        cpinfo.AddCopysetPeerInfo(
+            CopysetPeerInfo(i, curve::client::ChunkServerAddr(ep)));
+    }
+    cpinfo.leaderindex_ = 0;
+    mc.UpdateCopysetInfo(1, 1, cpinfo);
+
+    // 负载相同时按照chunkid打散
+    ASSERT_EQ(0, mc.GetReadPeer(1, 1, 1, &csId, &csAddr, &isLeader));
+    ASSERT_EQ(2, csId);
+    ASSERT_EQ(8202, csAddr.port);
+    ASSERT_FALSE(isLeader);
+    ASSERT_EQ(0, mc.GetReadPeer(1, 1, 3, &csId, &csAddr, &isLeader));
+    ASSERT_EQ(1, csId);
+    ASSERT_TRUE(isLeader);
+
+    // 选择在途读请求最少的副本
+    mc.OnReadSent(1);
+    mc.OnReadSent(2);
+    ASSERT_EQ(0, mc.GetReadPeer(1, 1, 0, &csId, &csAddr, &isLeader));
+    ASSERT_EQ(3, csId);
+    mc.OnReadDone(1, false, false);
+    ASSERT_EQ(0, mc.GetReadPeer(1, 1, 0, &csId, &csAddr, &isLeader));
+    ASSERT_EQ(1, csId);
+
+    // 读失败的副本被暂时排除
+    mc.OnReadSent(3);
+    mc.OnReadDone(3, true, false);
+    mc.OnReadDone(2, false, false);
+    ASSERT_EQ(0, mc.GetReadPeer(1, 1, 2, &csId, &csAddr, &isLeader));
+    ASSERT_EQ(1, csId);
+    mc.OnReadSent(1);
+    mc.OnReadSent(1);
+    ASSERT_EQ(0, mc.GetReadPeer(1, 1, 2, &csId, &csAddr, &isLeader));
+    ASSERT_EQ(2, csId);
+
+    // 返回重定向的副本也被暂时排除
+    mc.OnReadSent(2);
+    mc.OnReadDone(2, false, true);
+    ASSERT_EQ(0, mc.GetReadPeer(1, 1, 2, &csId, &csAddr, &isLeader));
+    ASSERT_EQ(1, csId);
+}
+
 }  // namespace client
 }  // namespace curve
@@ -28,6 +28,7 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <atomic>
 #include <set>
 
 #include "proto/chunk.pb.h"
@@ -41,6 +42,7 @@ using ::testing::Invoke;
 
 using curve::chunkserver::ChunkService;
 using curve::chunkserver::CHUNK_OP_STATUS;
+using curve::chunkserver::CHUNK_OP_TYPE;
 
 /* 当前仅仅模拟单 chunk read/write */
 class FakeChunkServiceImpl : public ChunkService {
@@ -74,6 +76,34 @@ class FakeChunkServiceImpl : public ChunkService {
         response->set_status(CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS);
     }
 
+    void BatchChunk(::google::protobuf::RpcController *controller,
+                    const ::curve::chunkserver::BatchChunkRequest *request,
+                    ::curve::chunkserver::BatchChunkResponse *response,
+                    google::protobuf::Closure *done) {
+        brpc::ClosureGuard doneGuard(done);
+
+        batchCount_++;
+        brpc::Controller *cntl = dynamic_cast<brpc::Controller *>(controller);
+        butil::IOBuf &data = cntl->request_attachment();
+        for (int i = 0; i < request->requests_size(); ++i) {
+            const ::curve::chunkserver::ChunkRequest &subRequest =
+                request->requests(i);
+            if (subRequest.optype() == CHUNK_OP_TYPE::CHUNK_OP_WRITE) {
+                chunkIds_.insert(subRequest.chunkid());
+                data.cutn(chunk_ + subRequest.offset(), subRequest.size());
+            } else {
+                cntl->response_attachment().append(
+                    chunk_ + subRequest.offset(), subRequest.size());
+            }
+            response->add_responses()->set_status(
+                CHUNK_OP_STATUS::CHUNK_OP_STATUS_SUCCESS);
+        }
+    }
+
+    int GetBatchCount() {
+        return batchCount_;
+    }
+
     void ReadChunkSnapshot(::google::protobuf::RpcController *controller,
                            const ::curve::chunkserver::ChunkRequest *request,
                            ::curve::chunkserver::ChunkResponse *response,
@@ -135,6 +165,7 @@ class FakeChunkServiceImpl : public ChunkService {
     /* 由于 bthread 栈空间的限制，这里不会开很大的空间，如果测试需要更大的空间
      * 请在堆上申请 */
     char chunk_[4096] = {0};
+    std::atomic<int> batchCount_{0};
 };
 
 class MockChunkServiceImpl : public ChunkService {
@@ -25,6 +25,9 @@
 #include <gmock/gmock.h>
 #include <brpc/channel.h>
 
+#include <list>
+#include <vector>
+
 #include "src/client/request_scheduler.h"
 #include "src/client/client_common.h"
 #include "test/client/mock_meta_cache.h"
@@ -597,5 +600,80 @@ TEST(RequestSchedulerTest, CommonTest) {
     ASSERT_EQ(0, sche.Fini());
 }
 
+TEST(RequestSchedulerTest, BatchRequestTest) {
+    RequestScheduleOption_t opt;
+    opt.scheduleQueueCapacity = 4096;
+    opt.scheduleThreadpoolSize = 2;
+    opt.ioSenderOpt.failRequestOpt.chunkserverRPCTimeoutMS = 200;
+    opt.ioSenderOpt.failRequestOpt.chunkserverOPMaxRetry = 5;
+    opt.ioSenderOpt.failRequestOpt.chunkserverOPRetryIntervalUS = 5000;
+    opt.ioSenderOpt.chunkserverEnableAppliedIndexRead = 1;
+    opt.ioSenderOpt.chunkserverBatchRequestMaxCount = 2;
+
+    brpc::Server server;
+    std::string listenAddr = "127.0.0.1:9109";
+    FakeChunkServiceImpl fakeChunkService;
+    ASSERT_EQ(server.AddService(&fakeChunkService,
+                                brpc::SERVER_DOESNT_OWN_SERVICE), 0);
+    brpc::ServerOptions option;
+    option.idle_timeout_sec = -1;
+    ASSERT_EQ(server.Start(listenAddr.c_str(), &option), 0);
+
+    RequestScheduler requestScheduler;
+    MockMetaCache mockMetaCache;
+    mockMetaCache.DelegateToFake();
+    EXPECT_CALL(mockMetaCache, GetLeader(_, _, _, _, _, _)).Times(AnyNumber());
+    ASSERT_EQ(0, requestScheduler.Init(opt, &mockMetaCache));
+    ASSERT_EQ(0, requestScheduler.Run());
+
+    FileMetric fm("test");
+    IOTracker iot(nullptr, nullptr, nullptr, &fm);
+    const int kCount = 3;
+    const size_t len = 16;
+    char writebuff[kCount][len];
+    char readbuff[kCount][len];
+    for (int i = 0; i < kCount; ++i) {
+        memset(writebuff[i], 'a' + i, len);
+        memset(readbuff[i], '0', len);
+    }
+
+    // 同一copyset上的请求每2个合并成一个rpc
+    for (OpType type : {OpType::WRITE, OpType::READ}) {
+        curve::common::CountDownEvent cond(kCount);
+        std::list<RequestContext *> reqCtxs;
+        std::vector<RequestClosure *> reqDones;
+        for (int i = 0; i < kCount; ++i) {
+            RequestContext *reqCtx = new FakeRequestContext();
+            reqCtx->optype_ = type;
+            reqCtx->idinfo_ = ChunkIDInfo(i + 1, 1, 100001);
+            reqCtx->writeBuffer_ = writebuff[i];
+            reqCtx->readBuffer_ = readbuff[i];
+            reqCtx->offset_ = i * len;
+            reqCtx->rawlength_ = len;
+
+            RequestClosure *reqDone = new FakeRequestClosure(&cond, reqCtx);
+            reqDone->SetFileMetric(&fm);
+            reqDone->SetIOTracker(&iot);
+            reqCtx->done_ = reqDone;
+            reqCtxs.push_back(reqCtx);
+            reqDones.push_back(reqDone);
+        }
+        ASSERT_EQ(0, requestScheduler.ScheduleRequest(reqCtxs));
+        cond.Wait();
+        for (auto reqDone : reqDones) {
+            ASSERT_EQ(0, reqDone->GetErrorCode());
+        }
+    }
+    for (int i = 0; i < kCount; ++i) {
+        ASSERT_EQ(0, memcmp(writebuff[i], readbuff[i], len));
+    }
+    // 每次IO的前两个请求合并成一个rpc，第三个请求单独下发
+    ASSERT_EQ(2, fakeChunkService.GetBatchCount());
+
+    requestScheduler.Fini();
+    ASSERT_EQ(0, server.Stop(0));
+    ASSERT_EQ(0, server.Join());
+}
+
 }   // namespace client
 }   // namespace curve
@@ -0,0 +1,114 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "src/common/aligned_buffer_pool.h"
+
+namespace curve {
+namespace common {
+
+TEST(AlignedBufferPoolTest, AlignTest) {
+    ASSERT_TRUE(IsAlignedTo(0, 4096));
+    ASSERT_TRUE(IsAlignedTo(8192, 4096));
+    ASSERT_FALSE(IsAlignedTo(512, 4096));
+    ASSERT_EQ(4096, AlignDown(8191, 4096));
+    ASSERT_EQ(8192, AlignUp(4097, 4096));
+    ASSERT_EQ(4096, AlignUp(4096, 4096));
+}
+
+TEST(AlignedBufferPoolTest, GetAndPutTest) {
+    size_t cached = AlignedBufferPool::ThreadCachedBytes();
+    char* data = nullptr;
+    {
+        // 按大小等级向上取整
+        AlignedBuffer buf = AlignedBufferPool::Get(5000);
+        ASSERT_NE(nullptr, buf.Data());
+        ASSERT_EQ(8192, buf.Capacity());
+        ASSERT_TRUE(IsAlignedTo(reinterpret_cast<uintptr_t>(buf.Data()),
+                                kDirectIOAlignment));
+        data = buf.Data();
+    }
+    // 归还后进入当前线程的缓存，再次申请同一等级时复用
+    ASSERT_EQ(cached + 8192, AlignedBufferPool::ThreadCachedBytes());
+    {
+        AlignedBuffer buf = AlignedBufferPool::Get(8192);
+        ASSERT_EQ(data, buf.Data());
+        ASSERT_EQ(cached, AlignedBufferPool::ThreadCachedBytes());
+    }
+
+    // 移动后只归还一次
+    {
+        AlignedBuffer buf1 = AlignedBufferPool::Get(4096);
+        AlignedBuffer buf2(std::move(buf1));
+        ASSERT_EQ(nullptr, buf1.Data());
+        ASSERT_NE(nullptr, buf2.Data());
+        AlignedBuffer buf3;
+        buf3 = std::move(buf2);
+        ASSERT_EQ(nullptr, buf2.Data());
+        ASSERT_EQ(4096, buf3.Capacity());
+    }
+}
+
+TEST(AlignedBufferPoolTest, LargeBufferTest) {
+    size_t cached = AlignedBufferPool::ThreadCachedBytes();
+    {
+        // 超过最大等级的申请不经过缓存
+        size_t size = AlignedBufferPool::kMaxBufferSize + 1;
+        AlignedBuffer buf = AlignedBufferPool::Get(size);
+        ASSERT_NE(nullptr, buf.Data());
+        ASSERT_EQ(AlignUp(size, kDirectIOAlignment), buf.Capacity());
+        ASSERT_TRUE(IsAlignedTo(reinterpret_cast<uintptr_t>(buf.Data()),
+                                kDirectIOAlignment));
+    }
+    ASSERT_EQ(cached, AlignedBufferPool::ThreadCachedBytes());
+}
+
+TEST(AlignedBufferPoolTest, CacheLimitTest) {
+    // 每个等级缓存的内存不超过上限，超出的部分直接释放
+    size_t size = AlignedBufferPool::kMaxBufferSize;
+    size_t count = AlignedBufferPool::kMaxCachedBytesPerClass / size + 2;
+    size_t cached = AlignedBufferPool::ThreadCachedBytes();
+    {
+        std::vector<AlignedBuffer> bufs;
+        for (size_t i = 0; i < count; ++i) {
+            bufs.push_back(AlignedBufferPool::Get(size));
+        }
+    }
+    ASSERT_EQ(cached + AlignedBufferPool::kMaxCachedBytesPerClass,
+              AlignedBufferPool::ThreadCachedBytes());
+
+    // 各线程的缓存相互独立
+    std::thread t([] {
+        ASSERT_EQ(0, AlignedBufferPool::ThreadCachedBytes());
+        AlignedBuffer buf = AlignedBufferPool::Get(4096);
+        ASSERT_NE(nullptr, buf.Data());
+    });
+    t.join();
+}
+
+}  // namespace common
+}  // namespace curve
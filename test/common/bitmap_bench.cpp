@@ -0,0 +1,176 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+/**
+ * Bitmap查找性能测试
+ * 对比逐位查找的旧实现和按64位word查找的新实现
+ * 用法: bitmap-bench --bits=4096 --iterations=100000
+ */
+
+#include <gflags/gflags.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>  // NOLINT
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "src/common/bitmap.h"
+
+DEFINE_uint32(bits, 4096, "Bit number of bitmap");
+DEFINE_uint64(iterations, 100000, "Iterations of each kernel");
+
+using curve::common::Bitmap;
+using curve::common::BitRange;
+
+namespace {
+
+// 以下为逐位查找的旧实现
+uint32_t LegacyNextSetBit(const Bitmap& bitmap,
+                          uint32_t index, uint32_t endIndex) {
+    if (endIndex > bitmap.Size() - 1)
+        endIndex = bitmap.Size() - 1;
+    for (; index <= endIndex; ++index) {
+        if (bitmap.Test(index))
+            return index;
+    }
+    return Bitmap::NO_POS;
+}
+
+uint32_t LegacyNextClearBit(const Bitmap& bitmap,
+                            uint32_t index, uint32_t endIndex) {
+    if (endIndex > bitmap.Size() - 1)
+        endIndex = bitmap.Size() - 1;
+    for (; index <= endIndex; ++index) {
+        if (!bitmap.Test(index))
+            return index;
+    }
+    return Bitmap::NO_POS;
+}
+
+void LegacyDivide(const Bitmap& bitmap,
+                  uint32_t startIndex,
+                  uint32_t endIndex,
+                  std::vector<BitRange>* clearRanges,
+                  std::vector<BitRange>* setRanges) {
+    while (startIndex != Bitmap::NO_POS) {
+        uint32_t nextClear = LegacyNextClearBit(bitmap, startIndex, endIndex);
+        if (nextClear != startIndex) {
+            BitRange range;
+            range.beginIndex = startIndex;
+            range.endIndex = nextClear == Bitmap::NO_POS
+                           ? endIndex : nextClear - 1;
+            setRanges->push_back(range);
+        }
+        if (nextClear == Bitmap::NO_POS)
+            break;
+        uint32_t nextSet = LegacyNextSetBit(bitmap, nextClear, endIndex);
+        BitRange range;
+        range.beginIndex = nextClear;
+        range.endIndex = nextSet == Bitmap::NO_POS ? endIndex : nextSet - 1;
+        clearRanges->push_back(range);
+        startIndex = nextSet;
+    }
+}
+
+// 返回每次调用的平均耗时，单位ns
+double Measure(const std::function<uint64_t()>& kernel) {
+    uint64_t sink = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < FLAGS_iterations; ++i) {
+        sink += kernel();
+    }
+    auto end = std::chrono::steady_clock::now();
+    // 防止编译器优化掉kernel的调用
+    if (sink == 1) {
+        printf(" ");
+    }
+    return std::chrono::duration<double, std::nano>(end - begin).count()
+           / FLAGS_iterations;
+}
+
+void RunCase(const std::string& name, const Bitmap& bitmap) {
+    uint32_t last = bitmap.Size() - 1;
+    double legacySet = Measure([&] {
+        return LegacyNextSetBit(bitmap, 0, last);
+    });
+    double newSet = Measure([&] {
+        return bitmap.NextSetBit(0, last);
+    });
+    double legacyClear = Measure([&] {
+        return LegacyNextClearBit(bitmap, 0, last);
+    });
+    double newClear = Measure([&] {
+        return bitmap.NextClearBit(0, last);
+    });
+    double legacyDivide = Measure([&] {
+        std::vector<BitRange> clearRanges;
+        std::vector<BitRange> setRanges;
+        LegacyDivide(bitmap, 0, last, &clearRanges, &setRanges);
+        return clearRanges.size() + setRanges.size();
+    });
+    double newDivide = Measure([&] {
+        std::vector<BitRange> clearRanges;
+        std::vector<BitRange> setRanges;
+        bitmap.Divide(0, last, &clearRanges, &setRanges);
+        return clearRanges.size() + setRanges.size();
+    });
+    printf("%-12s %-14s %12.1f %12.1f %8.2f\n", name.c_str(), "NextSetBit",
+           legacySet, newSet, legacySet / newSet);
+    printf("%-12s %-14s %12.1f %12.1f %8.2f\n", name.c_str(), "NextClearBit",
+           legacyClear, newClear, legacyClear / newClear);
+    printf("%-12s %-14s %12.1f %12.1f %8.2f\n", name.c_str(), "Divide",
+           legacyDivide, newDivide, legacyDivide / newDivide);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    google::ParseCommandLineFlags(&argc, &argv, true);
+    if (FLAGS_bits == 0) {
+        fprintf(stderr, "bits must be greater than 0\n");
+        return -1;
+    }
+
+    printf("%-12s %-14s %12s %12s %8s\n",
+           "bitmap", "kernel", "legacy(ns)", "word(ns)", "speedup");
+    // 全0和全1，分别是查找1和查找0的最坏情况
+    Bitmap empty(FLAGS_bits);
+    RunCase("empty", empty);
+    Bitmap full(FLAGS_bits);
+    full.Set();
+    RunCase("full", full);
+    // 只有末尾一位被写过，模拟刚开始写入的clone chunk
+    Bitmap tail(FLAGS_bits);
+    tail.Set(FLAGS_bits - 1);
+    RunCase("tail", tail);
+    // 随机写入若干段连续区域
+    Bitmap random(FLAGS_bits);
+    unsigned int seed = 0;
+    for (int i = 0; i < 16; ++i) {
+        uint32_t begin = rand_r(&seed) % FLAGS_bits;
+        random.Set(begin, begin + rand_r(&seed) % 128);
+    }
+    RunCase("random", random);
+    return 0;
+}
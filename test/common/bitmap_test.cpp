@@ -21,6 +21,7 @@
  */
 
 #include <gtest/gtest.h>
+#include <stdlib.h>
 
 #include "src/common/bitmap.h"
 
@@ -415,5 +416,76 @@ TEST(BitmapTEST, divide_test) {
     }
 }
 
+// 按位查找，作为按word查找结果的参照
+static uint32_t NaiveNext(const Bitmap& bitmap, uint32_t start,
+                          uint32_t end, bool value) {
+    for (uint32_t i = start; i <= end && i < bitmap.Size(); ++i) {
+        if (bitmap.Test(i) == value)
+            return i;
+    }
+    return Bitmap::NO_POS;
+}
+
+TEST(BitmapTEST, word_scan_test) {
+    // 位数不是64的整数倍，验证末尾不完整的word
+    const uint32_t bits = 4096 + 37;
+    unsigned int seed = 1234;
+    for (int round = 0; round < 20; ++round) {
+        Bitmap bitmap(bits);
+        if (round % 2 == 1) {
+            bitmap.Set();
+        }
+        // 随机置位或清除若干段，构造跨word的连续区域
+        for (int i = 0; i < round * 4; ++i) {
+            uint32_t begin = rand_r(&seed) % bits;
+            uint32_t end = begin + rand_r(&seed) % 300;
+            if (rand_r(&seed) % 2) {
+                bitmap.Set(begin, end);
+                for (uint32_t j = begin; j <= end && j < bits; ++j) {
+                    ASSERT_TRUE(bitmap.Test(j));
+                }
+            } else {
+                bitmap.Clear(begin, end);
+                for (uint32_t j = begin; j <= end && j < bits; ++j) {
+                    ASSERT_FALSE(bitmap.Test(j));
+                }
+            }
+        }
+        for (int i = 0; i < 200; ++i) {
+            uint32_t start = rand_r(&seed) % (bits + 10);
+            uint32_t end = start + rand_r(&seed) % 1000;
+            ASSERT_EQ(NaiveNext(bitmap, start, end, true),
+                      bitmap.NextSetBit(start, end));
+            ASSERT_EQ(NaiveNext(bitmap, start, end, false),
+                      bitmap.NextClearBit(start, end));
+            ASSERT_EQ(NaiveNext(bitmap, start, bits, true),
+                      bitmap.NextSetBit(start));
+            ASSERT_EQ(NaiveNext(bitmap, start, bits, false),
+                      bitmap.NextClearBit(start));
+        }
+
+        // 划分出的区域首尾相接且位状态一致
+        vector<BitRange> clearRanges;
+        vector<BitRange> setRanges;
+        bitmap.Divide(0, bits - 1, &clearRanges, &setRanges);
+        uint32_t covered = 0;
+        for (const auto& range : clearRanges) {
+            ASSERT_EQ(Bitmap::NO_POS, NaiveNext(bitmap, range.beginIndex,
+                                                range.endIndex, true));
+            covered += range.endIndex - range.beginIndex + 1;
+        }
+        for (const auto& range : setRanges) {
+            ASSERT_EQ(Bitmap::NO_POS, NaiveNext(bitmap, range.beginIndex,
+                                                range.endIndex, false));
+            covered += range.endIndex - range.beginIndex + 1;
+        }
+        ASSERT_EQ(bits, covered);
+
+        // 持久化格式不变，从内存拷贝后内容一致
+        Bitmap copy(bits, bitmap.GetBitmap());
+        ASSERT_EQ(bitmap, copy);
+    }
+}
+
 }  // namespace common
 }  // namespace curve
@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-12-14
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>   //NOLINT
+#include <vector>
+
+#include "src/common/concurrent/mpmc_ring_queue.h"
+
+namespace curve {
+namespace common {
+
+TEST(MPMCRingQueueTest, basic) {
+    MPMCRingQueue<int> queue(4);
+    ASSERT_EQ(4, queue.Capacity());
+    int value = 0;
+    ASSERT_FALSE(queue.TryPop(&value));
+
+    // 绕环多圈，检查先进先出和满、空的判断
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            ASSERT_TRUE(queue.TryPush(round * 10 + i));
+        }
+        ASSERT_EQ(4, queue.Size());
+        ASSERT_FALSE(queue.TryPush(100));
+        for (int i = 0; i < 4; ++i) {
+            ASSERT_TRUE(queue.TryPop(&value));
+            ASSERT_EQ(round * 10 + i, value);
+        }
+        ASSERT_EQ(0, queue.Size());
+        ASSERT_FALSE(queue.TryPop(&value));
+    }
+}
+
+TEST(MPMCRingQueueTest, MultiProducerMultiConsumer) {
+    const int kProducer = 4;
+    const int kConsumer = 4;
+    const int kPerProducer = 100000;
+    MPMCRingQueue<uint64_t> queue(64);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducer; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (uint64_t i = 0; i < kPerProducer; ++i) {
+                uint64_t value = (static_cast<uint64_t>(p) << 32) | i;
+                while (!queue.TryPush(value)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // 每个消费者看到的同一个生产者的数据是递增的，且所有数据不丢失不重复
+    std::atomic<int> total(0);
+    std::vector<std::vector<uint64_t>> counts(
+        kConsumer, std::vector<uint64_t>(kProducer, 0));
+    std::vector<std::thread> consumers;
+    std::atomic<bool> ordered(true);
+    for (int c = 0; c < kConsumer; ++c) {
+        consumers.emplace_back([&, c]() {
+            std::vector<int64_t> last(kProducer, -1);
+            uint64_t value;
+            while (total.load() < kProducer * kPerProducer) {
+                if (!queue.TryPop(&value)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                int p = value >> 32;
+                int64_t seq = value & 0xFFFFFFFF;
+                if (seq <= last[p]) {
+                    ordered.store(false);
+                }
+                last[p] = seq;
+                ++counts[c][p];
+                total.fetch_add(1);
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    for (auto& t : consumers) {
+        t.join();
+    }
+    ASSERT_TRUE(ordered.load());
+    for (int p = 0; p < kProducer; ++p) {
+        uint64_t sum = 0;
+        for (int c = 0; c < kConsumer; ++c) {
+            sum += counts[c][p];
+        }
+        ASSERT_EQ(kPerProducer, sum);
+    }
+    ASSERT_EQ(0, queue.Size());
+}
+
+}  // namespace common
+}  // namespace curve
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+
+#include <thread>   //NOLINT
+#include <vector>
+
+#include "src/common/concurrent/mpsc_ring_queue.h"
+
+namespace curve {
+namespace common {
+
+TEST(MPSCRingQueueTest, basic) {
+    // 容量向上取整为2的幂，最小为2
+    {
+        MPSCRingQueue<int> queue(1);
+        ASSERT_EQ(2, queue.Capacity());
+        MPSCRingQueue<int> queue2(100);
+        ASSERT_EQ(128, queue2.Capacity());
+    }
+
+    MPSCRingQueue<int> queue(4);
+    int value = 0;
+    ASSERT_TRUE(queue.Empty());
+    ASSERT_FALSE(queue.Full());
+    ASSERT_FALSE(queue.TryPop(&value));
+    ASSERT_EQ(nullptr, queue.Front());
+
+    // 绕环多圈，检查先进先出和满、空的判断
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            ASSERT_TRUE(queue.TryPush(round * 10 + i));
+        }
+        ASSERT_TRUE(queue.Full());
+        ASSERT_FALSE(queue.TryPush(100));
+        ASSERT_EQ(round * 10, *queue.Front());
+        for (int i = 0; i < 4; ++i) {
+            ASSERT_TRUE(queue.TryPop(&value));
+            ASSERT_EQ(round * 10 + i, value);
+        }
+        ASSERT_TRUE(queue.Empty());
+        ASSERT_FALSE(queue.TryPop(&value));
+    }
+}
+
+TEST(MPSCRingQueueTest, MultiProducer) {
+    const int kProducer = 4;
+    const int kPerProducer = 100000;
+    MPSCRingQueue<uint64_t> queue(64);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducer; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (uint64_t i = 0; i < kPerProducer; ++i) {
+                uint64_t value = (static_cast<uint64_t>(p) << 32) | i;
+                while (!queue.TryPush(value)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // 每个生产者的数据都按顺序出队，且不丢失不重复
+    std::vector<uint64_t> next(kProducer, 0);
+    int total = 0;
+    uint64_t value;
+    while (total < kProducer * kPerProducer) {
+        if (!queue.TryPop(&value)) {
+            continue;
+        }
+        int p = value >> 32;
+        ASSERT_EQ(next[p], value & 0xFFFFFFFF);
+        ++next[p];
+        ++total;
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    ASSERT_TRUE(queue.Empty());
+}
+
+}  // namespace common
+}  // namespace curve
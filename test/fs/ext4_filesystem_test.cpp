@@ -444,6 +444,39 @@ TEST_F(Ext4LocalFileSystemTest, WriteTest) {
 }
 
 // test Fallocate
+TEST_F(Ext4LocalFileSystemTest, WritevTest) {
+    char buf1[2] = {0};
+    char buf2[2] = {0};
+    struct iovec iov[2];
+    iov[0].iov_base = buf1;
+    iov[0].iov_len = sizeof(buf1);
+    iov[1].iov_base = buf2;
+    iov[1].iov_len = sizeof(buf2);
+    // success
+    EXPECT_CALL(*wrapper, pwritev(_, NotNull(), 2, 0))
+        .WillOnce(Return(4));
+    ASSERT_EQ(lfs->Writev(666, iov, 2, 0), 4);
+    // partial write, the remaining iovec will be written again
+    EXPECT_CALL(*wrapper, pwritev(_, NotNull(), 2, 0))
+        .WillOnce(Return(1));
+    EXPECT_CALL(*wrapper, pwritev(_, NotNull(), 2, 1))
+        .WillOnce(Return(1));
+    EXPECT_CALL(*wrapper, pwritev(_, NotNull(), 1, 2))
+        .WillOnce(Return(2));
+    ASSERT_EQ(lfs->Writev(666, iov, 2, 0), 4);
+    // pwritev failed
+    EXPECT_CALL(*wrapper, pwritev(_, NotNull(), _, _))
+        .WillOnce(Return(-1));
+    ASSERT_EQ(lfs->Writev(666, iov, 2, 0), -errno);
+    // set errno = EINTR,but only return -1 once
+    errno = EINTR;
+    EXPECT_CALL(*wrapper, pwritev(_, NotNull(), _, _))
+        .Times(2)
+        .WillOnce(Return(-1))
+        .WillOnce(Return(4));
+    ASSERT_EQ(lfs->Writev(666, iov, 2, 0), 4);
+}
+
 TEST_F(Ext4LocalFileSystemTest, FallocateTest) {
     // success
     EXPECT_CALL(*wrapper, fallocate(_, _, _, _))
@@ -455,6 +488,17 @@ TEST_F(Ext4LocalFileSystemTest, FallocateTest) {
     ASSERT_EQ(lfs->Fallocate(666, 0, 0, 4096), -errno);
 }
 
+TEST_F(Ext4LocalFileSystemTest, FtruncateTest) {
+    // success
+    EXPECT_CALL(*wrapper, ftruncate(666, 4096))
+        .WillOnce(Return(0));
+    ASSERT_EQ(lfs->Ftruncate(666, 4096), 0);
+    // ftruncate failed
+    EXPECT_CALL(*wrapper, ftruncate(666, 4096))
+        .WillOnce(Return(-1));
+    ASSERT_EQ(lfs->Ftruncate(666, 4096), -errno);
+}
+
 // test Fstat
 TEST_F(Ext4LocalFileSystemTest, FstatTest) {
     struct stat info;
@@ -480,6 +524,51 @@ TEST_F(Ext4LocalFileSystemTest, FsyncTest) {
     ASSERT_EQ(lfs->Fsync(666), -errno);
 }
 
+// test Fdatasync
+TEST_F(Ext4LocalFileSystemTest, FdatasyncTest) {
+    // success
+    EXPECT_CALL(*wrapper, fdatasync(666))
+        .WillOnce(Return(0));
+    ASSERT_EQ(lfs->Fdatasync(666), 0);
+    // fdatasync failed
+    EXPECT_CALL(*wrapper, fdatasync(666))
+        .WillOnce(Return(-1));
+    ASSERT_EQ(lfs->Fdatasync(666), -errno);
+}
+
+// 未开启io_uring时，异步接口在调用线程中同步完成
+TEST_F(Ext4LocalFileSystemTest, AsyncFallbackTest) {
+    ASSERT_FALSE(lfs->SupportAsyncIO());
+    char buf[4] = {0};
+    struct iovec iov[1] = {{buf, 4}};
+    int result = 0;
+    auto done = [&result](int rc) { result = rc; };
+
+    // read
+    EXPECT_CALL(*wrapper, pread(666, buf, 4, 0))
+        .WillOnce(Return(4));
+    ASSERT_EQ(0, lfs->ReadAsync(666, buf, 0, 4, done));
+    ASSERT_EQ(4, result);
+    // write failed
+    EXPECT_CALL(*wrapper, pwrite(666, buf, 4, 0))
+        .WillOnce(Return(-1));
+    ASSERT_EQ(0, lfs->WriteAsync(666, buf, 0, 4, done));
+    ASSERT_EQ(-errno, result);
+    // writev
+    EXPECT_CALL(*wrapper, pwritev(666, NotNull(), 1, 0))
+        .WillOnce(Return(4));
+    ASSERT_EQ(0, lfs->WritevAsync(666, iov, 1, 0, done));
+    ASSERT_EQ(4, result);
+    // fsync
+    EXPECT_CALL(*wrapper, fsync(666))
+        .WillOnce(Return(0));
+    result = -1;
+    ASSERT_EQ(0, lfs->FsyncAsync(666, done));
+    ASSERT_EQ(0, result);
+    // 不支持注册buffer
+    ASSERT_GT(0, lfs->RegisterBuffers(iov, 1));
+}
+
 TEST_F(Ext4LocalFileSystemTest, ReadRealTest) {
     std::shared_ptr<PosixWrapper> pw = std::make_shared<PosixWrapper>();
     lfs->SetPosixWrapper(pw);
@@ -0,0 +1,268 @@
+/*
+ *  Copyright (c) 2020 NetEase Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ * Project: curve
+ * File Created: 20-11-20
+ * Author: curve
+ */
+
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <cstring>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "src/fs/io_uring_engine.h"
+
+namespace curve {
+namespace fs {
+
+const char kTestFile[] = "./io_uring_engine_test.data";  // NOLINT
+const int kPageSize = 4096;
+
+// 等待指定数量的异步请求完成
+class AioWaiter {
+ public:
+    explicit AioWaiter(int count) : count_(count) {}
+
+    AioCallback Callback(int* result) {
+        return [this, result](int rc) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            *result = rc;
+            if (--count_ == 0) {
+                cond_.notify_all();
+            }
+        };
+    }
+
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cond_.wait(lock, [this] { return count_ == 0; });
+    }
+
+ private:
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    int count_;
+};
+
+class IOUringEngineTest : public testing::Test {
+ public:
+    void SetUp() {
+        fd_ = ::open(kTestFile, O_CREAT | O_RDWR | O_TRUNC, 0644);
+        ASSERT_LE(0, fd_);
+        int rc = engine_.Init(8);
+        // 内核不支持或被禁止使用io_uring时跳过
+        supported_ = (rc == 0);
+        if (!supported_) {
+            ASSERT_GT(0, rc);
+            ASSERT_FALSE(engine_.Running());
+        }
+    }
+
+    void TearDown() {
+        engine_.Stop();
+        ::close(fd_);
+        ::unlink(kTestFile);
+    }
+
+ protected:
+    IOUringEngine engine_;
+    int fd_;
+    bool supported_;
+};
+
+TEST_F(IOUringEngineTest, ReadWriteTest) {
+    if (!supported_) {
+        return;
+    }
+    std::vector<char> writeBuf(2 * kPageSize, 'a');
+    memset(writeBuf.data() + kPageSize, 'b', kPageSize);
+
+    // write
+    int result = -1;
+    {
+        AioWaiter waiter(1);
+        ASSERT_EQ(0, engine_.SubmitWrite(fd_, writeBuf.data(), 0,
+                                         2 * kPageSize,
+                                         waiter.Callback(&result)));
+        waiter.Wait();
+        ASSERT_EQ(2 * kPageSize, result);
+    }
+    // fsync
+    {
+        AioWaiter waiter(1);
+        ASSERT_EQ(0, engine_.SubmitFsync(fd_, true,
+                                         waiter.Callback(&result)));
+        waiter.Wait();
+        ASSERT_EQ(0, result);
+    }
+    // read
+    {
+        std::vector<char> readBuf(2 * kPageSize, 0);
+        AioWaiter waiter(1);
+        ASSERT_EQ(0, engine_.SubmitRead(fd_, readBuf.data(), 0,
+                                        2 * kPageSize,
+                                        waiter.Callback(&result)));
+        waiter.Wait();
+        ASSERT_EQ(2 * kPageSize, result);
+        ASSERT_EQ(0, memcmp(writeBuf.data(), readBuf.data(), 2 * kPageSize));
+    }
+    // 读超过文件末尾，返回实际读取的长度
+    {
+        std::vector<char> readBuf(2 * kPageSize, 0);
+        AioWaiter waiter(1);
+        ASSERT_EQ(0, engine_.SubmitRead(fd_, readBuf.data(), kPageSize,
+                                        2 * kPageSize,
+                                        waiter.Callback(&result)));
+        waiter.Wait();
+        ASSERT_EQ(kPageSize, result);
+        ASSERT_EQ(0, memcmp(writeBuf.data() + kPageSize,
+                            readBuf.data(), kPageSize));
+    }
+    // 无效的fd
+    {
+        char buf[kPageSize];
+        AioWaiter waiter(1);
+        ASSERT_EQ(0, engine_.SubmitRead(-1, buf, 0, kPageSize,
+                                        waiter.Callback(&result)));
+        waiter.Wait();
+        ASSERT_EQ(-EBADF, result);
+    }
+    // 长度为0的写直接完成，不会被当作写入0字节的错误
+    {
+        AioWaiter waiter(1);
+        ASSERT_EQ(0, engine_.SubmitWrite(fd_, writeBuf.data(), 0, 0,
+                                         waiter.Callback(&result)));
+        waiter.Wait();
+        ASSERT_EQ(0, result);
+    }
+}
+
+TEST_F(IOUringEngineTest, WritevTest) {
+    if (!supported_) {
+        return;
+    }
+    char a[kPageSize];
+    char b[2 * kPageSize];
+    memset(a, 'a', sizeof(a));
+    memset(b, 'b', sizeof(b));
+    struct iovec iov[3] = {{a, sizeof(a)}, {nullptr, 0}, {b, sizeof(b)}};
+
+    int result = -1;
+    AioWaiter waiter(1);
+    ASSERT_EQ(0, engine_.SubmitWritev(fd_, iov, 3, kPageSize,
+                                      waiter.Callback(&result)));
+    waiter.Wait();
+    ASSERT_EQ(3 * kPageSize, result);
+
+    std::vector<char> readBuf(3 * kPageSize, 0);
+    ASSERT_EQ(3 * kPageSize,
+              ::pread(fd_, readBuf.data(), 3 * kPageSize, kPageSize));
+    ASSERT_EQ(0, memcmp(a, readBuf.data(), kPageSize));
+    ASSERT_EQ(0, memcmp(b, readBuf.data() + kPageSize, 2 * kPageSize));
+}
+
+// 提交的请求数超过队列深度，提交者等待在途请求完成后继续提交
+TEST_F(IOUringEngineTest, ManyInflightTest) {
+    if (!supported_) {
+        return;
+    }
+    const int count = 64;
+    std::vector<char> data(count * kPageSize);
+    for (int i = 0; i < count; ++i) {
+        memset(data.data() + i * kPageSize, 'a' + i % 26, kPageSize);
+    }
+    ASSERT_EQ(count * kPageSize,
+              ::pwrite(fd_, data.data(), count * kPageSize, 0));
+
+    std::vector<char> readBuf(count * kPageSize, 0);
+    std::vector<int> results(count, -1);
+    AioWaiter waiter(count);
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(0, engine_.SubmitRead(fd_, readBuf.data() + i * kPageSize,
+                                        i * kPageSize, kPageSize,
+                                        waiter.Callback(&results[i])));
+    }
+    waiter.Wait();
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(kPageSize, results[i]);
+    }
+    ASSERT_EQ(0, memcmp(data.data(), readBuf.data(), count * kPageSize));
+}
+
+TEST_F(IOUringEngineTest, RegisterBuffersTest) {
+    if (!supported_) {
+        return;
+    }
+    std::vector<char> fixed(2 * kPageSize, 'f');
+    struct iovec iov = {fixed.data(), fixed.size()};
+    int rc = engine_.RegisterBuffers(&iov, 1);
+    // 受限于RLIMIT_MEMLOCK注册可能失败，此时仍可以正常读写
+    if (rc == 0) {
+        ASSERT_EQ(-EBUSY, engine_.RegisterBuffers(&iov, 1));
+    }
+
+    int result = -1;
+    {
+        AioWaiter waiter(1);
+        ASSERT_EQ(0, engine_.SubmitWrite(fd_, fixed.data(), 0, kPageSize,
+                                         waiter.Callback(&result)));
+        waiter.Wait();
+        ASSERT_EQ(kPageSize, result);
+    }
+    {
+        AioWaiter waiter(1);
+        ASSERT_EQ(0, engine_.SubmitRead(fd_, fixed.data() + kPageSize, 0,
+                                        kPageSize, waiter.Callback(&result)));
+        waiter.Wait();
+        ASSERT_EQ(kPageSize, result);
+    }
+    ASSERT_EQ(0, memcmp(fixed.data(), fixed.data() + kPageSize, kPageSize));
+}
+
+TEST_F(IOUringEngineTest, StopTest) {
+    if (!supported_) {
+        char buf[kPageSize];
+        ASSERT_GT(0, engine_.SubmitRead(fd_, buf, 0, kPageSize,
+                                        [](int rc) {}));
+        return;
+    }
+    char buf[kPageSize];
+    int result = -1;
+    AioWaiter waiter(1);
+    ASSERT_EQ(0, engine_.SubmitRead(fd_, buf, 0, kPageSize,
+                                    waiter.Callback(&result)));
+    // Stop会等待在途请求完成
+    engine_.Stop();
+    ASSERT_FALSE(engine_.Running());
+    waiter.Wait();
+    ASSERT_EQ(0, result);
+    // 停止后无法再提交
+    ASSERT_GT(0, engine_.SubmitRead(fd_, buf, 0, kPageSize, [](int rc) {}));
+    // 可以重新初始化
+    ASSERT_EQ(0, engine_.Init(8));
+    ASSERT_TRUE(engine_.Running());
+}
+
+}  // namespace fs
+}  // namespace curve
@@ -46,9 +46,12 @@ class MockPosixWrapper : public PosixWrapper {
     MOCK_METHOD1(closedir, int(DIR*));
     MOCK_METHOD4(pread, ssize_t(int, void*, size_t, off_t));
     MOCK_METHOD4(pwrite, ssize_t(int, const void*, size_t, off_t));
+    MOCK_METHOD4(pwritev, ssize_t(int, const struct iovec*, int, off_t));
     MOCK_METHOD4(fallocate, int(int, int, off_t, off_t));
+    MOCK_METHOD2(ftruncate, int(int, off_t));
     MOCK_METHOD2(fstat, int(int, struct stat*));
     MOCK_METHOD1(fsync, int(int));
+    MOCK_METHOD1(fdatasync, int(int));
     MOCK_METHOD2(statfs, int(const char*, struct statfs*));
     MOCK_METHOD1(uname, int(struct utsname *));
 };